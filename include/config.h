@@ -155,6 +155,33 @@ namespace vc4c
          * NOTE: Setting this to a large value might lead to very long compilation times.
          */
         unsigned maxCommonExpressionDinstance = 64;
+
+        /*
+         * The minimum number of basic blocks in a method to run block-local optimizations in parallel for independent
+         * basic blocks.
+         *
+         * A value of zero disables the parallel execution of block-local optimizations.
+         */
+        unsigned parallelBlockThreshold = 8;
+
+        /*
+         * The minimum number of instructions in a method to only revisit modified basic blocks (and the blocks
+         * depending on them) in block-local optimizations repeated until no more changes are made.
+         *
+         * A value of zero disables this and always visits all basic blocks.
+         *
+         * NOTE: Determining the blocks to revisit has an overhead per iteration which did not pay off for any of the
+         * measured kernels (compilation times and generated code did not change noticeably), and is therefore opt-in.
+         */
+        unsigned worklistThreshold = 0;
+
+        /*
+         * The maximum number of TMU loads within a loop to be prefetched for the next iteration.
+         *
+         * NOTE: Prefetching more than a single load is known to produce wrong results for some kernels (e.g. Pearson16)
+         * and is therefore opt-in.
+         */
+        unsigned maxPrefetchedLoads = 1;
     };
 
     /*
@@ -205,6 +232,32 @@ namespace vc4c
          * Whether to stop compilation when instruction verification failed
          */
         bool stopWhenVerificationFailed = true;
+        /*
+         * The directory to store and look up cached compilation results in.
+         *
+         * If set, the results of Compiler#compile are cached on disk keyed by the input, this configuration, the
+         * compilation options and the compiler version. If a matching entry exists, it is returned directly without
+         * running the actual compilation.
+         *
+         * NOTE: Headers included by OpenCL C source code (other than the VC4CL standard library) are not part of the
+         * cache key, so changes to them are not detected!
+         *
+         * An empty value (the default) disables the compilation cache.
+         */
+        std::string cacheDirectory = "";
+        /*
+         * The file to write a trace of the compilation into.
+         *
+         * If set, the time spent in the single compilation stages, normalization steps, optimization passes and code
+         * generation steps is recorded for every thread and written in the Chrome trace-event JSON format (which can
+         * be viewed with chrome://tracing or Perfetto) after the compilation finished. The trace can also be enabled by
+         * setting the VC4C_TRACE environment variable to the output file.
+         *
+         * NOTE: Tracing concurrent compilations within the same process is not supported.
+         *
+         * An empty value (the default) disables tracing.
+         */
+        std::string traceFile = "";
     };
 
     /*
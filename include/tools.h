@@ -13,9 +13,11 @@
 #include "config.h"
 
 #include <array>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <map>
+#include <memory>
 #include <vector>
 
 namespace vc4c
@@ -59,11 +61,16 @@ namespace vc4c
              */
             std::vector<std::pair<uint32_t, Optional<std::vector<uint32_t>>>> parameter;
             /*
-             * The work-group configuration to run the execution with
+             * The work-group configuration to run the execution with.
+             *
+             * For kernels compiled without the work-group loop, every work-group is emulated separately and
+             * independent work-groups are emulated concurrently.
              */
             WorkGroupConfig workGroup;
             /*
-             * The maximum number of cycles to execute before terminating the emulation
+             * The maximum number of instructions any single QPU executes before terminating the emulation.
+             *
+             * Stalls are not counted, so the limit is the same for all emulation modes.
              */
             uint32_t maxEmulationCycles = std::numeric_limits<uint32_t>::max();
             /*
@@ -74,6 +81,45 @@ namespace vc4c
              * The path to dump the results of the instrumentation
              */
             std::string instrumentationDump;
+            /*
+             * The path to write the profile of the emulated kernel to, in a callgrind-compatible format.
+             *
+             * The costs of all instructions are grouped by the basic blocks of the machine code. Since the module does
+             * not contain the intermediate code labels, the blocks are named by their position in the kernel code,
+             * which matches the order of the intermediate code labels starting a block.
+             */
+            std::string profileDump;
+            /*
+             * The path to write the binary trace of the emulation to.
+             *
+             * The trace records all register writes, memory accesses, semaphore and mutex events and branches of all
+             * QPUs and can be inspected and compared with the emulator tool without re-running the emulation.
+             */
+            std::string traceDump;
+            /*
+             * Whether to run the faster functional emulation instead of the cycle-accurate one.
+             *
+             * The functional emulation produces the same results for valid kernel code, but does not model any
+             * memory access delays, caches or instruction timing. The number of cycles counted is not meaningful.
+             */
+            bool functionalEmulation = false;
+            /*
+             * Whether to emulate every QPU on its own host thread. This implies the functional emulation.
+             *
+             * The QPUs only synchronize on accesses to shared periphery (the hardware mutex, the semaphores, the VPM
+             * and DMA and the host interrupt). By default, these accesses are executed in a deterministic order, so
+             * the results do not depend on the scheduling of the host threads.
+             *
+             * NOTE: TMU and UNIFORM reads are not ordered against VPM DMA writes of other QPUs, so kernels reading
+             * memory written by other QPUs without synchronizing (e.g. via a barrier) might produce different results.
+             */
+            bool parallelEmulation = false;
+            /*
+             * Whether the parallel emulation only serializes the accesses to shared periphery without enforcing a
+             * deterministic order. This is faster, but kernels with data races might produce different results for
+             * different runs.
+             */
+            bool relaxedSynchronization = false;
 
             std::size_t calcParameterSize() const;
             uint32_t calcNumWorkItems() const;
@@ -114,7 +160,9 @@ namespace vc4c
             std::vector<uint32_t> uniformAddresses;
 
             /*
-             * The maximum number of cycles to execute before terminating the emulation
+             * The maximum number of instructions any single QPU executes before terminating the emulation.
+             *
+             * Stalls are not counted, so the limit is the same for all emulation modes.
              */
             uint32_t maxEmulationCycles = std::numeric_limits<uint32_t>::max();
             /*
@@ -166,7 +214,32 @@ namespace vc4c
              */
             unsigned numStalls;
             /*
-             * Counts the total number, this instruction was executed
+             * Counts the number of stalls waiting for the instruction to be loaded into the instruction cache
+             */
+            unsigned numInstructionFetchStalls;
+            /*
+             * Counts the number of stalls waiting for the next UNIFORM value to be loaded
+             */
+            unsigned numUniformStalls;
+            /*
+             * Counts the number of stalls waiting for a TMU load to finish (the load_tmu signal)
+             */
+            unsigned numTMUStalls;
+            /*
+             * Counts the number of stalls waiting to acquire the hardware mutex
+             */
+            unsigned numMutexStalls;
+            /*
+             * Counts the number of stalls waiting to decrement (or increment) a semaphore
+             */
+            unsigned numSemaphoreStalls;
+            /*
+             * Counts the number of stalls waiting for a VPM DMA load or store to finish
+             */
+            unsigned numVPMStalls;
+            /*
+             * Counts the total number, this instruction was executed. This includes the executions which stalled, so
+             * for the cycle-accurate emulation, this is the number of cycles spent in this instruction.
              */
             unsigned numExecutions;
 
@@ -228,6 +301,50 @@ namespace vc4c
         EmulationResult emulate(const EmulationData& data);
         LowLevelEmulationResult emulate(const LowLevelEmulationData& data);
 
+        /*
+         * Emulates a single kernel of a module for many different inputs and work-group configurations.
+         *
+         * The module is only extracted and the kernel code is only decoded once when the session is created. The
+         * memory of finished emulations is reused for following ones.
+         */
+        class EmulationSession
+        {
+        public:
+            /*
+             * Loads the kernel with the given name from the module. The name can be omitted for modules with only a
+             * single kernel.
+             */
+            explicit EmulationSession(const CompilationData& module, const std::string& kernelName = "");
+            EmulationSession(const EmulationSession&) = delete;
+            EmulationSession(EmulationSession&&) noexcept;
+            ~EmulationSession() noexcept;
+
+            EmulationSession& operator=(const EmulationSession&) = delete;
+            EmulationSession& operator=(EmulationSession&&) noexcept;
+
+            /*
+             * Runs the emulation for the parameters, work-group configuration and emulation settings of the given data
+             * and returns the result. The module and kernel name of the data are ignored.
+             *
+             * NOTE: This function can be called from multiple threads at once.
+             */
+            EmulationResult emulate(const EmulationData& job) const;
+
+            /*
+             * Runs the emulation for all given jobs and passes the result of every job (together with its index) to
+             * the consumer as soon as the job is finished.
+             *
+             * If parallel is set, the jobs are executed on the shared thread pool and the results are passed to the
+             * consumer in the order of completion. The consumer is never called concurrently.
+             */
+            void emulate(const std::vector<EmulationData>& jobs,
+                const std::function<void(std::size_t, EmulationResult&&)>& consumer, bool parallel = false) const;
+
+        private:
+            struct SessionData;
+            std::unique_ptr<SessionData> data;
+        };
+
         /*
          * Parses the given command-line parameter and stores it in the configuration
          *
@@ -20,7 +20,7 @@ const std::string BasicBlock::DEFAULT_BLOCK("%start_of_function");
 const std::string BasicBlock::LAST_BLOCK("%end_of_function");
 
 BasicBlock::BasicBlock(Method& method, std::unique_ptr<intermediate::BranchLabel>&& label) :
-    method(method), instructions()
+    method(method), instructions(intermediate::InstructionsList::allocator_type{method.pool})
 {
     instructions.emplace_back(std::move(label));
 }
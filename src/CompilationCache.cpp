@@ -0,0 +1,213 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "CompilationCache.h"
+
+#include "CompilationError.h"
+#include "Profiler.h"
+#include "log.h"
+#include "precompilation/FrontendCompiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace vc4c;
+
+// Marks the cache file format, needs to be changed when the layout of the entries changes
+static constexpr char CACHE_MAGIC[] = "VC4CCACHE-1";
+
+static std::atomic_size_t numCacheHits{0};
+
+static uint64_t hashKey(const std::string& key)
+{
+    // 64-bit FNV-1a, does not need to be cryptographically secure, since the full key is checked on look-up
+    uint64_t hash = 0xcbf29ce484222325;
+    for(auto c : key)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+static void createDirectories(const std::string& path)
+{
+    std::size_t pos = 0;
+    do
+    {
+        pos = path.find('/', pos + 1);
+        auto folder = path.substr(0, pos);
+        if(mkdir(folder.data(), 0755) != 0 && errno != EEXIST)
+            throw CompilationError(CompilationStep::GENERAL, "Failed to create cache directory", strerror(errno));
+    } while(pos != std::string::npos);
+}
+
+template <typename T>
+static void writeValue(std::ostream& out, const T& val)
+{
+    out.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+template <typename T>
+static bool readValue(std::istream& in, T& val)
+{
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&val), sizeof(val)));
+}
+
+static void writeSorted(std::ostream& out, const std::unordered_set<std::string>& set)
+{
+    // the iteration order of unordered sets is not guaranteed to be the same, so we need to sort them
+    std::set<std::string> sorted(set.begin(), set.end());
+    for(const auto& s : sorted)
+        out << s << ',';
+    out << ';';
+}
+
+static void writeModificationTime(std::ostream& out, const std::string& file)
+{
+    struct stat info
+    {
+    };
+    if(!file.empty() && stat(file.data(), &info) == 0)
+        out << file << '@' << info.st_mtime << ':' << info.st_size;
+    out << ';';
+}
+
+CompilationCache::CompilationCache(const std::string& directory) : directory(directory)
+{
+    if(!this->directory.empty() && this->directory.back() == '/')
+        this->directory.pop_back();
+}
+
+std::string CompilationCache::createKey(
+    const CompilationData& input, const Configuration& config, const std::string& options)
+{
+    std::stringstream key;
+    key << CACHE_MAGIC << ';' << VC4C_VERSION << ';' << options << ';';
+
+    // All configuration values are written which have an effect on the output. The cache directory and the trace file
+    // do not.
+    key << static_cast<unsigned>(config.mathType) << ';' << static_cast<unsigned>(config.outputMode) << ';'
+        << config.writeKernelInfo << ';' << config.availableVPMSize << ';' << static_cast<unsigned>(config.frontend)
+        << ';' << static_cast<unsigned>(config.optimizationLevel) << ';' << config.stopWhenVerificationFailed << ';';
+    writeSorted(key, config.additionalEnabledOptimizations);
+    writeSorted(key, config.additionalDisabledOptimizations);
+    const auto& opts = config.additionalOptions;
+    key << opts.combineLoadThreshold << ',' << opts.accumulatorThreshold << ',' << opts.replaceNopThreshold << ','
+        << opts.maxOptimizationIterations << ',' << opts.maxCommonExpressionDinstance << ','
+        << opts.parallelBlockThreshold << ',' << opts.worklistThreshold << ',' << opts.maxPrefetchedLoads << ';';
+
+    if(input.getType() == SourceType::OPENCL_C)
+    {
+        // the standard library is implicitly included, so changes to it change the compilation result
+        try
+        {
+            const auto& stdlib = precompilation::findStandardLibraryFiles();
+            writeModificationTime(key, stdlib.configurationHeader);
+            writeModificationTime(key, stdlib.precompiledHeader);
+            writeModificationTime(key, stdlib.llvmModule);
+            writeModificationTime(key, stdlib.spirvModule);
+        }
+        catch(const CompilationError&)
+        {
+            // compilation will fail anyway, ignore here
+        }
+    }
+
+    key << static_cast<unsigned>(input.getType()) << ';';
+    input.readInto(key);
+    return key.str();
+}
+
+bool CompilationCache::lookup(const std::string& key, std::vector<uint8_t>& outData, std::size_t& outNumBytes) const
+{
+    PROFILE_SCOPE(CompilationCacheLookup);
+    auto path = getEntryPath(key);
+    std::ifstream fis{path, std::ios::in | std::ios::binary};
+    if(!fis)
+        return false;
+
+    char magic[sizeof(CACHE_MAGIC)] = {};
+    uint64_t keySize = 0;
+    if(!fis.read(magic, sizeof(magic)) || std::memcmp(magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        !readValue(fis, keySize) || keySize != key.size())
+        return false;
+    std::string storedKey(keySize, '\0');
+    if(!fis.read(&storedKey[0], static_cast<std::streamsize>(keySize)) || storedKey != key)
+    {
+        CPPLOG_LAZY(
+            logging::Level::DEBUG, log << "Compilation cache hash collision for entry: " << path << logging::endl);
+        return false;
+    }
+
+    uint64_t numBytes = 0;
+    uint64_t dataSize = 0;
+    if(!readValue(fis, numBytes) || !readValue(fis, dataSize))
+        return false;
+    outData.resize(dataSize);
+    if(!fis.read(reinterpret_cast<char*>(outData.data()), static_cast<std::streamsize>(dataSize)))
+        return false;
+    outNumBytes = numBytes;
+    ++numCacheHits;
+
+    CPPLOG_LAZY(logging::Level::INFO, log << "Using cached compilation result: " << path << logging::endl);
+    return true;
+}
+
+void CompilationCache::store(const std::string& key, const CompilationData& result, std::size_t numBytes) const
+{
+    PROFILE_SCOPE(CompilationCacheStore);
+    auto path = getEntryPath(key);
+    // write into a temporary file first and then rename it to not have other processes read partial entries
+    auto tmpPath = path + ".tmp" + std::to_string(getpid());
+    try
+    {
+        createDirectories(directory);
+        std::stringstream data;
+        result.readInto(data);
+        auto content = data.str();
+
+        std::ofstream fos{tmpPath, std::ios::out | std::ios::binary | std::ios::trunc};
+        fos.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        writeValue(fos, static_cast<uint64_t>(key.size()));
+        fos.write(key.data(), static_cast<std::streamsize>(key.size()));
+        writeValue(fos, static_cast<uint64_t>(numBytes));
+        writeValue(fos, static_cast<uint64_t>(content.size()));
+        fos.write(content.data(), static_cast<std::streamsize>(content.size()));
+        fos.close();
+        if(!fos)
+            throw CompilationError(CompilationStep::GENERAL, "Failed to write cache entry", tmpPath);
+        if(std::rename(tmpPath.data(), path.data()) != 0)
+            throw CompilationError(CompilationStep::GENERAL, "Failed to move cache entry", strerror(errno));
+        CPPLOG_LAZY(logging::Level::DEBUG, log << "Stored compilation result in cache: " << path << logging::endl);
+    }
+    catch(const CompilationError& e)
+    {
+        std::remove(tmpPath.data());
+        logging::warn() << "Failed to store compilation result in cache: " << e.what() << logging::endl;
+    }
+}
+
+std::size_t CompilationCache::getNumHits() noexcept
+{
+    return numCacheHits;
+}
+
+std::string CompilationCache::getEntryPath(const std::string& key) const
+{
+    std::stringstream ss;
+    ss << directory << '/' << std::hex << std::setfill('0') << std::setw(16) << hashKey(key) << ".qpu";
+    return ss.str();
+}
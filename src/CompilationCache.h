@@ -0,0 +1,69 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_COMPILATION_CACHE_H
+#define VC4C_COMPILATION_CACHE_H
+
+#include "Precompiler.h"
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+namespace vc4c
+{
+    /*
+     * Persistent content-addressed cache for compilation results.
+     *
+     * Every entry is stored in a separate file in the cache directory named after the hash of its key. The file
+     * contains the full key, so hash collisions are detected and treated as a cache miss.
+     *
+     * The cache is safe to be used by multiple processes in parallel, since entries are written to a temporary file
+     * first and then atomically renamed to their final name.
+     */
+    class CompilationCache
+    {
+    public:
+        explicit CompilationCache(const std::string& directory);
+
+        /*
+         * Creates the key for the given compilation.
+         *
+         * The key consists of the raw input data, all configuration values which have an effect on the generated code,
+         * the compilation options and the compiler version. For OpenCL C input, the modification times of the used
+         * VC4CL standard library files are also included.
+         */
+        static std::string createKey(
+            const CompilationData& input, const Configuration& config, const std::string& options);
+
+        /*
+         * Looks up the entry for the given key and returns whether it was found.
+         *
+         * On a cache hit, the cached compilation result as well as the number of bytes written by the original
+         * compilation are written into the output parameters.
+         */
+        bool lookup(const std::string& key, std::vector<uint8_t>& outData, std::size_t& outNumBytes) const;
+
+        /*
+         * Stores the given compilation result for the given key.
+         *
+         * Errors writing the cache entry are logged, but not thrown, since the compilation itself was successful.
+         */
+        void store(const std::string& key, const CompilationData& result, std::size_t numBytes) const;
+
+        /*
+         * Returns the number of look-ups (over all caches of this process) which found a matching entry
+         */
+        static std::size_t getNumHits() noexcept;
+
+    private:
+        std::string directory;
+
+        std::string getEntryPath(const std::string& key) const;
+    };
+} // namespace vc4c
+
+#endif /* VC4C_COMPILATION_CACHE_H */
@@ -6,6 +6,7 @@
 
 #include "Compiler.h"
 
+#include "CompilationCache.h"
 #include "CompilationError.h"
 #include "CompilerInstance.h"
 #include "Logger.h"
@@ -28,6 +29,7 @@
 #include <cstdlib>
 #include <fcntl.h>
 #include <fstream>
+#include <functional>
 #include <iterator>
 #include <memory>
 #include <sstream>
@@ -95,12 +97,17 @@ CompilerInstance::CompilerInstance(const Configuration& config) : moduleConfig(c
 
 void CompilerInstance::precompileAndParseInput(const CompilationData& input, const std::string& options)
 {
-    auto intermediate = Precompiler::precompile(input, moduleConfig, options);
+    CompilationData intermediate;
+    {
+        PROFILE_TRACE_SCOPE("stage", "Precompile");
+        intermediate = Precompiler::precompile(input, moduleConfig, options);
+    }
     parseInput(intermediate);
 }
 
 void CompilerInstance::parseInput(const CompilationData& input)
 {
+    PROFILE_TRACE_SCOPE("stage", "Parse");
     PROFILE_SCOPE(Parser);
     std::unique_ptr<Parser> parser = getParser(input);
     parser->parse(module);
@@ -113,6 +120,7 @@ void CompilerInstance::normalize(bool dropNonKernels)
 
 void CompilerInstance::normalize(const std::set<std::string>& selectedSteps, bool dropNonKernels)
 {
+    PROFILE_TRACE_SCOPE("stage", "Normalize");
     normalization::Normalizer norm(moduleConfig);
 
     PROFILE_START(Normalizer);
@@ -126,6 +134,7 @@ void CompilerInstance::normalize(const std::set<std::string>& selectedSteps, boo
 
 void CompilerInstance::optimize()
 {
+    PROFILE_TRACE_SCOPE("stage", "Optimize");
     optimizations::Optimizer opt(moduleConfig);
 
     PROFILE_START(Optimizer);
@@ -139,6 +148,7 @@ void CompilerInstance::optimize(const std::vector<std::string>& selectedPasses)
     optimizeConfig.optimizationLevel = OptimizationLevel::NONE;
     optimizeConfig.additionalEnabledOptimizations.insert(selectedPasses.begin(), selectedPasses.end());
 
+    PROFILE_TRACE_SCOPE("stage", "Optimize");
     optimizations::Optimizer opt(optimizeConfig);
 
     PROFILE_START(Optimizer);
@@ -148,6 +158,7 @@ void CompilerInstance::optimize(const std::vector<std::string>& selectedPasses)
 
 void CompilerInstance::adjust(const std::set<std::string>& selectedSteps)
 {
+    PROFILE_TRACE_SCOPE("stage", "Adjust");
     normalization::Normalizer norm(moduleConfig);
 
     PROFILE_START(SecondNormalizer);
@@ -160,6 +171,7 @@ void CompilerInstance::adjust(const std::set<std::string>& selectedSteps)
 
 std::size_t CompilerInstance::generateCode(std::ostream& output)
 {
+    PROFILE_TRACE_SCOPE("stage", "GenerateCode");
     qpu_asm::CodeGenerator codeGen(module, moduleConfig);
 
     auto kernels = module.getKernels();
@@ -171,6 +183,7 @@ std::size_t CompilerInstance::generateCode(std::ostream& output)
 std::size_t CompilerInstance::generateCode(
     std::ostream& output, const std::vector<qpu_asm::RegisterFixupStep>& customSteps)
 {
+    PROFILE_TRACE_SCOPE("stage", "GenerateCode");
     qpu_asm::CodeGenerator codeGen(module, customSteps, moduleConfig);
 
     auto kernels = module.getKernels();
@@ -179,9 +192,9 @@ std::size_t CompilerInstance::generateCode(
     return codeGen.writeOutput(output);
 }
 
-std::pair<CompilationData, std::size_t> CompilerInstance::generateCode(const Optional<std::string>& outputFile)
+static std::pair<CompilationData, std::size_t> writeCompilationResult(const Configuration& config,
+    const Optional<std::string>& outputFile, const std::function<std::size_t(std::ostream&)>& generateCode)
 {
-    // code generation
     CompilationData result{};
     std::size_t bytesWritten = 0;
     if(outputFile)
@@ -189,9 +202,12 @@ std::pair<CompilationData, std::size_t> CompilerInstance::generateCode(const Opt
         std::ofstream fos{*outputFile};
         bytesWritten = generateCode(fos);
         fos.flush();
+        if(!fos)
+            throw CompilationError(
+                CompilationStep::CODE_GENERATION, "Failed to write compilation result to file", *outputFile);
 
         result = CompilationData{
-            *outputFile, moduleConfig.outputMode == OutputMode::HEX ? SourceType::QPUASM_HEX : SourceType::QPUASM_BIN};
+            *outputFile, config.outputMode == OutputMode::HEX ? SourceType::QPUASM_HEX : SourceType::QPUASM_BIN};
     }
     else
     {
@@ -200,28 +216,136 @@ std::pair<CompilationData, std::size_t> CompilerInstance::generateCode(const Opt
         output.flush();
 
         result = CompilationData{output,
-            moduleConfig.outputMode == OutputMode::HEX ? SourceType::QPUASM_HEX : SourceType::QPUASM_BIN,
+            config.outputMode == OutputMode::HEX ? SourceType::QPUASM_HEX : SourceType::QPUASM_BIN,
             "compilation result"};
     }
 
     return std::make_pair(std::move(result), bytesWritten);
 }
 
+std::pair<CompilationData, std::size_t> CompilerInstance::generateCode(const Optional<std::string>& outputFile)
+{
+    // code generation
+    return writeCompilationResult(
+        moduleConfig, outputFile, [this](std::ostream& output) -> std::size_t { return generateCode(output); });
+}
+
+std::size_t CompilerInstance::compileKernels(std::ostream& output)
+{
+    PROFILE_TRACE_SCOPE("stage", "CompileKernels");
+    normalization::Normalizer norm(moduleConfig);
+    optimizations::Optimizer opt(moduleConfig);
+    qpu_asm::CodeGenerator codeGen(module, moduleConfig);
+
+    // the module-wide normalization (e.g. inlining of functions) needs to be finished before any kernel is processed
+    norm.prepareKernels(module);
+
+    // every kernel runs through all remaining stages on its own, so a big kernel does not stall the other kernels
+    auto kernels = module.getKernels();
+    const auto f = [&](Method* kernelFunc) -> void {
+        {
+            PROFILE_TRACE_SCOPE("stage", "Normalize", kernelFunc->name);
+            norm.normalizeMethod(module, *kernelFunc);
+        }
+        {
+            PROFILE_TRACE_SCOPE("stage", "Optimize", kernelFunc->name);
+            opt.optimizeMethod(module, *kernelFunc);
+        }
+        {
+            PROFILE_TRACE_SCOPE("stage", "Adjust", kernelFunc->name);
+            norm.adjustMethod(module, *kernelFunc);
+        }
+        PROFILE_TRACE_SCOPE("stage", "GenerateCode", kernelFunc->name);
+        codeGen.toMachineCode(*kernelFunc);
+    };
+    ThreadPool::scheduleAll<Method*>("Compilation", kernels, f, THREAD_LOGGER.get());
+
+    // only drop the non-kernel functions here to not modify the module while the kernels are processed
+    module.dropNonKernels();
+    return codeGen.writeOutput(output);
+}
+
+std::pair<CompilationData, std::size_t> CompilerInstance::compileKernels(const Optional<std::string>& outputFile)
+{
+    return writeCompilationResult(
+        moduleConfig, outputFile, [this](std::ostream& output) -> std::size_t { return compileKernels(output); });
+}
+
+namespace
+{
+    /*
+     * Records the trace spans of a single compilation, if enabled, and writes them on destruction (also on errors)
+     */
+    struct CompilationTrace
+    {
+        explicit CompilationTrace(const Configuration& config) : fileName(config.traceFile)
+        {
+            // the environment variable allows to trace compilations of programs using the compiler as library
+            auto envTraceFile = std::getenv("VC4C_TRACE");
+            if(fileName.empty() && envTraceFile)
+                fileName = envTraceFile;
+            if(!fileName.empty())
+                profiler::startTracing();
+        }
+
+        CompilationTrace(const CompilationTrace&) = delete;
+        CompilationTrace(CompilationTrace&&) noexcept = delete;
+
+        ~CompilationTrace()
+        {
+            if(!fileName.empty())
+                profiler::stopTracing(fileName);
+        }
+
+        CompilationTrace& operator=(const CompilationTrace&) = delete;
+        CompilationTrace& operator=(CompilationTrace&&) noexcept = delete;
+
+        std::string fileName;
+    };
+} // namespace
+
 std::pair<CompilationData, std::size_t> Compiler::compile(const CompilationData& input, const Configuration& config,
     const std::string& options, const std::string& outputFile)
 {
+    CompilationTrace trace{config};
     try
     {
+        PROFILE_TRACE_SCOPE("stage", "Compile");
+        std::unique_ptr<CompilationCache> cache;
+        std::string cacheKey;
+        if(!config.cacheDirectory.empty())
+        {
+            cache = std::make_unique<CompilationCache>(config.cacheDirectory);
+            cacheKey = CompilationCache::createKey(input, config, options);
+            std::vector<uint8_t> cachedData;
+            std::size_t cachedBytes = 0;
+            if(cache->lookup(cacheKey, cachedData, cachedBytes))
+            {
+                auto type = config.outputMode == OutputMode::HEX ? SourceType::QPUASM_HEX : SourceType::QPUASM_BIN;
+                if(outputFile.empty())
+                    return std::make_pair(
+                        CompilationData{std::move(cachedData), type, "compilation result"}, cachedBytes);
+                std::ofstream fos{outputFile, std::ios::out | std::ios::binary};
+                fos.write(reinterpret_cast<const char*>(cachedData.data()),
+                    static_cast<std::streamsize>(cachedData.size()));
+                fos.flush();
+                if(!fos)
+                    throw CompilationError(
+                        CompilationStep::GENERAL, "Failed to write cached compilation result to file", outputFile);
+                return std::make_pair(CompilationData{outputFile, type}, cachedBytes);
+            }
+        }
+
         CompilerInstance instance{config};
 
         // pre-compilation
         instance.precompileAndParseInput(input, options);
 
         // compilation
-        instance.normalize();
-        instance.optimize();
-        instance.adjust();
-        auto result = instance.generateCode(outputFile.empty() ? Optional<std::string>{} : outputFile);
+        auto result = instance.compileKernels(outputFile.empty() ? Optional<std::string>{} : outputFile);
+
+        if(cache)
+            cache->store(cacheKey, result.first, result.second);
 
         // clean-up
         std::wcout.flush();
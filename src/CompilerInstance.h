@@ -44,6 +44,16 @@ namespace vc4c
         std::size_t generateCode(std::ostream& output);
         std::size_t generateCode(std::ostream& output, const std::vector<qpu_asm::RegisterFixupStep>& customSteps);
         std::pair<CompilationData, std::size_t> generateCode(const Optional<std::string>& outputFile = {});
+
+        /*
+         * Runs the normalization, optimization, adjustment and code generation for every kernel on its own, so the
+         * kernels do not need to wait for each other between these stages. Only writing the output waits for all
+         * kernels to be compiled.
+         *
+         * This generates the same code as running #normalize, #optimize, #adjust and #generateCode in that order.
+         */
+        std::size_t compileKernels(std::ostream& output);
+        std::pair<CompilationData, std::size_t> compileKernels(const Optional<std::string>& outputFile = {});
     };
 } // namespace vc4c
 
@@ -8,8 +8,18 @@
 
 #include "intermediate/IntermediateInstruction.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
 using namespace vc4c;
 
+// The number of active ConcurrentLocalUsersGuard objects
+static std::atomic_uint numConcurrentUsersGuards{0};
+// Striped locks for the user tracking of "default" locals, only used while a ConcurrentLocalUsersGuard is active
+static std::array<std::mutex, 64> concurrentUsersLocks;
+
 LocalData::~LocalData() noexcept = default;
 
 std::string LocalData::to_string() const
@@ -54,18 +64,23 @@ FastSet<const LocalUser*> Local::getUsers(const LocalUse::Type type) const
 
 void Local::forUsers(const LocalUse::Type type, const std::function<void(const LocalUser*)>& consumer) const
 {
-    auto lock = getUsersLock();
-    for(const auto& pair : this->users)
-    {
-        if((has_flag(type, LocalUse::Type::READER) && pair.second.readsLocal()) ||
-            (has_flag(type, LocalUse::Type::WRITER) && pair.second.writesLocal()))
-            consumer(pair.first);
-    }
+    allUsers(type, [&](const LocalUser* user) -> bool {
+        consumer(user);
+        return true;
+    });
 }
 
 bool Local::allUsers(LocalUse::Type type, const std::function<bool(const LocalUser*)>& consumer) const
 {
     auto lock = getUsersLock();
+    if(lock.owns_lock())
+    {
+        // Do not run the consumer while holding the lock, since it might access the users of other locals which could
+        // share the same lock (or be locked by another thread in the opposite order)
+        lock.unlock();
+        auto users = getUsers(type);
+        return std::all_of(users.begin(), users.end(), consumer);
+    }
     for(const auto& pair : this->users)
     {
         if((has_flag(type, LocalUse::Type::READER) && pair.second.readsLocal()) ||
@@ -171,7 +186,10 @@ bool Local::isMarker() const noexcept
 
 std::unique_lock<std::mutex> Local::getUsersLock() const
 {
-    return std::unique_lock<std::mutex>{/* no mutex owned*/};
+    if(numConcurrentUsersGuards.load(std::memory_order_acquire) == 0)
+        return std::unique_lock<std::mutex>{/* no mutex owned*/};
+    auto index = (reinterpret_cast<std::uintptr_t>(this) / sizeof(Local)) % concurrentUsersLocks.size();
+    return std::unique_lock<std::mutex>{concurrentUsersLocks[index]};
 }
 
 Parameter::Parameter(const std::string& name, DataType type, const ParameterDecorations decorations) :
@@ -408,3 +426,13 @@ std::string ReferenceData::to_string() const
         (offset == ANY_ELEMENT ? std::string("") : (std::string(" at ") + std::to_string(offset))) + ")";
 }
 LCOV_EXCL_STOP
+
+ConcurrentLocalUsersGuard::ConcurrentLocalUsersGuard()
+{
+    numConcurrentUsersGuards.fetch_add(1, std::memory_order_acq_rel);
+}
+
+ConcurrentLocalUsersGuard::~ConcurrentLocalUsersGuard() noexcept
+{
+    numConcurrentUsersGuards.fetch_sub(1, std::memory_order_acq_rel);
+}
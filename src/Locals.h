@@ -611,6 +611,24 @@ namespace vc4c
         int offset;
     };
 
+    /*
+     * While an object of this type exists, the tracking of users of all locals is synchronized.
+     *
+     * This is required when instructions of a single method are modified concurrently (e.g. by block-local
+     * optimizations executed in parallel), since the locals shared between the modified instructions are then updated
+     * from multiple threads.
+     */
+    struct ConcurrentLocalUsersGuard : private NonCopyable
+    {
+        ConcurrentLocalUsersGuard();
+        ConcurrentLocalUsersGuard(const ConcurrentLocalUsersGuard&) = delete;
+        ConcurrentLocalUsersGuard(ConcurrentLocalUsersGuard&&) noexcept = delete;
+        ~ConcurrentLocalUsersGuard() noexcept;
+
+        ConcurrentLocalUsersGuard& operator=(const ConcurrentLocalUsersGuard&) = delete;
+        ConcurrentLocalUsersGuard& operator=(ConcurrentLocalUsersGuard&&) noexcept = delete;
+    };
+
 } /* namespace vc4c */
 
 #endif /* LOCALS_H */
@@ -8,6 +8,7 @@
 
 #include "Module.h"
 #include "Profiler.h"
+#include "analysis/AnalysisManager.h"
 #include "analysis/ControlFlowGraph.h"
 #include "intermediate/IntermediateInstruction.h"
 #include "periphery/VPM.h"
@@ -20,7 +21,8 @@ using namespace vc4c;
 
 Method::Method(Module& module) :
     flags(MethodFlags::NONE), name(), returnType(TYPE_UNKNOWN),
-    vpm(new periphery::VPM(module.compilationConfig.availableVPMSize)), module(module)
+    vpm(new periphery::VPM(module.compilationConfig.availableVPMSize)), module(module),
+    basicBlocks(BasicBlockList::allocator_type{pool}), locals(StableList<Local>::allocator_type{pool})
 {
 }
 
@@ -66,6 +68,7 @@ const StackAllocation* Method::findStackAllocation(const std::string& name) cons
 const Local* Method::createLocal(DataType type, const std::string& name, const Local* lowerPart, const Local* upperPart)
 {
     Local loc(type, name);
+    std::lock_guard<std::mutex> guard(localsMutex);
     addLocalData(loc, lowerPart, upperPart);
     locals.emplace_back(std::move(loc));
     return &locals.back();
@@ -84,6 +87,7 @@ Parameter& Method::addParameter(Parameter&& param)
 const BuiltinLocal* Method::findOrCreateBuiltin(BuiltinLocal::Type type)
 {
     using Type = BuiltinLocal::Type;
+    std::lock_guard<std::mutex> guard(localsMutex);
     if(builtinLocals.size() < BuiltinLocal::NUM_LOCALS)
         builtinLocals.resize(BuiltinLocal::NUM_LOCALS);
     auto& entry = builtinLocals.at(static_cast<std::size_t>(type));
@@ -521,6 +525,13 @@ analysis::ControlFlowGraph& Method::getCFG()
     return *cfg;
 }
 
+analysis::AnalysisManager& Method::getAnalyses()
+{
+    if(!analyses)
+        analyses = std::make_unique<analysis::AnalysisManager>(*this);
+    return *analyses;
+}
+
 void Method::moveBlock(BasicBlockList::iterator origin, BasicBlockList::iterator dest)
 {
     // splice removes the element pointed to by origin from the list (second) parameter and inserts it into the list
@@ -594,6 +605,8 @@ void Method::checkAndCreateDefaultBasicBlock()
 
 void Method::updateCFGOnBlockInsertion(BasicBlock* block)
 {
+    std::lock_guard<std::mutex> guard(cfgMutex);
+    invalidateAnalysesOnCFGChange();
     if(!cfg)
         return;
     cfg->updateOnBlockInsertion(*this, *block);
@@ -601,6 +614,8 @@ void Method::updateCFGOnBlockInsertion(BasicBlock* block)
 
 void Method::updateCFGOnBlockRemoval(BasicBlock* block)
 {
+    std::lock_guard<std::mutex> guard(cfgMutex);
+    invalidateAnalysesOnCFGChange();
     if(!cfg)
         return;
     cfg->updateOnBlockRemoval(*this, *block);
@@ -608,6 +623,8 @@ void Method::updateCFGOnBlockRemoval(BasicBlock* block)
 
 void Method::updateCFGOnBranchInsertion(InstructionWalker it)
 {
+    std::lock_guard<std::mutex> guard(cfgMutex);
+    invalidateAnalysesOnCFGChange();
     if(!cfg)
         return;
     cfg->updateOnBranchInsertion(*this, it);
@@ -615,11 +632,21 @@ void Method::updateCFGOnBranchInsertion(InstructionWalker it)
 
 void Method::updateCFGOnBranchRemoval(BasicBlock& affectedBlock, const FastSet<const Local*>& branchTargets)
 {
+    std::lock_guard<std::mutex> guard(cfgMutex);
+    invalidateAnalysesOnCFGChange();
     if(!cfg)
         return;
     cfg->updateOnBranchRemoval(*this, affectedBlock, branchTargets);
 }
 
+void Method::invalidateAnalysesOnCFGChange()
+{
+    // the control flow analyses are reset by the CFG itself, but all other analyses are associated with the basic
+    // blocks and the instructions modified here
+    if(analyses)
+        analyses->invalidate(analysis::AnalysisType::INSTRUCTIONS);
+}
+
 void Method::addLocalData(Local& loc, const Local* lowerPart, const Local* upperPart)
 {
     if(loc.type.isSimpleType() && loc.type.getScalarBitCount() > 32 && loc.type.getScalarBitCount() <= 64)
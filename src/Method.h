@@ -13,6 +13,7 @@
 #include "Optional.h"
 
 #include <memory>
+#include <mutex>
 
 namespace vc4c
 {
@@ -23,6 +24,7 @@ namespace vc4c
     namespace analysis
     {
         class ControlFlowGraph;
+        class AnalysisManager;
     } // namespace analysis
     class Module;
     struct Global;
@@ -299,6 +301,22 @@ namespace vc4c
          */
         analysis::ControlFlowGraph& getCFG();
 
+        /*
+         * Returns the manager caching the results of analyses for this method
+         */
+        analysis::AnalysisManager& getAnalyses();
+
+        /*
+         * Returns the pool the basic blocks, instructions and locals of this method are allocated from.
+         *
+         * NOTE: Instructions are only allocated from this pool while it is active for the current thread, see
+         * tools::SlabPool::Scope
+         */
+        tools::SlabPool& getPool()
+        {
+            return pool;
+        }
+
         /*
          * The module the method belongs to
          */
@@ -324,6 +342,11 @@ namespace vc4c
         std::string to_string() const;
 
     private:
+        /*
+         * The pool owning the memory of the basic blocks, instructions and locals, released in bulk when the method is
+         * destroyed. Needs to be declared before all members allocating from it to be destroyed after them.
+         */
+        tools::SlabPool pool;
         /*
          * The list of basic blocks
          */
@@ -345,6 +368,18 @@ namespace vc4c
          */
         std::unique_ptr<analysis::ControlFlowGraph> cfg;
 
+        /*
+         * The cached analyses results, created on first access
+         */
+        std::unique_ptr<analysis::AnalysisManager> analyses;
+
+        /*
+         * Guards the modification of the list of locals, the builtin locals and the CFG, since they can be accessed
+         * by optimizations running in parallel for independent basic blocks
+         */
+        std::mutex localsMutex;
+        std::mutex cfgMutex;
+
         std::string createLocalName(const std::string& prefix = "", const std::string& postfix = "");
 
         BasicBlock* getNextBlockAfter(const BasicBlock* block);
@@ -356,12 +391,14 @@ namespace vc4c
         void updateCFGOnBlockRemoval(BasicBlock* block);
         void updateCFGOnBranchInsertion(InstructionWalker it);
         void updateCFGOnBranchRemoval(BasicBlock& affectedBlock, const FastSet<const Local*>& branchTargets);
+        void invalidateAnalysesOnCFGChange();
 
         void addLocalData(Local& loc, const Local* lowerPart = nullptr, const Local* upperPart = nullptr);
 
         friend class BasicBlock;
         friend class InstructionWalker;
         friend class ConstInstructionWalker;
+        friend class analysis::AnalysisManager;
     };
 
     using MethodIterator = ScopedInstructionWalker<Method>;
@@ -54,18 +54,6 @@ static void mapPipe(int pipe, int fd)
         throw CompilationError(CompilationStep::GENERAL, "Error duplicating pipe", strerror(errno));
 }
 
-static std::vector<std::string> splitString(const std::string& input, const char delimiter)
-{
-    std::vector<std::string> result;
-    std::stringstream in(input);
-    std::string token;
-    while(std::getline(in, token, delimiter))
-    {
-        result.push_back(token);
-    }
-    return result;
-}
-
 static void runChild(
     const std::string& command, std::array<std::array<int, 2>, 3>& pipes, bool hasStdIn, bool hasStdOut, bool hasStdErr)
 {
@@ -90,19 +78,8 @@ static void runChild(
         closePipe(pipes[STD_ERR][WRITE]);
     }
 
-    // split command
-    std::vector<std::string> parts = splitString(command, ' ');
-    const std::string file = parts.at(0);
-    std::array<char*, 128> args{};
-    args.fill(nullptr);
-    // man(3) exec: "The first argument, by convention, should point to the filename associated with the file being
-    // executed"
-    for(std::size_t i = 0; i < parts.size(); ++i)
-    {
-        args.at(i) = const_cast<char*>(parts[i].data());
-    }
-
-    execvp(file.data(), args.data());
+    // run the command via the shell (as popen() does), so quoted arguments and redirections are handled correctly
+    execl("/bin/sh", "sh", "-c", command.data(), nullptr);
 }
 
 static bool isChildFinished(pid_t pid, int* exitStatus, bool wait = false)
@@ -8,19 +8,23 @@
 
 #include "log.h"
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <cstring>
 #include <fstream>
 #include <iomanip>
+#include <list>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <set>
+#include <sys/prctl.h>
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <unistd.h>
 #include <unordered_map>
+#include <vector>
 
 // LCOV_EXCL_START
 
@@ -456,4 +460,159 @@ void profiler::flushThreadCache()
     threadCache.reset();
 }
 
+std::atomic_bool profiler::tracingEnabled{false};
+
+struct TraceSpan
+{
+    const char* category;
+    std::string name;
+    std::string detail;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+/*
+ * The trace spans recorded by a single thread.
+ *
+ * Only the owning thread appends to the buffer, but the spans are cleared and written by the thread starting/stopping
+ * the tracing, so all accesses to the spans need to hold the buffer lock. Since the lock is almost never contended,
+ * this is cheap for recording spans. The buffers are owned by the global list below to keep the spans of exited threads
+ * (e.g. of finished thread pools) until they are written.
+ */
+struct TraceBuffer
+{
+    std::size_t threadId;
+    std::string threadName;
+    std::mutex lock;
+    std::vector<TraceSpan> spans;
+    bool threadExited = false;
+};
+
+static std::list<std::unique_ptr<TraceBuffer>> traceBuffers;
+static std::mutex lockTraceBuffers;
+static std::chrono::steady_clock::time_point traceStart;
+
+/*
+ * Marks the buffer of the current thread on thread exit, so it can be dropped after its spans are written
+ */
+struct TraceBufferHandle
+{
+    TraceBuffer* buffer = nullptr;
+
+    ~TraceBufferHandle()
+    {
+        if(buffer)
+        {
+            std::lock_guard<std::mutex> guard(lockTraceBuffers);
+            buffer->threadExited = true;
+        }
+    }
+};
+
+static thread_local TraceBufferHandle traceBuffer;
+
+static TraceBuffer& getTraceBuffer()
+{
+    static std::atomic_size_t nextThreadId{1};
+    if(!traceBuffer.buffer)
+    {
+        auto buffer = std::make_unique<TraceBuffer>();
+        std::array<char, 17> threadName{};
+        prctl(PR_GET_NAME, threadName.data(), 0, 0, 0);
+        buffer->threadName = threadName.data();
+        buffer->threadId = nextThreadId++;
+        traceBuffer.buffer = buffer.get();
+        std::lock_guard<std::mutex> guard(lockTraceBuffers);
+        traceBuffers.emplace_back(std::move(buffer));
+    }
+    return *traceBuffer.buffer;
+}
+
+void profiler::startTracing()
+{
+    std::lock_guard<std::mutex> guard(lockTraceBuffers);
+    for(auto& buffer : traceBuffers)
+    {
+        std::lock_guard<std::mutex> bufferGuard(buffer->lock);
+        buffer->spans.clear();
+    }
+    traceStart = std::chrono::steady_clock::now();
+    tracingEnabled = true;
+}
+
+void profiler::recordTraceSpan(const char* category, std::string&& name, std::string&& detail,
+    std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    auto& buffer = getTraceBuffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    buffer.spans.emplace_back(TraceSpan{category, std::move(name), std::move(detail), start, end});
+}
+
+static void writeJSONString(std::ostream& output, const std::string& s)
+{
+    output << '"';
+    for(auto c : s)
+    {
+        if(c == '"' || c == '\\')
+            output << '\\' << c;
+        else if(static_cast<unsigned char>(c) < 0x20)
+            output << ' ';
+        else
+            output << c;
+    }
+    output << '"';
+}
+
+void profiler::stopTracing(std::ostream& output)
+{
+    tracingEnabled = false;
+    std::lock_guard<std::mutex> guard(lockTraceBuffers);
+    auto toMicroseconds = [](std::chrono::steady_clock::duration duration) -> double {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) / 1000.0;
+    };
+
+    output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for(auto& buffer : traceBuffers)
+    {
+        std::lock_guard<std::mutex> bufferGuard(buffer->lock);
+        if(buffer->spans.empty())
+            continue;
+        output << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+               << buffer->threadId << ",\"args\":{\"name\":";
+        writeJSONString(output, buffer->threadName);
+        output << "}}";
+        first = false;
+        for(const auto& span : buffer->spans)
+        {
+            output << ",\n{\"name\":";
+            writeJSONString(output, span.name);
+            output << ",\"cat\":\"" << span.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                   << ",\"ts\":" << std::fixed << std::setprecision(3) << toMicroseconds(span.start - traceStart)
+                   << ",\"dur\":" << toMicroseconds(span.end - span.start);
+            if(!span.detail.empty())
+            {
+                output << ",\"args\":{\"detail\":";
+                writeJSONString(output, span.detail);
+                output << '}';
+            }
+            output << '}';
+        }
+        buffer->spans.clear();
+    }
+    output << "\n]}" << std::endl;
+
+    traceBuffers.remove_if([](const std::unique_ptr<TraceBuffer>& buffer) -> bool { return buffer->threadExited; });
+}
+
+void profiler::stopTracing(const std::string& fileName)
+{
+    std::ofstream fos{fileName};
+    stopTracing(fos);
+    if(!fos)
+        logging::warn() << "Failed to write trace file: " << fileName << logging::endl;
+    else
+        CPPLOG_LAZY(logging::Level::INFO, log << "Written trace to: " << fileName << logging::endl);
+}
+
 // LCOV_EXCL_STOP
@@ -7,7 +7,9 @@
 #ifndef PROFILER_H
 #define PROFILER_H
 
+#include <atomic>
 #include <chrono>
+#include <iosfwd>
 #include <string>
 
 namespace vc4c
@@ -113,6 +115,13 @@ namespace vc4c
 #define PROFILE_FLUSH_THREAD_CACHE()
 #endif
 
+// The trace spans are available in release builds too, since they are only recorded when tracing is enabled at run-time
+// The line number is appended to the variable name to allow for multiple trace scopes in a single function
+#define PROFILE_TRACE_CONCAT_INNER(a, b) a##b
+#define PROFILE_TRACE_CONCAT(a, b) PROFILE_TRACE_CONCAT_INNER(a, b)
+#define PROFILE_TRACE_SCOPE(category, ...)                                                                             \
+    profiler::TraceScope PROFILE_TRACE_CONCAT(profileTrace, __LINE__)(category, __VA_ARGS__)
+
     namespace profiler
     {
         using Clock = std::chrono::system_clock;
@@ -165,6 +174,79 @@ namespace vc4c
         void startThreadCache();
         void flushThreadCache();
 
+        /*
+         * Whether trace spans are currently recorded, see #startTracing
+         */
+        extern std::atomic_bool tracingEnabled;
+
+        inline bool isTracingEnabled() noexcept
+        {
+            return tracingEnabled.load(std::memory_order_relaxed);
+        }
+
+        /*
+         * Starts recording trace spans, discarding any previously recorded ones.
+         *
+         * Other than the profiling functions above, tracing is also available in release builds and is enabled at
+         * run-time, e.g. via Configuration#traceFile or the VC4C_TRACE environment variable.
+         */
+        void startTracing();
+
+        /*
+         * Stops recording trace spans and writes all spans recorded since #startTracing in the Chrome trace-event JSON
+         * format, which can be opened in chrome://tracing or Perfetto.
+         *
+         * NOTE: This must not be called while traced code is still running on any thread!
+         */
+        void stopTracing(std::ostream& output);
+        void stopTracing(const std::string& fileName);
+
+        void recordTraceSpan(const char* category, std::string&& name, std::string&& detail,
+            std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+        /*
+         * Records the time between its construction and destruction as a trace span on the current thread, if tracing
+         * is enabled. Otherwise, this only costs a single (relaxed) atomic load.
+         */
+        struct TraceScope
+        {
+            TraceScope(const char* category, const char* name) : TraceScope(category, std::string{}, std::string{})
+            {
+                if(active)
+                    this->name = name;
+            }
+
+            TraceScope(const char* category, const std::string& name, const std::string& detail = "") :
+                category(category), active(isTracingEnabled())
+            {
+                if(active)
+                {
+                    this->name = name;
+                    this->detail = detail;
+                    start = std::chrono::steady_clock::now();
+                }
+            }
+
+            TraceScope(const TraceScope&) = delete;
+            TraceScope(TraceScope&&) noexcept = delete;
+
+            ~TraceScope()
+            {
+                if(active)
+                    recordTraceSpan(
+                        category, std::move(name), std::move(detail), start, std::chrono::steady_clock::now());
+            }
+
+            TraceScope& operator=(const TraceScope&) = delete;
+            TraceScope& operator=(TraceScope&&) noexcept = delete;
+
+            const char* category;
+            bool active;
+            std::string name;
+            std::string detail;
+            std::chrono::steady_clock::time_point start;
+        };
+
     } // namespace profiler
 } // namespace vc4c
 
@@ -98,14 +98,26 @@ BitMask SIMDVector::getBitMask() const noexcept
         [](BitMask mask, Literal lit) -> BitMask { return mask | lit.getBitMask(); });
 }
 
-SIMDVector SIMDVector::transform(const std::function<Literal(Literal)>& transformOp) const
+bool SIMDVector::toWords(Words& words) const noexcept
 {
-    SIMDVector copy;
+    bool anyUndefined = false;
     for(std::size_t i = 0; i < elements.size(); ++i)
     {
-        copy.elements[i] = transformOp(elements[i]);
+        anyUndefined |= elements[i].isUndefined();
+        words[i] = elements[i].unsignedInt();
     }
-    return copy;
+    return !anyUndefined;
+}
+
+SIMDVector SIMDVector::fromWords(const Words& words, LiteralType type) noexcept
+{
+    SIMDVector result;
+    for(std::size_t i = 0; i < words.size(); ++i)
+    {
+        result.elements[i] = Literal(words[i]);
+        result.elements[i].type = type;
+    }
+    return result;
 }
 
 SIMDVector SIMDVector::rotate(uint8_t offset) const&
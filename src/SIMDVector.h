@@ -42,6 +42,13 @@ namespace vc4c
         using Elements = std::array<Literal, NATIVE_VECTOR_SIZE>;
 
     public:
+        /*
+         * Raw 32-bit lane representation of the vector elements without any literal type.
+         *
+         * This is used for element-wise calculations on all elements at once, e.g. in the emulator.
+         */
+        using Words = std::array<uint32_t, NATIVE_VECTOR_SIZE>;
+
         constexpr explicit SIMDVector(Literal defaultValue = UNDEFINED_LITERAL) noexcept :
             elements({defaultValue, defaultValue, defaultValue, defaultValue, defaultValue, defaultValue, defaultValue,
                 defaultValue, defaultValue, defaultValue, defaultValue, defaultValue, defaultValue, defaultValue,
@@ -153,7 +160,28 @@ namespace vc4c
          */
         BitMask getBitMask() const noexcept;
 
-        SIMDVector transform(const std::function<Literal(Literal)>& transformOp) const;
+        template <typename Func>
+        SIMDVector transform(Func&& transformOp) const
+        {
+            // not using std::function to allow the transformation to be inlined
+            SIMDVector copy;
+            for(std::size_t i = 0; i < elements.size(); ++i)
+            {
+                copy.elements[i] = transformOp(elements[i]);
+            }
+            return copy;
+        }
+
+        /*
+         * Extracts the raw bit-values of all elements into the given output. Returns false (and leaves the output in
+         * an unspecified state) if any element is undefined.
+         */
+        bool toWords(Words& words) const noexcept;
+
+        /*
+         * Creates a vector from the given raw bit-values, all elements having the given literal type
+         */
+        static SIMDVector fromWords(const Words& words, LiteralType type = LiteralType::INTEGER) noexcept;
 
         /*
          * Rotates the elements of this vector UPWARDS by the given offset.
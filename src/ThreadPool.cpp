@@ -6,18 +6,67 @@
 
 #include "ThreadPool.h"
 
-#include "Profiler.h"
+#include "Logger.h"
 #include "log.h"
 
 #include <sys/prctl.h>
 
 using namespace vc4c;
 
-ThreadPool::ThreadPool(const std::string& poolName, unsigned numThreads) : keepRunning(true)
+// the pool the current thread is a worker of (if any) and the index of its task queue
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local std::size_t currentQueue = 0;
+// whether the current thread is executing a task and the logger of that task
+static thread_local bool isInTask = false;
+static thread_local logging::Logger* currentTaskLogger = nullptr;
+
+ThreadPool::TaskGroup::~TaskGroup() noexcept
+{
+    // the tasks reference this group, so we need to wait for them in any case
+    waitForTasks();
+}
+
+void ThreadPool::TaskGroup::schedule(std::function<void()>&& func, logging::Logger* logger)
+{
+    ++numPendingTasks;
+    pool.push(Task{std::move(func), logger, this});
+}
+
+void ThreadPool::TaskGroup::wait()
+{
+    waitForTasks();
+    std::lock_guard<std::mutex> guard(errorMutex);
+    if(error)
+    {
+        auto tmp = error;
+        error = nullptr;
+        std::rethrow_exception(tmp);
+    }
+}
+
+void ThreadPool::TaskGroup::waitForTasks()
 {
+    while(numPendingTasks > 0)
+    {
+        // help executing tasks instead of blocking, to not dead-lock when waiting from within a task
+        if(pool.runPendingTask())
+            continue;
+        // all our remaining tasks are currently executed by other threads
+        std::unique_lock<std::mutex> lock(pool.sleepMutex);
+        pool.sleepCondition.wait_until(lock, std::chrono::system_clock::now() + std::chrono::milliseconds{10},
+            [&] { return numPendingTasks == 0 || pool.numQueuedTasks > 0; });
+    }
+}
+
+ThreadPool::ThreadPool(const std::string& poolName, unsigned numThreads) :
+    poolName(poolName), keepRunning(true), numQueuedTasks(0)
+{
+    queues.reserve(numThreads + 1);
+    for(unsigned i = 0; i <= numThreads; ++i)
+        queues.emplace_back(std::make_unique<TaskQueue>());
     workers.reserve(numThreads);
     for(unsigned i = 0; i < numThreads; ++i)
-        workers.emplace_back([this, poolName]() { workerTask(poolName); });
+        workers.emplace_back([this, i]() { workerTask(i); });
 }
 
 ThreadPool::~ThreadPool()
@@ -25,60 +74,136 @@ ThreadPool::~ThreadPool()
     keepRunning = false;
 
     // wait for all threads to end to not cause std::terminate to be issued
-    queueCondition.notify_all();
+    {
+        std::lock_guard<std::mutex> guard(sleepMutex);
+        sleepCondition.notify_all();
+    }
     for(auto& worker : workers)
         worker.join();
 }
 
-std::future<void> ThreadPool::schedule(std::function<void()>&& func, logging::Logger* logger)
+ThreadPool& ThreadPool::getSharedPool()
+{
+    static ThreadPool pool("VC4C-Worker", std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    return pool;
+}
+
+void ThreadPool::push(Task&& task)
+{
+    auto queueIndex = currentPool == this ? currentQueue : workers.size();
+    {
+        std::lock_guard<std::mutex> guard(queues[queueIndex]->mutex);
+        queues[queueIndex]->tasks.emplace_back(std::move(task));
+        ++numQueuedTasks;
+    }
+    {
+        // acquire the lock to not miss threads about to go to sleep
+        std::lock_guard<std::mutex> guard(sleepMutex);
+    }
+    sleepCondition.notify_one();
+}
+
+bool ThreadPool::pop(std::size_t queueIndex, bool fromBack, Task& task)
+{
+    auto& queue = *queues[queueIndex];
+    std::lock_guard<std::mutex> guard(queue.mutex);
+    if(queue.tasks.empty())
+        return false;
+    if(fromBack)
+    {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+    }
+    else
+    {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+    }
+    --numQueuedTasks;
+    return true;
+}
+
+bool ThreadPool::runPendingTask()
 {
-    std::packaged_task<void()> task{[func{std::move(func)}, logger]() {
-        // Since this is unconditionally called for every task, the logger is only used for the tasks where is
-        // explicitly set. In other words, the next task overwrites the logger to be used (possibly with a NULL pointer,
-        // to use the global logger).
-        logging::setThreadLogger(logger);
-        func();
-    }};
-    auto fut = task.get_future();
+    if(numQueuedTasks == 0)
+        return false;
+
+    Task task;
+    bool isWorker = currentPool == this;
+    auto ownQueue = isWorker ? currentQueue : workers.size();
+    // workers take the most recently scheduled (and probably still cached) task of their own queue and steal the
+    // oldest task of any other queue
+    bool found = pop(ownQueue, isWorker, task);
+    for(std::size_t i = 1; !found && i < queues.size(); ++i)
+        found = pop((ownQueue + i) % queues.size(), false, task);
+    if(!found)
+        return false;
+    execute(task);
+    return true;
+}
+
+void ThreadPool::execute(Task& task)
+{
+    // Since this is unconditionally called for every task, the logger is only used for the tasks where is explicitly
+    // set. In other words, the next task overwrites the logger to be used (possibly with a NULL pointer, to use the
+    // global logger).
+    auto wasInTask = isInTask;
+    auto previousLogger = currentTaskLogger;
+    isInTask = true;
+    currentTaskLogger = task.logger;
+    logging::setThreadLogger(task.logger);
+    try
+    {
+        task.func();
+    }
+    catch(...)
     {
-        std::lock_guard<std::mutex> guard(queueMutex);
-        taskQueue.emplace(std::move(task));
+        std::lock_guard<std::mutex> guard(task.group->errorMutex);
+        if(!task.group->error)
+            task.group->error = std::current_exception();
+    }
+    // restore the logger of the task interrupted by executing this one or of the thread itself
+    isInTask = wasInTask;
+    currentTaskLogger = previousLogger;
+    logging::setThreadLogger(wasInTask ? previousLogger : THREAD_LOGGER.get());
+
+    if(--task.group->numPendingTasks == 0)
+    {
+        // wake up the thread waiting for the group
+        std::lock_guard<std::mutex> guard(sleepMutex);
+        sleepCondition.notify_all();
     }
-    queueCondition.notify_one();
-    return fut;
 }
 
-void ThreadPool::workerTask(const std::string& poolName)
+void ThreadPool::workerTask(std::size_t queueIndex)
 {
+    currentPool = this;
+    currentQueue = queueIndex;
     prctl(PR_SET_NAME, poolName.data(), 0, 0, 0);
-    PROFILE_CREATE_THREAD_CACHE();
+    // NOTE: The workers do not cache the profiling results thread-locally, since they might live until the end of the
+    // process and the cached results would not be flushed before the profiling results are printed.
     while(keepRunning)
     {
-        std::packaged_task<void()> task;
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            /*
-             * There is a bug in TSAN which throws "double lock of a mutex" for the queueMutex.
-             *
-             * The actual desired queueCondition.wait_for(...) triggers the bug, while explicitly using
-             * queueCondition.wait_until(...) with a std::chrono::system_clock::time_points avoids it.
-             * Since this is also the identical (previous) behavior, we explicitly use this for now until
-             * TSAN is fixed.
-             *
-             * TSAN bug: https://github.com/google/sanitizers/issues/1259
-             */
-            queueCondition.wait_until(lock, std::chrono::system_clock::now() + std::chrono::milliseconds{100},
-                [&] { return !keepRunning || !taskQueue.empty(); });
-            if(!keepRunning)
-                break;
-            if(taskQueue.empty())
-                continue;
-            task = std::move(taskQueue.front());
-            taskQueue.pop();
-        }
-
-        // execute task outside of lock
-        task();
+        if(runPendingTask())
+            continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        /*
+         * There is a bug in TSAN which throws "double lock of a mutex" for the sleepMutex.
+         *
+         * The actual desired sleepCondition.wait_for(...) triggers the bug, while explicitly using
+         * sleepCondition.wait_until(...) with a std::chrono::system_clock::time_points avoids it.
+         * Since this is also the identical (previous) behavior, we explicitly use this for now until
+         * TSAN is fixed.
+         *
+         * TSAN bug: https://github.com/google/sanitizers/issues/1259
+         */
+        sleepCondition.wait_until(lock, std::chrono::system_clock::now() + std::chrono::milliseconds{100},
+            [&] { return !keepRunning || numQueuedTasks > 0; });
     }
-    PROFILE_FLUSH_THREAD_CACHE();
+}
+
+void ThreadPool::logScheduleAll(const std::string& name, std::size_t numTasks)
+{
+    CPPLOG_LAZY(logging::Level::DEBUG,
+        log << "Scheduling " << numTasks << " tasks for '" << name << "' on shared thread pool" << logging::endl);
 }
@@ -8,10 +8,14 @@
 
 #include <algorithm>
 #include <atomic>
-#include <future>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -22,9 +26,55 @@ namespace logging
 
 namespace vc4c
 {
+    /**
+     * Pool of worker threads executing tasks with work-stealing.
+     *
+     * Every worker has its own task queue. Tasks scheduled by a worker are pushed to and taken from the back of its own
+     * queue, while workers without any work steal tasks from the front of the other queues. Tasks scheduled by threads
+     * not belonging to the pool are pushed to an additional shared queue.
+     *
+     * Tasks are grouped in TaskGroups which are waited on in a fork-join manner: A thread waiting for a group
+     * executes pending tasks itself, so tasks can schedule (and wait for) sub-tasks without dead-locking, even if all
+     * workers are busy.
+     */
     class ThreadPool
     {
     public:
+        /*
+         * A group of tasks scheduled on the same pool which can be waited on together
+         */
+        class TaskGroup
+        {
+        public:
+            explicit TaskGroup(ThreadPool& pool) : pool(pool), numPendingTasks(0) {}
+            TaskGroup(const TaskGroup&) = delete;
+            TaskGroup(TaskGroup&&) noexcept = delete;
+            ~TaskGroup() noexcept;
+
+            TaskGroup& operator=(const TaskGroup&) = delete;
+            TaskGroup& operator=(TaskGroup&&) noexcept = delete;
+
+            void schedule(std::function<void()>&& func, logging::Logger* logger = nullptr);
+
+            /*
+             * Waits for all tasks scheduled in this group to finish and rethrows the first exception thrown by any of
+             * them.
+             *
+             * While waiting, the calling thread executes pending tasks of the pool (of any group).
+             */
+            void wait();
+
+        private:
+            ThreadPool& pool;
+            std::atomic_size_t numPendingTasks;
+            std::mutex errorMutex;
+            std::exception_ptr error;
+
+            void waitForTasks();
+
+            friend class ThreadPool;
+        };
+
         explicit ThreadPool(const std::string& poolName, unsigned numThreads = std::thread::hardware_concurrency());
         ThreadPool(const ThreadPool&) = delete;
         ThreadPool(ThreadPool&&) noexcept = delete;
@@ -33,38 +83,71 @@ namespace vc4c
         ThreadPool& operator=(const ThreadPool&) = delete;
         ThreadPool& operator=(ThreadPool&&) noexcept = delete;
 
-        std::future<void> schedule(std::function<void()>&& func, logging::Logger* logger = nullptr);
+        /*
+         * Returns the process-wide pool shared by all compilations.
+         *
+         * Since the thread calling TaskGroup#wait executes tasks too, the shared pool has one worker less than there
+         * are hardware threads.
+         */
+        static ThreadPool& getSharedPool();
+
+        std::size_t getNumWorkers() const noexcept
+        {
+            return workers.size();
+        }
 
         template <typename T, typename Container = std::list<T>>
         void scheduleAll(
             const Container& c, const std::function<void(const T&)>& func, logging::Logger* logger = nullptr)
         {
-            std::vector<std::future<void>> futures;
-            futures.reserve(c.size());
-
+            TaskGroup group(*this);
             for(auto& elem : c)
-                futures.emplace_back(schedule([&]() { func(elem); }, logger));
-
-            for(auto& fut : futures)
-                fut.get();
+                group.schedule([&]() { func(elem); }, logger);
+            group.wait();
         }
 
+        /*
+         * Executes the given function for all elements of the container on the shared pool and waits for all of them
+         * to finish. The name is only used for debugging purposes.
+         */
         template <typename T, typename Container = std::list<T>>
         static void scheduleAll(const std::string& name, const Container& c, const std::function<void(const T&)>& func,
             logging::Logger* logger = nullptr)
         {
-            ThreadPool pool(name, std::min(static_cast<unsigned>(c.size()), std::thread::hardware_concurrency()));
-            return pool.scheduleAll(c, func, logger);
+            logScheduleAll(name, c.size());
+            return getSharedPool().scheduleAll(c, func, logger);
         }
 
     private:
+        struct Task
+        {
+            std::function<void()> func;
+            logging::Logger* logger;
+            TaskGroup* group;
+        };
+
+        struct TaskQueue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::string poolName;
+        // one queue per worker, followed by the queue for tasks scheduled from outside of the pool
+        std::vector<std::unique_ptr<TaskQueue>> queues;
         std::vector<std::thread> workers;
         std::atomic_bool keepRunning;
-        std::mutex queueMutex;
-        std::queue<std::packaged_task<void()>> taskQueue;
-        std::condition_variable queueCondition;
+        std::atomic_size_t numQueuedTasks;
+        std::mutex sleepMutex;
+        std::condition_variable sleepCondition;
+
+        void push(Task&& task);
+        bool pop(std::size_t queueIndex, bool fromBack, Task& task);
+        bool runPendingTask();
+        void execute(Task& task);
+        void workerTask(std::size_t queueIndex);
 
-        void workerTask(const std::string& poolName);
+        static void logScheduleAll(const std::string& name, std::size_t numTasks);
     };
 
 } /* namespace vc4c */
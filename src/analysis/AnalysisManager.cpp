@@ -0,0 +1,82 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "AnalysisManager.h"
+
+#include "../Method.h"
+#include "../Profiler.h"
+#include "ControlFlowGraph.h"
+#include "ControlFlowLoop.h"
+#include "DataDependencyGraph.h"
+#include "DominatorTree.h"
+#include "log.h"
+
+using namespace vc4c;
+using namespace vc4c::analysis;
+
+AnalysisManager::AnalysisManager(Method& method) : method(method) {}
+
+AnalysisManager::~AnalysisManager() noexcept = default;
+
+std::shared_ptr<DominatorTree> AnalysisManager::getDominatorTree()
+{
+    // the dominator tree is cached by the CFG itself and reset on any change of the CFG
+    return method.getCFG().getDominatorTree();
+}
+
+FastAccessList<ControlFlowLoop> AnalysisManager::getLoops(bool recursively, bool skipWorkGroupLoops)
+{
+    // the loops are cached by the CFG itself and reset on any change of the CFG
+    return method.getCFG().findLoops(recursively, skipWorkGroupLoops);
+}
+
+std::shared_ptr<const DataDependencyGraph> AnalysisManager::getDataDependencyGraph()
+{
+    std::lock_guard<std::mutex> guard(cacheMutex);
+    if(!dataDependencies)
+    {
+        PROFILE_COUNTER(vc4c::profiler::COUNTER_OPTIMIZATION, "Data dependency graphs created", 1);
+        dataDependencies = DataDependencyGraph::createDependencyGraph(method);
+    }
+    return dataDependencies;
+}
+
+void AnalysisManager::invalidate(AnalysisType types)
+{
+    if(has_flag(types, AnalysisType::DOMINATOR_TREE) || has_flag(types, AnalysisType::LOOPS))
+    {
+        if(auto cfg = method.cfg.get())
+        {
+            // the loops are built from the dominator tree, so we need to reset them too
+            cfg->loops.reset();
+            if(has_flag(types, AnalysisType::DOMINATOR_TREE))
+                cfg->dominatorTree.reset();
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(cacheMutex);
+    if(has_flag(types, AnalysisType::DATA_DEPENDENCIES))
+        dataDependencies.reset();
+}
+
+void AnalysisManager::invalidateExcept(AnalysisType preserved)
+{
+    invalidate(remove_flag(AnalysisType::ALL, preserved));
+}
+
+bool AnalysisManager::isCached(AnalysisType types) const
+{
+    auto cfg = method.cfg.get();
+    if(has_flag(types, AnalysisType::DOMINATOR_TREE) && !(cfg && cfg->dominatorTree))
+        return false;
+    if(has_flag(types, AnalysisType::LOOPS) && !(cfg && cfg->loops))
+        return false;
+
+    std::lock_guard<std::mutex> guard(cacheMutex);
+    if(has_flag(types, AnalysisType::DATA_DEPENDENCIES) && !dataDependencies)
+        return false;
+    return true;
+}
@@ -0,0 +1,108 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_ANALYSIS_MANAGER_H
+#define VC4C_ANALYSIS_MANAGER_H
+
+#include "../Optional.h"
+#include "../performance.h"
+
+#include <memory>
+#include <mutex>
+
+namespace vc4c
+{
+    class Method;
+
+    namespace analysis
+    {
+        class ControlFlowLoop;
+        class DataDependencyGraph;
+        struct DominatorTree;
+
+        /*
+         * Bit-field of the analyses cached by the AnalysisManager
+         */
+        enum class AnalysisType : uint8_t
+        {
+            NONE = 0,
+            /*
+             * The dominator tree of the CFG
+             */
+            DOMINATOR_TREE = 1 << 0,
+            /*
+             * The control flow loops of the CFG
+             */
+            LOOPS = 1 << 1,
+            /*
+             * The data dependencies between basic blocks
+             */
+            DATA_DEPENDENCIES = 1 << 2,
+            /*
+             * The analyses depending only on the control flow of the method
+             */
+            CONTROL_FLOW = DOMINATOR_TREE | LOOPS,
+            /*
+             * The analyses depending on the actual instructions of the method
+             */
+            INSTRUCTIONS = DATA_DEPENDENCIES,
+            ALL = CONTROL_FLOW | INSTRUCTIONS
+        };
+
+        /*
+         * Caches the results of analyses for a single method, so they can be shared by different optimizations.
+         *
+         * The results are created lazily on first access and kept until they are invalidated. Analyses depending on the
+         * control flow are automatically invalidated when the CFG is updated. All other analyses need to be
+         * invalidated explicitly by the code modifying the method, e.g. the optimizer invalidates all analyses not
+         * preserved by an optimization pass which changed the method.
+         *
+         * NOTE: The results are returned as shared pointers to keep them valid for the caller, even if they are
+         * invalidated (e.g. by modifying the CFG) while in use.
+         */
+        class AnalysisManager : private NonCopyable
+        {
+        public:
+            explicit AnalysisManager(Method& method);
+            AnalysisManager(const AnalysisManager&) = delete;
+            AnalysisManager(AnalysisManager&&) noexcept = delete;
+            ~AnalysisManager() noexcept;
+
+            AnalysisManager& operator=(const AnalysisManager&) = delete;
+            AnalysisManager& operator=(AnalysisManager&&) noexcept = delete;
+
+            std::shared_ptr<DominatorTree> getDominatorTree();
+            /*
+             * Returns the loops of the method, see ControlFlowGraph#findLoops
+             *
+             * NOTE: The loops are copied on purpose to allow modification of the CFG while iterating them.
+             */
+            FastAccessList<ControlFlowLoop> getLoops(bool recursively, bool skipWorkGroupLoops = true);
+            std::shared_ptr<const DataDependencyGraph> getDataDependencyGraph();
+
+            /*
+             * Drops the cached results for all the given analyses
+             */
+            void invalidate(AnalysisType types = AnalysisType::ALL);
+            /*
+             * Drops the cached results for all analyses not contained in the given preserved analyses
+             */
+            void invalidateExcept(AnalysisType preserved);
+
+            /*
+             * Returns whether the results of all the given analyses are currently cached
+             */
+            bool isCached(AnalysisType types) const;
+
+        private:
+            Method& method;
+            mutable std::mutex cacheMutex;
+            std::shared_ptr<const DataDependencyGraph> dataDependencies;
+        };
+    } // namespace analysis
+} // namespace vc4c
+
+#endif /* VC4C_ANALYSIS_MANAGER_H */
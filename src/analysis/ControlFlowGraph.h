@@ -151,6 +151,7 @@ namespace vc4c
             void findAllLoops();
 
             friend class Method;
+            friend class AnalysisManager;
         };
     } // namespace analysis
 } /* namespace vc4c */
@@ -630,15 +630,17 @@ static void createTMUCoordinateDependencies(DependencyGraph& graph, DependencyNo
     // Tests show a delay of 8 instructions in between (total of 9 cycles) to be the most efficient:
     // 8 instructions inserted increase execution time almost not at all (a bit due to instruction fetching), 9+ do
     // noticeably
+    // NOTE: The TMU address might be written in a previous block, e.g. if the load is prefetched in the previous loop
+    // iteration.
     const unsigned tmuLoadDelay = 8;
-    if(node.key->getSignal() == SIGNAL_LOAD_TMU0)
+    if(lastTMU0CoordsWrite != nullptr && node.key->getSignal() == SIGNAL_LOAD_TMU0)
     {
         // triggering of read from the FIFO depends on the memory address being set previously which fills the FIFO from
         // memory (thus taking longer)
         auto& otherNode = graph.assertNode(lastTMU0CoordsWrite);
         addDependency(otherNode.getOrCreateEdge(&node).data, DependencyType::PERIPHERY_ORDER, tmuLoadDelay);
     }
-    if(node.key->getSignal() == SIGNAL_LOAD_TMU1)
+    if(lastTMU1CoordsWrite != nullptr && node.key->getSignal() == SIGNAL_LOAD_TMU1)
     {
         // triggering of read from the FIFO depends on the memory address being set previously which fills the FIFO from
         // memory (thus taking longer)
@@ -40,6 +40,44 @@ std::unique_ptr<InterferenceGraph> InterferenceGraph::createGraph(
         tmpAnalysis(method);
     auto& livenessAnalysis = globalLivenessAnalysis ? *globalLivenessAnalysis : tmpAnalysis;
 
+    graph.addInterferences(method, livenessAnalysis, nullptr);
+
+    PROFILE_END(createInterferenceGraph);
+
+#ifndef NDEBUG
+    LCOV_EXCL_START
+    logging::logLazy(logging::Level::DEBUG, [&]() {
+        auto nameFunc = [](const Local* loc) -> std::string { return loc->name; };
+        auto edgeFunc = [](InterferenceType type) -> bool { return !has_flag(type, InterferenceType::USED_TOGETHER); };
+        DebugGraph<const Local*, InterferenceType, Directionality::UNDIRECTED>::dumpGraph(
+            graph, "/tmp/vc4c-interference.dot", nameFunc, edgeFunc);
+    });
+    LCOV_EXCL_STOP
+#endif
+    return graph_ptr;
+}
+
+void InterferenceGraph::updateGraph(
+    Method& method, const GlobalLivenessAnalysis& livenessAnalysis, const FastSet<const Local*>& changedLocals)
+{
+    PROFILE_START(updateInterferenceGraph);
+    for(auto loc : changedLocals)
+    {
+        if(findNode(loc))
+            eraseNode(loc);
+    }
+    addInterferences(method, livenessAnalysis, &changedLocals);
+    PROFILE_END(updateInterferenceGraph);
+}
+
+void InterferenceGraph::addInterferences(
+    Method& method, const GlobalLivenessAnalysis& livenessAnalysis, const FastSet<const Local*>* changedLocals)
+{
+    // if a set of changed locals is given, only edges touching at least one of these locals are created
+    auto isChanged = [changedLocals](const Local* loc) -> bool {
+        return !changedLocals || changedLocals->find(loc) != changedLocals->end();
+    };
+
     PROFILE_START(LivenessToInterference);
     for(auto& block : method)
     {
@@ -53,8 +91,16 @@ std::unique_ptr<InterferenceGraph> InterferenceGraph::createGraph(
         // LivenessChangesAnalysis on the list of tracked live locals.
         auto& liveLocals = blockAnalysis.getEndResult();
         FastMap<const Local*, InterferenceNode*> liveNodes(liveLocals.size());
+        // the subset of the live locals which are changed, to only create edges touching changed locals for
+        // unchanged locals becoming live
+        FastMap<const Local*, InterferenceNode*> liveChangedNodes;
         for(auto loc : liveLocals)
-            liveNodes.emplace(loc, &graph.getOrCreateNode(loc));
+        {
+            auto& node = getOrCreateNode(loc);
+            liveNodes.emplace(loc, &node);
+            if(changedLocals && isChanged(loc))
+                liveChangedNodes.emplace(loc, &node);
+        }
         // NOTE: iterate in reverse order to be able to track the changes in live locals (which are also generated in
         // reverse order) correctly
         for(auto it = block.rbegin(); it != block.rend(); ++it)
@@ -65,21 +111,25 @@ std::unique_ptr<InterferenceGraph> InterferenceGraph::createGraph(
             {
                 auto firstOut = combInstr->getFirstOp()->checkOutputLocal();
                 auto secondOut = combInstr->getSecondOp()->checkOutputLocal();
-                if(firstOut && secondOut && firstOut != secondOut)
+                if(firstOut && secondOut && firstOut != secondOut && (isChanged(firstOut) || isChanged(secondOut)))
                 {
-                    graph.getOrCreateNode(firstOut)
-                        .getOrCreateEdge(&graph.getOrCreateNode(secondOut), InterferenceType::USED_TOGETHER)
+                    getOrCreateNode(firstOut)
+                        .getOrCreateEdge(&getOrCreateNode(secondOut), InterferenceType::USED_TOGETHER)
                         .data = InterferenceType::USED_TOGETHER;
                 }
             }
             // instructions in general can read multiple locals
             // we have a maximum of 4 locals per (combined) instruction
             FastSet<InterferenceNode*> localsRead(4);
+            bool anyReadChanged = false;
             (*it)->forReadLocals([&](const Local* loc, const intermediate::IntermediateInstruction& inst) {
                 if(!loc->type.isLabelType())
-                    localsRead.emplace(&graph.getOrCreateNode(loc));
+                {
+                    localsRead.emplace(&getOrCreateNode(loc));
+                    anyReadChanged = anyReadChanged || isChanged(loc);
+                }
             });
-            if(localsRead.size() > 1)
+            if(localsRead.size() > 1 && anyReadChanged)
             {
                 for(auto locIt = localsRead.begin(); locIt != localsRead.end(); ++locIt)
                 {
@@ -87,8 +137,9 @@ std::unique_ptr<InterferenceGraph> InterferenceGraph::createGraph(
                     auto locIt2 = locIt;
                     for(++locIt2; locIt2 != localsRead.end(); ++locIt2)
                     {
-                        firstNode.getOrCreateEdge(*locIt2, InterferenceType::USED_TOGETHER).data =
-                            InterferenceType::USED_TOGETHER;
+                        if(isChanged(firstNode.key) || isChanged((*locIt2)->key))
+                            firstNode.getOrCreateEdge(*locIt2, InterferenceType::USED_TOGETHER).data =
+                                InterferenceType::USED_TOGETHER;
                     }
                 }
             }
@@ -100,12 +151,16 @@ std::unique_ptr<InterferenceGraph> InterferenceGraph::createGraph(
             // locals.
 
             for(auto loc : changes.removedLocals)
+            {
                 liveNodes.erase(loc);
+                liveChangedNodes.erase(loc);
+            }
 
             for(auto loc : changes.addedLocals)
             {
-                auto& firstNode = graph.getOrCreateNode(loc);
-                for(auto node : liveNodes)
+                auto& firstNode = getOrCreateNode(loc);
+                bool isLocalChanged = isChanged(loc);
+                for(auto node : (isLocalChanged ? liveNodes : liveChangedNodes))
                 {
                     if(node.second != &firstNode)
                         // the node could already be in the list (e.g. when read multiple times) and creating an edge
@@ -113,22 +168,10 @@ std::unique_ptr<InterferenceGraph> InterferenceGraph::createGraph(
                         firstNode.getOrCreateEdge(node.second, InterferenceType::USED_SIMULTANEOUSLY);
                 }
                 liveNodes.emplace(loc, &firstNode);
+                if(changedLocals && isLocalChanged)
+                    liveChangedNodes.emplace(loc, &firstNode);
             }
         }
     }
     PROFILE_END(LivenessToInterference);
-
-    PROFILE_END(createInterferenceGraph);
-
-#ifndef NDEBUG
-    LCOV_EXCL_START
-    logging::logLazy(logging::Level::DEBUG, [&]() {
-        auto nameFunc = [](const Local* loc) -> std::string { return loc->name; };
-        auto edgeFunc = [](InterferenceType type) -> bool { return !has_flag(type, InterferenceType::USED_TOGETHER); };
-        DebugGraph<const Local*, InterferenceType, Directionality::UNDIRECTED>::dumpGraph(
-            graph, "/tmp/vc4c-interference.dot", nameFunc, edgeFunc);
-    });
-    LCOV_EXCL_STOP
-#endif
-    return graph_ptr;
 }
@@ -56,8 +56,19 @@ namespace vc4c
             static std::unique_ptr<InterferenceGraph> createGraph(
                 Method& method, const GlobalLivenessAnalysis* globalLivenessAnalysis = nullptr);
 
+            /*
+             * Updates the interference of the given locals after the instructions accessing them were changed.
+             *
+             * All nodes of the changed locals are recreated from the given (up-to-date) liveness analysis, while the
+             * interference between all other locals is kept as-is.
+             */
+            void updateGraph(Method& method, const GlobalLivenessAnalysis& livenessAnalysis,
+                const FastSet<const Local*>& changedLocals);
+
         private:
             explicit InterferenceGraph(std::size_t numLocals) : Graph(numLocals) {}
+            void addInterferences(Method& method, const GlobalLivenessAnalysis& livenessAnalysis,
+                const FastSet<const Local*>* changedLocals);
         };
     } /* namespace analysis */
 } /* namespace vc4c */
@@ -84,6 +84,7 @@ static FixupResult runRegisterFixupStep(const RegisterFixupStep& step, Method& m
 {
     CPPLOG_LAZY(
         logging::Level::DEBUG, log << "Running register fix-up step: " << step.name << "..." << logging::endl);
+    PROFILE_TRACE_SCOPE("backend", step.name, method.name);
     PROFILE_START_DYNAMIC(step.name);
     auto result = step(method, config, *coloredGraph);
     PROFILE_END_DYNAMIC(step.name);
@@ -108,6 +109,11 @@ const FastAccessList<DecoratedInstruction>& CodeGenerator::generateInstructions(
             PROFILE_SCOPE(initializeLocalsUses);
             coloredGraph = std::make_unique<GraphColoring>(method, method.walkAllInstructions());
         }
+        else if(lastResult == FixupResult::FIXES_APPLIED_UPDATE_GRAPH)
+        {
+            PROFILE_SCOPE(updateLocalsUses);
+            coloredGraph->updateLocalUses();
+        }
         if(lastResult != FixupResult::NOTHING_FIXED)
         {
             // only recolor the graph if we did anything at all
@@ -133,6 +139,11 @@ const FastAccessList<DecoratedInstruction>& CodeGenerator::generateInstructions(
             PROFILE_SCOPE(initializeLocalsUses);
             coloredGraph = std::make_unique<GraphColoring>(method, method.walkAllInstructions());
         }
+        else if(lastResult == FixupResult::FIXES_APPLIED_UPDATE_GRAPH)
+        {
+            PROFILE_SCOPE(updateLocalsUses);
+            coloredGraph->updateLocalUses();
+        }
         PROFILE_START(colorGraph);
         auto hasError = coloredGraph->colorGraph();
         // the call to #toRegisterMap() below will fail anyway and has better error information
@@ -286,5 +297,7 @@ std::size_t CodeGenerator::writeOutput(std::ostream& stream)
 // register/instruction mapping
 void CodeGenerator::toMachineCode(Method& kernel)
 {
+    PROFILE_TRACE_SCOPE("backend", "GenerateCode", kernel.name);
+    tools::SlabPool::Scope poolScope(kernel.getPool());
     generateInstructions(kernel);
 }
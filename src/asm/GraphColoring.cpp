@@ -15,6 +15,7 @@
 #include "log.h"
 
 #include <algorithm>
+#include <functional>
 
 using namespace vc4c;
 using namespace vc4c::qpu_asm;
@@ -77,12 +78,6 @@ void ColoredNodeBase::takeValues(const ColoredNodeBase& other)
     this->availableAcc = other.availableAcc;
     this->availableA = other.availableA;
     this->availableB = other.availableB;
-    auto* self = reinterpret_cast<ColoredNode*>(this);
-    const auto* otherNode = reinterpret_cast<const ColoredNode*>(&other);
-    otherNode->forAllEdges([self](const ColoredNode& neighbor, const ColoredEdge& edge) -> bool {
-        self->getOrCreateEdge(const_cast<ColoredNode*>(&neighbor), LocalRelation{edge.data});
-        return true;
-    });
 }
 
 Register ColoredNodeBase::getRegisterFixed() const
@@ -182,7 +177,7 @@ std::size_t ColoredNodeBase::fixToRegister()
 LCOV_EXCL_START
 std::string ColoredNodeBase::to_string(bool longDescription) const
 {
-    const auto* self = reinterpret_cast<const ColoredNode*>(this);
+    const auto* self = static_cast<const ColoredNode*>(this);
     std::string res = (self->key->name + " init: ")
                           .append(toString(initialFile))
                           .append(", avail: ")
@@ -206,6 +201,188 @@ std::string ColoredNodeBase::to_string(bool longDescription) const
 }
 LCOV_EXCL_STOP
 
+ColoredNode::ColoredNode(ColoredGraph& graph, uint32_t index, const Local* key, RegisterFile possibleFiles) :
+    ColoredNodeBase(possibleFiles), key(key), graph(&graph), index(index)
+{
+}
+
+static bool compareEdgeNeighbor(const ColoredEdge& edge, uint32_t neighbor) noexcept
+{
+    return edge.neighbor < neighbor;
+}
+
+ColoredEdge* ColoredNode::findOwnedEdge(uint32_t neighbor)
+{
+    return const_cast<ColoredEdge*>(static_cast<const ColoredNode*>(this)->findOwnedEdge(neighbor));
+}
+
+const ColoredEdge* ColoredNode::findOwnedEdge(uint32_t neighbor) const
+{
+    auto it = std::lower_bound(ownedEdges.begin(), ownedEdges.end(), neighbor, compareEdgeNeighbor);
+    return it != ownedEdges.end() && it->neighbor == neighbor ? &*it : nullptr;
+}
+
+ColoredEdge& ColoredNode::getEdge(uint32_t neighbor)
+{
+    return const_cast<ColoredEdge&>(static_cast<const ColoredNode*>(this)->getEdge(neighbor));
+}
+
+const ColoredEdge& ColoredNode::getEdge(uint32_t neighbor) const
+{
+    const auto& neighborNode = static_cast<const ColoredGraph*>(graph)->getNode(neighbor);
+    const auto* edge = neighbor > index ? findOwnedEdge(neighbor) : neighborNode.findOwnedEdge(index);
+    if(!edge)
+        throw CompilationError(
+            CompilationStep::LABEL_REGISTER_MAPPING, "Failed to find edge to node", neighborNode.key->name);
+    return *edge;
+}
+
+bool ColoredNode::isAdjacent(const ColoredNode* other) const
+{
+    const auto& owner = index < other->index ? *this : *other;
+    return owner.findOwnedEdge(std::max(index, other->index)) != nullptr;
+}
+
+ColoredEdge& ColoredNode::getOrCreateEdge(ColoredNode* other, LocalRelation relation)
+{
+    auto& owner = index < other->index ? *this : *other;
+    auto& lower = index < other->index ? *other : *this;
+    auto it = std::lower_bound(owner.ownedEdges.begin(), owner.ownedEdges.end(), lower.index, compareEdgeNeighbor);
+    if(it != owner.ownedEdges.end() && it->neighbor == lower.index)
+        return *it;
+    lower.lowerNeighbors.insert(
+        std::lower_bound(lower.lowerNeighbors.begin(), lower.lowerNeighbors.end(), owner.index), owner.index);
+    return *owner.ownedEdges.insert(it, ColoredEdge{lower.index, relation});
+}
+
+const ColoredEdge& ColoredNode::assertEdge(const ColoredNode* other) const
+{
+    return getEdge(other->index);
+}
+
+void ColoredNode::takeValues(const ColoredNode& other)
+{
+    ColoredNodeBase::takeValues(other);
+    other.forAllEdges([this](const ColoredNode& neighbor, const ColoredEdge& edge) -> bool {
+        if(&neighbor != this)
+            getOrCreateEdge(&graph->getNode(neighbor.index), edge.data);
+        return true;
+    });
+}
+
+ColoredNode& ColoredGraph::getOrCreateNode(const Local* key, RegisterFile possibleFiles)
+{
+    auto it = indices.find(key);
+    if(it != indices.end())
+        return nodes[it->second];
+    if(!freeIndices.empty())
+    {
+        auto index = freeIndices.back();
+        freeIndices.pop_back();
+        indices.emplace(key, index);
+        auto& node = nodes[index];
+        static_cast<ColoredNodeBase&>(node) = ColoredNodeBase(possibleFiles);
+        node.key = key;
+        return node;
+    }
+    auto index = static_cast<uint32_t>(nodes.size());
+    indices.emplace(key, index);
+    nodes.emplace_back(*this, index, key, possibleFiles);
+    return nodes.back();
+}
+
+ColoredNode& ColoredGraph::assertNode(const Local* key)
+{
+    if(auto node = findNode(key))
+        return *node;
+    throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Failed to find graph-node for local", key->name);
+}
+
+const ColoredNode& ColoredGraph::assertNode(const Local* key) const
+{
+    if(auto node = findNode(key))
+        return *node;
+    throw CompilationError(CompilationStep::LABEL_REGISTER_MAPPING, "Failed to find graph-node for local", key->name);
+}
+
+ColoredNode* ColoredGraph::findNode(const Local* key)
+{
+    auto it = indices.find(key);
+    return it != indices.end() ? &nodes[it->second] : nullptr;
+}
+
+const ColoredNode* ColoredGraph::findNode(const Local* key) const
+{
+    auto it = indices.find(key);
+    return it != indices.end() ? &nodes[it->second] : nullptr;
+}
+
+void ColoredGraph::eraseNode(const Local* key)
+{
+    auto it = indices.find(key);
+    if(it == indices.end())
+        throw CompilationError(
+            CompilationStep::LABEL_REGISTER_MAPPING, "Failed to find graph-node for local", key->name);
+    auto index = it->second;
+    auto& node = nodes[index];
+    for(auto neighbor : node.lowerNeighbors)
+    {
+        auto& neighborEdges = nodes[neighbor].ownedEdges;
+        auto edgeIt = std::lower_bound(neighborEdges.begin(), neighborEdges.end(), index, compareEdgeNeighbor);
+        if(edgeIt != neighborEdges.end() && edgeIt->neighbor == index)
+            neighborEdges.erase(edgeIt);
+    }
+    for(const auto& edge : node.ownedEdges)
+    {
+        auto& neighborIndices = nodes[edge.neighbor].lowerNeighbors;
+        auto indexIt = std::lower_bound(neighborIndices.begin(), neighborIndices.end(), index);
+        if(indexIt != neighborIndices.end() && *indexIt == index)
+            neighborIndices.erase(indexIt);
+    }
+    node.ownedEdges.clear();
+    node.lowerNeighbors.clear();
+    node.key = nullptr;
+    indices.erase(it);
+    freeIndices.push_back(index);
+}
+
+void ColoredGraph::appendEdge(ColoredNode& first, ColoredNode& second, LocalRelation relation)
+{
+    auto& owner = first.index < second.index ? first : second;
+    auto& lower = first.index < second.index ? second : first;
+    owner.ownedEdges.emplace_back(ColoredEdge{lower.index, relation});
+    lower.lowerNeighbors.emplace_back(owner.index);
+}
+
+void ColoredGraph::sortEdges()
+{
+    for(auto& node : nodes)
+    {
+        if(!std::is_sorted(node.ownedEdges.begin(), node.ownedEdges.end(),
+               [](const ColoredEdge& first, const ColoredEdge& second) -> bool {
+                   return first.neighbor < second.neighbor;
+               }))
+            std::sort(node.ownedEdges.begin(), node.ownedEdges.end(),
+                [](const ColoredEdge& first, const ColoredEdge& second) -> bool {
+                    return first.neighbor < second.neighbor;
+                });
+        if(!std::is_sorted(node.lowerNeighbors.begin(), node.lowerNeighbors.end()))
+            std::sort(node.lowerNeighbors.begin(), node.lowerNeighbors.end());
+    }
+}
+
+void ColoredGraph::reserveNodeSize(std::size_t size)
+{
+    indices.reserve(size);
+}
+
+void ColoredGraph::clear()
+{
+    nodes.clear();
+    indices.clear();
+    freeIndices.clear();
+}
+
 static void fixToRegisterFile(const RegisterFile file, const Local* local, FastMap<const Local*, LocalUsage>& localUses)
 {
     localUses.at(local).possibleFiles = intersect_flags(localUses.at(local).possibleFiles, file);
@@ -421,6 +598,24 @@ GraphColoring::GraphColoring(Method& method, InstructionWalker it) :
     openSet.reserve(method.getNumLocals());
     localUses.reserve(method.getNumLocals());
 
+    createLocalUses(it);
+}
+
+void GraphColoring::markLocalChanged(const Local* local)
+{
+    changedLocals.emplace(local);
+}
+
+void GraphColoring::updateLocalUses()
+{
+    closedSet.clear();
+    openSet.clear();
+    localUses.clear();
+    createLocalUses(method.walkAllInstructions());
+}
+
+void GraphColoring::createLocalUses(InstructionWalker it)
+{
     const Local* lastWrittenLocal0 = nullptr;
     const Local* lastWrittenLocal1 = nullptr;
     while(!it.isEndOfMethod())
@@ -473,8 +668,7 @@ GraphColoring::GraphColoring(Method& method, InstructionWalker it) :
  */
 static void insertR5Node(ColoredGraph& graph)
 {
-    auto& r5Node = graph.getOrCreateNode(analysis::FAKE_REPLICATE_REGISTER,
-        ColoredNode(graph, analysis::FAKE_REPLICATE_REGISTER, RegisterFile::ACCUMULATOR));
+    auto& r5Node = graph.getOrCreateNode(analysis::FAKE_REPLICATE_REGISTER, RegisterFile::ACCUMULATOR);
     r5Node.blockRegister(RegisterFile::ACCUMULATOR, 0);
     r5Node.blockRegister(RegisterFile::ACCUMULATOR, 1);
     r5Node.blockRegister(RegisterFile::ACCUMULATOR, 2);
@@ -492,7 +686,34 @@ void GraphColoring::createGraph()
     // have changed the local interferences.
     livenessAnalysis = analysis::GlobalLivenessAnalysis(true);
     livenessAnalysis(method);
-    interferenceGraph = analysis::InterferenceGraph::createGraph(method, &livenessAnalysis);
+    const bool updateGraph = interferenceGraph != nullptr;
+    if(updateGraph)
+    {
+        // The interference between locals whose accesses did not change stays the same, so we only need to recreate
+        // the nodes of the changed locals, any new locals (e.g. temporaries inserted by the fix-up steps) and the
+        // locals which are no longer used at all.
+        // NOTE: The r5 usage is not tracked by the fix-up steps, so always recreate its interference.
+        changedLocals.emplace(analysis::FAKE_REPLICATE_REGISTER);
+        for(const auto& pair : localUses)
+        {
+            if(!interferenceGraph->findNode(pair.first))
+                changedLocals.emplace(pair.first);
+        }
+        graph.forAllNodes([&](const ColoredNode& node) {
+            if(node.key != analysis::FAKE_REPLICATE_REGISTER && localUses.find(node.key) == localUses.end())
+                changedLocals.emplace(node.key);
+        });
+        CPPLOG_LAZY(logging::Level::DEBUG,
+            log << "Updating colored graph for " << changedLocals.size() << " changed locals..." << logging::endl);
+        interferenceGraph->updateGraph(method, livenessAnalysis, changedLocals);
+        for(auto loc : changedLocals)
+        {
+            if(graph.findNode(loc))
+                graph.eraseNode(loc);
+        }
+    }
+    else
+        interferenceGraph = analysis::InterferenceGraph::createGraph(method, &livenessAnalysis);
 
     graph.reserveNodeSize(localUses.size());
     insertR5Node(graph);
@@ -501,8 +722,8 @@ void GraphColoring::createGraph()
     for(const auto& pair : localUses)
     {
         auto& node = graph.getOrCreateNode(pair.first);
-        node.possibleFiles = pair.second.possibleFiles;
-        node.initialFile = pair.second.possibleFiles;
+        // reset all registers blocked by the previous coloring of kept nodes
+        static_cast<ColoredNodeBase&>(node) = ColoredNodeBase(pair.second.possibleFiles);
         {
             auto writer = pair.first->getSingleWriter();
             auto load = dynamic_cast<const intermediate::LoadImmediate*>(writer);
@@ -583,20 +804,36 @@ void GraphColoring::createGraph()
 
     // 2. iteration: associate locals used together
     PROFILE_START(InterferenceToColoredGraph);
-    for(const auto& interferenceNode : interferenceGraph->getNodes())
-    {
-        ColoredNode& node = graph.assertNode(interferenceNode.first);
-        if(node.getEdgesSize() == 0)
-            // To not force rehashing, only reserve for nodes without edges
-            node.reserveEdgesSize(interferenceNode.second.getEdgesSize());
-        interferenceNode.second.forAllEdges(
+    // Every interference edge between two visited nodes is visited from both of them, so we only add it from the node
+    // with the lower index.
+    auto addInterferenceEdges = [&](const analysis::InterferenceNode& interferenceNode,
+                                    const std::function<bool(const Local*)>& isNeighborVisited) {
+        ColoredNode& node = graph.assertNode(interferenceNode.key);
+        interferenceNode.forAllEdges(
             [&](const analysis::InterferenceNode& neighbor, const analysis::Interference& edge) -> bool {
-                // TODO can we here somehow only run for one half of the edges? since now we want to add every edge
-                // twice (for each adjacent node)
-                node.getOrCreateEdge(&graph.assertNode(neighbor.key)).data = edge.data;
+                auto& neighborNode = graph.assertNode(neighbor.key);
+                if(node.getIndex() < neighborNode.getIndex() || !isNeighborVisited(neighbor.key))
+                    graph.appendEdge(node, neighborNode, edge.data);
                 return true;
             });
+    };
+    if(updateGraph)
+    {
+        // the edges between unchanged locals are still present in the colored graph
+        for(auto loc : changedLocals)
+        {
+            if(auto interferenceNode = interferenceGraph->findNode(loc))
+                addInterferenceEdges(*interferenceNode,
+                    [&](const Local* neighbor) -> bool { return changedLocals.find(neighbor) != changedLocals.end(); });
+        }
+    }
+    else
+    {
+        for(const auto& interferenceNode : interferenceGraph->getNodes())
+            addInterferenceEdges(interferenceNode.second, [](const Local* neighbor) -> bool { return true; });
     }
+    changedLocals.clear();
+    graph.sortEdges();
     PROFILE_END(InterferenceToColoredGraph);
 
     // 3. iteration: pre-color neighbors with fixed/blocked register-files
@@ -604,16 +841,14 @@ void GraphColoring::createGraph()
     // assigned anymore to anything, since their only valid register-file is now blocked.
     PROFILE_START(ForwardBlockedRegisterFiles);
     FastSet<ColoredNode*> openNodes;
-    for(auto& node : graph.getNodes())
-    {
-        if(node.second.possibleFiles == RegisterFile::PHYSICAL_A ||
-            node.second.possibleFiles == RegisterFile::PHYSICAL_B)
+    graph.forAllNodes([&](ColoredNode& node) {
+        if(node.possibleFiles == RegisterFile::PHYSICAL_A || node.possibleFiles == RegisterFile::PHYSICAL_B)
         {
             // this node is fixed to register-file A(B), all others used together cannot be on file A(B)
-            auto blockedFile = node.second.possibleFiles;
+            auto blockedFile = node.possibleFiles;
             auto otherFile =
                 blockedFile == RegisterFile::PHYSICAL_A ? RegisterFile::PHYSICAL_B : RegisterFile::PHYSICAL_A;
-            node.second.forAllEdges([&](ColoredNode& neighbor, ColoredEdge& edge) -> bool {
+            node.forAllEdges([&](ColoredNode& neighbor, ColoredEdge& edge) -> bool {
                 if(edge.data == analysis::InterferenceType::USED_TOGETHER)
                 {
                     bool fileRemoved = has_flag(neighbor.possibleFiles, blockedFile);
@@ -625,7 +860,7 @@ void GraphColoring::createGraph()
                 return true;
             });
         }
-    }
+    });
     // block all locals which interfere with r5 usage from using r5
     graph.assertNode(analysis::FAKE_REPLICATE_REGISTER)
         .forAllEdges([](ColoredNode& neighbor, ColoredEdge& edge) -> bool {
@@ -653,18 +888,22 @@ void GraphColoring::createGraph()
     PROFILE_END(ForwardBlockedRegisterFiles);
 
     CPPLOG_LAZY(logging::Level::DEBUG,
-        log << "Colored graph with " << graph.getNodes().size() << " nodes created!" << logging::endl);
+        log << "Colored graph with " << graph.size() << " nodes created!" << logging::endl);
 #ifndef NDEBUG
     LCOV_EXCL_START
     logging::logLazy(logging::Level::DEBUG, [&]() {
-        DebugGraph<const Local*, LocalRelation, ColoredEdge::Directed> debugGraph(
-            "/tmp/vc4c-register-graph.dot", graph.getNodes().size());
-        auto nameFunc = [](const Local* const& l) -> std::string { return l->name; };
-        auto weakEdgeFunc = [](const LocalRelation& r) -> bool { return r != LocalRelation::USED_TOGETHER; };
-        for(const auto& node : graph.getNodes())
-        {
-            debugGraph.addNodeWithNeighbors<ColoredNode>(node.second, nameFunc, weakEdgeFunc);
-        }
+        DebugGraph<const Local*, LocalRelation, Directionality::UNDIRECTED> debugGraph(
+            "/tmp/vc4c-register-graph.dot", graph.size());
+        graph.forAllNodes([&](const ColoredNode& node) {
+            debugGraph.addNode(node.key, node.key->name);
+            node.forAllEdges([&](const ColoredNode& neighbor, const ColoredEdge& edge) -> bool {
+                // only print every edge once
+                if(node.key < neighbor.key)
+                    debugGraph.addEdge(
+                        node.key, neighbor.key, edge.data != LocalRelation::USED_TOGETHER, "", Direction::NONE);
+                return true;
+            });
+        });
     });
     LCOV_EXCL_STOP
 #endif
@@ -707,11 +946,14 @@ static void processClosedSet(ColoredGraph& graph, FastSet<const Local*>& closedS
                 }
                 else
                     neighbor.blockRegister(node->possibleFiles, fixedRegister);
-                auto it = openSet.find(neighbor.key);
-                if(isFixed(neighbor.possibleFiles) && it != openSet.end())
+                if(isFixed(neighbor.possibleFiles))
                 {
-                    openSet.erase(it);
-                    closedSet.insert(neighbor.key);
+                    auto it = openSet.find(neighbor.key);
+                    if(it != openSet.end())
+                    {
+                        openSet.erase(it);
+                        closedSet.insert(neighbor.key);
+                    }
                 }
 
                 return true;
@@ -730,7 +972,7 @@ static void processClosedSet(ColoredGraph& graph, FastSet<const Local*>& closedS
 
 bool GraphColoring::colorGraph()
 {
-    if(!graph.getNodes().empty())
+    if(!graph.empty())
     {
         PROFILE(resetGraph);
     }
@@ -846,8 +1088,17 @@ static NODISCARD bool reassignNodeToRegister(ColoredGraph& graph, ColoredNode& n
     return fixed;
 }
 
+static void markLocalsChanged(InstructionWalker it, FastSet<const Local*>& changedLocals)
+{
+    it->forUsedLocals([&](const Local* loc, LocalUse::Type type, const intermediate::IntermediateInstruction& inst) {
+        if(!loc->type.isLabelType())
+            changedLocals.emplace(loc);
+    });
+}
+
 static NODISCARD bool moveLocalToRegisterFile(Method& method, ColoredGraph& graph, ColoredNode& node,
-    FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse, const RegisterFile file)
+    FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse, const RegisterFile file,
+    FastSet<const Local*>& changedLocals)
 {
     bool needNextRound = false;
     const auto& users = node.key->getUsers();
@@ -883,6 +1134,7 @@ static NODISCARD bool moveLocalToRegisterFile(Method& method, ColoredGraph& grap
         auto& tmpUse = localUses.emplace(tmp.local(), LocalUsage(it, it)).first->second;
         it.nextInBlock();
         it->replaceLocal(node.key, tmp.local(), LocalUse::Type::READER);
+        changedLocals.emplace(node.key);
         // 4) add temporary to graph (and local usage) with same blocked registers as local, but accumulator as file
         // (since it is read in the next instruction)
         tmpUse.possibleFiles = RegisterFile::ACCUMULATOR;
@@ -898,16 +1150,11 @@ static NODISCARD bool moveLocalToRegisterFile(Method& method, ColoredGraph& grap
         localUse.associatedInstructions.erase(it);
         localUse.associatedInstructions.insert(tmpUse.firstOccurrence);
         // TODO or always force a re-creation of the graph ?? Could remove all setting/updating of graph-nodes
-        auto& tmpNode = graph.getOrCreateNode(tmp.local(), ColoredNode(graph, tmp.local(), RegisterFile::ACCUMULATOR));
+        auto& tmpNode = graph.getOrCreateNode(tmp.local(), RegisterFile::ACCUMULATOR);
         // XXX setting the neighbors of the temporary to the neighbors of the local actually is far too broad, but we
         // cannot determine the actual neighbors
-        tmpNode.takeValues(node);
         // TODO need to update the local used in the current instruction as input with the new temporary
-        tmpNode.reserveEdgesSize(node.getEdgesSize());
-        node.forAllEdges([&](ColoredNode& neighbor, ColoredEdge&) -> bool {
-            neighbor.getOrCreateEdge(&tmpNode, LocalRelation::USED_SIMULTANEOUSLY);
-            return true;
-        });
+        tmpNode.takeValues(node);
         if(!reassignNodeToRegister(graph, graph.assertNode(tmp.local())))
             needNextRound = true;
     }
@@ -925,7 +1172,7 @@ static bool blocksLocal(const ColoredNode* neighbor, LocalRelation relation)
 }
 
 static NODISCARD bool fixSingleError(Method& method, ColoredGraph& graph, ColoredNode& node,
-    FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse)
+    FastMap<const Local*, LocalUsage>& localUses, LocalUsage& localUse, FastSet<const Local*>& changedLocals)
 {
     /*
      * The following cases can occur:
@@ -993,6 +1240,7 @@ static NODISCARD bool fixSingleError(Method& method, ColoredGraph& graph, Colore
                     // If a combined instruction writes the same local in both options, the local needs to be on an
                     // accumulator, independent whether the next instruction reads it. To fix this, new need to split up
                     // the combined instructions into two separate ones.
+                    markLocalsChanged(it, changedLocals);
                     auto parts = comb->splitUp();
                     auto firstIt = it.copy();
                     firstIt.emplace(std::move(parts.first));
@@ -1091,7 +1339,7 @@ static NODISCARD bool fixSingleError(Method& method, ColoredGraph& graph, Colore
             // the "easier" solution is to copy the local into an accumulator before each use, where it conflicts with
             // other inputs
             return moveLocalToRegisterFile(method, graph, node, localUses, localUse,
-                fileACouldBeUsed ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B);
+                fileACouldBeUsed ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B, changedLocals);
         }
         else
         {
@@ -1118,6 +1366,7 @@ static NODISCARD bool fixSingleError(Method& method, ColoredGraph& graph, Colore
                         continue;
                     auto& otherLocalUse = localUses.at(otherOutputLocal);
 
+                    markLocalsChanged(it, changedLocals);
                     auto parts = comb->splitUp();
                     auto firstIt = it.copy();
                     localUse.associatedInstructions.erase(it);
@@ -1146,7 +1395,7 @@ static NODISCARD bool fixSingleError(Method& method, ColoredGraph& graph, Colore
 
             if(splitUpSomeCombinedInstructions)
                 return moveLocalToRegisterFile(method, graph, node, localUses, localUse,
-                    fileACouldBeUsed ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B);
+                    fileACouldBeUsed ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B, changedLocals);
 
             // if only one file is blocked, create a copy, write it (after the local is written to) and use it as inputs
             // for all uses of the original local  if both files are blocked, create two copies, copy the local into
@@ -1203,7 +1452,7 @@ static NODISCARD bool fixSingleError(Method& method, ColoredGraph& graph, Colore
         }
 
         return moveLocalToRegisterFile(method, graph, node, localUses, localUse,
-            moveToFileA ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B);
+            moveToFileA ? RegisterFile::PHYSICAL_A : RegisterFile::PHYSICAL_B, changedLocals);
     }
     else
         throw CompilationError(
@@ -1216,8 +1465,8 @@ bool GraphColoring::fixErrors()
 {
     PROFILE_SCOPE(fixRegisterErrors);
     logging::logLazy(logging::Level::DEBUG, [&]() {
-        for(const auto& node : graph.getNodes())
-            logging::debug() << node.second.to_string() << logging::endl;
+        graph.forAllNodes(
+            [](const ColoredNode& node) { logging::debug() << node.to_string() << logging::endl; });
     });
 
     auto locIt = errorSet.begin();
@@ -1236,7 +1485,7 @@ bool GraphColoring::fixErrors()
             s << logging::endl;
         });
         LCOV_EXCL_STOP
-        if(fixSingleError(method, graph, node, localUses, localUses.at(*locIt)))
+        if(fixSingleError(method, graph, node, localUses, localUses.at(*locIt), changedLocals))
             locIt = errorSet.erase(locIt);
         else
             ++locIt;
@@ -1255,15 +1504,14 @@ FastMap<const Local*, Register> GraphColoring::toRegisterMap() const
     }
 
     FastMap<const Local*, Register> result;
-    result.reserve(graph.getNodes().size());
+    result.reserve(graph.size());
 
-    for(const auto& pair : graph.getNodes())
-    {
-        auto it = result.emplace(pair.first, pair.second.getRegisterFixed()).first;
+    graph.forAllNodes([&](const ColoredNode& node) {
+        auto it = result.emplace(node.key, node.getRegisterFixed()).first;
         CPPLOG_LAZY(logging::Level::DEBUG,
-            log << "Assigned local " << pair.first->name << " to register " << it->second.to_string(true, false)
+            log << "Assigned local " << node.key->name << " to register " << it->second.to_string(true, false)
                 << logging::endl);
-    }
+    });
 
     return result;
 }
@@ -1289,7 +1537,7 @@ void GraphColoring::resetGraph()
     openSet.clear();
     closedSet.clear();
     errorSet.clear();
-    graph.clear();
+    // the colored graph itself is updated (or recreated) by #createGraph()
     for(const auto& pair : localUses)
     {
         if(isFixed(pair.second.possibleFiles))
@@ -7,13 +7,14 @@
 #ifndef GRAPH_COLORING_H
 #define GRAPH_COLORING_H
 
-#include "../Graph.h"
 #include "../InstructionWalker.h"
 #include "../analysis/InterferenceGraph.h"
 #include "../analysis/LivenessAnalysis.h"
 #include "../performance.h"
 
 #include <bitset>
+#include <deque>
+#include <vector>
 
 namespace vc4c
 {
@@ -92,10 +93,209 @@ namespace vc4c
             std::bitset<6> availableAcc = 0x02FUL;
         };
 
-        using ColoredNode = Node<const Local*, LocalRelation, Directionality::UNDIRECTED, ColoredNodeBase>;
-        using ColoredEdge = typename ColoredNode::EdgeType;
+        struct ColoredEdge
+        {
+            // the index of the neighboring node with the higher index within the colored graph
+            uint32_t neighbor;
+            LocalRelation data;
+        };
+
+        class ColoredGraph;
+
+        /*
+         * A node in the colored graph, which stores its edges in sorted adjacency arrays.
+         *
+         * Every edge (including its relation) is stored only once, in the node with the lower index. The node with the
+         * higher index only stores the index of the owning node.
+         */
+        class ColoredNode : public ColoredNodeBase
+        {
+        public:
+            ColoredNode(ColoredGraph& graph, uint32_t index, const Local* key, RegisterFile possibleFiles);
+
+            /*
+             * Calls the consumer for all neighbors and the edges to them until the consumer returns false
+             */
+            template <typename Func>
+            void forAllEdges(Func&& consumer);
+            template <typename Func>
+            void forAllEdges(Func&& consumer) const;
+
+            inline std::size_t getEdgesSize() const noexcept
+            {
+                return ownedEdges.size() + lowerNeighbors.size();
+            }
+
+            bool isAdjacent(const ColoredNode* other) const;
+
+            /*
+             * Returns the edge to the given node or creates a new edge with the given relation
+             */
+            ColoredEdge& getOrCreateEdge(
+                ColoredNode* other, LocalRelation relation = LocalRelation::USED_SIMULTANEOUSLY);
+            const ColoredEdge& assertEdge(const ColoredNode* other) const;
+
+            /*
+             * Copies the status and the edges of the other node into this node
+             */
+            void takeValues(const ColoredNode& other);
+
+            inline uint32_t getIndex() const noexcept
+            {
+                return index;
+            }
+
+            // the local this node represents, NULL for erased nodes
+            const Local* key;
+
+        private:
+            ColoredGraph* graph;
+            uint32_t index;
+            // the edges to all neighbors with a higher index, sorted by the neighbor index
+            std::vector<ColoredEdge> ownedEdges;
+            // the indices of all neighbors with a lower index (which own the edge to this node), sorted
+            std::vector<uint32_t> lowerNeighbors;
+
+            ColoredEdge* findOwnedEdge(uint32_t neighbor);
+            const ColoredEdge* findOwnedEdge(uint32_t neighbor) const;
+            /*
+             * Returns the edge between this node and the node at the given index. Both nodes need to be adjacent!
+             */
+            ColoredEdge& getEdge(uint32_t neighbor);
+            const ColoredEdge& getEdge(uint32_t neighbor) const;
 
-        using ColoredGraph = Graph<const Local*, ColoredNode>;
+            friend class ColoredGraph;
+        };
+
+        /*
+         * The graph of all locals to be assigned to registers, connected by their interference.
+         *
+         * The locals are numbered densely and their nodes are stored in a contiguous container indexed by that number,
+         * so no hashing is required to access the neighbors of a node.
+         */
+        class ColoredGraph
+        {
+        public:
+            ColoredGraph() = default;
+            ColoredGraph(const ColoredGraph&) = delete;
+            ColoredGraph(ColoredGraph&&) noexcept = delete;
+            ~ColoredGraph() noexcept = default;
+
+            ColoredGraph& operator=(const ColoredGraph&) = delete;
+            ColoredGraph& operator=(ColoredGraph&&) noexcept = delete;
+
+            ColoredNode& getOrCreateNode(const Local* key, RegisterFile possibleFiles = RegisterFile::ANY);
+            ColoredNode& assertNode(const Local* key);
+            const ColoredNode& assertNode(const Local* key) const;
+            ColoredNode* findNode(const Local* key);
+            const ColoredNode* findNode(const Local* key) const;
+
+            /*
+             * Removes the node for the given local and all edges to it.
+             *
+             * The index of the erased node is reused for the next node created.
+             */
+            void eraseNode(const Local* key);
+
+            /*
+             * Adds an edge between the two nodes without checking for an existing edge.
+             *
+             * NOTE: This does not keep the adjacency arrays sorted, so #sortEdges() needs to be called after adding
+             * all edges and before accessing any edges!
+             */
+            void appendEdge(ColoredNode& first, ColoredNode& second, LocalRelation relation);
+
+            /*
+             * Sorts the adjacency arrays of all nodes after edges were added via #appendEdge()
+             */
+            void sortEdges();
+
+            inline ColoredNode& getNode(uint32_t index)
+            {
+                return nodes[index];
+            }
+
+            inline const ColoredNode& getNode(uint32_t index) const
+            {
+                return nodes[index];
+            }
+
+            inline std::size_t size() const noexcept
+            {
+                return indices.size();
+            }
+
+            inline bool empty() const noexcept
+            {
+                return indices.empty();
+            }
+
+            void reserveNodeSize(std::size_t size);
+            void clear();
+
+            /*
+             * Calls the consumer for all (not erased) nodes
+             */
+            template <typename Func>
+            void forAllNodes(Func&& consumer)
+            {
+                for(auto& node : nodes)
+                {
+                    if(node.key)
+                        consumer(node);
+                }
+            }
+
+            template <typename Func>
+            void forAllNodes(Func&& consumer) const
+            {
+                for(const auto& node : nodes)
+                {
+                    if(node.key)
+                        consumer(node);
+                }
+            }
+
+        private:
+            // a deque does not move the existing nodes when adding new ones, so references to nodes stay valid
+            std::deque<ColoredNode> nodes;
+            FastMap<const Local*, uint32_t> indices;
+            // the indices of erased nodes
+            std::vector<uint32_t> freeIndices;
+        };
+
+        template <typename Func>
+        void ColoredNode::forAllEdges(Func&& consumer)
+        {
+            for(auto neighbor : lowerNeighbors)
+            {
+                auto& neighborNode = graph->getNode(neighbor);
+                if(!consumer(neighborNode, neighborNode.getEdge(index)))
+                    return;
+            }
+            for(auto& edge : ownedEdges)
+            {
+                if(!consumer(graph->getNode(edge.neighbor), edge))
+                    return;
+            }
+        }
+
+        template <typename Func>
+        void ColoredNode::forAllEdges(Func&& consumer) const
+        {
+            const auto* constGraph = static_cast<const ColoredGraph*>(graph);
+            for(auto neighbor : lowerNeighbors)
+            {
+                const auto& neighborNode = constGraph->getNode(neighbor);
+                if(!consumer(neighborNode, neighborNode.getEdge(index)))
+                    return;
+            }
+            for(const auto& edge : ownedEdges)
+            {
+                if(!consumer(constGraph->getNode(edge.neighbor), edge))
+                    return;
+            }
+        }
 
         /*
          * Graph coloring
@@ -144,6 +344,22 @@ namespace vc4c
              */
             NODISCARD bool fixErrors();
 
+            /*!
+             * Marks the given local as changed, i.e. instructions accessing the local were inserted, removed or moved
+             * or the local was replaced in some of its accesses.
+             *
+             * The next call to #colorGraph() only recreates the interference of changed locals and of locals which
+             * are newly created or no longer used, all other locals keep their neighbors from the previous coloring.
+             */
+            void markLocalChanged(const Local* local);
+
+            /*!
+             * Recalculates the usages of all locals after the instructions were modified.
+             *
+             * NOTE: All locals whose accesses were modified need to be marked as changed via #markLocalChanged().
+             */
+            void updateLocalUses();
+
             FastMap<const Local*, Register> toRegisterMap() const;
 
             /*!
@@ -165,7 +381,10 @@ namespace vc4c
 
             ColoredGraph graph;
             FastSet<const Local*> errorSet;
+            // the locals whose interference needs to be recreated by the next graph update
+            FastSet<const Local*> changedLocals;
 
+            void createLocalUses(InstructionWalker it);
             void createGraph();
             void resetGraph();
         };
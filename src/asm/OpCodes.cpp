@@ -342,10 +342,55 @@ Optional<Value> Unpack::operator()(const Value& val) const
     return NO_VALUE;
 }
 
+/*
+ * Unpacks all elements at once on the raw 32-bit lanes, returns false for the unpack modes not supported here
+ */
+static bool unpackWords(Unpack mode, SIMDVector::Words& words) noexcept
+{
+    switch(mode)
+    {
+    case UNPACK_16A_32:
+        for(auto& word : words)
+            word = static_cast<uint32_t>(static_cast<int32_t>(bit_cast<int16_t>(truncate<uint16_t>(word))));
+        return true;
+    case UNPACK_16B_32:
+        for(auto& word : words)
+            word = static_cast<uint32_t>(static_cast<int32_t>(bit_cast<int16_t>(truncate<uint16_t>(word >> 16))));
+        return true;
+    case UNPACK_R4_ALPHA_REPLICATE:
+        FALL_THROUGH
+    case UNPACK_8888_32:
+        for(auto& word : words)
+            word = (word >> 24u) * 0x01010101u;
+        return true;
+    case UNPACK_8A_32:
+        for(auto& word : words)
+            word = word & 0xFFu;
+        return true;
+    case UNPACK_8B_32:
+        for(auto& word : words)
+            word = word >> 8 & 0xFFu;
+        return true;
+    case UNPACK_8C_32:
+        for(auto& word : words)
+            word = word >> 16 & 0xFFu;
+        return true;
+    case UNPACK_8D_32:
+        for(auto& word : words)
+            word = word >> 24 & 0xFFu;
+        return true;
+    default:
+        return false;
+    }
+}
+
 SIMDVector Unpack::operator()(const SIMDVector& val, bool isFloatOperation) const
 {
     if(!hasEffect())
         return val;
+    SIMDVector::Words words{};
+    if(!isFloatOperation && val.toWords(words) && unpackWords(*this, words))
+        return SIMDVector::fromWords(words);
     return val.transform([&](Literal lit) -> Literal { return unpackLiteral(*this, lit, isFloatOperation); });
 }
 
@@ -1436,8 +1481,9 @@ PrecalculatedValue OpCode::operator()(Literal firstOperand, Literal secondOperan
 // in the OpCode::operator() taking Literal arguments.
 static Literal resolveUndefined(Literal operand, bool isFloat)
 {
-    static std::default_random_engine engine{};
-    static std::uniform_int_distribution<uint32_t> distribution{};
+    // thread-local, since this might be called from multiple threads at once
+    thread_local std::default_random_engine engine{};
+    thread_local std::uniform_int_distribution<uint32_t> distribution{};
     if(operand.isUndefined())
     {
         operand = Literal(distribution(engine));
@@ -1446,6 +1492,159 @@ static Literal resolveUndefined(Literal operand, bool isFloat)
     return operand;
 }
 
+/*
+ * Applies the given byte-wise operation on all 4 bytes of all elements
+ */
+template <typename Func>
+static void calcBytewise(
+    const SIMDVector::Words& first, const SIMDVector::Words& second, SIMDVector::Words& out, Func&& func) noexcept
+{
+    for(std::size_t i = 0; i < out.size(); ++i)
+    {
+        uint32_t result = 0;
+        for(uint32_t shift = 0; shift < 32; shift += 8)
+            result |= (func((first[i] >> shift) & 0xFFu, (second[i] >> shift) & 0xFFu) & 0xFFu) << shift;
+        out[i] = result;
+    }
+}
+
+/*
+ * Calculates the integer (and bit-wise) operations directly on the raw 32-bit lanes of all elements at once. These
+ * simple loops without any per-element type handling or type-erased calls can be vectorized by the compiler.
+ *
+ * Returns false if the operation is not supported, in which case the generic per-literal calculation is used.
+ */
+static bool calcWords(const OpCode& code, const SIMDVector::Words& first, const SIMDVector::Words& second,
+    SIMDVector::Words& out, SIMDVector::Words& carry, SIMDVector::Words& overflow) noexcept
+{
+    const std::size_t numElements = out.size();
+    carry.fill(0);
+    overflow.fill(0);
+    switch(code.opAdd)
+    {
+    case OP_ADD.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+        {
+            out[i] = first[i] + second[i];
+            carry[i] = out[i] < first[i];
+            // signed overflow iff both inputs have the same sign and the result has another sign
+            overflow[i] = ((first[i] ^ out[i]) & (second[i] ^ out[i])) >> 31u;
+        }
+        return true;
+    case OP_SUB.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+        {
+            auto a = static_cast<int32_t>(first[i]);
+            auto b = static_cast<int32_t>(second[i]);
+            auto extendedVal = static_cast<int64_t>(a) - static_cast<int64_t>(b);
+            out[i] = first[i] - second[i];
+            // same as the per-literal calculation
+            carry[i] = (a >= 0 && b < 0 && extendedVal != 0) || (a >= 0 && b > 0 && extendedVal < 0) ||
+                (a < 0 && b < 0 && extendedVal < 0);
+            overflow[i] = extendedVal > static_cast<int64_t>(std::numeric_limits<int32_t>::max()) ||
+                extendedVal < static_cast<int64_t>(std::numeric_limits<int32_t>::min());
+        }
+        return true;
+    case OP_SHR.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+        {
+            auto offset = second[i] & 0x1Fu;
+            out[i] = first[i] >> offset;
+            carry[i] = offset != 0 && ((first[i] >> ((offset - 1) & 0x1Fu)) & 1u);
+        }
+        return true;
+    case OP_ASR.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+        {
+            auto offset = second[i] & 0x1Fu;
+            // same as intrinsics::asr(), assuming the host uses an arithmetic shift for signed values
+            out[i] = static_cast<uint32_t>(static_cast<int32_t>(first[i]) >> offset);
+            carry[i] = offset != 0 && ((first[i] >> ((offset - 1) & 0x1Fu)) & 1u);
+        }
+        return true;
+    case OP_ROR.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+            out[i] = rotate_right(first[i], static_cast<int>(second[i]));
+        return true;
+    case OP_SHL.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+        {
+            auto offset = second[i] & 0x1Fu;
+            out[i] = first[i] << offset;
+            carry[i] = ((static_cast<uint64_t>(first[i]) << offset) >> 32u) & 1u;
+        }
+        return true;
+    case OP_MIN.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+        {
+            auto a = static_cast<int32_t>(first[i]);
+            auto b = static_cast<int32_t>(second[i]);
+            out[i] = static_cast<uint32_t>(std::min(a, b));
+            carry[i] = a > b;
+        }
+        return true;
+    case OP_MAX.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+        {
+            auto a = static_cast<int32_t>(first[i]);
+            auto b = static_cast<int32_t>(second[i]);
+            out[i] = static_cast<uint32_t>(std::max(a, b));
+            carry[i] = a > b;
+        }
+        return true;
+    case OP_AND.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+            out[i] = first[i] & second[i];
+        return true;
+    case OP_OR.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+            out[i] = first[i] | second[i];
+        return true;
+    case OP_XOR.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+            out[i] = first[i] ^ second[i];
+        return true;
+    case OP_NOT.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+            out[i] = ~first[i];
+        return true;
+    case OP_CLZ.opAdd:
+        for(std::size_t i = 0; i < numElements; ++i)
+            out[i] = clz(first[i]);
+        return true;
+    case OP_V8ADDS.opAdd:
+        calcBytewise(first, second, out,
+            [](uint32_t a, uint32_t b) -> uint32_t { return std::min(a + b, static_cast<uint32_t>(255)); });
+        return true;
+    case OP_V8SUBS.opAdd:
+        calcBytewise(first, second, out, [](uint32_t a, uint32_t b) -> uint32_t { return a > b ? a - b : 0u; });
+        return true;
+    }
+
+    switch(code.opMul)
+    {
+    case OP_MUL24.opMul:
+        for(std::size_t i = 0; i < numElements; ++i)
+        {
+            auto extendedVal =
+                static_cast<uint64_t>(first[i] & 0xFFFFFFu) * static_cast<uint64_t>(second[i] & 0xFFFFFFu);
+            out[i] = static_cast<uint32_t>(extendedVal);
+            carry[i] = extendedVal > static_cast<uint64_t>(0xFFFFFFFFul);
+        }
+        return true;
+    case OP_V8MULD.opMul:
+        calcBytewise(first, second, out, [](uint32_t a, uint32_t b) -> uint32_t { return (a * b + 127) / 255; });
+        return true;
+    case OP_V8MIN.opMul:
+        calcBytewise(first, second, out, [](uint32_t a, uint32_t b) -> uint32_t { return std::min(a, b); });
+        return true;
+    case OP_V8MAX.opMul:
+        calcBytewise(first, second, out, [](uint32_t a, uint32_t b) -> uint32_t { return std::max(a, b); });
+        return true;
+    }
+    return false;
+}
+
 PrecalculatedVector OpCode::operator()(const SIMDVector& firstOperand, const SIMDVector& secondOperand) const
 {
     if(numOperands >= 1 && firstOperand.isUndefined())
@@ -1454,6 +1653,28 @@ PrecalculatedVector OpCode::operator()(const SIMDVector& firstOperand, const SIM
     if(numOperands == 2 && secondOperand.isUndefined())
         // returns an undefined vector
         return std::make_pair(SIMDVector{}, VectorFlags{});
+
+    SIMDVector::Words firstWords{};
+    SIMDVector::Words secondWords{};
+    if(!acceptsFloat && firstOperand.toWords(firstWords) && (numOperands == 1 || secondOperand.toWords(secondWords)))
+    {
+        SIMDVector::Words out{};
+        SIMDVector::Words carry{};
+        SIMDVector::Words overflow{};
+        if(calcWords(*this, firstWords, secondWords, out, carry, overflow))
+        {
+            VectorFlags flags;
+            for(std::size_t i = 0; i < out.size(); ++i)
+            {
+                flags[i].zero = out[i] == 0 ? FlagStatus::SET : FlagStatus::CLEAR;
+                flags[i].negative = (out[i] >> 31u) != 0 ? FlagStatus::SET : FlagStatus::CLEAR;
+                flags[i].carry = carry[i] != 0 ? FlagStatus::SET : FlagStatus::CLEAR;
+                flags[i].overflow = overflow[i] != 0 ? FlagStatus::SET : FlagStatus::CLEAR;
+            }
+            return std::make_pair(SIMDVector::fromWords(out), flags);
+        }
+    }
+
     SIMDVector res;
     VectorFlags flags;
     for(unsigned char i = 0; i < res.size(); ++i)
@@ -21,7 +21,6 @@ using namespace vc4c;
 using namespace vc4c::qpu_asm;
 using namespace vc4c::operators;
 
-// TODO make steps: 1. only small fixes, 2. group locals, "spill" to vector, rematerialize, 3. spill into VPM
 const std::vector<RegisterFixupStep> qpu_asm::FIXUP_STEPS = {
     // For the first two steps, try to run our in-graph fix-ups
     {"Small rewrites",
@@ -221,12 +220,13 @@ FixupResult qpu_asm::groupParameters(Method& method, const Configuration& config
             }
         }
 
+        coloredGraph.markLocalChanged(*paramIt);
         // paramIt is incremented in the loop header
         ++groupIndex;
         somethingChanged = true;
     }
 
-    return somethingChanged ? FixupResult::FIXES_APPLIED_RECREATE_GRAPH : FixupResult::NOTHING_FIXED;
+    return somethingChanged ? FixupResult::FIXES_APPLIED_UPDATE_GRAPH : FixupResult::NOTHING_FIXED;
 }
 
 static std::pair<const Local*, uint8_t> reserveGroupSpace(
@@ -250,8 +250,37 @@ static std::pair<const Local*, uint8_t> reserveGroupSpace(
     return std::make_pair(group, 0);
 }
 
+/*
+ * Returns whether any instruction after the given one (in the same block) depends on flags set before it
+ */
+static bool areFlagsUsedAfter(InstructionWalker it)
+{
+    for(it.nextInBlock(); !it.isEndOfBlock(); it.nextInBlock())
+    {
+        if(!it.has())
+            continue;
+        std::array<const intermediate::IntermediateInstruction*, 2> parts{it.get(), nullptr};
+        if(auto combined = it.get<const intermediate::CombinedOperation>())
+            parts = {combined->getFirstOp(), combined->getSecondOp()};
+        auto branch = it.get<const intermediate::Branch>();
+        if(branch && !branch->isUnconditional())
+            return true;
+        for(auto part : parts)
+        {
+            if(part && part->hasConditionalExecution())
+                return true;
+        }
+        for(auto part : parts)
+        {
+            if(part && part->doesSetFlag())
+                return false;
+        }
+    }
+    return false;
+}
+
 FixupResult qpu_asm::groupScalarLocals(
-    Method& method, const Configuration& config, const GraphColoring& coloredGraph, bool runConservative)
+    Method& method, const Configuration& config, GraphColoring& coloredGraph, bool runConservative)
 {
     FastMap<const Local*, InstructionWalker> candidateLocals;
     FastMap<const Local*, FastSet<InstructionWalker>> localReaders;
@@ -314,10 +343,17 @@ FixupResult qpu_asm::groupScalarLocals(
                         // ... unless it sets flags, then move before that to not override the flags with out insertion
                         // flags
                         insertIt.previousInBlock();
-                    candidateLocals.emplace(pair.first, insertIt);
+                    // ... and before any instructions still depending on previously set flags
+                    while(insertIt != pair.second && !insertIt.isStartOfBlock() && areFlagsUsedAfter(insertIt))
+                        insertIt.previousInBlock();
+                    if(!areFlagsUsedAfter(insertIt))
+                        candidateLocals.emplace(pair.first, insertIt);
+                    continue;
                 }
             }
-            candidateLocals.emplace(pair);
+            if(!areFlagsUsedAfter(pair.second))
+                // the inserted spilling code sets flags, so we cannot insert it where the flags are still used
+                candidateLocals.emplace(pair);
         }
     }
 
@@ -354,6 +390,7 @@ FixupResult qpu_asm::groupScalarLocals(
         // allocate an element in our spill register
         auto pos = reserveGroupSpace(method, groups, entry.first);
         currentlyGroupedLocals.emplace(entry.first, pos);
+        coloredGraph.markLocalChanged(entry.first);
         CPPLOG_LAZY(logging::Level::DEBUG,
             log << "Grouping local '" << entry.first->to_string() << "' into " << pos.first->to_string() << " at index "
                 << static_cast<unsigned>(pos.second) << logging::endl);
@@ -401,7 +438,7 @@ FixupResult qpu_asm::groupScalarLocals(
             }
         }
     }
-    return FixupResult::FIXES_APPLIED_RECREATE_GRAPH;
+    return FixupResult::FIXES_APPLIED_UPDATE_GRAPH;
 }
 
 FixupResult qpu_asm::rematerializeConstants(Method& method, const Configuration& config, GraphColoring& coloredGraph)
@@ -440,6 +477,7 @@ FixupResult qpu_asm::rematerializeConstants(Method& method, const Configuration&
             CPPLOG_LAZY(logging::Level::DEBUG,
                 log << "Moving constant calculation close to its single user: " << constantIt->to_string()
                     << logging::endl);
+            coloredGraph.markLocalChanged(loc);
             auto decorations = it.emplace(constantIt.release()).decoration;
             constantIt.safeErase(decorations);
             if(!constantIt.isEndOfBlock() && constantIt.has() &&
@@ -475,7 +513,7 @@ FixupResult qpu_asm::rematerializeConstants(Method& method, const Configuration&
      * calculation, insert close to users (with different locals).
      */
 
-    return constants.empty() ? FixupResult::NOTHING_FIXED : FixupResult::FIXES_APPLIED_RECREATE_GRAPH;
+    return constants.empty() ? FixupResult::NOTHING_FIXED : FixupResult::FIXES_APPLIED_UPDATE_GRAPH;
 }
 
 /**
@@ -484,10 +522,16 @@ FixupResult qpu_asm::rematerializeConstants(Method& method, const Configuration&
  * Source: https://www.inf.ed.ac.uk/teaching/courses/copt/lecture-7.pdf
  *
  * => Prefer spilling locals with smaller rating (lower cost, greater possible gain)
+ *
+ * Rematerializing a constant only requires a single instruction before every read, while spilling into VPM requires
+ * setting up the VPM access (and locking the hardware mutex) for every read and write.
  */
-static float calculateRating(
-    const LocalUsage& localUsage, const analysis::LoopInclusionTree& inclusionTree, const ColoredNode& node)
+static float calculateRating(const LocalUsage& localUsage, const analysis::LoopInclusionTree& inclusionTree,
+    const ColoredNode& node, bool isRematerializable)
 {
+    // the approximate number of instructions inserted for a single spill or unspill access via VPM
+    static constexpr uint32_t VPM_ACCESS_COST = 8;
+
     uint32_t accumulatedCosts = 0;
     for(const auto& it : localUsage.associatedInstructions)
     {
@@ -497,12 +541,28 @@ static float calculateRating(
             if(loop.first->findInLoop(it))
                 depth = std::max(depth, loop.second.getLongestPathToRoot());
         }
-        accumulatedCosts += 1 + depth;
+        accumulatedCosts += (1 + depth) * (isRematerializable ? 1 : VPM_ACCESS_COST);
     }
     // TODO somehow also regard the distance (across blocks) between reads and writes
     return static_cast<float>(accumulatedCosts) / static_cast<float>(node.getEdgesSize());
 }
 
+/**
+ * Returns the constant value the given local is set to, if the local can be rematerialized by simply loading the
+ * constant again before its reads.
+ */
+static Optional<Value> getRematerializableConstant(const Local* loc)
+{
+    auto writer = loc->getSingleWriter();
+    if(!writer || !writer->isConstantInstruction() || writer->hasConditionalExecution() || writer->hasSideEffects())
+        return NO_VALUE;
+    auto constant = writer->precalculate().first;
+    // only rematerialize values which can be loaded with a single instruction
+    if(constant && (constant->isLiteralValue() || constant->checkImmediate()))
+        return constant;
+    return NO_VALUE;
+}
+
 static bool isInMutexLock(InstructionWalker it)
 {
     while(!it.isStartOfBlock())
@@ -624,7 +684,9 @@ FixupResult qpu_asm::spillLocals(Method& method, const Configuration& config, Gr
             // too small usage range, don't spill
             continue;
 
-        spillCandidates[calculateRating(entry.second, *loopInclusions, graphNode)].emplace(entry.first);
+        auto isRematerializable = getRematerializableConstant(entry.first).has_value();
+        spillCandidates[calculateRating(entry.second, *loopInclusions, graphNode, isRematerializable)].emplace(
+            entry.first);
     }
 
     bool spilledLocals = false;
@@ -632,6 +694,23 @@ FixupResult qpu_asm::spillLocals(Method& method, const Configuration& config, Gr
 
     FastMap<const intermediate::IntermediateInstruction*, InstructionWalker> instructionMapping(
         method.countInstructions());
+    auto updateInstructionMapping = [&]() {
+        if(!instructionMapping.empty())
+            return;
+        // create this mapping once to not need to iterate over all instructions again and again
+        for(auto it = method.walkAllInstructions(); !it.isEndOfMethod(); it.nextInMethod())
+        {
+            if(auto combinedOp = it.get<intermediate::CombinedOperation>())
+            {
+                if(auto op = combinedOp->getFirstOp())
+                    instructionMapping.emplace(op, it);
+                if(auto op = combinedOp->getSecondOp())
+                    instructionMapping.emplace(op, it);
+            }
+            else if(it.has())
+                instructionMapping.emplace(it.get(), it);
+        }
+    };
 
     FastMap<const periphery::VPMArea*, tools::SmallSortedPointerSet<const ColoredNode*>> spilledAreas;
 
@@ -639,6 +718,44 @@ FixupResult qpu_asm::spillLocals(Method& method, const Configuration& config, Gr
     {
         for(const auto* loc : entry.second)
         {
+            if(auto constant = getRematerializableConstant(loc))
+            {
+                // Instead of spilling constants, load them again before (groups of) their reads
+                CPPLOG_LAZY(logging::Level::DEBUG,
+                    log << "Rematerializing constant local '" << loc->name << "' with rating: " << entry.first
+                        << logging::endl);
+                updateInstructionMapping();
+                auto accessGroups = groupSpillAccesses(
+                    loc->getUsers(), instructionMapping, config.additionalOptions.accumulatorThreshold);
+                for(auto& group : accessGroups)
+                {
+                    auto it = group.mainAccess;
+                    if(group.mainAccessUse.writesLocal())
+                    {
+                        if(group.additionalReaders.empty() && it.get() == loc->getSingleWriter())
+                            // the original value is no longer read at all
+                            it.safeErase();
+                        continue;
+                    }
+                    auto tmp = assign(it, loc->type, std::string{loc->name}) = *constant;
+                    auto constantIt = it.copy().previousInBlock();
+                    normalization::handleImmediate(method.module, method, constantIt, config);
+                    it->replaceLocal(loc, tmp.local(), LocalUse::Type::READER);
+                    for(auto* reader : group.additionalReaders)
+                        reader->replaceLocal(loc, tmp.local(), LocalUse::Type::READER);
+                    if(intermediate::needsDelay(it.copy().previousInBlock().get(), it.get()))
+                        // e.g. if the user is a vector rotation
+                        nop(it, intermediate::DelayType::WAIT_REGISTER);
+                }
+                PROFILE_COUNTER_SCOPE(vc4c::profiler::COUNTER_BACKEND, "Constants rematerialized", 1);
+                coloredGraph.markLocalChanged(loc);
+                spilledLocals = spilledLocals || !accessGroups.empty();
+                continue;
+            }
+            if(noMoreSpace)
+                // we can still rematerialize constants
+                continue;
+
             const periphery::VPMArea* spillArea = nullptr;
             const auto& localNode = coloredGraph.getGraph().assertNode(loc);
             for(const auto& entry : spilledAreas)
@@ -663,31 +780,17 @@ FixupResult qpu_asm::spillLocals(Method& method, const Configuration& config, Gr
                 spillArea = method.vpm->addSpillArea(method.metaData.getMaximumInstancesCount());
             if(!spillArea)
             {
-                CPPLOG_LAZY(logging::Level::DEBUG, log << "No more space in VPM, aborting spilling!" << logging::endl);
+                CPPLOG_LAZY(logging::Level::DEBUG,
+                    log << "No more space in VPM, only rematerializing constants from now on!" << logging::endl);
                 noMoreSpace = true;
-                break;
+                continue;
             }
 
             spilledAreas[spillArea].emplace(&localNode);
             CPPLOG_LAZY(logging::Level::DEBUG,
                 log << "Spilling local '" << loc->name << "' with rating: " << entry.first << logging::endl);
 
-            if(instructionMapping.empty())
-            {
-                // create this mapping once to not need to iterate over all instructions again and again
-                for(auto it = method.walkAllInstructions(); !it.isEndOfMethod(); it.nextInMethod())
-                {
-                    if(auto combinedOp = it.get<intermediate::CombinedOperation>())
-                    {
-                        if(auto op = combinedOp->getFirstOp())
-                            instructionMapping.emplace(op, it);
-                        if(auto op = combinedOp->getSecondOp())
-                            instructionMapping.emplace(op, it);
-                    }
-                    else if(it.has())
-                        instructionMapping.emplace(it.get(), it);
-                }
-            }
+            updateInstructionMapping();
 
             // since we modify the users, need to create a copy first
             auto accessGroups =
@@ -739,13 +842,12 @@ FixupResult qpu_asm::spillLocals(Method& method, const Configuration& config, Gr
 
             PROFILE_COUNTER_SCOPE(
                 vc4c::profiler::COUNTER_BACKEND, "Locals spilled", method.metaData.getMaximumInstancesCount());
+            coloredGraph.markLocalChanged(loc);
             spilledLocals = true;
         }
-        if(noMoreSpace)
-            break;
     }
 
     CPPLOG_LAZY_BLOCK(logging::Level::DEBUG, method.vpm->dumpUsage());
     method.dumpInstructions();
-    return spilledLocals ? FixupResult::FIXES_APPLIED_RECREATE_GRAPH : FixupResult::NOTHING_FIXED;
+    return spilledLocals ? FixupResult::FIXES_APPLIED_UPDATE_GRAPH : FixupResult::NOTHING_FIXED;
 }
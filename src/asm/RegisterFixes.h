@@ -27,6 +27,9 @@ namespace vc4c
             ALL_FIXED,
             // Some fixes were applied and the colored graph needs to be regenerated before the next step is run
             FIXES_APPLIED_RECREATE_GRAPH,
+            // Some fixes were applied and all modified locals were marked as changed in the colored graph, so only
+            // the local usages need to be recalculated and the graph can be updated incrementally
+            FIXES_APPLIED_UPDATE_GRAPH,
             // Only fixes that do not modify the colored graph have been applied
             FIXES_APPLIED_KEEP_GRAPH,
             // No fixes were applied, colored graph was not changed, next step should be run
@@ -51,7 +54,7 @@ namespace vc4c
          * 1. color local graph and check for errors
          * 1.1 if there are no errors, end
          * 2. run the current fix-up step
-         * 3. if necessary, completely recreate the colored graph
+         * 3. if necessary, update or completely recreate the colored graph
          * 4. increment current fix-up step and go back to 1.
          */
         extern const std::vector<RegisterFixupStep> FIXUP_STEPS;
@@ -113,7 +116,7 @@ namespace vc4c
          * livenesses changed.
          */
         FixupResult groupScalarLocals(
-            Method& method, const Configuration& config, const GraphColoring& coloredGraph, bool runConservative);
+            Method& method, const Configuration& config, GraphColoring& coloredGraph, bool runConservative);
 
         /**
          * Reduces register pressure by moving constant calculations closer to their usages.
@@ -139,6 +142,10 @@ namespace vc4c
         /**
          * Reduces register pressure by spilling long-living and rarely used locals into VPM cache rows.
          *
+         * The locals to spill are selected by the costs of the inserted accesses (weighted by their loop depth) and
+         * the number of interfering locals. Every QPU uses its own VPM row within the spill areas. Locals set to a
+         * constant value are not spilled, but the constant is loaded again before (groups of) its reads.
+         *
          * NOTE: This fix-up could greatly reduce performance, since it introduces VPM accesses.
          *
          */
@@ -160,8 +160,10 @@ namespace vc4c
         /*
          * Converted to QPU instructions,
          * but still with method-calls and typed locals
+         *
+         * NOTE: Instructions are allocated from a memory pool, since they are created (and destroyed) very frequently.
          */
-        class IntermediateInstruction
+        class IntermediateInstruction : public tools::SlabAllocated
         {
         public:
             IntermediateInstruction(const IntermediateInstruction&) = delete;
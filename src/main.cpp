@@ -69,6 +69,15 @@ static void printHelp()
               << "\tThe maximum number of iterations to repeat the optimizations in" << std::endl;
     std::cout << "\t--fcommon-subexpression-threshold=" << defaultConfig.additionalOptions.maxCommonExpressionDinstance
               << "\tThe maximum distance for two common subexpressions to be combined" << std::endl;
+    std::cout << "\t--fparallel-block-threshold=" << defaultConfig.additionalOptions.parallelBlockThreshold
+              << "\tThe minimum number of basic blocks to optimize independent blocks in parallel (0 to disable)"
+              << std::endl;
+    std::cout << "\t--fworklist-threshold=" << defaultConfig.additionalOptions.worklistThreshold
+              << "\tThe minimum number of instructions to only revisit modified blocks in repeated optimizations (0 to "
+                 "disable)"
+              << std::endl;
+    std::cout << "\t--fmax-prefetched-loads=" << defaultConfig.additionalOptions.maxPrefetchedLoads
+              << "\tThe maximum number of memory loads in a loop to prefetch for the next iteration" << std::endl;
 
     std::cout << "options:" << std::endl;
     std::cout << "\t--kernel-info\t\tWrite the kernel-info meta-data (as required by VC4CL run-time, default)"
@@ -78,6 +87,12 @@ static void printHelp()
     std::cout << "\t--llvm\t\t\tExplicitely use the LLVM-IR front-end" << std::endl;
     std::cout << "\t--verification-error\tAbort if instruction verification failed" << std::endl;
     std::cout << "\t--no-verification-error\tContinue if instruction verification failed" << std::endl;
+    std::cout << "\t--cache-dir=<dir>\tCache compilation results in the given directory and reuse them for identical "
+                 "inputs"
+              << std::endl;
+    std::cout << "\t--trace=<file>\t\tWrite a trace of the time spent in the single compilation steps in the Chrome "
+                 "trace-event format"
+              << std::endl;
     std::cout << "\tany other option is passed to the pre-compiler" << std::endl;
 
     std::cout << "modes:" << std::endl;
@@ -270,6 +270,15 @@ static void runNormalizationStep(
 }
 
 void Normalizer::normalize(Module& module, const std::set<std::string>& selectedSteps) const
+{
+    prepareKernels(module);
+    // run other normalization steps on kernel functions
+    auto kernels = module.getKernels();
+    const auto f = [&, this](Method* kernelFunc) -> void { normalizeMethod(module, *kernelFunc, selectedSteps); };
+    ThreadPool::scheduleAll<Method*>("Normalization", kernels, f, THREAD_LOGGER.get());
+}
+
+void Normalizer::prepareKernels(Module& module) const
 {
     // 1. eliminate phi on all methods
     for(auto& method : module)
@@ -281,27 +290,28 @@ void Normalizer::normalize(Module& module, const std::set<std::string>& selected
             logging::debug() << logging::endl;
             logging::debug() << "Running pass: EliminatePhiNodes" << logging::endl;
         });
+        PROFILE_TRACE_SCOPE("normalization", "EliminatePhiNodes", method->name);
+        tools::SlabPool::Scope poolScope(method->getPool());
         PROFILE_COUNTER(
             vc4c::profiler::COUNTER_NORMALIZATION, "Eliminate Phi-nodes (before)", method->countInstructions());
         eliminatePhiNodes(module, *method, config);
         PROFILE_COUNTER_WITH_PREV(
             vc4c::profiler::COUNTER_NORMALIZATION, "Eliminate Phi-nodes (after)", method->countInstructions());
     }
-    auto kernels = module.getKernels();
     // 2. inline kernel-functions
-    for(Method* kernelFunc : kernels)
+    for(Method* kernelFunc : module.getKernels())
     {
         Method& kernel = *kernelFunc;
 
+        PROFILE_TRACE_SCOPE("normalization", "Inline", kernel.name);
+        // the inlined instructions are copied into the kernel, so they are allocated from the pool of the kernel
+        tools::SlabPool::Scope poolScope(kernel.getPool());
         PROFILE_COUNTER(vc4c::profiler::COUNTER_NORMALIZATION, "Inline (before)", kernel.countInstructions());
         PROFILE_START(Inline);
         inlineMethods(module, kernel, config);
         PROFILE_END(Inline);
         PROFILE_COUNTER_WITH_PREV(vc4c::profiler::COUNTER_NORMALIZATION, "Inline (after)", kernel.countInstructions());
     }
-    // 3. run other normalization steps on kernel functions
-    const auto f = [&, this](Method* kernelFunc) -> void { normalizeMethod(module, *kernelFunc, selectedSteps); };
-    ThreadPool::scheduleAll<Method*>("Normalization", kernels, f, THREAD_LOGGER.get());
 }
 
 void Normalizer::adjust(Module& module, const std::set<std::string>& selectedSteps) const
@@ -316,6 +326,8 @@ void Normalizer::normalizeMethod(Module& module, Method& method, const std::set<
 {
     CPPLOG_LAZY(logging::Level::DEBUG, log << "-----" << logging::endl);
     CPPLOG_LAZY(logging::Level::INFO, log << "Running normalization passes for: " << method.name << logging::endl);
+    // allocate all new instructions from the memory pool of the method
+    tools::SlabPool::Scope poolScope(method.getPool());
     std::size_t numInstructions = method.countInstructions();
 
     PROFILE_START(NormalizationPasses);
@@ -326,6 +338,7 @@ void Normalizer::normalizeMethod(Module& module, Method& method, const std::set<
             continue;
         logging::debug() << logging::endl;
         logging::debug() << "Running pass: " << step.first << logging::endl;
+        PROFILE_TRACE_SCOPE("normalization", step.first, method.name);
         PROFILE_START_DYNAMIC(step.first);
         runNormalizationStep(step.second, module, method, config);
         PROFILE_END_DYNAMIC(step.first);
@@ -339,6 +352,7 @@ void Normalizer::normalizeMethod(Module& module, Method& method, const std::set<
             logging::debug() << logging::endl;
             logging::debug() << "Running pass: MapMemoryAccess" << logging::endl;
         });
+        PROFILE_TRACE_SCOPE("normalization", "MapMemoryAccess", method.name);
         PROFILE_SCOPE(MapMemoryAccess);
         mapMemoryAccess(module, method, config);
     }
@@ -354,6 +368,7 @@ void Normalizer::normalizeMethod(Module& module, Method& method, const std::set<
             logging::debug() << logging::endl;
             logging::debug() << "Running pass: " << step.first << logging::endl;
         });
+        PROFILE_TRACE_SCOPE("normalization", step.first, method.name);
         PROFILE_START_DYNAMIC(step.first);
         runNormalizationStep(step.second, module, method, config);
         PROFILE_END_DYNAMIC(step.first);
@@ -366,6 +381,7 @@ void Normalizer::normalizeMethod(Module& module, Method& method, const std::set<
             logging::debug() << logging::endl;
             logging::debug() << "Running pass: AddStartStopSegment" << logging::endl;
         });
+        PROFILE_TRACE_SCOPE("normalization", "AddStartStopSegment", method.name);
         PROFILE_SCOPE(AddStartStopSegment);
         optimizations::addStartStopSegment(module, method, config);
     }
@@ -393,6 +409,7 @@ void Normalizer::adjustMethod(Module& module, Method& method, const std::set<std
 {
     CPPLOG_LAZY(logging::Level::DEBUG, log << "-----" << logging::endl);
     CPPLOG_LAZY(logging::Level::INFO, log << "Running adjustment passes for: " << method.name << logging::endl);
+    tools::SlabPool::Scope poolScope(method.getPool());
     std::size_t numInstructions = method.countInstructions();
 
     PROFILE_START(AdjustmentPasses);
@@ -406,6 +423,7 @@ void Normalizer::adjustMethod(Module& module, Method& method, const std::set<std
             logging::debug() << logging::endl;
             logging::debug() << "Running pass: " << step.first << logging::endl;
         });
+        PROFILE_TRACE_SCOPE("normalization", step.first, method.name);
         PROFILE_START_DYNAMIC(step.first);
         runNormalizationStep(step.second, module, method, config);
         PROFILE_END_DYNAMIC(step.first);
@@ -420,6 +438,7 @@ void Normalizer::adjustMethod(Module& module, Method& method, const std::set<std
 
     if(selectedSteps.empty() || selectedSteps.find("ExtendBranches") != selectedSteps.end())
     {
+        PROFILE_TRACE_SCOPE("normalization", "ExtendBranches", method.name);
         PROFILE_SCOPE(ExtendBranches);
         extendBranches(module, method, config);
     }
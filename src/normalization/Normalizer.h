@@ -58,17 +58,33 @@ namespace vc4c
              */
             void adjust(Module& module, const std::set<std::string>& selectedSteps = {}) const;
 
-        private:
-            Configuration config;
+            /*
+             * Runs the module-wide part of the normalization, e.g. eliminating phi-nodes and inlining all functions
+             * into the kernels.
+             *
+             * NOTE: This needs to be run before #normalizeMethod is called for any kernel
+             */
+            void prepareKernels(Module& module) const;
 
             /*
              * Runs all registered normalization steps on the given method.
              *
              * After this function has returned, it is guaranteed, that all remaining instructions within the method are
              * normalized (e.g. return true for #isNormalized()).
+             *
+             * This can be run in parallel for different kernels of the same module.
              */
-            void normalizeMethod(Module& module, Method& method, const std::set<std::string>& selectedSteps) const;
-            void adjustMethod(Module& module, Method& method, const std::set<std::string>& selectedSteps) const;
+            void normalizeMethod(Module& module, Method& method, const std::set<std::string>& selectedSteps = {}) const;
+
+            /*
+             * Runs the adjustment steps on the given method, see #adjust
+             *
+             * This can be run in parallel for different kernels of the same module.
+             */
+            void adjustMethod(Module& module, Method& method, const std::set<std::string>& selectedSteps = {}) const;
+
+        private:
+            Configuration config;
         };
     } /* namespace normalization */
 } /* namespace vc4c */
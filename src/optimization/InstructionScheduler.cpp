@@ -11,325 +11,300 @@
 #include "../Profiler.h"
 #include "../analysis/DependencyGraph.h"
 #include "../intermediate/IntermediateInstruction.h"
+#include "../periphery/TMU.h"
 #include "log.h"
 
+#include <algorithm>
+#include <array>
+
 using namespace vc4c;
 using namespace vc4c::optimizations;
 
-struct NodeSorter : public std::less<intermediate::IntermediateInstruction*>
-{
-    static int ratePriority(intermediate::IntermediateInstruction* inst)
-    {
-        int priority = 0;
-        // prioritizing conditional instructions keeps setting flags and their uses together
-        if(inst->hasConditionalExecution())
-        {
-            priority += 100;
-        }
-        // prioritize setting of TMU_NO_SWAP to make the best of the delays required before loading
-        if(inst->writesRegister(REG_TMU_NOSWAP))
-            priority += 100;
-        // prioritize unlocking mutex to keep critical section as small as possible
-        if(inst->writesRegister(REG_MUTEX))
-            priority += 80;
-        // XXX give reading of work-item info (as well as parameters) a high priority (minimizes their local's
-        // life-time)
-        if(std::any_of(inst->getArguments().begin(), inst->getArguments().end(),
-               [](const Value& val) -> bool { return val.checkLocal() && val.local()->is<Parameter>(); }))
-            priority += 50;
-
-        // writing TMU address gets higher priority, to leave enough space for utilizing the delay to actually read the
-        // value
-        if(inst->writesRegister(REG_TMU0_ADDRESS) || inst->writesRegister(REG_TMU1_ADDRESS))
-            priority += 40;
-
-        // prioritize triggering read of TMU and reading from TMU to be directly scheduled after the delay is up to free
-        // queue space
-        if(inst->getSignal().triggersReadOfR4() || inst->readsRegister(REG_TMU_OUT))
-            priority += 30;
-
-        // Increasing semaphores gets higher priority, decreasing it lower to reduce stall time
-        auto semaphore = dynamic_cast<const intermediate::SemaphoreAdjustment*>(inst);
-        if(semaphore)
-        {
-            if(semaphore->increase)
-                priority += 20;
-            else
-                priority -= 20;
-        }
-
-        // Triggering of TMU reads gets lower priority to leave enough space between setting address and reading value
-        // to utilize delay
-        if(inst->getSignal().triggersReadOfR4())
-            priority -= 30;
-
-        // give vector rotations lower priority to make the usage-range of the accumulator used smaller
-        if(inst->getVectorRotation() & &intermediate::RotationInfo::isFullRotationAllowed)
-            priority -= 50;
-
-        // for conditional instructions setting flags themselves not preceding the other instructions depending on same
-        // flags
-        if(inst->doesSetFlag())
-            priority -= 60;
-
-        // loading/calculation of literals get smaller priority, since they are used mostly locally
-        if(std::all_of(inst->getArguments().begin(), inst->getArguments().end(), [](const Value& val) -> bool {
-               return val.getLiteralValue() || val.hasRegister(REG_ELEMENT_NUMBER) || val.hasRegister(REG_QPU_NUMBER);
-           }))
-            priority -= 80;
-
-        // given branches a lower priority moves them to the end of the block where they belong
-        if(dynamic_cast<const intermediate::Branch*>(inst))
-            priority -= 90;
-
-        // mutex_acquire gets the lowest priority to not extend the critical section
-        if(inst->readsRegister(REG_MUTEX))
-            priority -= 100;
-
-        return -priority;
-    }
-
-    bool operator()(intermediate::IntermediateInstruction* x, intermediate::IntermediateInstruction* y)
-    {
-        int prioX = 0;
-        auto it = priorities.find(x);
-        if(it != priorities.end())
-            prioX = it->second;
-        else
-            prioX = priorities[x] = ratePriority(x);
-        int prioY = 0;
-        it = priorities.find(y);
-        if(it != priorities.end())
-            prioY = it->second;
-        else
-            prioY = priorities[y] = ratePriority(y);
-        if(prioX == prioY)
-            return x < y;
-        return prioX < prioY;
-    }
+/*
+ * Machine model of the VideoCore IV QPU used for scheduling.
+ *
+ * Most of the latencies are modeled as (mandatory or preferred) delays of the dependencies between the instructions,
+ * see DependencyGraph:
+ * - the result of a SFU calculation can be read from r4 in the 3rd instruction after triggering it (mandatory)
+ * - a TMU load should be triggered 8 instructions (9 cycles) after writing the TMU address to not stall the QPU
+ * - waiting for a VPM DMA load/store should be done 6/10 instructions after setting the DMA address
+ * - reading r5 for vector rotations, values written with pack-modes and some registers require a distance of 1
+ *   instruction (mandatory)
+ * - branches depend on all other instructions of the block and are therefore scheduled last. Their 3 delay slots are
+ *   inserted afterwards by the normalization and thus not modeled here
+ *
+ * Additionally, the scheduler models the properties below, which cannot be represented by the dependency graph.
+ */
 
-    // caches priorities per instruction, so we do not have to re-calculate them
-    FastMap<intermediate::IntermediateInstruction*, int> priorities;
+// A value written to a physical register file can only be read in the next but one instruction, while accumulators
+// can be read in the next instruction. Since the locals are not yet mapped to registers, locals read by more than one
+// instruction are assumed to live long enough to be mapped to the register file.
+static constexpr unsigned REGISTER_FILE_READ_LATENCY = 1;
+// The number of cycles between writing a TMU address and triggering the load which are not modeled by the dependency
+// graph, since the load is triggered in a following block, e.g. for TMU loads prefetched for the next loop iteration.
+static constexpr unsigned TMU_PREFETCH_LATENCY = 8;
+// NOTE: The number of queued requests per TMU (including the ones queued in previous blocks) is limited to
+// periphery::TMU_QUEUE_SIZE, since queuing more requests stalls (or even hangs) the QPU.
+// The maximum distance (in instructions of the original order) an instruction can be moved up. This limits the
+// extension of the local's live ranges (and therefore the register pressure) as well as the number of candidates
+// checked for every scheduled instruction.
+static constexpr std::size_t SCHEDULING_WINDOW = 24;
 
-    explicit NodeSorter(std::size_t numEntries)
-    {
-        priorities.reserve(numEntries);
-    }
+struct ScheduleEntry
+{
+    std::unique_ptr<intermediate::IntermediateInstruction> instruction;
+    const analysis::DependencyNode* node = nullptr;
+    // the number of predecessors not yet scheduled
+    unsigned numOpenPredecessors = 0;
+    // the first cycle this instruction can be scheduled at without violating any mandatory delay
+    std::size_t mandatoryCycle = 0;
+    // the first cycle this instruction can be scheduled at without stalling for a preferred delay
+    std::size_t preferredCycle = 0;
+    // the length of the critical path (including mandatory and preferred delays) to the end of the block
+    std::size_t criticalPath = 0;
+    // positive for instructions freeing resources shared with other QPUs, negative for instructions locking them
+    int resourceRating = 0;
+    // whether the written value is assumed to be stored in the physical register file (see REGISTER_FILE_READ_LATENCY)
+    bool writesRegisterFile = false;
+    bool isScheduled = false;
 };
 
-// TODO OpenSet leaks all pending instructions if exception is thrown
-using OpenSet = SortedSet<intermediate::IntermediateInstruction*, NodeSorter>;
-using DelaysMap = FastMap<const intermediate::IntermediateInstruction*, std::size_t>;
-
-static constexpr int DEFAULT_PRIORITY = 1000;
-// needs to be larger then the default priority to disregard in any case
-static constexpr int MIN_PRIORITY = 2000;
-
-static int calculateSchedulingPriority(analysis::DependencyEdge& dependency, BasicBlock& block)
+static int rateResourceUsage(const intermediate::IntermediateInstruction& inst)
 {
-    PROFILE_SCOPE(calculateSchedulingPriority);
-    int latencyLeft = static_cast<int>(dependency.data.numDelayCycles);
-    auto it = --block.end();
-    while(it != block.begin() && latencyLeft > 0)
-    {
-        if(it->get() == dependency.getInput().key)
-            // we found the dependent instruction
-            break;
-        if(*it && (*it)->mapsToASMInstruction())
-            --latencyLeft;
-        --it;
-    }
-    if(latencyLeft <= 0 && !dependency.data.isMandatoryDelay)
-    {
-        auto instr = dependency.getOutput().key;
-        // also value instructions freeing resources (e.g. reading periphery/releasing mutex/last read of locals)
-        // and devalue instructions locking resources and using new registers, as well as instructions only depending on
-        // literals
-        if(instr->writesRegister(REG_MUTEX) || instr->writesRegister(REG_VPM_DMA_LOAD_ADDR) ||
-            instr->writesRegister(REG_VPM_DMA_STORE_ADDR))
-            latencyLeft -= 3;
-        if(instr->readsRegister(REG_TMU_OUT) || instr->readsRegister(REG_VPM_IO) ||
-            instr->writesRegister(REG_TMU0_ADDRESS) || instr->writesRegister(REG_TMU1_ADDRESS))
-            latencyLeft -= 4;
-        if(instr->readsRegister(REG_VPM_DMA_LOAD_WAIT) || instr->readsRegister(REG_VPM_DMA_STORE_WAIT) ||
-            instr->readsRegister(REG_MUTEX))
-            latencyLeft += 2;
-        if(std::any_of(instr->getArguments().begin(), instr->getArguments().end(), [&](const Value& arg) -> bool {
-               return arg.checkLocal() && arg.local()->countUsers(LocalUse::Type::READER) == 1;
-           }))
-            --latencyLeft;
-        if(instr->checkOutputLocal() && instr->getOutput()->getSingleWriter() == instr)
-            latencyLeft += 2;
-        if(std::all_of(instr->getArguments().begin(), instr->getArguments().end(), [&](const Value& arg) -> bool {
-               return arg.getLiteralValue() || arg.hasRegister(REG_QPU_NUMBER) || arg.hasRegister(REG_ELEMENT_NUMBER);
-           }))
-            ++latencyLeft;
-    }
-    // if variable latency, return remaining latency (to achieving best case)
-    // otherwise, return MIN_PRIORITY
-    return (latencyLeft > 0 && dependency.data.isMandatoryDelay) ? MIN_PRIORITY : latencyLeft;
-    // TODO also look into the future and keep some instructions (e.g. vector rotations/arithmetics) close to their
-    // use?? (would need to calculate priority of uses and deduct distance)
-    // or look into the future and calculate the maximum mandatory (+preferred) delay between this instruction and the
-    // end of block (e.g. maximum path for all dependent delays) -> prefer maximum mandatory delay > maximum preferred
-    // delay > any other. Or directly calculate remaining delay into priority mandatory/preferred. Delay "behind"
-    // instruction can be calculated once per instruction?!
+    // releasing the mutex as early as possible keeps the critical section small, while acquiring it as late as
+    // possible
+    if(inst.writesRegister(REG_MUTEX))
+        return 2;
+    if(inst.readsRegister(REG_MUTEX))
+        return -2;
+    // increasing semaphores earlier and decreasing them later reduces the stall time of other QPUs
+    if(auto semaphore = dynamic_cast<const intermediate::SemaphoreAdjustment*>(&inst))
+        return semaphore->increase ? 1 : -1;
+    // reading TMU results frees space in the TMU queue
+    if(inst.readsRegister(REG_TMU_OUT))
+        return 1;
+    return 0;
 }
 
-static int checkDependenciesMet(analysis::DependencyNode& entry, BasicBlock& block, OpenSet& openNodes)
+/*
+ * Returns the TMU the instruction queues a new request for (by writing its S coordinate/address) or the TMU the
+ * instruction consumes a request from (by triggering a load of its result into r4).
+ */
+static Optional<unsigned> getQueuedTMU(const intermediate::IntermediateInstruction& inst)
 {
-    if(!entry.hasIncomingDependencies())
-        return true;
-    int schedulingPriority = 0;
-    entry.forAllIncomingEdges([&](analysis::DependencyNode& neighbor, analysis::DependencyEdge& edge) -> bool {
-        if(openNodes.find(const_cast<intermediate::IntermediateInstruction*>(neighbor.key)) != openNodes.end())
-        {
-            // the dependent instruction was not yet scheduled, cannot schedule
-            schedulingPriority = MIN_PRIORITY;
-            return false;
-        }
-        // at this point, the dependent instruction is already scheduled
-        else if(edge.data.numDelayCycles == 0)
-        {
-            // simple dependency to maintain order, is already given -> check other dependencies
-            return true;
-        }
-        else
-        {
-            int priority = calculateSchedulingPriority(edge, block);
-            if(priority == 0)
-            {
-                // dependency is completely met -> check other dependencies
-                return true;
-            }
-            schedulingPriority += priority;
-        }
-        return true;
-    });
-    return schedulingPriority;
+    if(inst.writesRegister(REG_TMU0_ADDRESS))
+        return 0u;
+    if(inst.writesRegister(REG_TMU1_ADDRESS))
+        return 1u;
+    return {};
 }
 
-static OpenSet::const_iterator selectInstruction(OpenSet& openNodes, analysis::DependencyGraph& graph,
-    BasicBlock& block, const DelaysMap& successiveMandatoryDelays, const DelaysMap& successiveDelays)
+static Optional<unsigned> getConsumedTMU(const intermediate::IntermediateInstruction& inst)
 {
-    // iterate open-set until entry with no more dependencies
-    auto it = openNodes.begin();
-    std::pair<OpenSet::const_iterator, int> selected = std::make_pair(openNodes.end(), DEFAULT_PRIORITY);
-    auto lastInstruction = block.walkEnd().previousInBlock();
-    PROFILE_START(SelectInstruction);
-    while(it != openNodes.end())
-    {
-        // select first entry (with highest priority) for which all dependencies are fulfilled (with latency)
-        int priority = checkDependenciesMet(graph.assertNode(*it), block, openNodes);
-        if(priority < MIN_PRIORITY)
-            priority -= static_cast<int>(successiveMandatoryDelays.at(*it));
-        // TODO use preferred delays?
-        // TODO remove adding/removing priorities in calculateSchedulingPriority?
-        // TODO remove extra cases here?
-        // TODO need to combine more instructions!
-        // TODO success rate (i.e. emulation tests) is good, need to optimize performance
-        // TODO is putting too much pressure on mutex lock (15% more than before)
-        if(priority < std::get<1>(selected) ||
-            // keep instructions writing the same local together to be combined more easily
-            // TODO make better/check result
-            (priority == std::get<1>(selected) && lastInstruction->checkOutputLocal() &&
-                (*it)->writesLocal(lastInstruction->getOutput()->local())) ||
-            // keep vector rotations close to their use by devaluing them after all other equal-priority instructions
-            (priority == std::get<1>(selected) && lastInstruction->getVectorRotation() &&
-                !(*it)->getVectorRotation()) ||
-            // prefer reading of r4 to free up space in TMU queue/allow other triggers to write to r4
-            (priority == std::get<1>(selected) && (*it)->readsRegister(REG_TMU_OUT)) ||
-            // prefer anything over locking mutex
-            (priority == std::get<1>(selected) && std::get<0>(selected) != openNodes.end() &&
-                (*std::get<0>(selected))->readsRegister(REG_MUTEX)))
-        {
-            std::get<0>(selected) = it;
-            std::get<1>(selected) = priority;
-        }
-        // TODO some more efficient version? E.g. caching priorities, check from lowest, update, take new lowest
-        ++it;
-    }
-    PROFILE_END(SelectInstruction);
+    if(inst.getSignal() == SIGNAL_LOAD_TMU0)
+        return 0u;
+    if(inst.getSignal() == SIGNAL_LOAD_TMU1)
+        return 1u;
+    return {};
+}
 
-    if(std::get<0>(selected) != openNodes.end())
+/*
+ * Returns whether the candidate should be scheduled in the given cycle instead of the currently selected instruction.
+ *
+ * Instructions which can be executed without stalling are always preferred. Of these, the instructions with the longer
+ * critical path are selected first to start long-latency operations as early as possible. Of the instructions stalling
+ * for a preferred delay, the one with the shortest stall is selected.
+ */
+static bool isBetterCandidate(const ScheduleEntry& candidate, std::size_t candidateIndex, const ScheduleEntry& selected,
+    std::size_t selectedIndex, std::size_t cycle, const Local* lastOutput)
+{
+    auto candidateStalls = candidate.preferredCycle > cycle;
+    auto selectedStalls = selected.preferredCycle > cycle;
+    if(candidateStalls != selectedStalls)
+        return !candidateStalls;
+    if(candidateStalls && candidate.preferredCycle != selected.preferredCycle)
+        return candidate.preferredCycle < selected.preferredCycle;
+    // locking shared resources is delayed until there is nothing else to do, regardless of the critical path
+    if((candidate.resourceRating < 0) != (selected.resourceRating < 0))
+        return selected.resourceRating < 0;
+    if(candidate.criticalPath != selected.criticalPath)
+        return candidate.criticalPath > selected.criticalPath;
+    if(candidate.resourceRating != selected.resourceRating)
+        return candidate.resourceRating > selected.resourceRating;
+    // keep (conditional) writes of the same local together, so they can be combined more easily
+    if(lastOutput)
     {
-        CPPLOG_LAZY(logging::Level::DEBUG,
-            log << "Selected '" << (*std::get<0>(selected))->to_string()
-                << "' as next instruction with remaining latency of " << std::get<1>(selected) << logging::endl);
-        return std::get<0>(selected);
+        auto candidateWritesLast = candidate.instruction->writesLocal(lastOutput);
+        if(candidateWritesLast != selected.instruction->writesLocal(lastOutput))
+            return candidateWritesLast;
     }
-
-    return openNodes.end();
+    // otherwise keep the original order
+    return candidateIndex < selectedIndex;
 }
 
-// FIXME largely extends usage-ranges and increases pressure on registers
-// FIXME increases mutex-ranges!!
-// TODO make sure no more than 4(8?) TMU requests/responds are queued at any time (per TMU?)
-// - Specification documents 8 entries of single row (for general memory query), but does not specify whether one queue
-// or per TMU
-// - Tests show that up to 8 requests per TMU run (whether result is correct not tested!!), 9+ hang QPU
-
-/*
- * Select an instruction which does not depend on any instruction (not yet scheduled) anymore and insert it into the
- * basic block
- */
-static void selectInstructions(analysis::DependencyGraph& graph, BasicBlock& block,
-    const DelaysMap& successiveMandatoryDelays, const DelaysMap& successiveDelays)
+std::size_t optimizations::scheduleInstructions(
+    const Module& module, Method& method, BasicBlock& block, const Configuration& config)
 {
+    auto dependencies = analysis::DependencyGraph::createGraph(block);
+
     // 1. "empty" basic block without deleting the instructions, skipping the label
+    std::vector<ScheduleEntry> entries;
+    entries.reserve(block.size());
+    // the removed NOPs are kept alive until the end, since they are still referenced by the dependency graph
+    std::vector<std::unique_ptr<intermediate::IntermediateInstruction>> removedNops;
+    FastMap<const intermediate::IntermediateInstruction*, uint32_t> indices;
+    indices.reserve(block.size());
     auto it = block.walk().nextInBlock();
-    OpenSet openNodes(NodeSorter(block.size()));
     while(!it.isEndOfBlock())
     {
-        auto decorations = intermediate::InstructionDecorations::NONE;
-        if(it.has() &&
-            !(it.get<intermediate::Nop>() && !it->hasSideEffects() &&
-                it.get<const intermediate::Nop>()->type != intermediate::DelayType::THREAD_END))
+        if(it.has())
         {
-            // remove all non side-effect NOPs
-            decorations = it->decoration;
-            openNodes.emplace(it.release().release());
+            auto nop = it.get<const intermediate::Nop>();
+            if(nop && !nop->hasSideEffects() && nop->type != intermediate::DelayType::THREAD_END)
+                // remove all non side-effect NOPs, the required delays are re-inserted from the dependencies
+                removedNops.emplace_back(it.release());
+            else
+            {
+                indices.emplace(it.get(), static_cast<uint32_t>(entries.size()));
+                entries.emplace_back();
+                entries.back().instruction = it.release();
+            }
         }
-        it.safeErase(decorations);
+        it.erase();
     }
 
-    // 2. fill again with reordered instructions
-    while(!openNodes.empty())
+    // 2. calculate the static priorities and the number of predecessors for all instructions
+    PROFILE_START(CalculateCriticalPath);
+    // Since all dependencies point to following instructions, the critical paths can be calculated in a single
+    // backwards pass. The TMU requests are matched to their loads in the same pass to find the requests not read in
+    // this block.
+    std::array<unsigned, 2> pendingTMULoads{0, 0};
+    for(auto i = entries.size(); i > 0; --i)
     {
-        auto inst = selectInstruction(openNodes, graph, block, successiveMandatoryDelays, successiveDelays);
-        if(inst == openNodes.end())
-        {
-            // no instruction could be scheduled not violating the fixed latency, insert NOPs
-            CPPLOG_LAZY(logging::Level::DEBUG,
-                log << "Failed to schedule an instruction, falling back to inserting NOP" << logging::endl);
-            block.walkEnd().emplace(std::make_unique<intermediate::Nop>(intermediate::DelayType::WAIT_REGISTER));
-        }
-        else
+        auto& entry = entries[i - 1];
+        entry.node = &dependencies->assertNode(entry.instruction.get());
+        entry.node->forAllOutgoingEdges(
+            [&](const analysis::DependencyNode& successor, const analysis::DependencyEdge& edge) -> bool {
+                auto succIt = indices.find(successor.key);
+                if(succIt != indices.end())
+                    entry.criticalPath = std::max(entry.criticalPath,
+                        1 + edge.data.numDelayCycles + entries[succIt->second].criticalPath);
+                return true;
+            });
+        if(auto tmu = getConsumedTMU(*entry.instruction))
+            ++pendingTMULoads[*tmu];
+        if(auto tmu = getQueuedTMU(*entry.instruction))
         {
-            block.walkEnd().emplace(std::unique_ptr<intermediate::IntermediateInstruction>{*inst});
-            openNodes.erase(inst);
+            if(pendingTMULoads[*tmu] > 0)
+                --pendingTMULoads[*tmu];
+            else
+                // requests read in a following block are issued as early as possible to hide the memory latency
+                entry.criticalPath = std::max(entry.criticalPath, static_cast<std::size_t>(TMU_PREFETCH_LATENCY));
         }
     }
-}
+    // the remaining loads read the requests queued in a previous block (e.g. prefetched in the previous loop iteration)
+    auto queuedTMURequests = pendingTMULoads;
+    std::vector<uint32_t> readyEntries;
+    for(uint32_t i = 0; i < entries.size(); ++i)
+    {
+        auto& entry = entries[i];
+        entry.resourceRating = rateResourceUsage(*entry.instruction);
+        if(auto loc = entry.instruction->checkOutputLocal())
+            entry.writesRegisterFile = loc->countUsers(LocalUse::Type::READER) > 1;
+        entry.node->forAllIncomingEdges(
+            [&](const analysis::DependencyNode& predecessor, const analysis::DependencyEdge& edge) -> bool {
+                // dependencies on removed NOPs are ignored
+                if(indices.find(predecessor.key) != indices.end())
+                    ++entry.numOpenPredecessors;
+                return true;
+            });
+        if(entry.numOpenPredecessors == 0)
+            readyEntries.push_back(i);
+    }
+    PROFILE_END(CalculateCriticalPath);
 
-std::size_t optimizations::reorderInstructions(const Module& module, Method& kernel, const Configuration& config)
-{
-    auto prevInstructions = kernel.countInstructions();
-    for(BasicBlock& bb : kernel)
+    // 3. fill again with the scheduled instructions
+    PROFILE_START(ScheduleInstructions);
+    std::size_t numChanges = 0;
+    std::size_t cycle = 0;
+    std::size_t numScheduled = 0;
+    // all instructions before this index are already scheduled
+    std::size_t firstOpenIndex = 0;
+    const Local* lastOutput = nullptr;
+    while(numScheduled < entries.size())
     {
-        auto dependencies = analysis::DependencyGraph::createGraph(bb);
-        // calculate required and recommended successive delays for all instructions
-        DelaysMap successiveMandatoryDelays;
-        DelaysMap successiveDelays;
-        PROFILE_START(CalculateCriticalPath);
-        for(const auto& node : dependencies->getNodes())
+        auto selected = readyEntries.end();
+        for(auto readyIt = readyEntries.begin(); readyIt != readyEntries.end(); ++readyIt)
         {
-            // since we cache all delays (also for all intermediate results), it is only calculated once per node
-            node.second.calculateSucceedingCriticalPathLength(true, &successiveMandatoryDelays);
-            node.second.calculateSucceedingCriticalPathLength(false, &successiveDelays);
+            const auto& candidate = entries[*readyIt];
+            if(*readyIt >= firstOpenIndex + SCHEDULING_WINDOW || candidate.mandatoryCycle > cycle)
+                continue;
+            // the original order is always valid, so the limit does not apply to the first open instruction
+            auto tmu = getQueuedTMU(*candidate.instruction);
+            if(tmu && queuedTMURequests[*tmu] >= periphery::TMU_QUEUE_SIZE && *readyIt != firstOpenIndex)
+                continue;
+            if(selected == readyEntries.end() ||
+                isBetterCandidate(candidate, *readyIt, entries[*selected], *selected, cycle, lastOutput))
+                selected = readyIt;
         }
-        PROFILE_END(CalculateCriticalPath);
-        selectInstructions(*dependencies, bb, successiveMandatoryDelays, successiveDelays);
+
+        if(selected == readyEntries.end())
+        {
+            // no instruction can be scheduled without violating a mandatory delay, insert NOP
+            CPPLOG_LAZY(logging::Level::DEBUG,
+                log << "Failed to schedule an instruction in cycle " << cycle << ", inserting NOP" << logging::endl);
+            block.walkEnd().emplace(std::make_unique<intermediate::Nop>(intermediate::DelayType::WAIT_REGISTER));
+            ++numChanges;
+            ++cycle;
+            continue;
+        }
+
+        auto index = *selected;
+        *selected = readyEntries.back();
+        readyEntries.pop_back();
+        auto& entry = entries[index];
+        CPPLOG_LAZY(logging::Level::DEBUG,
+            log << "Scheduling '" << entry.instruction->to_string() << "' in cycle " << cycle
+                << (entry.preferredCycle > cycle ? " (stalling)" : "") << " with critical path length "
+                << entry.criticalPath << logging::endl);
+
+        if(index != numScheduled)
+            ++numChanges;
+        if(auto tmu = getQueuedTMU(*entry.instruction))
+            ++queuedTMURequests[*tmu];
+        if(auto tmu = getConsumedTMU(*entry.instruction))
+            queuedTMURequests[*tmu] = queuedTMURequests[*tmu] > 0 ? queuedTMURequests[*tmu] - 1 : 0;
+        lastOutput = entry.instruction->checkOutputLocal();
+        // instructions not mapping to machine code do not take any cycle
+        auto nextCycle = cycle + (entry.instruction->mapsToASMInstruction() ? 1 : 0);
+        entry.node->forAllOutgoingEdges(
+            [&](const analysis::DependencyNode& successor, const analysis::DependencyEdge& edge) -> bool {
+                auto succIt = indices.find(successor.key);
+                if(succIt == indices.end())
+                    return true;
+                auto& succ = entries[succIt->second];
+                auto delay = edge.data.numDelayCycles;
+                if(edge.data.isMandatoryDelay)
+                    succ.mandatoryCycle = std::max(succ.mandatoryCycle, nextCycle + delay);
+                if(delay == 0 && entry.writesRegisterFile &&
+                    has_flag(edge.data.type, analysis::DependencyType::VALUE_READ_AFTER_WRITE))
+                    delay = REGISTER_FILE_READ_LATENCY;
+                succ.preferredCycle = std::max(succ.preferredCycle, nextCycle + delay);
+                if(--succ.numOpenPredecessors == 0)
+                    readyEntries.push_back(succIt->second);
+                return true;
+            });
+        block.walkEnd().emplace(std::move(entry.instruction));
+        entry.isScheduled = true;
+        ++numScheduled;
+        cycle = nextCycle;
+        while(firstOpenIndex < entries.size() && entries[firstOpenIndex].isScheduled)
+            ++firstOpenIndex;
     }
-    return prevInstructions - kernel.countInstructions();
+    PROFILE_END(ScheduleInstructions);
+
+    CPPLOG_LAZY(logging::Level::DEBUG,
+        log << "Scheduled " << entries.size() << " instructions of block " << block.getLabel()->getLabel()->name
+            << " into " << cycle << " cycles with " << numChanges << " changes" << logging::endl);
+    return numChanges + removedNops.size();
 }
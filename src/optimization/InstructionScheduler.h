@@ -11,13 +11,22 @@
 
 namespace vc4c
 {
+    class BasicBlock;
     class Method;
     class Module;
     struct Configuration;
 
     namespace optimizations
     {
-        std::size_t reorderInstructions(const Module& module, Method& kernel, const Configuration& config);
+        /*
+         * Reorders the instructions of the basic block with a list scheduler to hide the latencies of the SFU, TMU and
+         * VPM accesses and to minimize the number of delays which need to be inserted.
+         *
+         * The instructions are selected by the length of their critical path to the end of the block, only moving
+         * instructions a limited distance to not increase the register pressure too much.
+         */
+        std::size_t scheduleInstructions(
+            const Module& module, Method& method, BasicBlock& block, const Configuration& config);
 
     } /* namespace optimizations */
 } /* namespace vc4c */
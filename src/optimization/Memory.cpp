@@ -12,6 +12,7 @@
 #include "../Module.h"
 #include "../Profiler.h"
 #include "../SIMDVector.h"
+#include "../analysis/AnalysisManager.h"
 #include "../analysis/ControlFlowGraph.h"
 #include "../analysis/ControlFlowLoop.h"
 #include "../analysis/DataDependencyGraph.h"
@@ -1382,7 +1383,8 @@ struct TMULoadOffset
 };
 
 static FastMap<TypedInstructionWalker<intermediate::RAMAccessInstruction>, TMULoadOffset> findTMULoadsInLoop(
-    const analysis::ControlFlowLoop& loop, Method& method, const analysis::DataDependencyGraph& dependencyGraph)
+    const analysis::ControlFlowLoop& loop, Method& method, const analysis::DataDependencyGraph& dependencyGraph,
+    unsigned maxNumLoads)
 {
     std::array<FastMap<TypedInstructionWalker<intermediate::RAMAccessInstruction>, TMULoadOffset>, 2>
         relevantTMULoads{};
@@ -1464,11 +1466,17 @@ static FastMap<TypedInstructionWalker<intermediate::RAMAccessInstruction>, TMULo
         }
     }
 
-    // TODO for now only optimize for a single TMU load.
-    // We could extend this up to 2/4/8? TMU loads (per TMU?), if we can guarantee the order
-    // Tests on hardware running Pearson16 have shown that even allowing single load per TMU causes wrong values to be
-    // loaded, same as on emulator
-    if(numTMULoads[0] + numTMULoads[1] != 1)
+    // Since the TMUs return the values in the order they were requested, we can only prefetch the loads of a TMU if we
+    // prefetch all of them. Also, all prefetched loads need to fit into the TMU FIFOs (after possibly distributing them
+    // over both TMUs).
+    // NOTE: Tests on hardware running Pearson16 have shown that even allowing a single prefetched load per TMU causes
+    // wrong values to be loaded, same as on emulator. This is not yet root-caused, so by default only loops with a
+    // single load are prefetched and prefetching more loads needs to be enabled explicitly (see
+    // OptimizationOptions#maxPrefetchedLoads). Any change here needs to be verified by comparing the results with and
+    // without prefetching (see TestEmulator#testPrefetchLoads).
+    if(relevantTMULoads[0].size() != numTMULoads[0] || relevantTMULoads[1].size() != numTMULoads[1])
+        return {};
+    if(numTMULoads[0] + numTMULoads[1] > std::min(maxNumLoads, 2 * periphery::TMU_QUEUE_SIZE))
         return {};
 
     FastMap<TypedInstructionWalker<intermediate::RAMAccessInstruction>, TMULoadOffset> result;
@@ -1500,8 +1508,96 @@ static Value calculateAddress(InstructionWalker& it, const analysis::InductionVa
     return assign(it, addressType, "%prefetch_tmu_address") = (baseLocal->createReference() + tmpOffset);
 }
 
+/*
+ * Creates a cache entry for the same memory access as the given entry, but reading via the other TMU
+ */
+static std::shared_ptr<periphery::TMUCacheEntry> switchTMU(const periphery::TMUCacheEntry& entry)
+{
+    const auto& otherTMU = entry.getTMUIndex() == 0 ? periphery::TMU1 : periphery::TMU0;
+    // the type is only used to initialize the members which are copied below anyway
+    auto newEntry = otherTMU.createEntry(entry.addresses, TYPE_INT32);
+    newEntry->numVectorElements = entry.numVectorElements;
+    newEntry->elementStrideInBytes = entry.elementStrideInBytes;
+    newEntry->customAddressCalculation = entry.customAddressCalculation;
+    return newEntry;
+}
+
+struct PipelinedTMULoad
+{
+    TypedInstructionWalker<intermediate::RAMAccessInstruction> ramAccess;
+    TypedInstructionWalker<intermediate::CacheAccessInstruction> cacheAccess;
+    // the position of the cache access within the loop block, determines the order of the values in the TMU FIFO
+    std::size_t cacheAccessPosition;
+    const TMULoadOffset* offset;
+    std::shared_ptr<periphery::TMUCacheEntry> cacheEntry;
+};
+
+/*
+ * Returns the position to insert the instructions draining the TMU FIFOs after the loop into
+ */
+static InstructionWalker findDrainPosition(
+    const analysis::ControlFlowLoop& loop, Method& method, const analysis::CFGNode* preheader)
+{
+    auto successor = loop.findSuccessor();
+    bool successorFollowsPreheader = false;
+    successor->forAllIncomingEdges([&](const analysis::CFGNode& predecessor, const analysis::CFGEdge& edge) -> bool {
+        if(&predecessor == preheader)
+        {
+            successorFollowsPreheader = true;
+            return false;
+        }
+        return true;
+    });
+    if(!successorFollowsPreheader)
+        return successor->key->walk().nextInBlock();
+
+    /*
+     * If we have a proper preheader (i.e. a block from which control flow unconditionally jumps into the loop), this
+     * preheader block is not executed if the loop is not taken at all. Since we do insert our prefetch TMU RAM access
+     * into that block, no data is prefetched at all if the loop is not taken at all.
+     *
+     * To not hang indefinitely on the TMU FIFO drain instruction if the loop is not taken, we need to make sure the
+     * drain is also only executed if the loop is actually taken.
+     *
+     * TODO improve on this by always inserting a proper preheader block and inserting the prefetch there? And then also
+     * always insert a separate loop successor block which is only reached from the loop body?
+     */
+    auto newLabel = method.addNewLocal(TYPE_LABEL, "%loop_successor");
+    auto drainIt =
+        method.emplaceLabel(successor->key->walk(), std::make_unique<intermediate::BranchLabel>(*newLabel.local()));
+
+    auto exitEdge = loop.findExitEdge();
+    if(!exitEdge)
+        throw CompilationError(
+            CompilationStep::OPTIMIZER, "Failed to determine exit edge for TMU load prefetch", loop.to_string());
+    if(exitEdge->isOutput(*successor))
+    {
+        // if the old successor block still has an edge from the loop itself (i.e. the edge from the loop to the old
+        // successor block was not a fall-through), we need to redirect this edge to the new successor block.
+        // TODO make all this way cleaner (for all possible CFG constellations) and move to control flow loop?!
+        auto& exitNode = exitEdge->getOtherNode(*successor);
+        auto exitBranch = exitEdge->data.getPredecessor(exitNode.key).get<intermediate::Branch>();
+        if(exitBranch && exitBranch->getSingleTargetLabel() == successor->key->getLabel()->getLabel())
+            exitBranch->setTarget(newLabel.local());
+        else
+            throw CompilationError(CompilationStep::OPTIMIZER,
+                "Unhandled case of redirecting loop successor branch for TMU prefetch drain", loop.to_string());
+    }
+    return drainIt.nextInBlock();
+}
+
+/*
+ * Software-pipelines the TMU loads of the loop: The values for the first iteration are requested before the loop and
+ * every iteration requests the values for the next iteration as soon as it has read its own values. This way, the
+ * memory latency of the loads is hidden behind the calculations of the remaining loop iteration (which the
+ * instruction scheduler can then fill with independent instructions).
+ *
+ * Since the TMUs return the values in the order of the requests, the requests for the next iteration are queued in
+ * the same order as the values are read and only after the values of the current iteration are read.
+ */
 NODISCARD static bool prefetchTMULoadsInLoop(const analysis::ControlFlowLoop& loop, Method& method,
-    const analysis::DataDependencyGraph& dependencyGraph, const analysis::DominatorTree& dominators)
+    const analysis::DataDependencyGraph& dependencyGraph, const analysis::DominatorTree& dominators,
+    unsigned maxNumLoads)
 {
     auto preheader = loop.findPreheader(dominators);
     auto successor = loop.findSuccessor();
@@ -1513,25 +1609,112 @@ NODISCARD static bool prefetchTMULoadsInLoop(const analysis::ControlFlowLoop& lo
         // fail fast, since we won't be able to insert the moved/copied instructions anywhere
         return false;
 
-    auto matchingTMULoads = findTMULoadsInLoop(loop, method, dependencyGraph);
+    auto repeatIt = repeatEdge->data.getPredecessor(tail->key);
+    auto repeatBranch = repeatIt.get<intermediate::Branch>();
+    if(!repeatBranch || repeatBranch->isUnconditional())
+        // we need the loop condition to not prefetch out of bounds in the last iteration
+        return false;
 
-    for(auto& load : matchingTMULoads)
+    auto matchingTMULoads = findTMULoadsInLoop(loop, method, dependencyGraph, maxNumLoads);
+    if(matchingTMULoads.empty())
+        return false;
+
+    // 1. check whether all loads can be pipelined before modifying anything. The loop consists of a single block.
+    auto& block = *tail->key;
+    std::vector<InstructionWalker> walkers;
+    FastMap<const intermediate::IntermediateInstruction*, std::size_t> positions;
+    for(auto it = block.walk(); !it.isEndOfBlock(); it.nextInBlock())
     {
-        CPPLOG_LAZY(logging::Level::DEBUG,
-            log << "Prefetching TMU RAM load in loop '" << loop.to_string(false) << "': " << load.first->to_string()
-                << logging::endl);
-        auto initialPrefetchIt =
-            preheader->key->findWalkerForInstruction(load.second.inductionVariable.initialAssignment);
-        auto successivePrefetchIt = repeatEdge->data.getPredecessor(tail->key);
-        if(!initialPrefetchIt)
-            continue;
+        if(it.has())
+            positions.emplace(it.get(), walkers.size());
+        walkers.push_back(it);
+    }
+    auto getPosition = [&](const intermediate::IntermediateInstruction* inst) -> Optional<std::size_t> {
+        auto posIt = positions.find(inst);
+        if(posIt != positions.end())
+            return posIt->second;
+        return {};
+    };
+
+    auto flagsIt = block.findLastSettingOfFlags(repeatIt);
+    if(!flagsIt)
+        return false;
+    // the prefetch for the next iteration needs the incremented induction variables and the loop condition flags
+    auto firstPrefetchPosition = positions.at(flagsIt->get());
+    auto repeatPosition = positions.at(repeatIt.get());
 
-        auto originalAccess = load.first.get();
+    std::vector<PipelinedTMULoad> loads;
+    loads.reserve(matchingTMULoads.size());
+    for(const auto& load : matchingTMULoads)
+    {
+        const auto& inductionVariable = load.second.inductionVariable;
+        auto cacheEntry = load.first->getTMUCacheEntry();
+        auto cacheReader = cacheEntry->getCacheReader();
+        auto ramPosition = getPosition(load.first.get());
+        auto cachePosition = getPosition(cacheReader);
+        auto stepPosition = getPosition(inductionVariable.inductionStep);
+        if(cacheEntry->getRAMReader() != load.first.get() || !ramPosition || !cachePosition || !stepPosition ||
+            *ramPosition > *cachePosition || *cachePosition > repeatPosition || *stepPosition > repeatPosition ||
+            !preheader->key->findWalkerForInstruction(inductionVariable.initialAssignment))
+            return false;
+        firstPrefetchPosition = std::max(firstPrefetchPosition, *stepPosition);
+        loads.emplace_back(PipelinedTMULoad{
+            load.first, typeSafe(walkers[*cachePosition], *cacheReader), *cachePosition, &load.second, cacheEntry});
+    }
+    // the values are read (and therefore need to be requested) in the order of the cache accesses
+    std::sort(loads.begin(), loads.end(), [](const PipelinedTMULoad& one, const PipelinedTMULoad& other) -> bool {
+        return one.cacheAccessPosition < other.cacheAccessPosition;
+    });
+
+    // 2. distribute the loads over both TMUs to queue as many requests as possible
+    std::array<unsigned, 2> numLoads{};
+    for(const auto& load : loads)
+        ++numLoads[load.cacheEntry->getTMUIndex()];
+    bool redistributeLoads = loads.size() > 1 &&
+        (numLoads[0] == 0 || numLoads[1] == 0 || std::max(numLoads[0], numLoads[1]) > periphery::TMU_QUEUE_SIZE);
+    if(redistributeLoads)
+    {
+        numLoads = {};
+        for(std::size_t i = 0; i < loads.size(); ++i)
+            ++numLoads[i % 2];
+    }
+    if(std::max(numLoads[0], numLoads[1]) > periphery::TMU_QUEUE_SIZE)
+        return false;
 
-        // move original TMU RAM load before the loop
-        auto it = initialPrefetchIt->copy().nextInBlock();
-        auto assignmentInst = initialPrefetchIt->get<intermediate::ExtendedInstruction>();
-        if(assignmentInst && assignmentInst->hasConditionalExecution())
+    CPPLOG_LAZY(logging::Level::DEBUG,
+        log << "Pipelining " << numLoads[0] << " TMU0 and " << numLoads[1] << " TMU1 loads in loop '"
+            << loop.to_string(false) << '\'' << logging::endl);
+
+    if(redistributeLoads)
+    {
+        for(std::size_t i = 0; i < loads.size(); ++i)
+        {
+            auto& load = loads[i];
+            if(load.cacheEntry->getTMUIndex() == i % 2)
+                continue;
+            load.cacheEntry = switchTMU(*load.cacheEntry);
+            auto newCacheAccess = std::make_unique<intermediate::CacheAccessInstruction>(
+                intermediate::MemoryOperation::READ, load.cacheAccess->getData(), load.cacheEntry);
+            newCacheAccess->copyExtrasFrom(*load.cacheAccess.get(), true);
+            load.cacheAccess.reset(std::move(newCacheAccess));
+        }
+    }
+
+    // 3. request the values for the first iteration at the end of the preheader (after any other TMU access there)
+    auto preheaderIt = preheader->key->walkEnd();
+    while(!preheaderIt.copy().previousInBlock().isStartOfBlock() &&
+        preheaderIt.copy().previousInBlock().get<intermediate::Branch>())
+        preheaderIt.previousInBlock();
+    FastSet<const Local*> fixedInductionVariables;
+    std::vector<Value> firstIterationAddresses;
+    firstIterationAddresses.reserve(loads.size());
+    for(auto& load : loads)
+    {
+        const auto& inductionVariable = load.offset->inductionVariable;
+        auto assignmentIt = *preheader->key->findWalkerForInstruction(inductionVariable.initialAssignment);
+        auto assignmentInst = assignmentIt.get<intermediate::ExtendedInstruction>();
+        if(assignmentInst && assignmentInst->hasConditionalExecution() &&
+            fixedInductionVariables.emplace(inductionVariable.local).second)
         {
             /*
              * In some cases where the loop might be skipped completely, the induction variable is only written
@@ -1544,90 +1727,68 @@ NODISCARD static bool prefetchTMULoadsInLoop(const analysis::ControlFlowLoop& lo
                 // if we write a constant value (have no data dependencies) just make the assignment unconditional
                 assignmentInst->setCondition(COND_ALWAYS);
             else
-                assign(it, load.second.inductionVariable.local->createReference()) =
+            {
+                auto it = assignmentIt.nextInBlock();
+                assign(it, inductionVariable.local->createReference()) =
                     (INT_ZERO, assignmentInst->getCondition().invert());
+            }
         }
-        auto firstIterationAddress = calculateAddress(it, load.second.inductionVariable, load.second.offsetExpression,
-            method, originalAccess->getMemoryAddress().type, load.second.baseLocal);
-        it.emplace(const_cast<TypedInstructionWalker<intermediate::RAMAccessInstruction>&>(load.first).release());
-        it.get<intermediate::RAMAccessInstruction>()->setMemoryAddress(firstIterationAddress);
-
-        // add instruction prefetching the value for the next iteration into the TMU FIFO
-        it = successivePrefetchIt.copy().previousInBlock();
-        auto nextIterationAddress = calculateAddress(it, load.second.inductionVariable, load.second.offsetExpression,
-            method, originalAccess->getMemoryAddress().type, load.second.baseLocal);
-        if(auto branch = successivePrefetchIt.get<intermediate::Branch>())
-        {
-            /*
-             * If the loop is not repeated anymore (this is our last iteration), we would prefetch a memory address
-             * which is not intended to be addressed and therefore might not be allocated at all.
-             *
-             * To mitigate this, we re-load the first address instead, if we don't repeat the loop anymore. This memory
-             * address should already be cached and also has already been accessed, so we know we can access it anyway.
-             */
-            auto branchCond = branch->branchCondition;
-            if(branch->getSingleTargetLabel() == header->key->getLabel()->getLabel())
-                branchCond = branchCond.invert();
-            assign(it, nextIterationAddress) = (firstIterationAddress, branchCond.toConditionCode());
-        }
-        it.emplace(std::make_unique<intermediate::RAMAccessInstruction>(
-            intermediate::MemoryOperation::READ, nextIterationAddress, originalAccess->cache));
-
-        // add instruction to drain the TMU FIFO after loop
-        bool successorFollowsPreheader = false;
-        successor->forAllIncomingEdges(
-            [&](const analysis::CFGNode& predecessor, const analysis::CFGEdge& edge) -> bool {
-                if(&predecessor == preheader)
-                {
-                    successorFollowsPreheader = true;
-                    return false;
-                }
-                return true;
-            });
-        auto discardIt = successor->key->walk();
-        if(!successorFollowsPreheader)
+
+        auto addressType = load.ramAccess->getMemoryAddress().type;
+        auto numEntries = load.ramAccess->getNumEntries();
+        auto firstIterationAddress = calculateAddress(
+            preheaderIt, inductionVariable, load.offset->offsetExpression, method, addressType, load.offset->baseLocal);
+        preheaderIt.emplace(std::make_unique<intermediate::RAMAccessInstruction>(
+            intermediate::MemoryOperation::READ, firstIterationAddress, load.cacheEntry, numEntries));
+        preheaderIt.nextInBlock();
+        firstIterationAddresses.push_back(firstIterationAddress);
+    }
+
+    // 4. request the values for the next iteration as soon as the values of this iteration are read
+    auto branchCond = repeatBranch->branchCondition;
+    if(repeatBranch->getSingleTargetLabel() == header->key->getLabel()->getLabel())
+        branchCond = branchCond.invert();
+    auto prefetchIt = block.walkEnd();
+    std::size_t lastPrefetchPosition = 0;
+    for(std::size_t i = 0; i < loads.size(); ++i)
+    {
+        auto& load = loads[i];
+        auto prefetchPosition = std::max(firstPrefetchPosition, load.cacheAccessPosition);
+        if(i == 0 || prefetchPosition > lastPrefetchPosition)
         {
-            /*
-             * If we have a proper preheader (i.e. a block from which control flow unconditionally jumps into the loop),
-             * this preheader block is not executed if the loop is not taken at all. Since we do insert our prefetch TMU
-             * RAM access into that block, no data is prefetched at all if the loop is not taken at all.
-             *
-             * To not hang indefinitely on the TMU FIFO drain instruction if the loop is not taken, we need to make sure
-             * the drain is also only executed if the loop is actually taken.
-             *
-             * TODO improve on this by always inserting a proper preheader block and inserting the prefetch there? And
-             * then also always insert a separate loop successor block which is only reached from the loop body?
-             */
-            auto newLabel = method.addNewLocal(TYPE_LABEL, "%loop_successor");
-            discardIt = method.emplaceLabel(
-                successor->key->walk(), std::make_unique<intermediate::BranchLabel>(*newLabel.local()));
-
-            auto exitEdge = loop.findExitEdge();
-            if(!exitEdge)
-                throw CompilationError(CompilationStep::OPTIMIZER,
-                    "Failed to determine exit edge for TMU load prefetch", loop.to_string());
-            if(exitEdge->isOutput(*successor))
-            {
-                // if the old successor block still has an edge from the loop itself (i.e. the edge from the loop to the
-                // old successor block was not a fall-through), we need to redirect this edge to the new successor
-                // block.
-                // TODO make all this way cleaner (for all possible CFG constellations) and move to control flow loop?!
-                auto& exitNode = exitEdge->getOtherNode(*successor);
-                auto exitBranch = exitEdge->data.getPredecessor(exitNode.key).get<intermediate::Branch>();
-                if(exitBranch && exitBranch->getSingleTargetLabel() == successor->key->getLabel()->getLabel())
-                    exitBranch->setTarget(newLabel.local());
-                else
-                    throw CompilationError(CompilationStep::OPTIMIZER,
-                        "Unhandled case of redirecting loop successor branch for TMU prefetch drain", loop.to_string());
-            }
+            // otherwise we insert directly after the previous prefetch to keep the order of the requests
+            prefetchIt = walkers[prefetchPosition].copy().nextInBlock();
+            lastPrefetchPosition = prefetchPosition;
         }
+        auto addressType = load.ramAccess->getMemoryAddress().type;
+        auto numEntries = load.ramAccess->getNumEntries();
+        auto nextIterationAddress = calculateAddress(prefetchIt, load.offset->inductionVariable,
+            load.offset->offsetExpression, method, addressType, load.offset->baseLocal);
+        /*
+         * If the loop is not repeated anymore (this is our last iteration), we would prefetch a memory address which is
+         * not intended to be addressed and therefore might not be allocated at all.
+         *
+         * To mitigate this, we re-load the first address instead, if we don't repeat the loop anymore. This memory
+         * address should already be cached and also has already been accessed, so we know we can access it anyway.
+         */
+        assign(prefetchIt, nextIterationAddress) = (firstIterationAddresses[i], branchCond.toConditionCode());
+        prefetchIt.emplace(std::make_unique<intermediate::RAMAccessInstruction>(
+            intermediate::MemoryOperation::READ, nextIterationAddress, load.cacheEntry, numEntries));
+        prefetchIt.nextInBlock();
+        // the original access is replaced by the prefetch in the preheader
+        load.ramAccess.erase();
+    }
 
-        it = discardIt.nextInBlock();
-        it.emplace(std::make_unique<intermediate::CacheAccessInstruction>(
-            intermediate::MemoryOperation::READ, NOP_REGISTER, originalAccess->cache));
+    // 5. drop the values prefetched by the last iteration after the loop
+    auto drainIt = findDrainPosition(loop, method, preheader);
+    for(const auto& load : loads)
+    {
+        drainIt.emplace(std::make_unique<intermediate::CacheAccessInstruction>(
+            intermediate::MemoryOperation::READ, NOP_REGISTER, load.cacheEntry));
+        drainIt.nextInBlock();
     }
 
-    return !matchingTMULoads.empty();
+    return true;
 }
 
 static bool containsSynchronizationInstruction(const analysis::ControlFlowLoop& loop)
@@ -1649,13 +1810,14 @@ std::size_t optimizations::prefetchTMULoads(const Module& module, Method& method
     // 2. check number of TMU loads (per TMU)
     // 3. try to determine TMU addresses and whether they are derived from induction variable/can be statically
     // pre-computed
-    // 4. move first load (RAM access) out of loop, further loads to previous iteration
-    // 5. insert dropping of pre-loaded value after loop
+    // 4. distribute loads over both TMUs, move first loads (RAM access) out of loop, further loads to previous
+    // iteration
+    // 5. insert dropping of pre-loaded values after loop
 
-    auto& cfg = method.getCFG();
-    auto dominatorTree = cfg.getDominatorTree();
-    auto loops = cfg.findLoops(false, true);
-    auto dependencyGraph = analysis::DataDependencyGraph::createDependencyGraph(method);
+    auto& analyses = method.getAnalyses();
+    auto dominatorTree = analyses.getDominatorTree();
+    auto loops = analyses.getLoops(false, true);
+    auto dependencyGraph = analyses.getDataDependencyGraph();
 
     std::size_t numChanges = 0;
 
@@ -1675,7 +1837,8 @@ std::size_t optimizations::prefetchTMULoads(const Module& module, Method& method
             continue;
         if(containsSynchronizationInstruction(loop))
             continue;
-        if(prefetchTMULoadsInLoop(loop, method, *dependencyGraph, *dominatorTree))
+        if(prefetchTMULoadsInLoop(
+               loop, method, *dependencyGraph, *dominatorTree, config.additionalOptions.maxPrefetchedLoads))
             ++numChanges;
     }
 
@@ -48,6 +48,9 @@ namespace vc4c
         /**
          * Tries to find TMU loads within loops where we can pre-calculate the address for loads in the next loop
          * iteration and thus we can pre-fetch the data loaded for the next loop iteration into the TMU FIFO.
+         *
+         * All TMU loads of a supported loop are pipelined this way (distributing them over both TMUs, if required), so
+         * the memory latency of the next iteration is hidden behind the calculations of the current iteration.
          */
         std::size_t prefetchTMULoads(const Module& module, Method& method, const Configuration& config);
 
@@ -21,6 +21,10 @@
 #include "Vector.h"
 #include "log.h"
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
 using namespace vc4c;
 using namespace vc4c::optimizations;
 
@@ -29,16 +33,68 @@ const std::string optimizations::PASS_CACHE_MEMORY = "cache-memory";
 const std::string optimizations::PASS_PEEPHOLE_REMOVE = "peephole-remove";
 const std::string optimizations::PASS_PEEPHOLE_COMBINE = "peephole-combine";
 
+static std::atomic_bool collectPassStatistics{false};
+static std::map<std::string, PassStatistics> passStatistics;
+static std::mutex passStatisticsLock;
+// the allocation counter of the optimization pass currently run by this thread, only set when collecting statistics
+static thread_local std::atomic<uint64_t>* currentPassAllocations = nullptr;
+
+/*
+ * Sets the allocation counter for the current thread for the lifetime of this object
+ */
+struct PassAllocationScope
+{
+    explicit PassAllocationScope(std::atomic<uint64_t>* counter) noexcept : previousCounter(currentPassAllocations)
+    {
+        currentPassAllocations = counter;
+    }
+    PassAllocationScope(const PassAllocationScope&) = delete;
+    PassAllocationScope(PassAllocationScope&&) = delete;
+    ~PassAllocationScope() noexcept
+    {
+        currentPassAllocations = previousCounter;
+    }
+
+    PassAllocationScope& operator=(const PassAllocationScope&) = delete;
+    PassAllocationScope& operator=(PassAllocationScope&&) = delete;
+
+    std::atomic<uint64_t>* previousCounter;
+};
+
 OptimizationPass::OptimizationPass(const std::string& name, const std::string& parameterName, const Pass& pass,
-    const std::string& description, OptimizationType type) :
+    const std::string& description, OptimizationType type, analysis::AnalysisType preservedAnalyses) :
+    name(name),
+    parameterName(parameterName), description(description), type(type), preservedAnalyses(preservedAnalyses),
+    pass(pass), blockPass(nullptr)
+{
+}
+
+OptimizationPass::OptimizationPass(const std::string& name, const std::string& parameterName,
+    const BlockPass& pass, const std::string& description, OptimizationType type,
+    analysis::AnalysisType preservedAnalyses) :
     name(name),
-    parameterName(parameterName), description(description), type(type), pass(pass)
+    parameterName(parameterName), description(description), type(type), preservedAnalyses(preservedAnalyses),
+    pass(nullptr), blockPass(pass)
 {
 }
 
 std::size_t OptimizationPass::operator()(const Module& module, Method& method, const Configuration& config) const
 {
-    return pass ? pass(module, method, config) : 0u;
+    if(pass)
+        return pass(module, method, config);
+    std::size_t numChanges = 0;
+    if(blockPass)
+    {
+        for(BasicBlock& block : method)
+            numChanges += blockPass(module, method, block, config);
+    }
+    return numChanges;
+}
+
+std::size_t OptimizationPass::operator()(
+    const Module& module, Method& method, BasicBlock& block, const Configuration& config) const
+{
+    return blockPass ? blockPass(module, method, block, config) : 0u;
 }
 
 OptimizationStep::OptimizationStep(const std::string& name, const Step& step) : name(name), step(step) {}
@@ -67,43 +123,50 @@ static const std::vector<OptimizationStep> SINGLE_STEPS = {
     // removes calls to SFU registers with constant input
     OptimizationStep("RewriteConstantSFU", rewriteConstantSFUCall)};
 
-static std::size_t runSingleSteps(const Module& module, Method& method, const Configuration& config)
+static std::size_t runSingleSteps(const Module& module, Method& method, BasicBlock& block, const Configuration& config)
 {
     LCOV_EXCL_START
-    logging::logLazy(logging::Level::DEBUG, [&](std::wostream& log) {
-        log << "Running steps: ";
-        for(const OptimizationStep& step : SINGLE_STEPS)
-            log << step.name << ", ";
-        log << logging::endl;
-    });
+    if(block.isStartOfMethod())
+    {
+        logging::logLazy(logging::Level::DEBUG, [&](std::wostream& log) {
+            log << "Running steps: ";
+            for(const OptimizationStep& step : SINGLE_STEPS)
+                log << step.name << ", ";
+            log << logging::endl;
+        });
+    }
     LCOV_EXCL_STOP
 
     // since an optimization-step can be run on the result of the previous step,
     // we can't just pass the resulting iterator (pointing behind the optimization result) into the next
     // optimization-step  but since lists do not reallocate elements at inserting/removing, we can re-use the previous
     // iterator
-    auto it = method.walkAllInstructions();
     // this construct with previous iterator is required, because the iterator could be invalidated (if the underlying
-    // node is removed)
-    auto prevIt = it;
+    // node is removed). The steps do not modify the label, so we start with the first instruction after it.
+    auto prevIt = block.walk();
+    auto it = prevIt.copy().nextInBlock();
     std::size_t numChanges = 0;
-    while(!it.isEndOfMethod())
+    while(!it.isEndOfBlock())
     {
         for(const OptimizationStep& step : SINGLE_STEPS)
         {
             PROFILE_START_DYNAMIC(step.name);
+            const auto* inst = it.get();
             auto newIt = step(module, method, it, config);
             // we can't just test newIt == it here, since if we replace the content of the iterator instead of deleting
             // it, the iterators are still the same, even if we emplace instructions before
-            if(newIt.copy().previousInMethod() != prevIt || newIt != it)
+            if(newIt.copy().previousInBlock() != prevIt || newIt != it)
             {
                 it = prevIt;
                 ++numChanges;
             }
+            else if(newIt.get() != inst)
+                // the instruction was replaced in-place, which also needs to be reported as change
+                ++numChanges;
             PROFILE_END_DYNAMIC_EXTREMA(step.name, method.name);
         }
-        it.nextInMethod();
-        prevIt = it.copy().previousInMethod();
+        it.nextInBlock();
+        prevIt = it.copy().previousInBlock();
     }
 
     return numChanges;
@@ -148,28 +211,376 @@ Optimizer::Optimizer(const Configuration& config) : config(config)
     }
 }
 
-static bool runPass(
-    const OptimizationPass& pass, std::size_t index, const Module& module, Method& method, const Configuration& config)
+/*
+ * Parameters and globals are only read within the method (parameters are written once from the UNIFORMs in the start
+ * segment, globals are never written), so sharing them between blocks does not make the blocks dependent. The same
+ * applies to the labels of the branch targets.
+ */
+static bool isReadOnlyInput(const Local* loc)
+{
+    if(loc->type.isLabelType())
+        return true;
+    return (loc->is<Parameter>() || loc->is<Global>()) && loc->countUsers(LocalUse::Type::WRITER) <= 1;
+}
+
+/*
+ * The locals a single basic block depends on, used as key to determine whether two blocks can be optimized in parallel
+ */
+struct BlockDependencyKey
+{
+    // the locals read or written within the block, excluding read-only inputs
+    FastSet<const Local*> accessedLocals;
+    // the locals written within the block
+    FastSet<const Local*> writtenLocals;
+    // the locals read within the block (including read-only inputs) and recursively the locals read by their writers
+    FastSet<const Local*> inspectedLocals;
+};
+
+static BlockDependencyKey createDependencyKey(const BasicBlock& block)
+{
+    BlockDependencyKey key;
+    std::vector<const Local*> openLocals;
+    auto addInspectedLocal = [&](const Local* loc, const intermediate::IntermediateInstruction&) {
+        if(key.inspectedLocals.emplace(loc).second)
+            openLocals.push_back(loc);
+    };
+    for(const auto& inst : block)
+    {
+        if(!inst)
+            continue;
+        inst->forReadLocals([&](const Local* loc, const intermediate::IntermediateInstruction& reader) {
+            if(!isReadOnlyInput(loc))
+                key.accessedLocals.emplace(loc);
+            addInspectedLocal(loc, reader);
+        });
+        inst->forWrittenLocals([&](const Local* loc, const intermediate::IntermediateInstruction& writer) {
+            key.accessedLocals.emplace(loc);
+            key.writtenLocals.emplace(loc);
+            addInspectedLocal(loc, writer);
+        });
+    }
+    while(!openLocals.empty())
+    {
+        auto loc = openLocals.back();
+        openLocals.pop_back();
+        loc->forUsers(
+            LocalUse::Type::WRITER, [&](const LocalUser* writer) { writer->forReadLocals(addInspectedLocal); });
+    }
+    return key;
+}
+
+std::vector<std::vector<BasicBlock*>> optimizations::groupIndependentBlocks(
+    Method& method, const FastSet<const BasicBlock*>* filter)
+{
+    // the waves containing a block accessing, writing or inspecting the local
+    FastMap<const Local*, std::vector<std::size_t>> accessingWaves;
+    FastMap<const Local*, std::vector<std::size_t>> writingWaves;
+    FastMap<const Local*, std::vector<std::size_t>> inspectingWaves;
+    auto addWave = [](FastMap<const Local*, std::vector<std::size_t>>& waveMap, const Local* loc, std::size_t wave) {
+        auto& waves = waveMap[loc];
+        if(std::find(waves.begin(), waves.end(), wave) == waves.end())
+            waves.push_back(wave);
+    };
+    auto markConflicts = [](const FastMap<const Local*, std::vector<std::size_t>>& waveMap,
+                             const FastSet<const Local*>& locals, std::vector<bool>& conflicts) {
+        for(auto loc : locals)
+        {
+            auto it = waveMap.find(loc);
+            if(it != waveMap.end())
+            {
+                for(auto wave : it->second)
+                    conflicts[wave] = true;
+            }
+        }
+    };
+
+    std::vector<std::vector<BasicBlock*>> waves;
+    std::vector<bool> conflictingWaves;
+    for(BasicBlock& block : method)
+    {
+        if(filter && filter->find(&block) == filter->end())
+            continue;
+        auto key = createDependencyKey(block);
+
+        // Two blocks conflict, if they both access the same (not read-only) local or if one of them writes a local
+        // inspected by the other one. Every block is greedily assigned to the first wave it does not conflict with.
+        conflictingWaves.assign(waves.size() + 1, false);
+        markConflicts(accessingWaves, key.accessedLocals, conflictingWaves);
+        markConflicts(inspectingWaves, key.writtenLocals, conflictingWaves);
+        markConflicts(writingWaves, key.inspectedLocals, conflictingWaves);
+        auto waveIt = std::find(conflictingWaves.begin(), conflictingWaves.end(), false);
+        auto wave = static_cast<std::size_t>(std::distance(conflictingWaves.begin(), waveIt));
+        if(wave == waves.size())
+            waves.emplace_back();
+        waves[wave].push_back(&block);
+
+        for(auto loc : key.accessedLocals)
+            addWave(accessingWaves, loc, wave);
+        for(auto loc : key.writtenLocals)
+            addWave(writingWaves, loc, wave);
+        for(auto loc : key.inspectedLocals)
+            addWave(inspectingWaves, loc, wave);
+    }
+    return waves;
+}
+
+/*
+ * The waves of independent basic blocks, cached for all block-local passes run in the same pass round.
+ *
+ * Block-local passes only rewrite the instructions of their block with locals already inspected by the block, so the
+ * grouping stays valid until a method-wide pass changes the method or the set of visited blocks changes.
+ */
+struct BlockWaves
+{
+    std::vector<std::vector<BasicBlock*>> waves;
+    bool isValid = false;
+};
+
+/*
+ * Tracks the basic blocks which need to be revisited by block-local optimizations in the next iteration of the
+ * repeating optimization passes.
+ *
+ * Block-local passes report the blocks they modified, method-wide passes can modify any block and therefore mark all
+ * blocks as modified. Since a modification can enable further optimizations for all other users of the locals
+ * accessed, and for all users of the locals calculated from these locals, the blocks containing these users are
+ * revisited too.
+ */
+class BlockWorklist
+{
+public:
+    /*
+     * Marks the given block as modified by a block-local pass, can be called concurrently for different blocks
+     */
+    void markModified(const BasicBlock& block)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        modifiedBlocks.emplace(&block);
+    }
+
+    /*
+     * Marks all blocks as modified, e.g. when a method-wide pass changed the method
+     */
+    void markAllModified()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        allModified = true;
+    }
+
+    /*
+     * Determines the blocks to be visited in the next iteration from the blocks modified since the last update.
+     *
+     * Returns the number of blocks to be visited in the next iteration.
+     */
+    std::size_t update(const Method& method)
+    {
+        blocks.clear();
+        if(allModified)
+        {
+            accessedLocals.clear();
+            for(const BasicBlock& block : method)
+                blocks.emplace(&block);
+        }
+        else if(!modifiedBlocks.empty())
+        {
+            FastSet<const Local*> modifiedLocals;
+            std::vector<const Local*> openLocals;
+            auto addLocal = [&](const Local* loc) {
+                if(modifiedLocals.emplace(loc).second)
+                    openLocals.push_back(loc);
+            };
+            for(auto block : modifiedBlocks)
+            {
+                blocks.emplace(block);
+                // also include the locals previously accessed, since e.g. removing a write might enable optimizations
+                // for the remaining users of the local
+                auto localsIt = accessedLocals.find(block);
+                if(localsIt != accessedLocals.end())
+                {
+                    for(auto loc : localsIt->second)
+                        addLocal(loc);
+                }
+                for(const auto& inst : *block)
+                {
+                    if(inst)
+                        inst->forUsedLocals(
+                            [&](const Local* loc, LocalUse::Type, const intermediate::IntermediateInstruction&) {
+                                addLocal(loc);
+                            });
+                }
+            }
+
+            FastMap<const LocalUser*, const BasicBlock*> instructionBlocks;
+            for(const BasicBlock& block : method)
+            {
+                for(const auto& inst : block)
+                {
+                    if(inst)
+                        instructionBlocks.emplace(inst.get(), &block);
+                }
+            }
+            while(!openLocals.empty())
+            {
+                auto loc = openLocals.back();
+                openLocals.pop_back();
+                loc->forUsers(LocalUse::Type::BOTH, [&](const LocalUser* user) {
+                    auto blockIt = instructionBlocks.find(user);
+                    if(blockIt != instructionBlocks.end())
+                        blocks.emplace(blockIt->second);
+                    // optimizations of the readers of locals calculated from the modified local may also depend on
+                    // the modification, e.g. by inspecting the writers of their inputs
+                    if(user->readsLocal(loc))
+                        user->forWrittenLocals(
+                            [&](const Local* out, const intermediate::IntermediateInstruction&) { addLocal(out); });
+                });
+            }
+        }
+
+        for(auto block : blocks)
+        {
+            auto& locals = accessedLocals[block];
+            locals.clear();
+            for(const auto& inst : *block)
+            {
+                if(inst)
+                    inst->forUsedLocals(
+                        [&](const Local* loc, LocalUse::Type, const intermediate::IntermediateInstruction&) {
+                            locals.emplace(loc);
+                        });
+            }
+        }
+        allModified = false;
+        modifiedBlocks.clear();
+        return blocks.size();
+    }
+
+    const FastSet<const BasicBlock*>& getBlocks() const
+    {
+        return blocks;
+    }
+
+private:
+    std::mutex lock;
+    // initially, all blocks need to be visited
+    bool allModified = true;
+    FastSet<const BasicBlock*> modifiedBlocks;
+    FastSet<const BasicBlock*> blocks;
+    // the locals accessed by the visited blocks, when they were last visited
+    FastMap<const BasicBlock*, FastSet<const Local*>> accessedLocals;
+};
+
+static std::size_t runBlockLocalPass(const OptimizationPass& pass, const Module& module, Method& method,
+    const Configuration& config, ThreadPool* pool, BlockWorklist* worklist, BlockWaves& blockWaves)
+{
+    const FastSet<const BasicBlock*>* filter = worklist ? &worklist->getBlocks() : nullptr;
+    auto runForBlock = [&](BasicBlock& block) -> std::size_t {
+        auto numChanges = pass(module, method, block, config);
+        if(numChanges > 0 && worklist)
+            worklist->markModified(block);
+        return numChanges;
+    };
+
+    if(!pool)
+    {
+        std::size_t numChanges = 0;
+        for(BasicBlock& block : method)
+        {
+            if(!filter || filter->find(&block) != filter->end())
+                numChanges += runForBlock(block);
+        }
+        return numChanges;
+    }
+
+    if(!blockWaves.isValid)
+    {
+        blockWaves.waves = groupIndependentBlocks(method, filter);
+        blockWaves.isValid = true;
+    }
+    const auto& waves = blockWaves.waves;
+    CPPLOG_LAZY(logging::Level::DEBUG,
+        log << "Running pass '" << pass.name << "' for " << (filter ? filter->size() : method.size())
+            << " basic blocks in " << waves.size() << " parallel waves" << logging::endl);
+
+    std::atomic_size_t numChanges{0};
+    // the allocations of the worker threads are attributed to the same pass
+    auto passAllocations = currentPassAllocations;
+    ConcurrentLocalUsersGuard guard;
+    for(const auto& wave : waves)
+    {
+        if(wave.size() == 1)
+        {
+            numChanges += runForBlock(*wave.front());
+            continue;
+        }
+        pool->scheduleAll<BasicBlock*, std::vector<BasicBlock*>>(
+            wave,
+            [&](BasicBlock* block) {
+                // the blocks are processed by other threads, which also need to allocate from the method's pool
+                tools::SlabPool::Scope poolScope(method.getPool());
+                PassAllocationScope allocationScope(passAllocations);
+                numChanges += runForBlock(*block);
+            },
+            THREAD_LOGGER.get());
+    }
+    return numChanges;
+}
+
+/*
+ * If a worklist is given, block-local passes are only run for the basic blocks contained in it and all modifications
+ * are reported to the worklist.
+ *
+ * The block waves are (re-)calculated on demand by block-local passes run in parallel and invalidated by method-wide
+ * passes changing the method.
+ */
+static bool runPass(const OptimizationPass& pass, std::size_t index, const Module& module, Method& method,
+    const Configuration& config, ThreadPool* blockPool, BlockWaves& blockWaves, BlockWorklist* worklist = nullptr)
 {
     if(!pass)
         // don't pretend we run this pass, since we do not, at least not here
         return false;
+    PROFILE_TRACE_SCOPE("optimization", pass.name, method.name);
 
     logging::logLazy(logging::Level::DEBUG, [&]() {
         logging::debug() << logging::endl;
         logging::debug() << "Running pass: " << pass.name << logging::endl;
     });
     std::size_t numChanges = 0;
+    bool withStatistics = collectPassStatistics;
+    std::atomic<uint64_t> numAllocations{0};
+    auto start = withStatistics ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
     {
+        PassAllocationScope allocationScope(withStatistics ? &numAllocations : nullptr);
         PROFILE_COUNTER_DYNAMIC(
             vc4c::profiler::COUNTER_OPTIMIZATION, pass.name + " (before)", method.countInstructions());
         PROFILE_START_DYNAMIC(pass.name);
-        numChanges = (pass) (module, method, config);
+        if((blockPool || worklist) && pass.isBlockLocal())
+            numChanges = runBlockLocalPass(pass, module, method, config, blockPool, worklist, blockWaves);
+        else
+        {
+            numChanges = (pass) (module, method, config);
+            if(numChanges > 0)
+            {
+                blockWaves.isValid = false;
+                if(worklist)
+                    worklist->markAllModified();
+            }
+        }
         PROFILE_END_DYNAMIC(pass.name);
+        if(numChanges > 0)
+            method.getAnalyses().invalidateExcept(pass.preservedAnalyses);
         PROFILE_COUNTER_DYNAMIC_WITH_PREV(
             vc4c::profiler::COUNTER_OPTIMIZATION, pass.name + " (after)", method.countInstructions());
     }
     PROFILE_COUNTER_DYNAMIC(vc4c::profiler::COUNTER_OPTIMIZATION, pass.name + " (changes)", numChanges);
+    if(withStatistics)
+    {
+        auto duration = std::chrono::steady_clock::now() - start;
+        std::lock_guard<std::mutex> guard(passStatisticsLock);
+        auto& stats = passStatistics[pass.name];
+        stats.duration += std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
+        ++stats.invocations;
+        stats.changes += numChanges;
+        stats.allocations += numAllocations;
+    }
     return numChanges > 0;
 }
 
@@ -180,15 +591,31 @@ static void runOptimizationPasses(const Module& module, Method& method, const Co
 {
     CPPLOG_LAZY(logging::Level::DEBUG, log << "-----" << logging::endl);
     CPPLOG_LAZY(logging::Level::INFO, log << "Running optimization passes for: " << method.name << logging::endl);
+    PROFILE_TRACE_SCOPE("optimization", "OptimizeMethod", method.name);
     std::size_t numInstructions = method.countInstructions();
 
+    // block-local passes are executed in parallel for independent blocks for methods with enough basic blocks
+    // the blocks are scheduled on the shared pool, which is also used to optimize the kernels in parallel
+    ThreadPool* blockPool = nullptr;
+    auto blockThreshold = config.additionalOptions.parallelBlockThreshold;
+    if(blockThreshold > 0 && method.size() >= blockThreshold && std::thread::hardware_concurrency() > 1)
+        blockPool = &ThreadPool::getSharedPool();
+
+    BlockWaves blockWaves;
     std::size_t index = 0;
     for(const OptimizationPass* pass : initialPasses)
     {
-        runPass(*pass, index, module, method, config);
+        runPass(*pass, index, module, method, config, blockPool, blockWaves);
         index += 100;
     }
 
+    // if enabled for large methods, block-local passes only revisit the blocks modified in the previous iteration (and
+    // the blocks depending on them) instead of all blocks
+    std::unique_ptr<BlockWorklist> worklist;
+    auto worklistThreshold = config.additionalOptions.worklistThreshold;
+    if(worklistThreshold > 0 && numInstructions >= worklistThreshold)
+        worklist = std::make_unique<BlockWorklist>();
+
     const OptimizationPass* lastChangingOptimization = nullptr;
     std::size_t startIndex = index;
     bool continueLoop = !repeatingPasses.empty();
@@ -199,6 +626,17 @@ static void runOptimizationPasses(const Module& module, Method& method, const Co
             log << "Running optimization iteration "
                 << (config.additionalOptions.maxOptimizationIterations - iterationsLeft) << "..." << logging::endl);
         index = startIndex;
+        // the block waves are re-calculated once per round, since the block-local passes of the previous round might
+        // have removed dependencies between blocks (or the worklist selects other blocks)
+        blockWaves.isValid = false;
+        if(worklist)
+        {
+            auto numBlocks = worklist->update(method);
+            CPPLOG_LAZY(logging::Level::DEBUG,
+                log << "Revisiting " << numBlocks << " of " << method.size() << " basic blocks" << logging::endl);
+            PROFILE_COUNTER(
+                vc4c::profiler::COUNTER_OPTIMIZATION, "Worklist blocks skipped", method.size() - numBlocks);
+        }
         for(const OptimizationPass* pass : repeatingPasses)
         {
             if(lastChangingOptimization == pass)
@@ -207,7 +645,7 @@ static void runOptimizationPasses(const Module& module, Method& method, const Co
                 continueLoop = false;
                 break;
             }
-            if(runPass(*pass, index, module, method, config))
+            if(runPass(*pass, index, module, method, config, blockPool, blockWaves, worklist.get()))
                 lastChangingOptimization = pass;
             index += 100;
         }
@@ -220,9 +658,10 @@ static void runOptimizationPasses(const Module& module, Method& method, const Co
             << " This indicates either an error in the optimizations or that there is more optimizations to be done!"
             << logging::endl;
 
+    blockWaves.isValid = false;
     for(const OptimizationPass* pass : finalPasses)
     {
-        runPass(*pass, index, module, method, config);
+        runPass(*pass, index, module, method, config, blockPool, blockWaves);
         index += 100;
     }
 
@@ -242,17 +681,24 @@ static void runOptimizationPasses(const Module& module, Method& method, const Co
     PROFILE_COUNTER(vc4c::profiler::COUNTER_OPTIMIZATION, "OptimizationIterations", numIterations);
     CPPLOG_LAZY(logging::Level::DEBUG, log << "-----" << logging::endl);
     method.dumpInstructions();
+    // not all passes report every change correctly and the following steps modify the method anyway, so drop the
+    // cached analyses to not keep possibly invalid results around
+    method.getAnalyses().invalidate();
 }
 
 void Optimizer::optimize(Module& module) const
 {
     auto kernels = module.getKernels();
-    const auto f = [&](Method* kernelFunc) {
-        runOptimizationPasses(module, *kernelFunc, config, initialPasses, repeatingPasses, finalPasses);
-    };
+    const auto f = [&](Method* kernelFunc) { optimizeMethod(module, *kernelFunc); };
     ThreadPool::scheduleAll<Method*>("Optimizer", kernels, f, THREAD_LOGGER.get());
 }
 
+void Optimizer::optimizeMethod(const Module& module, Method& method) const
+{
+    tools::SlabPool::Scope poolScope(method.getPool());
+    runOptimizationPasses(module, method, config, initialPasses, repeatingPasses, finalPasses);
+}
+
 const std::vector<OptimizationPass> Optimizer::ALL_PASSES = {
     /*
      * The first optimizations run modify the control-flow of the method.
@@ -274,11 +720,14 @@ const std::vector<OptimizationPass> Optimizer::ALL_PASSES = {
     OptimizationPass("VectorizeLoops", "vectorize-loops", vectorizeLoops, "vectorizes supported types of loops",
         OptimizationType::INITIAL),
     OptimizationPass("PrefetchLoads", "prefetch-loads", prefetchTMULoads,
-        "pre-fetches read-only memory loaded in loops", OptimizationType::INITIAL),
+        "pipelines read-only memory loaded in loops by pre-fetching the data for the next iteration",
+        OptimizationType::INITIAL),
     OptimizationPass("GroupTMUAccess", "group-memory", groupTMUAccess,
-        "merges memory accesses for adjacent memory and cache areas", OptimizationType::INITIAL),
+        "merges memory accesses for adjacent memory and cache areas", OptimizationType::INITIAL,
+        analysis::AnalysisType::CONTROL_FLOW),
     OptimizationPass("GroupLoweredRegisterAccess", "group-memory", groupLoweredRegisterAccess,
-        "merges memory accesses for adjacent memory and cache areas", OptimizationType::INITIAL),
+        "merges memory accesses for adjacent memory and cache areas", OptimizationType::INITIAL,
+        analysis::AnalysisType::CONTROL_FLOW),
     /*
      * Optimization run before this have access to the MemoryAccessInstructions and their accessed CacheEntries.
      * After this step is run, the direct hardware instructions are available instead.
@@ -286,35 +735,42 @@ const std::vector<OptimizationPass> Optimizer::ALL_PASSES = {
     OptimizationPass("LowerMemoryAccess", "lower-memory-access", lowerMemoryAccess,
         "MANDATORY: lowers the memory access instructions to actual hardware instructions", OptimizationType::INITIAL),
     OptimizationPass("GroupVPMAccess", "group-memory", groupVPMAccess,
-        "merges memory accesses for adjacent memory and cache areas", OptimizationType::INITIAL),
+        "merges memory accesses for adjacent memory and cache areas", OptimizationType::INITIAL,
+        analysis::AnalysisType::CONTROL_FLOW),
     OptimizationPass("CompactVectorFolding", "compact-vector-folding", compactVectorFolding,
-        "optimizes element-wise vector folding with binary-tree folding", OptimizationType::INITIAL),
+        "optimizes element-wise vector folding with binary-tree folding", OptimizationType::INITIAL,
+        analysis::AnalysisType::CONTROL_FLOW),
     /*
      * The second block executes optimizations only within a single basic block.
      * These optimizations may be executed in a loop until there are not more changes to the instructions
      */
     OptimizationPass("SingleSteps", "single-steps", runSingleSteps,
         "runs all the single-step optimizations. Combining them results in fewer iterations over the instructions",
-        OptimizationType::REPEAT),
+        OptimizationType::REPEAT, analysis::AnalysisType::CONTROL_FLOW),
     OptimizationPass("CombineRotations", "combine-rotations", combineVectorRotations,
         "combines duplicate vector rotations, e.g. introduced by vector-shuffle into a single rotation",
-        OptimizationType::REPEAT),
+        OptimizationType::REPEAT, analysis::AnalysisType::CONTROL_FLOW),
     OptimizationPass("EliminateMoves", "eliminate-moves", eliminateRedundantMoves,
-        "Replaces moves with the operation producing their source", OptimizationType::REPEAT),
+        "Replaces moves with the operation producing their source", OptimizationType::REPEAT,
+        analysis::AnalysisType::CONTROL_FLOW),
     OptimizationPass("EliminateBitOperations", "eliminate-bit-operations", eliminateRedundantBitOp,
-        "Rewrites redundant bit operations", OptimizationType::REPEAT),
+        "Rewrites redundant bit operations", OptimizationType::REPEAT, analysis::AnalysisType::CONTROL_FLOW),
     OptimizationPass("PropagateMoves", "copy-propagation", propagateMoves,
-        "Replaces operands with their moved-from value", OptimizationType::REPEAT),
+        "Replaces operands with their moved-from value", OptimizationType::REPEAT,
+        analysis::AnalysisType::CONTROL_FLOW),
     OptimizationPass("RemoveFlags", "remove-unused-flags", removeUselessFlags,
         "rewrites and removes all flags with constant conditions", OptimizationType::REPEAT),
     OptimizationPass("CombineConstantLoads", "combine-loads", combineLoadingConstants,
-        "combines loadings of the same constant value within a small range of a basic block", OptimizationType::REPEAT),
+        "combines loadings of the same constant value within a small range of a basic block", OptimizationType::REPEAT,
+        analysis::AnalysisType::CONTROL_FLOW),
     OptimizationPass("EliminateDeadCode", "eliminate-dead-code", eliminateDeadCode,
-        "eliminates dead code (move to same, redundant arithmetic operations, ...)", OptimizationType::REPEAT),
+        "eliminates dead code (move to same, redundant arithmetic operations, ...)", OptimizationType::REPEAT,
+        analysis::AnalysisType::CONTROL_FLOW),
     OptimizationPass("RemoveConditionalFlags", "remove-conditional-flags", removeConditionalFlags,
         "removes flags depending on simple conditionals set by previous flags", OptimizationType::REPEAT),
     OptimizationPass("CombineVectorElementCopies", "combine-vector-element-copies", combineVectorElementCopies,
-        "combines element-wise copies from and to the same vectors", OptimizationType::REPEAT),
+        "combines element-wise copies from and to the same vectors", OptimizationType::REPEAT,
+        analysis::AnalysisType::CONTROL_FLOW),
     /*
      * The third block of optimizations is executed once after all the other optimizations finished and
      * can therefore introduce instructions or constructs (e.g. combined instructions) not supported by
@@ -325,21 +781,24 @@ const std::vector<OptimizationPass> Optimizer::ALL_PASSES = {
     OptimizationPass("SplitReadAfterWrites", "split-read-write", splitReadAfterWrites,
         "splits read-after-writes (except if the local is used only very locally), so the reordering and "
         "register-allocation have an easier job",
-        OptimizationType::FINAL),
-    OptimizationPass("InstructionScheduler", "schedule-instructions", reorderInstructions,
-        "schedule instructions according to their dependencies within basic blocks (WIP, slow)",
-        OptimizationType::FINAL),
+        OptimizationType::FINAL, analysis::AnalysisType::CONTROL_FLOW),
+    OptimizationPass("InstructionScheduler", "schedule-instructions", scheduleInstructions,
+        "schedule instructions within basic blocks according to their dependencies and latencies to hide TMU, SFU and "
+        "VPM delays",
+        OptimizationType::FINAL, analysis::AnalysisType::CONTROL_FLOW),
     OptimizationPass("ReorderInstructions", "reorder", reorderWithinBasicBlocks,
-        "re-order instructions to eliminate more NOPs and stall cycles", OptimizationType::FINAL),
+        "re-order instructions to eliminate more NOPs and stall cycles", OptimizationType::FINAL,
+        analysis::AnalysisType::CONTROL_FLOW),
     OptimizationPass("CombineALUIinstructions", "combine", combineOperations,
-        "run peep-hole optimization to combine ALU-operations", OptimizationType::FINAL),
+        "run peep-hole optimization to combine ALU-operations", OptimizationType::FINAL,
+        analysis::AnalysisType::CONTROL_FLOW),
     /*
      * The following peephole-optimizations are not actually run in the main optimization code, but are run separately
      * by the code generator.
      */
-    OptimizationPass("PeepholeRemoveInstructions", PASS_PEEPHOLE_REMOVE, nullptr,
+    OptimizationPass("PeepholeRemoveInstructions", PASS_PEEPHOLE_REMOVE, OptimizationPass::Pass{nullptr},
         "runs peephole-optimization after register-mapping to remove useless instructions", OptimizationType::FINAL),
-    OptimizationPass("PeepholeCombineInstructions", PASS_PEEPHOLE_COMBINE, nullptr,
+    OptimizationPass("PeepholeCombineInstructions", PASS_PEEPHOLE_COMBINE, OptimizationPass::Pass{nullptr},
         "runs peephole-optimization after register-mapping to combine instructions", OptimizationType::FINAL),
 };
 
@@ -349,9 +808,9 @@ std::set<std::string> Optimizer::getPasses(OptimizationLevel level)
     switch(level)
     {
     case OptimizationLevel::FULL:
-        passes.emplace("schedule-instructions");
         FALL_THROUGH
     case OptimizationLevel::MEDIUM:
+        passes.emplace("schedule-instructions");
         passes.emplace("merge-blocks");
         passes.emplace("combine-rotations");
         passes.emplace("eliminate-moves");
@@ -398,3 +857,24 @@ bool Optimizer::isEnabled(const std::string& optimizationPass, const Configurati
     auto enabledPasses = getPasses(config.optimizationLevel);
     return ::isEnabled(enabledPasses, optimizationPass, config);
 }
+
+void Optimizer::setCollectPassStatistics(bool enable)
+{
+    collectPassStatistics = enable;
+}
+
+void Optimizer::recordPassAllocation() noexcept
+{
+    if(auto counter = currentPassAllocations)
+        ++*counter;
+}
+
+std::map<std::string, PassStatistics> Optimizer::getPassStatistics(bool reset)
+{
+    std::lock_guard<std::mutex> guard(passStatisticsLock);
+    if(!reset)
+        return passStatistics;
+    std::map<std::string, PassStatistics> result;
+    std::swap(result, passStatistics);
+    return result;
+}
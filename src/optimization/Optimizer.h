@@ -7,9 +7,12 @@
 #ifndef OPTIMIZER_H
 #define OPTIMIZER_H
 
+#include "../analysis/AnalysisManager.h"
 #include "../helper.h"
+#include "../performance.h"
 #include "config.h"
 
+#include <chrono>
 #include <functional>
 #include <map>
 #include <set>
@@ -20,6 +23,7 @@ namespace vc4c
     class Method;
     class Module;
     class InstructionWalker;
+    class BasicBlock;
 
     namespace optimizations
     {
@@ -57,28 +61,56 @@ namespace vc4c
         public:
             /*
              * NOTE: Optimizations can be run in parallel, so no static or global variables can be set.
-             * The optimizations are only run in parallel for different methods, so any access to the method is
-             * thread-safe
+             * The optimizations are only run in parallel for different methods (and for block-local passes also for
+             * independent basic blocks of the same method, see BlockPass), so any access to the method is thread-safe
              */
             using Pass = FunctionPointer<std::size_t(const Module&, Method&, const Configuration&)>;
+            /*
+             * A block-local pass only modifies the instructions within the given basic block and does not change the
+             * control flow of the method.
+             *
+             * NOTE: Block-local passes can be run in parallel for basic blocks of the same method which do not access
+             * any common local, so they may only access instructions of other blocks via the users of locals!
+             */
+            using BlockPass = FunctionPointer<std::size_t(const Module&, Method&, BasicBlock&, const Configuration&)>;
 
+            /*
+             * NOTE: The analyses not preserved by a pass are invalidated after every execution of the pass which
+             * returned a non-zero number of changes. Thus, a pass modifying the method needs to report a change!
+             */
             OptimizationPass(const std::string& name, const std::string& parameterName, const Pass& pass,
-                const std::string& description, OptimizationType type);
+                const std::string& description, OptimizationType type,
+                analysis::AnalysisType preservedAnalyses = analysis::AnalysisType::NONE);
+            OptimizationPass(const std::string& name, const std::string& parameterName, const BlockPass& pass,
+                const std::string& description, OptimizationType type,
+                analysis::AnalysisType preservedAnalyses = analysis::AnalysisType::NONE);
 
             std::size_t operator()(const Module& module, Method& method, const Configuration& config) const;
+            std::size_t operator()(
+                const Module& module, Method& method, BasicBlock& block, const Configuration& config) const;
 
             inline operator bool() const noexcept
             {
-                return static_cast<bool>(pass);
+                return static_cast<bool>(pass) || static_cast<bool>(blockPass);
+            }
+
+            inline bool isBlockLocal() const noexcept
+            {
+                return static_cast<bool>(blockPass);
             }
 
             const std::string name;
             const std::string parameterName;
             const std::string description;
             const OptimizationType type;
+            /*
+             * The cached analyses (see Method#getAnalyses()) which stay valid when this pass modifies the method
+             */
+            const analysis::AnalysisType preservedAnalyses;
 
         private:
             const Pass pass;
+            const BlockPass blockPass;
         };
 
         /*
@@ -89,8 +121,8 @@ namespace vc4c
         public:
             /*
              * NOTE: Optimizations can be run in parallel, so no static or global variables can be set.
-             * The optimizations are only run in parallel for different methods, so any access to the method is
-             * thread-safe
+             * The single steps are run in parallel for independent basic blocks of the same method, so the same
+             * restrictions as for OptimizationPass::BlockPass apply.
              */
             using Step =
                 FunctionPointer<InstructionWalker(const Module&, Method&, InstructionWalker, const Configuration&)>;
@@ -106,6 +138,35 @@ namespace vc4c
             const Step step;
         };
 
+        /*
+         * Accumulated run-time statistics of a single optimization pass, see Optimizer#getPassStatistics
+         */
+        struct PassStatistics
+        {
+            std::chrono::nanoseconds duration{0};
+            uint64_t invocations = 0;
+            uint64_t changes = 0;
+            /*
+             * The number of heap allocations, only collected if reported via Optimizer#recordPassAllocation
+             */
+            uint64_t allocations = 0;
+        };
+
+        /*
+         * Groups the basic blocks of the given method into waves of blocks which can be optimized in parallel by
+         * block-local passes.
+         *
+         * Block-local optimizations only modify the instructions of their block, but also inspect all other users of
+         * the locals accessed (e.g. to check whether a local is read only once) and the writers of the locals read
+         * (recursively for the locals read by these writers). Thus two blocks are dependent and never placed in the
+         * same wave, if one of them contains such a user or writer of the other one. Read-only inputs (parameters and
+         * globals) can be shared by blocks of the same wave.
+         *
+         * If a filter is given, only the blocks contained in it are grouped.
+         */
+        std::vector<std::vector<BasicBlock*>> groupIndependentBlocks(
+            Method& method, const FastSet<const BasicBlock*>* filter = nullptr);
+
         class Optimizer
         {
         public:
@@ -113,6 +174,13 @@ namespace vc4c
 
             void optimize(Module& module) const;
 
+            /*
+             * Runs the optimization passes on the given kernel only.
+             *
+             * This can be run in parallel for different kernels of the same module.
+             */
+            void optimizeMethod(const Module& module, Method& method) const;
+
             /*
              * The complete list of all optimization passes available to be used
              *
@@ -130,6 +198,27 @@ namespace vc4c
              */
             static bool isEnabled(const std::string& optimizationPass, const Configuration& config);
 
+            /*
+             * Enables or disables collecting statistics for all optimization passes run by any optimizer.
+             *
+             * In contrast to the profiler, the statistics are also available in release builds, e.g. for benchmarks.
+             */
+            static void setCollectPassStatistics(bool enable);
+
+            /*
+             * Returns the statistics of all passes run since the statistics were last reset, optionally resetting them
+             */
+            static std::map<std::string, PassStatistics> getPassStatistics(bool reset = false);
+
+            /*
+             * Attributes a heap allocation to the optimization pass currently run by the calling thread (if any) while
+             * pass statistics are collected.
+             *
+             * The compiler cannot track its own heap allocations, so this is to be called by custom global allocation
+             * functions, e.g. of benchmarks. This function does not allocate any memory.
+             */
+            static void recordPassAllocation() noexcept;
+
         private:
             Configuration config;
             std::vector<const OptimizationPass*> initialPasses;
@@ -9,6 +9,7 @@
 #include "../Module.h"
 #include "../Profiler.h"
 #include "../SIMDVector.h"
+#include "../analysis/AnalysisManager.h"
 #include "../analysis/ControlFlowGraph.h"
 #include "../analysis/ControlFlowLoop.h"
 #include "../analysis/DataDependencyGraph.h"
@@ -1582,12 +1583,12 @@ std::size_t optimizations::vectorizeLoops(const Module& module, Method& method,
         return 0u;
 
     // 1. find loops
-    auto& cfg = method.getCFG();
-    auto loops = cfg.findLoops(false);
+    auto& analyses = method.getAnalyses();
+    auto loops = analyses.getLoops(false);
     std::size_t numChanges = 0;
 
     // 2. determine data dependencies of loop bodies
-    auto dependencyGraph = DataDependencyGraph::createDependencyGraph(method);
+    auto dependencyGraph = analyses.getDataDependencyGraph();
 
     for(auto& loop : loops)
     {
@@ -7,6 +7,8 @@
 #ifndef PERFORMANCE_H
 #define PERFORMANCE_H
 
+#include "tools/SlabAllocator.h"
+
 #include <list>
 #include <map>
 #include <set>
@@ -25,9 +27,12 @@ namespace vc4c
     /*!
      * A list type which allows fast insertion/deletion and reordering of arbitrary elements in the container (e.g. by
      * simply manipulating pointers to the next/previous elements)
+     *
+     * The list nodes can be allocated from a memory pool (see tools::SlabPool) to reduce the allocation overhead and
+     * improve memory locality.
      */
     template <typename T>
-    using FastModificationList = std::list<T>;
+    using FastModificationList = std::list<T, tools::SlabAllocator<T>>;
     /*!
      * A list-type which is stored compactly in memory providing better cache behavior and little to no memory overhead
      */
@@ -36,9 +41,12 @@ namespace vc4c
     /*!
      * A list type in which the references (and pointers) to the elements are not modified (e.g. stay valid even after
      * insertions, modifications)
+     *
+     * The list nodes can be allocated from a memory pool (see tools::SlabPool) to reduce the allocation overhead and
+     * improve memory locality.
      */
     template <typename T>
-    using StableList = std::list<T>;
+    using StableList = std::list<T, tools::SlabAllocator<T>>;
 
     /*!
      * A set type where the elements are sorted according to their (natural or explicit) order
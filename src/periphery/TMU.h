@@ -130,6 +130,11 @@ namespace vc4c
         extern const TMU TMU0;
         extern const TMU TMU1;
 
+        /*
+         * The number of requests a single QPU can queue to each of the TMUs before reading any of the results
+         */
+        constexpr unsigned TMU_QUEUE_SIZE = 4;
+
         /*
          * Generates the intermediate TMU memory/cache access instructions representing the given TMU data lookup.
          */
@@ -0,0 +1,423 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "EmulationTrace.h"
+
+#include "../Register.h"
+#include "../SIMDVector.h"
+#include "../performance.h"
+#include "CompilationError.h"
+#include "log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace vc4c;
+using namespace vc4c::tools;
+
+// Marks the trace file format, needs to be changed when the layout of the records changes
+static constexpr char TRACE_MAGIC[] = "VC4CTRACE-1";
+// The size of the file header, the magic number padded to full record header size
+static constexpr std::size_t TRACE_HEADER_SIZE = 16;
+static_assert(sizeof(TRACE_MAGIC) <= TRACE_HEADER_SIZE, "Trace magic number does not fit into header");
+
+// The size of the part of the trace file mapped at once, needs to be a multiple of the page size
+static constexpr std::size_t TRACE_WINDOW_SIZE = 4 * 1024 * 1024;
+// The number of words buffered per QPU before passing them to the writer
+static constexpr std::size_t TRACE_BUFFER_WORDS = 16 * 1024;
+
+static std::string toErrorString(int error)
+{
+    return std::string(strerror(error));
+}
+
+static std::string toRegisterString(uint32_t registerCode)
+{
+    Register reg{
+        static_cast<RegisterFile>((registerCode >> 8) & 0xFF), static_cast<unsigned char>(registerCode & 0xFF)};
+    return reg.to_string(true, false);
+}
+
+std::string TraceRecord::to_string() const
+{
+    std::stringstream s;
+    s << "group " << header->group << ", QPU " << static_cast<unsigned>(header->qpu) << ", cycle " << header->cycle
+      << ", pc " << header->pc << ": ";
+    switch(header->type)
+    {
+    case TraceEventType::REGISTER_WRITE:
+    {
+        std::bitset<16> elementMask(payload[0] >> 16);
+        s << "write " << toRegisterString(payload[0] & 0xFFFF) << " =";
+        std::size_t valueIndex = 1;
+        for(std::size_t i = 0; i < elementMask.size(); ++i)
+        {
+            s << ' ';
+            if(elementMask.test(i))
+                s << "0x" << std::hex << payload[valueIndex++] << std::dec;
+            else
+                s << '-';
+        }
+        break;
+    }
+    case TraceEventType::MEMORY_READ:
+    case TraceEventType::MEMORY_WRITE:
+    {
+        s << (header->type == TraceEventType::MEMORY_READ ? "read " : "write ") << payload[1] << " bytes "
+          << (header->type == TraceEventType::MEMORY_READ ? "from" : "to") << " 0x" << std::hex << payload[0] << ":";
+        auto bytes = reinterpret_cast<const uint8_t*>(payload + 2);
+        for(uint32_t i = 0; i < payload[1]; ++i)
+            s << ' ' << std::setfill('0') << std::setw(2) << static_cast<unsigned>(bytes[i]);
+        s << std::dec;
+        break;
+    }
+    case TraceEventType::SEMAPHORE:
+        s << (payload[1] ? "acquire" : "release") << " semaphore " << payload[0] << " -> " << payload[2]
+          << (payload[3] ? " (stalled)" : "");
+        break;
+    case TraceEventType::MUTEX:
+        switch(static_cast<MutexEvent>(payload[0]))
+        {
+        case MutexEvent::LOCKED:
+            s << "lock mutex";
+            break;
+        case MutexEvent::WAITING:
+            s << "wait for mutex";
+            break;
+        case MutexEvent::UNLOCKED:
+            s << "unlock mutex";
+            break;
+        }
+        break;
+    case TraceEventType::BRANCH:
+        s << "branch " << (payload[0] ? "taken" : "not taken") << " to pc " << payload[1];
+        break;
+    case TraceEventType::FINISH:
+        s << "finished";
+        break;
+    default:
+        s << "unknown event " << static_cast<unsigned>(header->type);
+    }
+    return s.str();
+}
+
+TraceWriter::TraceWriter(const std::string& fileName) :
+    fileDescriptor(-1), window(nullptr), windowOffset(0), windowPosition(0)
+{
+    fileDescriptor = open(fileName.data(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fileDescriptor < 0)
+        throw CompilationError(
+            CompilationStep::GENERAL, "Failed to open trace file '" + fileName + "'", toErrorString(errno));
+    mapNextWindow();
+    std::memcpy(window, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    windowPosition = TRACE_HEADER_SIZE;
+}
+
+TraceWriter::~TraceWriter() noexcept
+{
+    if(window)
+        munmap(window, TRACE_WINDOW_SIZE);
+    // cut off the unused part of the last window
+    if(ftruncate(fileDescriptor, static_cast<off_t>(windowOffset + windowPosition)) != 0)
+        logging::error() << "Failed to truncate trace file: " << toErrorString(errno) << logging::endl;
+    close(fileDescriptor);
+}
+
+void TraceWriter::append(const std::vector<uint32_t>& records)
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+    auto bytes = reinterpret_cast<const uint8_t*>(records.data());
+    auto remainingBytes = records.size() * sizeof(uint32_t);
+    while(remainingBytes > 0)
+    {
+        if(windowPosition == TRACE_WINDOW_SIZE)
+            mapNextWindow();
+        auto numBytes = std::min(remainingBytes, TRACE_WINDOW_SIZE - windowPosition);
+        std::memcpy(window + windowPosition, bytes, numBytes);
+        windowPosition += numBytes;
+        bytes += numBytes;
+        remainingBytes -= numBytes;
+    }
+}
+
+void TraceWriter::mapNextWindow()
+{
+    if(window)
+    {
+        munmap(window, TRACE_WINDOW_SIZE);
+        window = nullptr;
+        windowOffset += TRACE_WINDOW_SIZE;
+    }
+    if(ftruncate(fileDescriptor, static_cast<off_t>(windowOffset + TRACE_WINDOW_SIZE)) != 0)
+        throw CompilationError(CompilationStep::GENERAL, "Failed to extend trace file", toErrorString(errno));
+    auto mapped = mmap(nullptr, TRACE_WINDOW_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor,
+        static_cast<off_t>(windowOffset));
+    if(mapped == MAP_FAILED)
+        throw CompilationError(CompilationStep::GENERAL, "Failed to map trace file", toErrorString(errno));
+    window = static_cast<uint8_t*>(mapped);
+    windowPosition = 0;
+}
+
+TraceRecorder::~TraceRecorder() noexcept
+{
+    try
+    {
+        flush();
+    }
+    catch(const std::exception& err)
+    {
+        logging::error() << "Failed to write trace records: " << err.what() << logging::endl;
+    }
+}
+
+void TraceRecorder::recordRegisterWrite(const Register& reg, const SIMDVector& value, std::bitset<16> elementMask)
+{
+    beginRecord(TraceEventType::REGISTER_WRITE, 1 + elementMask.count());
+    buffer.push_back(static_cast<uint32_t>(elementMask.to_ulong() << 16) |
+        (static_cast<uint32_t>(reg.file) << 8) | reg.num);
+    for(std::size_t i = 0; i < elementMask.size(); ++i)
+    {
+        if(elementMask.test(i))
+            buffer.push_back(value[i].unsignedInt());
+    }
+}
+
+void TraceRecorder::recordMemoryAccess(bool isWrite, uint32_t address, const void* data, uint32_t numBytes)
+{
+    auto numDataWords = numBytes / sizeof(uint32_t) + (numBytes % sizeof(uint32_t) != 0);
+    beginRecord(isWrite ? TraceEventType::MEMORY_WRITE : TraceEventType::MEMORY_READ, 2 + numDataWords);
+    buffer.push_back(address);
+    buffer.push_back(numBytes);
+    auto offset = buffer.size();
+    buffer.resize(offset + numDataWords, 0);
+    std::memcpy(&buffer[offset], data, numBytes);
+}
+
+void TraceRecorder::recordSemaphore(uint8_t semaphore, bool acquire, uint32_t value, bool stalled)
+{
+    beginRecord(TraceEventType::SEMAPHORE, 4);
+    buffer.push_back(semaphore);
+    buffer.push_back(acquire);
+    buffer.push_back(value);
+    buffer.push_back(stalled);
+}
+
+void TraceRecorder::recordMutex(MutexEvent event)
+{
+    beginRecord(TraceEventType::MUTEX, 1);
+    buffer.push_back(static_cast<uint32_t>(event));
+}
+
+void TraceRecorder::recordBranch(bool taken, uint32_t target)
+{
+    beginRecord(TraceEventType::BRANCH, 2);
+    buffer.push_back(taken);
+    buffer.push_back(target);
+}
+
+void TraceRecorder::recordFinish()
+{
+    beginRecord(TraceEventType::FINISH, 0);
+    flush();
+}
+
+void TraceRecorder::flush()
+{
+    if(buffer.empty())
+        return;
+    writer.append(buffer);
+    buffer.clear();
+}
+
+void TraceRecorder::beginRecord(TraceEventType type, std::size_t numPayloadWords)
+{
+    if(numPayloadWords > std::numeric_limits<decltype(TraceRecordHeader::numPayloadWords)>::max())
+        throw CompilationError(
+            CompilationStep::GENERAL, "Trace record payload exceeds maximum size", std::to_string(numPayloadWords));
+    if(buffer.size() >= TRACE_BUFFER_WORDS)
+        flush();
+    TraceRecordHeader header{type, qpu, static_cast<uint16_t>(numPayloadWords), group, cycle, pc};
+    auto offset = buffer.size();
+    buffer.resize(offset + sizeof(TraceRecordHeader) / sizeof(uint32_t));
+    std::memcpy(&buffer[offset], &header, sizeof(header));
+}
+
+TraceReader::TraceReader(const std::string& fileName) : data(nullptr), size(0)
+{
+    auto fileDescriptor = open(fileName.data(), O_RDONLY);
+    if(fileDescriptor < 0)
+        throw CompilationError(
+            CompilationStep::GENERAL, "Failed to open trace file '" + fileName + "'", toErrorString(errno));
+    struct stat fileInfo
+    {
+    };
+    if(fstat(fileDescriptor, &fileInfo) != 0 || static_cast<std::size_t>(fileInfo.st_size) < TRACE_HEADER_SIZE)
+    {
+        close(fileDescriptor);
+        throw CompilationError(CompilationStep::GENERAL, "Invalid trace file", fileName);
+    }
+    size = static_cast<std::size_t>(fileInfo.st_size);
+    auto mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    // the mapping stays valid after closing the file
+    close(fileDescriptor);
+    if(mapped == MAP_FAILED)
+        throw CompilationError(CompilationStep::GENERAL, "Failed to map trace file", toErrorString(errno));
+    data = static_cast<const uint8_t*>(mapped);
+    if(std::memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0)
+    {
+        munmap(const_cast<uint8_t*>(data), size);
+        throw CompilationError(CompilationStep::GENERAL, "Invalid or unsupported trace file format", fileName);
+    }
+}
+
+TraceReader::~TraceReader() noexcept
+{
+    munmap(const_cast<uint8_t*>(data), size);
+}
+
+bool TraceReader::readRecord(std::size_t& offset, TraceRecord& record) const
+{
+    offset = std::max(offset, TRACE_HEADER_SIZE);
+    if(offset + sizeof(TraceRecordHeader) > size)
+        return false;
+    record.header = reinterpret_cast<const TraceRecordHeader*>(data + offset);
+    record.payload = reinterpret_cast<const uint32_t*>(data + offset + sizeof(TraceRecordHeader));
+    auto nextOffset = offset + sizeof(TraceRecordHeader) + record.header->numPayloadWords * sizeof(uint32_t);
+    if(nextOffset > size)
+        throw CompilationError(CompilationStep::GENERAL, "Truncated trace record at offset", std::to_string(offset));
+    offset = nextOffset;
+    return true;
+}
+
+using QPUKey = std::pair<uint32_t, uint8_t>;
+
+static std::string toQPUString(const QPUKey& key)
+{
+    return "group " + std::to_string(key.first) + ", QPU " + std::to_string(static_cast<unsigned>(key.second));
+}
+
+void tools::printTrace(std::ostream& out, const TraceReader& trace, const TraceFilter& filter)
+{
+    // the register contents of all printed QPUs, only the registers written are known
+    SortedMap<QPUKey, SortedMap<uint32_t, std::array<Optional<uint32_t>, 16>>> registers;
+
+    std::size_t offset = 0;
+    TraceRecord record{};
+    while(trace.readRecord(offset, record))
+    {
+        const auto& header = *record.header;
+        if((filter.group && header.group != *filter.group) || (filter.qpu && header.qpu != *filter.qpu) ||
+            (filter.lastCycle && header.cycle > *filter.lastCycle))
+            continue;
+        out << record.to_string() << std::endl;
+        if(header.type != TraceEventType::REGISTER_WRITE)
+            continue;
+        auto& values = registers[std::make_pair(header.group, header.qpu)][record.payload[0] & 0xFFFF];
+        std::bitset<16> elementMask(record.payload[0] >> 16);
+        std::size_t valueIndex = 1;
+        for(std::size_t i = 0; i < elementMask.size(); ++i)
+        {
+            if(elementMask.test(i))
+                values[i] = record.payload[valueIndex++];
+        }
+    }
+
+    for(const auto& qpu : registers)
+    {
+        out << std::endl << "Registers of " << toQPUString(qpu.first) << ":" << std::endl;
+        for(const auto& reg : qpu.second)
+        {
+            out << '\t' << std::left << std::setw(24) << toRegisterString(reg.first) << std::right;
+            for(const auto& value : reg.second)
+            {
+                if(value)
+                    out << " 0x" << std::hex << std::setfill('0') << std::setw(8) << *value << std::dec
+                        << std::setfill(' ');
+                else
+                    out << " ----------";
+            }
+            out << std::endl;
+        }
+    }
+}
+
+/*
+ * Whether the record depends on the timing of the QPUs and therefore might differ between valid runs
+ */
+static bool isTimingDependent(const TraceRecord& record)
+{
+    if(record.header->type == TraceEventType::SEMAPHORE)
+        return record.payload[3] != 0;
+    if(record.header->type == TraceEventType::MUTEX)
+        return static_cast<MutexEvent>(record.payload[0]) == MutexEvent::WAITING;
+    return false;
+}
+
+static SortedMap<QPUKey, std::vector<TraceRecord>> groupByQPU(const TraceReader& trace)
+{
+    SortedMap<QPUKey, std::vector<TraceRecord>> records;
+    std::size_t offset = 0;
+    TraceRecord record{};
+    while(trace.readRecord(offset, record))
+    {
+        if(!isTimingDependent(record))
+            records[std::make_pair(record.header->group, record.header->qpu)].push_back(record);
+    }
+    return records;
+}
+
+static bool isSameEvent(const TraceRecord& first, const TraceRecord& second)
+{
+    return first.header->type == second.header->type && first.header->pc == second.header->pc &&
+        first.header->numPayloadWords == second.header->numPayloadWords &&
+        std::equal(first.payload, first.payload + first.header->numPayloadWords, second.payload);
+}
+
+bool tools::compareTraces(std::ostream& out, const TraceReader& first, const TraceReader& second)
+{
+    auto firstRecords = groupByQPU(first);
+    auto secondRecords = groupByQPU(second);
+
+    bool equal = true;
+    for(const auto& qpu : firstRecords)
+    {
+        auto it = secondRecords.find(qpu.first);
+        if(it == secondRecords.end())
+        {
+            out << toQPUString(qpu.first) << " is only in the first trace" << std::endl;
+            equal = false;
+            continue;
+        }
+        const auto& left = qpu.second;
+        const auto& right = it->second;
+        auto mismatch = std::mismatch(left.begin(), left.end(), right.begin(), right.end(), isSameEvent);
+        if(mismatch.first == left.end() && mismatch.second == right.end())
+            continue;
+        equal = false;
+        out << toQPUString(qpu.first) << " differs after " << (mismatch.first - left.begin()) << " records:"
+            << std::endl;
+        out << "\tfirst:  " << (mismatch.first != left.end() ? mismatch.first->to_string() : "(end of trace)")
+            << std::endl;
+        out << "\tsecond: " << (mismatch.second != right.end() ? mismatch.second->to_string() : "(end of trace)")
+            << std::endl;
+    }
+    for(const auto& qpu : secondRecords)
+    {
+        if(firstRecords.find(qpu.first) == firstRecords.end())
+        {
+            out << toQPUString(qpu.first) << " is only in the second trace" << std::endl;
+            equal = false;
+        }
+    }
+    return equal;
+}
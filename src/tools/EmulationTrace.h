@@ -0,0 +1,215 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#ifndef VC4C_TOOLS_EMULATION_TRACE_H
+#define VC4C_TOOLS_EMULATION_TRACE_H
+
+#include "../Optional.h"
+
+#include <bitset>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vc4c
+{
+    struct Register;
+    class SIMDVector;
+
+    namespace tools
+    {
+        /*
+         * The binary trace of an emulation records all observable effects of the QPUs, so a run can be inspected and
+         * compared to other runs without re-emulating it.
+         *
+         * The trace file consists of a file header followed by the records of all QPUs. Every record consists of a
+         * record header and a number of 32-bit payload words. The records of a single QPU are in execution order,
+         * the records of different QPUs may interleave in any order.
+         */
+        enum class TraceEventType : uint8_t
+        {
+            // Payload: register (file << 8 | number) and element mask (upper 16 bits), values of the written elements
+            REGISTER_WRITE,
+            // Payload: memory address, number of bytes, bytes read (padded to full words)
+            MEMORY_READ,
+            // Payload: memory address, number of bytes, bytes written (padded to full words)
+            MEMORY_WRITE,
+            // Payload: semaphore index, whether it is acquired (decremented), resulting value, whether it stalled
+            SEMAPHORE,
+            // Payload: the MutexEvent
+            MUTEX,
+            // Payload: whether the branch is taken, the branch target
+            BRANCH,
+            // The QPU finished execution, no payload
+            FINISH
+        };
+
+        enum class MutexEvent : uint32_t
+        {
+            LOCKED,
+            // the mutex is locked by another QPU
+            WAITING,
+            UNLOCKED
+        };
+
+        struct TraceRecordHeader
+        {
+            TraceEventType type;
+            uint8_t qpu;
+            uint16_t numPayloadWords;
+            // the index of the work-group for host-side work-group dispatch, otherwise zero
+            uint32_t group;
+            // the local cycle (or step for the functional emulation) of the QPU
+            uint32_t cycle;
+            // the index of the instruction producing this record
+            uint32_t pc;
+        };
+        static_assert(sizeof(TraceRecordHeader) == 4 * sizeof(uint32_t), "Trace record header is not packed");
+
+        struct TraceRecord
+        {
+            const TraceRecordHeader* header;
+            const uint32_t* payload;
+
+            std::string to_string() const;
+        };
+
+        /*
+         * Writes the records of all QPUs into a memory-mapped trace file.
+         *
+         * The file is mapped in fixed-size windows which are appended to the file when full, so the trace is streamed
+         * to disk instead of being kept in memory.
+         */
+        class TraceWriter
+        {
+        public:
+            explicit TraceWriter(const std::string& fileName);
+            TraceWriter(const TraceWriter&) = delete;
+            TraceWriter(TraceWriter&&) noexcept = delete;
+            ~TraceWriter() noexcept;
+
+            TraceWriter& operator=(const TraceWriter&) = delete;
+            TraceWriter& operator=(TraceWriter&&) noexcept = delete;
+
+            /*
+             * Appends the given complete records to the trace, can be called from multiple threads at once
+             */
+            void append(const std::vector<uint32_t>& records);
+
+        private:
+            std::mutex writeLock;
+            int fileDescriptor;
+            uint8_t* window;
+            // the file offset of the currently mapped window
+            std::size_t windowOffset;
+            // the number of bytes already written into the current window
+            std::size_t windowPosition;
+
+            void mapNextWindow();
+        };
+
+        /*
+         * Collects the records of a single QPU and passes them in batches to the trace writer.
+         *
+         * NOTE: This type is not thread-safe, every QPU has its own recorder.
+         */
+        class TraceRecorder
+        {
+        public:
+            TraceRecorder(TraceWriter& writer, uint32_t group, uint8_t qpu) : writer(writer), group(group), qpu(qpu)
+            {
+            }
+            TraceRecorder(const TraceRecorder&) = delete;
+            TraceRecorder(TraceRecorder&&) noexcept = delete;
+            ~TraceRecorder() noexcept;
+
+            TraceRecorder& operator=(const TraceRecorder&) = delete;
+            TraceRecorder& operator=(TraceRecorder&&) noexcept = delete;
+
+            /*
+             * Sets the cycle and instruction all following records are associated with
+             */
+            inline void setPosition(uint32_t currentCycle, uint32_t currentPC) noexcept
+            {
+                cycle = currentCycle;
+                pc = currentPC;
+            }
+
+            void recordRegisterWrite(const Register& reg, const SIMDVector& value, std::bitset<16> elementMask);
+            void recordMemoryAccess(bool isWrite, uint32_t address, const void* data, uint32_t numBytes);
+            void recordSemaphore(uint8_t semaphore, bool acquire, uint32_t value, bool stalled);
+            void recordMutex(MutexEvent event);
+            void recordBranch(bool taken, uint32_t target);
+            void recordFinish();
+
+            void flush();
+
+        private:
+            TraceWriter& writer;
+            const uint32_t group;
+            const uint8_t qpu;
+            uint32_t cycle = 0;
+            uint32_t pc = 0;
+            std::vector<uint32_t> buffer;
+
+            void beginRecord(TraceEventType type, std::size_t numPayloadWords);
+        };
+
+        /*
+         * Read-only memory-mapped view of a trace file
+         */
+        class TraceReader
+        {
+        public:
+            explicit TraceReader(const std::string& fileName);
+            TraceReader(const TraceReader&) = delete;
+            TraceReader(TraceReader&&) noexcept = delete;
+            ~TraceReader() noexcept;
+
+            TraceReader& operator=(const TraceReader&) = delete;
+            TraceReader& operator=(TraceReader&&) noexcept = delete;
+
+            /*
+             * Reads the record at the given byte offset and advances the offset to the next record.
+             *
+             * Returns false if the end of the trace is reached. To read the first record, start at offset zero.
+             */
+            bool readRecord(std::size_t& offset, TraceRecord& record) const;
+
+        private:
+            const uint8_t* data;
+            std::size_t size;
+        };
+
+        struct TraceFilter
+        {
+            Optional<uint32_t> group;
+            Optional<uint8_t> qpu;
+            // only records of cycles up to (and including) this cycle are printed
+            Optional<uint32_t> lastCycle;
+        };
+
+        /*
+         * Prints all records matching the filter followed by the register contents of the matching QPUs, as
+         * reconstructed from the printed register writes
+         */
+        void printTrace(std::ostream& out, const TraceReader& trace, const TraceFilter& filter);
+
+        /*
+         * Compares the records of every QPU of both traces and prints the first differing record of every QPU.
+         *
+         * Since the number of stalls might differ between runs, the cycles as well as the stalled semaphore and mutex
+         * accesses are not compared.
+         *
+         * Returns whether the traces are equal.
+         */
+        bool compareTraces(std::ostream& out, const TraceReader& first, const TraceReader& second);
+    } // namespace tools
+} // namespace vc4c
+
+#endif /* VC4C_TOOLS_EMULATION_TRACE_H */
@@ -8,6 +8,7 @@
 
 #include "../GlobalValues.h"
 #include "../Profiler.h"
+#include "../ThreadPool.h"
 #include "../asm/ALUInstruction.h"
 #include "../asm/BranchInstruction.h"
 #include "../asm/Instruction.h"
@@ -21,20 +22,23 @@
 
 #include "log.h"
 
+#include <chrono>
 #include <cmath>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <iomanip>
+#include <iterator>
 #include <memory>
 #include <numeric>
 #include <random>
+#include <set>
 #include <sstream>
+#include <thread>
 
 using namespace vc4c;
 using namespace vc4c::tools;
 
-static std::mutex instrumentationLock;
-
 static constexpr MemoryAddress INSTRUCTION_BASE_ADDRESS{0x10000000};
 
 extern void extractBinary(const CompilationData& binary, ModuleHeader& module, StableList<Global>& globals,
@@ -89,6 +93,13 @@ class vc4c::tools::EmulationClock
 {
 public:
     uint32_t currentCycle = 0;
+    /*
+     * Whether to run the functional (not cycle-accurate) emulation.
+     *
+     * In functional mode, memory accesses complete immediately and no caches are modeled. Also every QPU runs until it
+     * blocks and tracks its own cycles instead of advancing in lock-step with the other QPUs.
+     */
+    bool functional = false;
 
     template <typename Func>
     void schedule(std::string&& name, Func&& func)
@@ -188,34 +199,61 @@ static std::string toDataString(const Container& container)
     return ss.str();
 }
 
-tools::Word* Memory::getWordAddress(MemoryAddress address)
+Memory::PageTable::PageTable(const MappedBuffers& mappedBuffers) : directory(1u << DIRECTORY_BITS)
 {
-    if(auto direct = VariantNamespace::get_if<DirectBuffer>(&data))
+    buffers.reserve(mappedBuffers.size());
+    for(const auto& buffer : mappedBuffers)
+        buffers.push_back(Buffer{buffer.first, static_cast<uint64_t>(buffer.first) + buffer.second.get().size(),
+            buffer.second.get().data()});
+
+    // Map the pages in reverse order, so for pages shared by multiple buffers, the first buffer is mapped
+    for(std::size_t i = buffers.size(); i > 0; --i)
     {
-        if(address >= direct->size() * sizeof(Word))
+        const auto& buffer = buffers[i - 1];
+        if(buffer.end == buffer.start)
+            continue;
+        auto lastPage = std::min((buffer.end - 1), uint64_t{0xFFFFFFFF}) >> PAGE_OFFSET_BITS;
+        for(uint64_t page = buffer.start >> PAGE_OFFSET_BITS; page <= lastPage; ++page)
         {
-            logging::warn() << "Buffer: [" << toAddressString(0) << ", "
-                            << toAddressString(direct->size() * sizeof(Word)) << ")" << logging::endl;
-            throw CompilationError(CompilationStep::GENERAL,
-                "Memory address is out of bounds, consider using larger buffer", toAddressString(address));
+            auto& table = directory[page >> PAGE_INDEX_BITS];
+            if(!table)
+                table.reset(new PageTableEntries{});
+            (*table)[page & ((1u << PAGE_INDEX_BITS) - 1u)] = static_cast<uint32_t>(i);
         }
-        return direct->data() + (address / sizeof(Word));
     }
-    auto& buffers = VariantNamespace::get<MappedBuffers>(data);
-    for(const auto& buf : buffers)
+}
+
+const Memory::PageTable::Buffer* Memory::PageTable::findBuffer(MemoryAddress address, std::size_t numBytes) const
+    noexcept
+{
+    const auto& table = directory[address >> (PAGE_INDEX_BITS + PAGE_OFFSET_BITS)];
+    if(!table)
+        return nullptr;
+    auto index = (*table)[(address >> PAGE_OFFSET_BITS) & ((1u << PAGE_INDEX_BITS) - 1u)];
+    if(index == 0)
+        return nullptr;
+    // A page might be shared by multiple buffers (if they are not page-aligned), all of which are sorted by their start
+    // address, so we only need to check the buffers following the first one mapped to the page
+    for(auto i = index - 1; i < buffers.size() && buffers[i].start <= address; ++i)
     {
-        if(buf.first <= address && (buf.first + buf.second.get().size()) > address)
-        {
-            auto wordBoundsAddress = (address / sizeof(Word)) * sizeof(Word);
-            return reinterpret_cast<Word*>(buf.second.get().data() + wordBoundsAddress - buf.first);
-        }
+        if(static_cast<uint64_t>(address) + numBytes <= buffers[i].end)
+            return &buffers[i];
     }
+    return nullptr;
+}
+
+void Memory::logMappedBuffers() const
+{
     logging::logLazy(logging::Level::WARNING, [&]() {
-        for(const auto& buffer : buffers)
-            logging::warn() << "Buffer: [" << toAddressString(buffer.first) << ", "
-                            << toAddressString(buffer.first + buffer.second.get().size()) << ")" << logging::endl;
+        for(const auto& buffer : VariantNamespace::get<PageTable>(data).getBuffers())
+            logging::warn() << "Buffer: [" << toAddressString(buffer.start) << ", " << toAddressString(buffer.end)
+                            << ")" << logging::endl;
     });
-    throw CompilationError(CompilationStep::GENERAL, "Address is not part of any buffer", toAddressString(address));
+}
+
+tools::Word* Memory::getWordAddress(MemoryAddress address)
+{
+    return const_cast<Word*>(static_cast<const Memory*>(this)->getWordAddress(address));
 }
 
 const tools::Word* Memory::getWordAddress(MemoryAddress address) const
@@ -231,20 +269,12 @@ const tools::Word* Memory::getWordAddress(MemoryAddress address) const
         }
         return direct->data() + (address / sizeof(Word));
     }
-    auto& buffers = VariantNamespace::get<MappedBuffers>(data);
-    for(const auto& buf : buffers)
+    if(auto buffer = VariantNamespace::get<PageTable>(data).findBuffer(address, 1))
     {
-        if(buf.first <= address && (buf.first + buf.second.get().size()) > address)
-        {
-            auto wordBoundsAddress = (address / sizeof(Word)) * sizeof(Word);
-            return reinterpret_cast<const Word*>(buf.second.get().data() + wordBoundsAddress - buf.first);
-        }
+        auto wordBoundsAddress = (address / sizeof(Word)) * sizeof(Word);
+        return reinterpret_cast<const Word*>(buffer->data + wordBoundsAddress - buffer->start);
     }
-    logging::logLazy(logging::Level::WARNING, [&]() {
-        for(const auto& buffer : buffers)
-            logging::warn() << "Buffer: [" << toAddressString(buffer.first) << ", "
-                            << toAddressString(buffer.first + buffer.second.get().size()) << ")" << logging::endl;
-    });
+    logMappedBuffers();
     throw CompilationError(CompilationStep::GENERAL, "Address is not part of any buffer", toAddressString(address));
 }
 
@@ -257,9 +287,20 @@ tools::Word Memory::readWord(MemoryAddress address) const
                 << toAddressString(address) << logging::endl);
     address = static_cast<MemoryAddress>((address / sizeof(Word)) * sizeof(Word));
     assertAddressInMemory(address, sizeof(Word));
+    auto guard = lockForReading();
     return *getWordAddress(address);
 }
 
+std::shared_lock<std::shared_timed_mutex> Memory::lockForReading() const
+{
+    return std::shared_lock<std::shared_timed_mutex>(accessLock);
+}
+
+std::unique_lock<std::shared_timed_mutex> Memory::lockForWriting()
+{
+    return std::unique_lock<std::shared_timed_mutex>(accessLock);
+}
+
 MemoryAddress Memory::incrementAddress(MemoryAddress address, DataType typeSize) const
 {
     return address + typeSize.getInMemoryWidth();
@@ -269,8 +310,7 @@ MemoryAddress Memory::getMaximumAddress() const
 {
     if(auto direct = VariantNamespace::get_if<DirectBuffer>(&data))
         return static_cast<MemoryAddress>(direct->size() * sizeof(Word));
-    return VariantNamespace::get<MappedBuffers>(data).rbegin()->first +
-        static_cast<Word>(VariantNamespace::get<MappedBuffers>(data).rbegin()->second.get().size());
+    return static_cast<MemoryAddress>(VariantNamespace::get<PageTable>(data).getBuffers().back().end);
 }
 
 void Memory::assertAddressInMemory(MemoryAddress address, std::size_t numBytes) const
@@ -287,18 +327,10 @@ void Memory::assertAddressInMemory(MemoryAddress address, std::size_t numBytes)
         }
         return;
     }
-    auto& buffers = VariantNamespace::get<MappedBuffers>(data);
-    for(auto& buffer : buffers)
-    {
-        if(buffer.first <= address && (buffer.first + buffer.second.get().size()) >= (address + numBytes))
-            // the address fits into this buffer
-            return;
-    }
-    logging::logLazy(logging::Level::WARNING, [&]() {
-        for(const auto& buffer : buffers)
-            logging::warn() << "Buffer: [" << toAddressString(buffer.first) << ", "
-                            << toAddressString(buffer.first + buffer.second.get().size()) << ")" << logging::endl;
-    });
+    if(VariantNamespace::get<PageTable>(data).findBuffer(address, numBytes))
+        // the address fits into this buffer
+        return;
+    logMappedBuffers();
     throw CompilationError(CompilationStep::GENERAL, "Address is not part of any buffer",
         "(" + toAddressString(address) + ", " + std::to_string(numBytes) + ")");
 }
@@ -310,11 +342,41 @@ void Memory::setUniforms(const std::vector<Word>& uniforms, MemoryAddress addres
         VariantNamespace::get<DirectBuffer>(data).begin() + static_cast<std::vector<Word>::difference_type>(offset));
 }
 
+std::vector<tools::Word> Memory::releaseStorage()
+{
+    auto storage = std::move(VariantNamespace::get<DirectBuffer>(data));
+    VariantNamespace::get<DirectBuffer>(data).clear();
+    return storage;
+}
+
 bool Mutex::isLocked() const
 {
     return lockedOwner != NO_OWNER;
 }
 
+void SharedMutexLock::lock()
+{
+    std::unique_lock<std::mutex> guard(mutex);
+    released.wait(guard, [this]() -> bool { return !locked; });
+    locked = true;
+}
+
+void SharedMutexLock::unlock()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        locked = false;
+    }
+    released.notify_one();
+}
+
+Mutex::~Mutex() noexcept
+{
+    // don't block the other work-groups if the emulation was aborted (or the kernel did not unlock the mutex)
+    if(groupLock && isLocked())
+        groupLock->unlock();
+}
+
 bool Mutex::lock(uint8_t qpu)
 {
     uint8_t currentOwner = NO_OWNER;
@@ -327,6 +389,14 @@ bool Mutex::lock(uint8_t qpu)
         PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "waitOnMutex", 1);
         return false;
     }
+    if(groupLock)
+    {
+        // The hardware mutex is shared with the QPUs of the concurrently emulated work-groups, which cannot make any
+        // progress while one of our QPUs holds the mutex anyway, so we can simply block them. Since the group lock is
+        // only acquired after locking the mutex of this group, the QPUs of this group never wait on each other here.
+        PROFILE_SCOPE(WaitForSharedMutex);
+        groupLock->lock();
+    }
     PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "lockMutex", 1);
     return true;
 }
@@ -341,6 +411,8 @@ void Mutex::unlock(uint8_t qpu)
         throw CompilationError(CompilationStep::GENERAL, "Cannot free mutex locked by another QPU",
             std::to_string(static_cast<unsigned>(currentOwner)));
     }
+    if(groupLock)
+        groupLock->unlock();
 }
 
 LCOV_EXCL_START
@@ -364,6 +436,8 @@ void Registers::writeRegister(Register reg, const SIMDVector& val, std::bitset<1
     CPPLOG_LAZY(logging::Level::DEBUG,
         log << "Writing into register '" << reg.to_string(true, false)
             << "': " << toRegisterWriteString(val, elementMask) << logging::endl);
+    if(qpu.trace && reg.num != REG_NOP.num)
+        qpu.trace->recordRegisterWrite(reg, val, elementMask);
     if(reg.isGeneralPurpose())
         writeStorageRegister(reg, SIMDVector(val), elementMask, bitMask);
     else if(reg.isAccumulator())
@@ -396,11 +470,15 @@ void Registers::writeRegister(Register reg, const SIMDVector& val, std::bitset<1
     else if(reg == REG_VPM_OUT_SETUP)
         qpu.vpm.setWriteSetup(val);
     else if(reg == REG_VPM_DMA_LOAD_ADDR)
-        qpu.vpm.setDMAReadAddress(val);
+        qpu.vpm.setDMAReadAddress(val, qpu.trace.get());
     else if(reg == REG_VPM_DMA_STORE_ADDR)
-        qpu.vpm.setDMAWriteAddress(val);
+        qpu.vpm.setDMAWriteAddress(val, qpu.trace.get());
     else if(reg.num == REG_MUTEX.num)
+    {
         qpu.mutex.unlock(qpu.ID);
+        if(qpu.trace)
+            qpu.trace->recordMutex(MutexEvent::UNLOCKED);
+    }
     else if(reg.num == REG_SFU_RECIP.num)
         qpu.sfu.startRecip(val, qpu.lastR4Value);
     else if(reg.num == REG_SFU_RECIP_SQRT.num)
@@ -436,8 +514,9 @@ void Registers::writeRegister(Register reg, const SIMDVector& val, std::bitset<1
 
 static SIMDVector generateRandomVector()
 {
-    static std::default_random_engine generator;
-    static std::uniform_real_distribution<float> distribution;
+    // thread-local, since the QPUs might be emulated on different threads
+    thread_local std::default_random_engine generator;
+    thread_local std::uniform_real_distribution<float> distribution;
 
     return SIMDVector({Literal(distribution(generator)), Literal(distribution(generator)),
         Literal(distribution(generator)), Literal(distribution(generator)), Literal(distribution(generator)),
@@ -459,15 +538,15 @@ std::pair<SIMDVector, bool> Registers::readRegister(Register reg, bool anyElemen
         return std::make_pair(qpu.lastR4Value, true);
     case REG_UNIFORM.num:
     {
-        auto it = readCache.find(REG_UNIFORM);
-        if(it == readCache.end())
+        auto cached = getReadCache(REG_UNIFORM);
+        if(!cached)
         {
             auto res = qpu.uniforms.readUniform();
             if(!res.second)
                 return std::make_pair(SIMDVector{}, false);
-            it = setReadCache(REG_UNIFORM, res.first);
+            cached = &setReadCache(REG_UNIFORM, res.first);
         }
-        return std::make_pair(it->second, true);
+        return std::make_pair(*cached, true);
     }
     case REG_VARYING.num:
     {
@@ -505,10 +584,10 @@ std::pair<SIMDVector, bool> Registers::readRegister(Register reg, bool anyElemen
         return std::make_pair(readStorageRegister(reg, anyElementUsed), true);
     case REG_VPM_IO.num:
     {
-        auto it = readCache.find(REG_VPM_IO);
-        if(it == readCache.end())
-            it = setReadCache(REG_VPM_IO, qpu.vpm.readValue());
-        return std::make_pair(it->second, true);
+        auto cached = getReadCache(REG_VPM_IO);
+        if(!cached)
+            cached = &setReadCache(REG_VPM_IO, qpu.vpm.readValue());
+        return std::make_pair(*cached, true);
     }
     case REG_VPM_DMA_LOAD_WAIT.num:
         if(reg == REG_VPM_DMA_LOAD_WAIT)
@@ -519,11 +598,15 @@ std::pair<SIMDVector, bool> Registers::readRegister(Register reg, bool anyElemen
         break;
     case REG_MUTEX.num:
     {
-        auto it = readCache.find(REG_MUTEX);
-        if(it == readCache.end())
-            it = setReadCache(
-                REG_MUTEX, qpu.mutex.lock(qpu.ID) ? SIMDVector(Literal(true)) : SIMDVector(Literal(false)));
-        return std::make_pair(it->second, it->second[0].isTrue());
+        auto cached = getReadCache(REG_MUTEX);
+        if(!cached)
+        {
+            bool locked = qpu.mutex.lock(qpu.ID);
+            if(qpu.trace)
+                qpu.trace->recordMutex(locked ? MutexEvent::LOCKED : MutexEvent::WAITING);
+            cached = &setReadCache(REG_MUTEX, locked ? SIMDVector(Literal(true)) : SIMDVector(Literal(false)));
+        }
+        return std::make_pair(*cached, (*cached)[0].isTrue());
     }
     }
     throw CompilationError(CompilationStep::GENERAL, "Read of invalid register", reg.to_string());
@@ -536,9 +619,15 @@ SIMDVector Registers::getInterruptValue() const
     throw CompilationError(CompilationStep::GENERAL, "Host interrupt was not triggered!");
 }
 
-void Registers::clearReadCache()
+void Registers::clearReadCache() noexcept
 {
-    readCache.clear();
+    if(++readCacheGeneration == 0)
+    {
+        // on overflow, the entries need to be reset once, since they might still be stamped with any generation
+        for(auto& entry : readCache)
+            entry.second = 0;
+        readCacheGeneration = 1;
+    }
 }
 
 static constexpr uint8_t toIndex(Register reg) noexcept
@@ -629,13 +718,18 @@ void Registers::writeStorageRegister(Register reg, SIMDVector&& val, std::bitset
     }
 }
 
-SortedMap<Register, SIMDVector>::iterator Registers::setReadCache(Register reg, const SIMDVector& val)
+const SIMDVector* Registers::getReadCache(Register reg) const noexcept
+{
+    const auto& entry = readCache[reg.num % readCache.size()];
+    return entry.second == readCacheGeneration ? &entry.first : nullptr;
+}
+
+const SIMDVector& Registers::setReadCache(Register reg, const SIMDVector& val)
 {
-    auto it = readCache.find(reg);
-    if(it == readCache.end())
-        return readCache.emplace(reg, val).first;
-    it->second = val;
-    return it;
+    auto& entry = readCache[reg.num % readCache.size()];
+    entry.first = val;
+    entry.second = readCacheGeneration;
+    return entry.first;
 }
 
 std::pair<SIMDVector, bool> UniformFifo::readUniform()
@@ -644,6 +738,15 @@ std::pair<SIMDVector, bool> UniformFifo::readUniform()
         // see Broadcom specification, page 22
         throw CompilationError(CompilationStep::GENERAL, "Reading UNIFORM within 2 cycles of last UNIFORM reset!");
 
+    if(clock.functional)
+    {
+        SIMDVector val(Literal(slice.readMemoryWord(uniformAddress)));
+        uniformAddress = static_cast<MemoryAddress>(uniformAddress + sizeof(Word));
+        CPPLOG_LAZY(logging::Level::DEBUG, log << "Reading UNIFORM value: " << val.to_string(true) << logging::endl);
+        PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "UNIFORM read", 1);
+        return std::make_pair(std::move(val), true);
+    }
+
     auto data = extractValue(fifo.front());
     if(!data.second)
     {
@@ -678,6 +781,9 @@ void UniformFifo::setUniformAddress(const SIMDVector& val)
 
 void UniformFifo::triggerFifoFill()
 {
+    if(clock.functional)
+        // UNIFORMs are read directly from memory
+        return;
     while(fifo.size() < 2)
     {
         // initial load of UNIFORM values
@@ -703,6 +809,14 @@ void TMUs::setTMURegisterS(uint8_t tmu, const SIMDVector& val)
     checkTMUWriteCycle();
 
     tmu = toRealTMU(tmu);
+    if(clock.functional)
+    {
+        auto& valueQueue = tmu == 1 ? tmu1Values : tmu0Values;
+        if(valueQueue.size() >= 8)
+            throw CompilationError(CompilationStep::GENERAL, "TMU request queue is full!");
+        valueQueue.emplace(readMemoryAddressDirectly(val));
+        return;
+    }
     auto& requestQueue = tmu == 1 ? tmu1Queue : tmu0Queue;
 
     if(requestQueue.size() >= 8)
@@ -732,6 +846,18 @@ bool TMUs::triggerTMURead(uint8_t tmu, SIMDVector& r4Register)
 {
     tmu = toRealTMU(tmu);
 
+    if(clock.functional)
+    {
+        auto& valueQueue = tmu == 1 ? tmu1Values : tmu0Values;
+        if(valueQueue.empty())
+            throw CompilationError(CompilationStep::GENERAL, "No data in TMU request queue to be read!");
+        r4Register = std::move(valueQueue.front());
+        valueQueue.pop();
+        CPPLOG_LAZY(
+            logging::Level::DEBUG, log << "Reading from TMU into r4: " << r4Register.to_string(true) << logging::endl);
+        return true;
+    }
+
     auto& requestQueue = tmu == 1 ? tmu1Queue : tmu0Queue;
 
     if(requestQueue.empty())
@@ -761,7 +887,7 @@ bool TMUs::triggerTMURead(uint8_t tmu, SIMDVector& r4Register)
 void TMUs::checkTMUWriteCycle() const
 {
     // Broadcom specification, page 37
-    if(lastTMUNoSwap + 3 > qpu.getCurrentCycle())
+    if(lastTMUNoSwap != 0 && lastTMUNoSwap + 3 > qpu.getCurrentCycle())
         throw CompilationError(CompilationStep::GENERAL, "Writing to TMU within 3 cycles of last TMU no-swap change!");
 }
 
@@ -817,6 +943,22 @@ std::future<SIMDVector> TMUs::readMemoryAddress(uint8_t tmu, const SIMDVector& a
     return future;
 }
 
+SIMDVector TMUs::readMemoryAddressDirectly(const SIMDVector& address) const
+{
+    SIMDVector res;
+    for(uint8_t i = 0; i < NATIVE_VECTOR_SIZE; ++i)
+    {
+        if(address[i].isUndefined())
+            throw CompilationError(
+                CompilationStep::GENERAL, "Cannot read from undefined TMU address", address.to_string());
+        res[i] = Literal(slice.readMemoryWord(address[i].toImmediate()));
+    }
+    CPPLOG_LAZY(logging::Level::DEBUG,
+        log << "Reading via TMU from memory address " << address.to_string(true) << ": " << res.to_string(true)
+            << logging::endl);
+    return res;
+}
+
 uint8_t TMUs::toRealTMU(uint8_t tmu) const
 {
     bool upperHalf = (qpu.ID % 4) >= 2;
@@ -857,6 +999,12 @@ void SFU::startLog2(const SIMDVector& val, SIMDVector& r4Register)
 
 void SFU::startOperation(SIMDVector&& result, SIMDVector& r4Register)
 {
+    if(clock.functional)
+    {
+        // valid code does not read r4 within the 2 instructions the calculation takes on the hardware
+        r4Register = std::move(result);
+        return;
+    }
     clock.schedule("SFU calculation",
         [remainingCycles{2}, &r4Register, output{std::move(result)}](uint32_t currentCycle) mutable -> bool {
             if(remainingCycles > 0)
@@ -1075,7 +1223,7 @@ void VPM::setReadSetup(const SIMDVector& val)
     CPPLOG_LAZY(logging::Level::DEBUG, log << "Set VPM read setup: " << setup.to_string() << logging::endl);
 }
 
-void VPM::setDMAWriteAddress(const SIMDVector& val)
+void VPM::setDMAWriteAddress(const SIMDVector& val, TraceRecorder* trace)
 {
     auto element0 = val[0];
     if(element0.isUndefined())
@@ -1116,6 +1264,7 @@ void VPM::setDMAWriteAddress(const SIMDVector& val)
         throw CompilationError(CompilationStep::GENERAL, "VPM row address is out of range: ",
             std::to_string(vpmBaseAddress.first) + " + " + std::to_string(sizes.first));
 
+    auto memoryGuard = memory.lockForWriting();
     if(setup.dmaSetup.getHorizontal())
     {
         for(uint32_t i = 0; i < sizes.first; ++i)
@@ -1124,6 +1273,10 @@ void VPM::setDMAWriteAddress(const SIMDVector& val)
             memcpy(reinterpret_cast<uint8_t*>(memory.getWordAddress(address)) + address % sizeof(Word),
                 reinterpret_cast<uint8_t*>(&cache.at(vpmBaseAddress.first).at(vpmBaseAddress.second)) + byteOffset,
                 typeSize * sizes.second);
+            if(trace)
+                trace->recordMemoryAccess(true, address,
+                    reinterpret_cast<uint8_t*>(memory.getWordAddress(address)) + address % sizeof(Word),
+                    typeSize * sizes.second);
             logging::debug() << "\tVPM row: " << toDataString(cache.at(vpmBaseAddress.first)) << logging::endl;
             vpmBaseAddress.first += 1;
             // write stride is end-to-start, so add size of vector
@@ -1141,6 +1294,9 @@ void VPM::setDMAWriteAddress(const SIMDVector& val)
                     reinterpret_cast<uint8_t*>(&cache.at(vpmBaseAddress.first + k).at(vpmBaseAddress.second + i)) +
                         byteOffset,
                     typeSize);
+                if(trace)
+                    trace->recordMemoryAccess(true, address,
+                        reinterpret_cast<uint8_t*>(memory.getWordAddress(address)) + address % sizeof(Word), typeSize);
                 address += typeSize;
             }
             address += stride;
@@ -1156,7 +1312,7 @@ void VPM::setDMAWriteAddress(const SIMDVector& val)
     PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "write DMA write address", 1);
 }
 
-void VPM::setDMAReadAddress(const SIMDVector& val)
+void VPM::setDMAReadAddress(const SIMDVector& val, TraceRecorder* trace)
 {
     auto element0 = val[0];
     if(element0.isUndefined())
@@ -1202,6 +1358,7 @@ void VPM::setDMAReadAddress(const SIMDVector& val)
         throw CompilationError(
             CompilationStep::GENERAL, "VPM row address is out of range: ", std::to_string(vpmBaseAddress.first));
 
+    auto memoryGuard = memory.lockForReading();
     if(setup.dmaSetup.getVertical())
     {
         for(uint32_t i = 0; i < sizes.second; ++i)
@@ -1212,6 +1369,9 @@ void VPM::setDMAReadAddress(const SIMDVector& val)
                 memcpy(reinterpret_cast<uint8_t*>(&cache.at(vpmBaseAddress.first + k).at(vpmBaseAddress.second + i)) +
                         byteOffset,
                     reinterpret_cast<uint8_t*>(memory.getWordAddress(address)) + address % sizeof(Word), typeSize);
+                if(trace)
+                    trace->recordMemoryAccess(false, address,
+                        reinterpret_cast<uint8_t*>(memory.getWordAddress(address)) + address % sizeof(Word), typeSize);
                 address += typeSize;
             }
             address += pitch;
@@ -1230,6 +1390,10 @@ void VPM::setDMAReadAddress(const SIMDVector& val)
             memcpy(reinterpret_cast<uint8_t*>(&cache.at(vpmBaseAddress.first).at(vpmBaseAddress.second)) + byteOffset,
                 reinterpret_cast<uint8_t*>(memory.getWordAddress(address)) + address % sizeof(Word),
                 typeSize * sizes.second);
+            if(trace)
+                trace->recordMemoryAccess(false, address,
+                    reinterpret_cast<uint8_t*>(memory.getWordAddress(address)) + address % sizeof(Word),
+                    typeSize * sizes.second);
             logging::debug() << "\tVPM row: " << toDataString(cache.at(vpmBaseAddress.first)) << logging::endl;
             vpmBaseAddress.first += static_cast<uint32_t>((vpitch * typeSize) / sizeof(Word));
             vpmBaseAddress.second += static_cast<uint32_t>((vpitch * typeSize) % sizeof(Word));
@@ -1244,6 +1408,9 @@ void VPM::setDMAReadAddress(const SIMDVector& val)
 
 bool VPM::waitDMAWrite() const
 {
+    if(clock.functional)
+        // DMA writes are executed immediately
+        return true;
     // XXX how many cycles?
     auto numCyclesLeft = static_cast<int>(lastDMAWriteTrigger) + 12 - static_cast<int>(clock.currentCycle);
     PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "wait DMA write", numCyclesLeft > 0);
@@ -1262,6 +1429,9 @@ bool VPM::waitDMAWrite() const
 
 bool VPM::waitDMARead() const
 {
+    if(clock.functional)
+        // DMA reads are executed immediately
+        return true;
     // XXX how many cycles?
     auto numCyclesLeft = static_cast<int>(lastDMAReadTrigger) + 12 - static_cast<int>(clock.currentCycle);
     PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "wait DMA read", numCyclesLeft > 0);
@@ -1803,9 +1973,19 @@ std::pair<qpu_asm::Instruction, bool> Slice::readInstruction(ProgramCounter pc)
     return std::make_pair(qpu_asm::Instruction{result}, true);
 }
 
+tools::Word Slice::readMemoryWord(MemoryAddress address) const
+{
+    return l2Cache.memory.readWord(address);
+}
+
 uint32_t QPU::getCurrentCycle() const
 {
-    return clock.currentCycle;
+    return clock.functional ? localCycle : clock.currentCycle;
+}
+
+bool QPU::isStalled() const
+{
+    return stalled;
 }
 
 static Register toRegister(Address addr, bool isfileB)
@@ -1826,356 +2006,753 @@ static VectorFlags generateImmediateFlags(const SIMDVector& vector)
     return flags;
 }
 
-static void checkValidPackTarget(Pack packMode, const qpu_asm::Instruction& inst)
+static bool isValidPackTarget(const qpu_asm::Instruction& inst)
 {
     auto firstReg = toRegister(inst.getAddOut(), inst.getWriteSwap() == WriteSwap::SWAP);
     auto secondReg = toRegister(inst.getMulOut(), inst.getWriteSwap() == WriteSwap::DONT_SWAP);
 
     if(firstReg.file == RegisterFile::PHYSICAL_A && firstReg.isGeneralPurpose())
         // valid pack target
-        return;
+        return true;
 
     if(secondReg.file == RegisterFile::PHYSICAL_A && secondReg.isGeneralPurpose())
         // valid pack target
-        return;
+        return true;
 
     if(firstReg.num == REG_NOP.num || secondReg.num == REG_NOP.num)
         // XXX don't know whether the value is actually packed or not, but we don't care
-        return;
+        return true;
 
     // no valid pack target
-    throw CompilationError(CompilationStep::GENERAL, "Cannot pack to invalid target", inst.toASMString());
+    return false;
 }
 
-bool QPU::execute()
-{
-    if(stopExecution)
-        return false;
-
-    {
-        std::lock_guard<std::mutex> instrumentationGuard(instrumentationLock);
-        ++instrumentation.at(pc).numExecutions;
-    }
-
-    // If we stall on an instruction (the PC is the same as for the previous cycle), the instruction is already in the
-    // QPU and does not have to be looked up again
-    qpu_asm::Instruction inst{lastInstruction.second};
-    if(lastInstruction.first != pc)
-    {
-        auto val = slice.readInstruction(pc);
-        if(!val.second)
-            return true;
-        inst = val.first;
-    }
-    lastInstruction = std::make_pair(pc, inst.toBinaryCode());
-
-    CPPLOG_LAZY(logging::Level::INFO,
-        log << "QPU " << static_cast<unsigned>(ID) << " (0x" << std::hex << pc << std::dec
-            << "): " << inst.toASMString() << logging::endl);
-    ProgramCounter nextPC = pc;
-    if(inst.getSig() == SIGNAL_NONE || executeSignal(inst.getSig()))
-    {
-        if(auto op = inst.as<qpu_asm::ALUInstruction>())
-        {
-            if(executeALU(op))
-                ++nextPC;
-            // otherwise the execution stalled and the PC stays the same
-        }
-        else if(auto br = inst.as<qpu_asm::BranchInstruction>())
-        {
-            if(isConditionMet(br->getBranchCondition()))
-            {
-                {
-                    std::lock_guard<std::mutex> instrumentationGuard(instrumentationLock);
-                    ++instrumentation.at(pc).numBranchTaken;
-                }
-                int32_t offset =
-                    (br->getImmediate() / static_cast<int32_t>(sizeof(uint64_t))) /* immediate offset is in bytes */;
-                if(br->getAddRegister() == BranchReg::BRANCH_REG)
-                {
-                    auto regVal =
-                        registers.readRegister(Register{RegisterFile::PHYSICAL_A, br->getRegisterAddress()}, true);
-                    // According to http://maazl.de/project/vc4asm/doc/VideoCoreIV-addendum.html, the register value is
-                    // taken from element 15, not element 0 as documented
-                    offset += regVal.first[15].signedInt() /
-                        static_cast<int32_t>(sizeof(uint64_t)) /* register value is in bytes */;
-                }
-                ProgramCounter targetPC{};
-                if(br->getBranchRelative() == BranchRel::BRANCH_RELATIVE)
-                    targetPC = nextPC + 4 /* Branch starts at PC + 4 */ + static_cast<ProgramCounter>(offset);
-                else
-                    targetPC = static_cast<ProgramCounter>(offset);
-
-                // see Broadcom specification, page 34
-                registers.writeRegister(toRegister(br->getAddOut(), br->getWriteSwap() == WriteSwap::SWAP),
-                    SIMDVector(Literal(pc + 4)), std::bitset<16>(0xFFFF), BITMASK_ALL);
-                registers.writeRegister(toRegister(br->getMulOut(), br->getWriteSwap() == WriteSwap::DONT_SWAP),
-                    SIMDVector(Literal(pc + 4)), std::bitset<16>(0xFFFF), BITMASK_ALL);
-
-                // schedule the jump after the next 3 instructions
-                clock.schedule(
-                    "Branch delay", [this, remainingCycles{3}, targetPC](uint32_t currentCycle) mutable -> bool {
-                        if(remainingCycles > 0)
-                        {
-                            --remainingCycles;
-                            return false;
-                        }
-                        pc = targetPC;
-                        CPPLOG_LAZY(logging::Level::DEBUG,
-                            log << "Jumping program counter for QPU " << static_cast<unsigned>(ID) << " to: 0x"
-                                << std::hex << pc << std::dec << logging::endl);
-                        return true;
-                    });
-            }
-            // simply skip to next PC
-            ++nextPC;
-            PROFILE_COUNTER(
-                vc4c::profiler::COUNTER_EMULATOR, "branches taken", isConditionMet(br->getBranchCondition()) ? 1 : 0);
-        }
-        else if(auto load = inst.as<qpu_asm::LoadInstruction>())
-        {
-            auto type = load->getType();
-            SIMDVector loadedValues;
-            switch(type)
-            {
-            case OpLoad::LOAD_IMM_32:
-                loadedValues = SIMDVector(Literal(load->getImmediateInt()));
-                break;
-            case OpLoad::LOAD_SIGNED:
-                loadedValues = intermediate::LoadImmediate::toLoadedValues(
-                    load->getImmediateInt(), intermediate::LoadType::PER_ELEMENT_SIGNED);
-                break;
-            case OpLoad::LOAD_UNSIGNED:
-                loadedValues = intermediate::LoadImmediate::toLoadedValues(
-                    load->getImmediateInt(), intermediate::LoadType::PER_ELEMENT_UNSIGNED);
-                break;
-            }
-
-            auto flags = generateImmediateFlags(loadedValues);
-            if(load->getPack().hasEffect())
-            {
-                checkValidPackTarget(load->getPack(), *load);
-                PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "values packed", 1);
-            }
-            SIMDVector imm = load->getPack()(loadedValues, flags, false);
-            auto mask = load->getPack().getOutputMask();
-            writeConditional(toRegister(load->getAddOut(), load->getWriteSwap() == WriteSwap::SWAP), imm,
-                load->getAddCondition(), mask);
-            writeConditional(toRegister(load->getMulOut(), load->getWriteSwap() == WriteSwap::DONT_SWAP), imm,
-                load->getMulCondition(), mask);
-            if(load->getSetFlag() == SetFlag::SET_FLAGS)
-                setFlags(imm, load->getAddCondition() != COND_NEVER ? load->getAddCondition() : load->getMulCondition(),
-                    flags);
-            ++nextPC;
-        }
-        else if(auto semaphore = inst.as<qpu_asm::SemaphoreInstruction>())
-        {
-            bool dontStall = true;
-            SIMDVector result{};
-            if(semaphore->getAcquire())
-                // NOTE: "acquire" is decrement, see SemaphoreInstruction#getAcquire() function documentation
-                std::tie(result, dontStall) = semaphores.decrement(static_cast<uint8_t>(semaphore->getSemaphore()), ID);
-            else
-                std::tie(result, dontStall) = semaphores.increment(static_cast<uint8_t>(semaphore->getSemaphore()), ID);
-
-            if(dontStall)
-            {
-                if(semaphore->getPack().hasEffect())
-                {
-                    checkValidPackTarget(semaphore->getPack(), *semaphore);
-                    PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "values packed", 1);
-                }
-                result = semaphore->getPack()(result, {}, false);
-                auto mask = semaphore->getPack().getOutputMask();
-                writeConditional(toRegister(semaphore->getAddOut(), semaphore->getWriteSwap() == WriteSwap::SWAP),
-                    result, semaphore->getAddCondition(), mask);
-                writeConditional(toRegister(semaphore->getMulOut(), semaphore->getWriteSwap() == WriteSwap::DONT_SWAP),
-                    result, semaphore->getMulCondition(), mask);
-                if(semaphore->getSetFlag() == SetFlag::SET_FLAGS)
-                    setFlags(result,
-                        semaphore->getAddCondition() != COND_NEVER ? semaphore->getAddCondition() :
-                                                                     semaphore->getMulCondition(),
-                        {});
-                ++nextPC;
-            }
-            else
-            {
-                std::lock_guard<std::mutex> instrumentationGuard(instrumentationLock);
-                ++instrumentation.at(pc).numStalls;
-            }
-        }
-        else
-            throw CompilationError(CompilationStep::GENERAL, "Invalid assembler instruction", inst.toASMString());
-    }
-
-    // clear cache for registers already read this instruction
-    registers.clearReadCache();
+/*
+ * A single ALU input with the input multiplexer already resolved
+ */
+struct DecodedInput
+{
+    InputMultiplex mux = InputMultiplex::ACC0;
+    // the register to read, if the input is not a small immediate
+    Register reg = REG_NOP;
+    // the value of the small immediate, if the input is a small immediate
+    Optional<Literal> immediate;
+    bool isImmediate = false;
+    // whether the unpack mode of the instruction applies to this input
+    bool isUnpacked = false;
+};
 
-    pc = nextPC;
-    return true;
-}
+/*
+ * A single (add or mul) ALU operation, the op-code is only set if the operation is actually executed
+ */
+struct DecodedOperation
+{
+    const OpCode* code = nullptr;
+    ConditionCode condition = COND_NEVER;
+    Register output = REG_NOP;
+    std::array<DecodedInput, 2> inputs;
+    // whether the pack mode of the instruction applies to this output
+    bool isPacked = false;
+};
 
-qpu_asm::Instruction QPU::getCurrentInstruction() const
-{
-    return qpu_asm::Instruction{lastInstruction.second};
-}
+/*
+ * Pre-decoded machine code instruction.
+ *
+ * The kernel code is decoded once before the emulation starts, so the QPUs do not need to re-extract the instruction
+ * type, op-codes, registers, conditions and pack/unpack modes from the machine code on every emulated cycle.
+ */
+struct vc4c::tools::DecodedInstruction
+{
+    // Executes the instruction, returns whether to advance to the next instruction (false if the instruction stalled)
+    using Handler = bool (QPU::*)(const DecodedInstruction&);
+
+    Handler handler = &QPU::executeInvalid;
+    qpu_asm::Instruction instruction;
+    Signaling signal = SIGNAL_NONE;
+    bool setFlags = false;
+    Pack pack = PACK_NOP;
+    Unpack unpack = UNPACK_NOP;
+    BitMask packMask = BITMASK_ALL;
+    bool validPackTarget = true;
+    DecodedOperation add;
+    DecodedOperation mul;
+
+    // ALU instructions
+    bool setFlagsByMulALU = false;
+    bool isVectorRotation = false;
+    bool isFullRangeRotation = false;
+    bool rotateByR5 = false;
+    uint8_t rotationOffset = 0;
+
+    // branch instructions
+    BranchCond branchCondition = BRANCH_ALWAYS;
+    bool branchRelative = false;
+    bool branchOnRegister = false;
+    Register branchRegister = REG_NOP;
+    int32_t branchOffset = 0;
+
+    // load immediate instructions, the loaded value is already packed
+    SIMDVector loadedValue;
+    VectorFlags loadedFlags;
+
+    // semaphore instructions
+    uint8_t semaphore = 0;
+    bool acquireSemaphore = false;
+
+    // whether the instruction accesses periphery shared between all QPUs (mutex, semaphores, VPM/DMA, host interrupt)
+    bool accessesSharedPeriphery = false;
+
+    static DecodedInstruction decode(const qpu_asm::Instruction& inst);
+};
 
-uint32_t QPU::getCurrentInstructionIndex() const
+template <typename T>
+static void decodeOutputs(DecodedInstruction& decoded, const T& inst)
 {
-    return pc;
+    decoded.add.condition = inst.getAddCondition();
+    decoded.add.output = toRegister(inst.getAddOut(), inst.getWriteSwap() == WriteSwap::SWAP);
+    decoded.mul.condition = inst.getMulCondition();
+    decoded.mul.output = toRegister(inst.getMulOut(), inst.getWriteSwap() == WriteSwap::DONT_SWAP);
+    decoded.setFlags = inst.getSetFlag() == SetFlag::SET_FLAGS;
+    decoded.pack = inst.getPack();
+    decoded.packMask = inst.getPack().getOutputMask();
+    decoded.validPackTarget = !inst.getPack().hasEffect() || isValidPackTarget(inst);
 }
 
-static std::pair<SIMDVector, bool> toInputValue(Registers& registers, InputMultiplex mux, Address addressA,
-    Address addressB, bool regBIsImmediate, bool anyElementExecuted)
+static DecodedInput decodeInput(const qpu_asm::ALUInstruction& inst, InputMultiplex mux)
 {
+    DecodedInput input;
+    input.mux = mux;
     switch(mux)
     {
     case InputMultiplex::ACC0:
-        return registers.readRegister(REG_ACC0, anyElementExecuted);
+        input.reg = REG_ACC0;
+        break;
     case InputMultiplex::ACC1:
-        return registers.readRegister(REG_ACC1, anyElementExecuted);
+        input.reg = REG_ACC1;
+        break;
     case InputMultiplex::ACC2:
-        return registers.readRegister(REG_ACC2, anyElementExecuted);
+        input.reg = REG_ACC2;
+        break;
     case InputMultiplex::ACC3:
-        return registers.readRegister(REG_ACC3, anyElementExecuted);
+        input.reg = REG_ACC3;
+        break;
     case InputMultiplex::ACC4:
-        return registers.readRegister(REG_SFU_OUT, anyElementExecuted);
+        input.reg = REG_SFU_OUT;
+        break;
     case InputMultiplex::ACC5:
-        return registers.readRegister(REG_ACC5, anyElementExecuted);
+        input.reg = REG_ACC5;
+        break;
     case InputMultiplex::REGA:
-        return registers.readRegister(Register{RegisterFile::PHYSICAL_A, addressA}, anyElementExecuted);
+        input.reg = Register{RegisterFile::PHYSICAL_A, inst.getInputA()};
+        break;
     case InputMultiplex::REGB:
-        if(regBIsImmediate)
-            return std::make_pair(SIMDVector(*SmallImmediate{addressB}.toLiteral()), true);
+        if(inst.getSig() == SIGNAL_ALU_IMMEDIATE)
+        {
+            input.isImmediate = true;
+            input.immediate = SmallImmediate{inst.getInputB()}.toLiteral();
+        }
         else
-            return registers.readRegister(Register{RegisterFile::PHYSICAL_B, addressB}, anyElementExecuted);
+            input.reg = Register{RegisterFile::PHYSICAL_B, inst.getInputB()};
+        break;
     }
-    throw CompilationError(CompilationStep::GENERAL, "Unhandled ALU input");
+    if(inst.getUnpack().hasEffect())
+        input.isUnpacked =
+            inst.getUnpack().isUnpackFromR4() ? mux == InputMultiplex::ACC4 : mux == InputMultiplex::REGA;
+    return input;
 }
 
-static std::pair<SIMDVector, bool> applyVectorRotation(std::pair<SIMDVector, bool>&& input,
-    const qpu_asm::ALUInstruction* ins, Registers& registers, bool anyElementExecuted)
+static bool isSharedPeripheryRegister(Register reg, bool isWrite)
 {
-    if(!input.second)
-        // if we stall, do not rotate
-        return std::move(input);
-    if(!ins->isVectorRotation())
-        // no rotation set
-        return std::move(input);
-    SmallImmediate offset(ins->getInputB());
-    if(!offset.isVectorRotation())
-        return std::move(input);
-    if(ins->getMulMultiplexA() == InputMultiplex::REGB || ins->getMulMultiplexB() == InputMultiplex::REGB)
-        // XXX can't we actually?! See http://maazl.de/project/vc4asm/doc/VideoCoreIV-addendum.html
-        throw CompilationError(CompilationStep::GENERAL, "Cannot read vector rotation offset", input.first.to_string());
-
-    if(input.first.isUndefined() || input.first.getAllSame())
-        return std::move(input);
-
-    unsigned char distance = 0;
-    if(offset == VECTOR_ROTATE_R5)
-        //"Mul output vector rotation is taken from accumulator r5, element 0, bits [3:0]"
-        // - Broadcom Specification, page 30
-        distance = static_cast<uint8_t>(registers.readRegister(REG_ACC5, anyElementExecuted).first[0].unsignedInt());
-    else
-        distance = offset.getRotationOffset().value();
-
-    SIMDVector result(std::move(input.first));
-    if(ins->isFullRangeRotation())
-        result = std::move(result).rotate(distance & 0xF);
-    else
-        result = std::move(result).rotatePerQuad(distance & 0x3);
-
-    PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "vector rotations (full/total)", ins->isFullRangeRotation());
-    return std::make_pair(result, true);
+    if(reg.isGeneralPurpose() || reg.isAccumulator())
+        return false;
+    if(isWrite && reg.num == REG_HOST_INTERRUPT.num)
+        return true;
+    // VPM I/O, VPM setup, DMA setup and wait, mutex
+    return reg.num >= REG_VPM_IO.num && reg.num <= REG_MUTEX.num;
+}
+
+DecodedInstruction DecodedInstruction::decode(const qpu_asm::Instruction& inst)
+{
+    DecodedInstruction decoded;
+    decoded.instruction = inst;
+    decoded.signal = inst.getSig();
+    if(auto op = inst.as<qpu_asm::ALUInstruction>())
+    {
+        decoded.handler = &QPU::executeALU;
+        decodeOutputs(decoded, *op);
+        decoded.unpack = op->getUnpack();
+        if(op->getAddCondition() != COND_NEVER && op->getAddition() != OP_NOP.opAdd)
+            decoded.add.code = &OpCode::toOpCode(op->getAddition(), false);
+        if(op->getMulCondition() != COND_NEVER && op->getMultiplication() != OP_NOP.opMul)
+            decoded.mul.code = &OpCode::toOpCode(op->getMultiplication(), true);
+        decoded.add.inputs = {decodeInput(*op, op->getAddMultiplexA()), decodeInput(*op, op->getAddMultiplexB())};
+        decoded.mul.inputs = {decodeInput(*op, op->getMulMultiplexA()), decodeInput(*op, op->getMulMultiplexB())};
+        decoded.add.isPacked = op->getWriteSwap() == WriteSwap::DONT_SWAP && op->getPack().hasEffect();
+        decoded.mul.isPacked = op->getWriteSwap() == WriteSwap::SWAP && op->getPack().hasEffect();
+        decoded.setFlagsByMulALU = isFlagSetByMulALU(op->getAddition(), op->getMultiplication());
+
+        SmallImmediate offset(op->getInputB());
+        decoded.isVectorRotation = op->isVectorRotation() && offset.isVectorRotation();
+        decoded.isFullRangeRotation = op->isFullRangeRotation();
+        decoded.rotateByR5 = offset == VECTOR_ROTATE_R5;
+        if(decoded.isVectorRotation && !decoded.rotateByR5)
+            decoded.rotationOffset = offset.getRotationOffset().value();
+    }
+    else if(auto br = inst.as<qpu_asm::BranchInstruction>())
+    {
+        decoded.handler = &QPU::executeBranch;
+        decoded.add.output = toRegister(br->getAddOut(), br->getWriteSwap() == WriteSwap::SWAP);
+        decoded.mul.output = toRegister(br->getMulOut(), br->getWriteSwap() == WriteSwap::DONT_SWAP);
+        decoded.branchCondition = br->getBranchCondition();
+        decoded.branchRelative = br->getBranchRelative() == BranchRel::BRANCH_RELATIVE;
+        decoded.branchOnRegister = br->getAddRegister() == BranchReg::BRANCH_REG;
+        decoded.branchRegister = Register{RegisterFile::PHYSICAL_A, br->getRegisterAddress()};
+        // immediate offset is in bytes
+        decoded.branchOffset = br->getImmediate() / static_cast<int32_t>(sizeof(uint64_t));
+    }
+    else if(auto load = inst.as<qpu_asm::LoadInstruction>())
+    {
+        decoded.handler = &QPU::executeLoad;
+        decodeOutputs(decoded, *load);
+        switch(load->getType())
+        {
+        case OpLoad::LOAD_IMM_32:
+            decoded.loadedValue = SIMDVector(Literal(load->getImmediateInt()));
+            break;
+        case OpLoad::LOAD_SIGNED:
+            decoded.loadedValue = intermediate::LoadImmediate::toLoadedValues(
+                load->getImmediateInt(), intermediate::LoadType::PER_ELEMENT_SIGNED);
+            break;
+        case OpLoad::LOAD_UNSIGNED:
+            decoded.loadedValue = intermediate::LoadImmediate::toLoadedValues(
+                load->getImmediateInt(), intermediate::LoadType::PER_ELEMENT_UNSIGNED);
+            break;
+        }
+        decoded.loadedFlags = generateImmediateFlags(decoded.loadedValue);
+        if(decoded.validPackTarget)
+            decoded.loadedValue = load->getPack()(decoded.loadedValue, decoded.loadedFlags, false);
+    }
+    else if(auto semaphore = inst.as<qpu_asm::SemaphoreInstruction>())
+    {
+        decoded.handler = &QPU::executeSemaphore;
+        decodeOutputs(decoded, *semaphore);
+        decoded.semaphore = static_cast<uint8_t>(semaphore->getSemaphore());
+        // NOTE: "acquire" is decrement, see SemaphoreInstruction#getAcquire() function documentation
+        decoded.acquireSemaphore = semaphore->getAcquire();
+    }
+    decoded.accessesSharedPeriphery = decoded.handler == &QPU::executeSemaphore ||
+        isSharedPeripheryRegister(decoded.add.output, true) || isSharedPeripheryRegister(decoded.mul.output, true);
+    if(decoded.handler == &QPU::executeALU)
+    {
+        for(const auto* op : {&decoded.add, &decoded.mul})
+        {
+            if(!op->code)
+                continue;
+            for(uint8_t i = 0; i < op->code->numOperands; ++i)
+                decoded.accessesSharedPeriphery |= isSharedPeripheryRegister(op->inputs[i].reg, false);
+        }
+    }
+    return decoded;
 }
 
-static bool isAnyElementExecuted(const VectorFlags& flags, ConditionCode code)
+std::vector<DecodedInstruction> tools::decodeInstructions(
+    std::vector<qpu_asm::Instruction>::const_iterator firstInstruction, std::size_t numInstructions)
 {
-    return code == COND_ALWAYS ||
-        std::any_of(flags.begin(), flags.end(), [=](ElementFlags flag) { return flag.matchesCondition(code); });
+    PROFILE_SCOPE(DecodeInstructions);
+    std::vector<DecodedInstruction> program;
+    program.reserve(numInstructions);
+    std::transform(firstInstruction, firstInstruction + static_cast<std::ptrdiff_t>(numInstructions),
+        std::back_inserter(program), DecodedInstruction::decode);
+    return program;
 }
 
-bool QPU::executeALU(const qpu_asm::ALUInstruction* aluInst)
+static void checkValidPackTarget(const DecodedInstruction& inst)
 {
-    SIMDVector addIn0{};
-    SIMDVector addIn1{};
-    SIMDVector mulIn0{};
-    SIMDVector mulIn1{};
-
-    const OpCode& addCode = OpCode::toOpCode(aluInst->getAddition(), false);
-    const OpCode& mulCode = OpCode::toOpCode(aluInst->getMultiplication(), true);
+    if(!inst.validPackTarget)
+        throw CompilationError(
+            CompilationStep::GENERAL, "Cannot pack to invalid target", inst.instruction.toASMString());
+}
 
-    // need to read both input before writing any registers
-    if(aluInst->getAddCondition() != COND_NEVER && aluInst->getAddition() != OP_NOP.opAdd)
+/*
+ * Synchronizes the QPUs emulated in parallel on separate host threads.
+ *
+ * All instructions accessing shared periphery are serialized. In deterministic mode, they are additionally executed in
+ * the order of the QPU-local cycle (ties broken by QPU number): Before accessing the shared periphery, a QPU waits
+ * until all other running QPUs have advanced past its current cycle. Since all QPUs execute the same sequence of
+ * instructions independent of the host thread scheduling, the result of the emulation is then reproducible.
+ *
+ * NOTE: TMU and UNIFORM reads are not serialized with the shared periphery accesses, they only take the shared lock of
+ * the memory, which VPM DMA writes take exclusively. So they never read partially written data, but are not ordered
+ * against VPM DMA writes of other QPUs (in either mode). Like on the hardware, a kernel needs to synchronize (e.g. via
+ * a barrier or the hardware mutex) before reading memory written by another QPU. For kernels which do not, the values
+ * read might differ between runs and from the values read in the (single-threaded) functional emulation.
+ */
+class vc4c::tools::QPUSynchronization : private NonCopyable
+{
+public:
+    QPUSynchronization(std::size_t numQPUs, bool deterministic) :
+        deterministic(deterministic), progress(new std::atomic<uint64_t>[numQPUs]), numQPUs(numQPUs),
+        waitingKeys(new std::atomic<uint64_t>[numQPUs]),
+        runningQPUs(static_cast<uint32_t>((1u << numQPUs) - 1u)), stalledQPUs(0), stallEpoch(0), aborted(false)
     {
-        bool anyElementExecuting = isAnyElementExecuted(flags, aluInst->getAddCondition());
-
-        bool addIn0NotStall = true;
+        for(std::size_t i = 0; i < numQPUs; ++i)
+        {
+            progress[i].store(0, std::memory_order_relaxed);
+            waitingKeys[i].store(NOT_WAITING, std::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * Publishes the cycle the given QPU is about to execute
+     */
+    void updateProgress(uint8_t qpu, uint32_t cycle)
+    {
+        if(deterministic)
+            publishProgress(qpu, toProgressKey(qpu, cycle));
+    }
+
+    /*
+     * Waits for the given QPU's turn (in deterministic mode) and acquires exclusive access to the shared periphery
+     */
+    std::unique_lock<std::mutex> beginSharedAccess(uint8_t qpu, uint32_t cycle)
+    {
+        if(deterministic)
+        {
+            PROFILE_SCOPE(WaitForSharedAccess);
+            const auto key = toProgressKey(qpu, cycle);
+            publishProgress(qpu, key);
+            // The QPU with the lowest key never waits, so this cannot dead-lock. Finished or aborted QPUs publish the
+            // maximum key.
+            std::unique_lock<std::mutex> guard(progressLock);
+            waitingKeys[qpu].store(key);
+            progressChanged.wait(guard, [&]() {
+                for(std::size_t i = 0; i < numQPUs; ++i)
+                {
+                    if(i != qpu && progress[i].load() < key)
+                        return false;
+                }
+                return true;
+            });
+            waitingKeys[qpu].store(NOT_WAITING);
+        }
+        return std::unique_lock<std::mutex>(sharedAccessLock);
+    }
+
+    /*
+     * Marks the given QPU as no longer running (finished or aborted)
+     */
+    void finish(uint8_t qpu)
+    {
+        publishProgress(qpu, std::numeric_limits<uint64_t>::max());
+        runningQPUs.fetch_and(~(1u << qpu));
+        stalledQPUs.fetch_and(~(1u << qpu));
+        ++stallEpoch;
+    }
+
+    void setStalled(uint8_t qpu, bool stalled)
+    {
+        if(stalled)
+            stalledQPUs.fetch_or(1u << qpu);
+        else
+        {
+            stalledQPUs.fetch_and(~(1u << qpu));
+            ++stallEpoch;
+        }
+    }
+
+    /*
+     * Returns whether all running QPUs are stalled and the epoch (increased whenever any QPU makes progress after
+     * having stalled or finishes). If all QPUs stay stalled over the same epoch, they block each other.
+     */
+    std::pair<bool, uint64_t> checkAllStalled() const
+    {
+        auto epoch = stallEpoch.load();
+        auto running = runningQPUs.load();
+        return std::make_pair(running != 0 && (stalledQPUs.load() & running) == running, epoch);
+    }
+
+    void abort()
+    {
+        aborted = true;
+    }
+
+    bool isAborted() const
+    {
+        return aborted.load(std::memory_order_relaxed);
+    }
+
+private:
+    const bool deterministic;
+    // the progress key (local cycle and QPU number) of every QPU
+    std::unique_ptr<std::atomic<uint64_t>[]> progress;
+    const std::size_t numQPUs;
+    // the progress key every QPU waits for all other QPUs to pass before accessing the shared periphery
+    std::unique_ptr<std::atomic<uint64_t>[]> waitingKeys;
+    std::mutex progressLock;
+    std::condition_variable progressChanged;
+    std::mutex sharedAccessLock;
+    std::atomic<uint32_t> runningQPUs;
+    std::atomic<uint32_t> stalledQPUs;
+    std::atomic<uint64_t> stallEpoch;
+    std::atomic_bool aborted;
+
+    static constexpr uint64_t NOT_WAITING = std::numeric_limits<uint64_t>::max();
+
+    static uint64_t toProgressKey(uint8_t qpu, uint32_t cycle) noexcept
+    {
+        return (static_cast<uint64_t>(cycle) << 8) | qpu;
+    }
+
+    void publishProgress(uint8_t qpu, uint64_t key)
+    {
+        // Both the progress and the waiting keys are sequentially consistent, so either a QPU about to wait sees the
+        // new progress or we see the waiting QPU and notify it.
+        auto previousKey = progress[qpu].exchange(key);
+        for(std::size_t i = 0; i < numQPUs; ++i)
+        {
+            // only notify if this QPU was blocking any waiting QPU, but does not anymore
+            auto waitingKey = waitingKeys[i].load();
+            if(i != qpu && previousKey < waitingKey && waitingKey < key)
+            {
+                // lock to not notify between a waiting QPU checking the progress and starting to wait
+                std::lock_guard<std::mutex> guard(progressLock);
+                progressChanged.notify_all();
+                return;
+            }
+        }
+    }
+};
+
+QPU::QPU(uint8_t id, EmulationClock& clock, Slice& slice, Mutex& mutex, SFU& sfu, VPM& vpm, Semaphores& semaphores,
+    MemoryAddress uniformAddress, const std::vector<DecodedInstruction>& program, QPUSynchronization* synchronization,
+    TraceWriter* traceWriter, uint32_t traceGroup) :
+    ID(id),
+    clock(clock), slice(slice), mutex(mutex), program(program), synchronization(synchronization), registers(*this),
+    uniforms(clock, *this, slice, uniformAddress), tmus(clock, *this, slice), sfu(sfu), vpm(vpm),
+    semaphores(semaphores), pc(0), lastInstruction{0xDEADDEAD, 0}, instrumentation(program.size()),
+    stopExecution(false), stalled(false), numExecutedInstructions(0), branchTarget(0), remainingBranchDelay(-1),
+    remainingEndDelay(-1), localCycle(0),
+    trace(traceWriter ? std::make_unique<TraceRecorder>(*traceWriter, traceGroup, id) : nullptr)
+{
+    // initially trigger the loading of the first UNIFORM values into the FIFO
+    uniforms.triggerFifoFill();
+}
+
+bool QPU::execute()
+{
+    if(stopExecution)
+    {
+        if(trace)
+            trace->recordFinish();
+        return false;
+    }
+    if(trace)
+        trace->setPosition(getCurrentCycle(), pc);
+
+    ++instrumentation.at(pc).numExecutions;
+
+    // If we stall on an instruction (the PC is the same as for the previous cycle), the instruction is already in the
+    // QPU and does not have to be looked up again
+    if(lastInstruction.first != pc && !clock.functional)
+    {
+        // the actual instruction is taken from the pre-decoded program, the read only models the instruction cache
+        auto val = slice.readInstruction(pc);
+        stalled = !val.second;
+        if(!val.second)
+        {
+            recordStall(&InstrumentationResult::numInstructionFetchStalls);
+            return true;
+        }
+    }
+    const DecodedInstruction& inst = program.at(pc);
+    lastInstruction = std::make_pair(pc, inst.instruction.toBinaryCode());
+
+    // the lock is released after the progress of this QPU is updated below
+    std::unique_lock<std::mutex> sharedAccessGuard;
+    if(synchronization && inst.accessesSharedPeriphery)
+        sharedAccessGuard = synchronization->beginSharedAccess(ID, localCycle);
+
+    CPPLOG_LAZY(logging::Level::INFO,
+        log << "QPU " << static_cast<unsigned>(ID) << " (0x" << std::hex << pc << std::dec
+            << "): " << inst.instruction.toASMString() << logging::endl);
+    ProgramCounter nextPC = pc;
+    if(inst.signal == SIGNAL_NONE || executeSignal(inst.signal))
+    {
+        if((this->*inst.handler)(inst))
+            ++nextPC;
+        // otherwise the execution stalled and the PC stays the same
+    }
+    else
+        // only the TMU load signals can stall
+        recordStall(&InstrumentationResult::numTMUStalls);
+
+    // clear cache for registers already read this instruction
+    registers.clearReadCache();
+
+    stalled = nextPC == pc;
+    if(!stalled)
+    {
+        ++numExecutedInstructions;
+        // the delay slots of branches and the thread end are counted per executed instruction, so stalled delay slots
+        // are not skipped
+        if(remainingBranchDelay == 0)
+        {
+            nextPC = branchTarget;
+            CPPLOG_LAZY(logging::Level::DEBUG,
+                log << "Jumping program counter for QPU " << static_cast<unsigned>(ID) << " to: 0x" << std::hex
+                    << nextPC << std::dec << logging::endl);
+        }
+        if(remainingBranchDelay >= 0)
+            --remainingBranchDelay;
+        if(remainingEndDelay == 0)
+            stopExecution = true;
+        if(remainingEndDelay >= 0)
+            --remainingEndDelay;
+    }
+    if(clock.functional)
+        ++localCycle;
+    if(synchronization)
+        synchronization->updateProgress(ID, localCycle);
+
+    pc = nextPC;
+    return true;
+}
+
+qpu_asm::Instruction QPU::getCurrentInstruction() const
+{
+    return qpu_asm::Instruction{lastInstruction.second};
+}
+
+uint32_t QPU::getCurrentInstructionIndex() const
+{
+    return pc;
+}
+
+const InstrumentationResults& QPU::getInstrumentation() const
+{
+    return instrumentation;
+}
+
+void QPU::recordStall(unsigned InstrumentationResult::*reason)
+{
+    auto& result = instrumentation.at(pc);
+    ++result.numStalls;
+    if(reason)
+        ++(result.*reason);
+}
+
+/*
+ * Returns the instrumentation counter for the reason of stalling on reading the given input
+ */
+static unsigned InstrumentationResult::*toStallReason(const DecodedInput& input)
+{
+    if(input.isImmediate)
+        return nullptr;
+    if(input.reg.num == REG_UNIFORM.num)
+        return &InstrumentationResult::numUniformStalls;
+    if(input.reg.num == REG_MUTEX.num)
+        return &InstrumentationResult::numMutexStalls;
+    if(input.reg.num == REG_VPM_DMA_LOAD_WAIT.num)
+        // also REG_VPM_DMA_STORE_WAIT
+        return &InstrumentationResult::numVPMStalls;
+    return nullptr;
+}
+
+bool QPU::executeBranch(const DecodedInstruction& inst)
+{
+    bool conditionMet = isConditionMet(inst.branchCondition);
+    if(conditionMet)
+    {
+        ++instrumentation.at(pc).numBranchTaken;
+        int32_t offset = inst.branchOffset;
+        if(inst.branchOnRegister)
+        {
+            auto regVal = registers.readRegister(inst.branchRegister, true);
+            // According to http://maazl.de/project/vc4asm/doc/VideoCoreIV-addendum.html, the register value is
+            // taken from element 15, not element 0 as documented
+            offset +=
+                regVal.first[15].signedInt() / static_cast<int32_t>(sizeof(uint64_t)) /* register value is in bytes */;
+        }
+        ProgramCounter targetPC{};
+        if(inst.branchRelative)
+            targetPC = pc + 4 /* Branch starts at PC + 4 */ + static_cast<ProgramCounter>(offset);
+        else
+            targetPC = static_cast<ProgramCounter>(offset);
+        if(trace)
+            trace->recordBranch(true, targetPC);
+
+        // see Broadcom specification, page 34
+        registers.writeRegister(inst.add.output, SIMDVector(Literal(pc + 4)), std::bitset<16>(0xFFFF), BITMASK_ALL);
+        registers.writeRegister(inst.mul.output, SIMDVector(Literal(pc + 4)), std::bitset<16>(0xFFFF), BITMASK_ALL);
+
+        // schedule the jump after the next 3 instructions
+        branchTarget = targetPC;
+        remainingBranchDelay = 3;
+    }
+    else if(trace)
+        trace->recordBranch(false, pc + 4);
+    PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "branches taken", conditionMet ? 1 : 0);
+    // simply skip to next PC
+    return true;
+}
+
+bool QPU::executeLoad(const DecodedInstruction& inst)
+{
+    if(inst.pack.hasEffect())
+    {
+        checkValidPackTarget(inst);
+        PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "values packed", 1);
+    }
+    writeConditional(inst.add.output, inst.loadedValue, inst.add.condition, inst.packMask);
+    writeConditional(inst.mul.output, inst.loadedValue, inst.mul.condition, inst.packMask);
+    if(inst.setFlags)
+        setFlags(inst.loadedValue, inst.add.condition != COND_NEVER ? inst.add.condition : inst.mul.condition,
+            inst.loadedFlags);
+    return true;
+}
+
+bool QPU::executeSemaphore(const DecodedInstruction& inst)
+{
+    bool dontStall = true;
+    SIMDVector result{};
+    if(inst.acquireSemaphore)
+        std::tie(result, dontStall) = semaphores.decrement(inst.semaphore, ID);
+    else
+        std::tie(result, dontStall) = semaphores.increment(inst.semaphore, ID);
+    if(trace)
+        trace->recordSemaphore(inst.semaphore, inst.acquireSemaphore, result[0].unsignedInt(), !dontStall);
+
+    if(!dontStall)
+    {
+        recordStall(&InstrumentationResult::numSemaphoreStalls);
+        return false;
+    }
+
+    if(inst.pack.hasEffect())
+    {
+        checkValidPackTarget(inst);
+        PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "values packed", 1);
+    }
+    result = inst.pack(result, {}, false);
+    writeConditional(inst.add.output, result, inst.add.condition, inst.packMask);
+    writeConditional(inst.mul.output, result, inst.mul.condition, inst.packMask);
+    if(inst.setFlags)
+        setFlags(result, inst.add.condition != COND_NEVER ? inst.add.condition : inst.mul.condition, {});
+    return true;
+}
+
+bool QPU::executeInvalid(const DecodedInstruction& inst)
+{
+    throw CompilationError(CompilationStep::GENERAL, "Invalid assembler instruction", inst.instruction.toASMString());
+}
+
+static std::pair<SIMDVector, bool> toInputValue(
+    Registers& registers, const DecodedInput& input, bool anyElementExecuted)
+{
+    if(input.isImmediate)
+        return std::make_pair(SIMDVector(*input.immediate), true);
+    return registers.readRegister(input.reg, anyElementExecuted);
+}
+
+static std::pair<SIMDVector, bool> applyVectorRotation(std::pair<SIMDVector, bool>&& input,
+    const DecodedInstruction& inst, Registers& registers, bool anyElementExecuted)
+{
+    if(!input.second)
+        // if we stall, do not rotate
+        return std::move(input);
+    if(!inst.isVectorRotation)
+        // no rotation set
+        return std::move(input);
+    if(inst.mul.inputs[0].mux == InputMultiplex::REGB || inst.mul.inputs[1].mux == InputMultiplex::REGB)
+        // XXX can't we actually?! See http://maazl.de/project/vc4asm/doc/VideoCoreIV-addendum.html
+        throw CompilationError(CompilationStep::GENERAL, "Cannot read vector rotation offset", input.first.to_string());
+
+    if(input.first.isUndefined() || input.first.getAllSame())
+        return std::move(input);
+
+    unsigned char distance = 0;
+    if(inst.rotateByR5)
+        //"Mul output vector rotation is taken from accumulator r5, element 0, bits [3:0]"
+        // - Broadcom Specification, page 30
+        distance = static_cast<uint8_t>(registers.readRegister(REG_ACC5, anyElementExecuted).first[0].unsignedInt());
+    else
+        distance = inst.rotationOffset;
+
+    SIMDVector result(std::move(input.first));
+    if(inst.isFullRangeRotation)
+        result = std::move(result).rotate(distance & 0xF);
+    else
+        result = std::move(result).rotatePerQuad(distance & 0x3);
+
+    PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "vector rotations (full/total)", inst.isFullRangeRotation);
+    return std::make_pair(result, true);
+}
+
+static bool isAnyElementExecuted(const VectorFlags& flags, ConditionCode code)
+{
+    return code == COND_ALWAYS ||
+        std::any_of(flags.begin(), flags.end(), [=](ElementFlags flag) { return flag.matchesCondition(code); });
+}
+
+bool QPU::executeALU(const DecodedInstruction& inst)
+{
+    SIMDVector addIn0{};
+    SIMDVector addIn1{};
+    SIMDVector mulIn0{};
+    SIMDVector mulIn1{};
+
+    // need to read both input before writing any registers
+    if(inst.add.code)
+    {
+        bool anyElementExecuting = isAnyElementExecuted(flags, inst.add.condition);
+
+        bool addIn0NotStall = true;
         bool addIn1NotStall = true;
-        std::tie(addIn0, addIn0NotStall) = toInputValue(registers, aluInst->getAddMultiplexA(), aluInst->getInputA(),
-            aluInst->getInputB(), aluInst->getSig() == SIGNAL_ALU_IMMEDIATE, anyElementExecuting);
-        if(addCode.numOperands > 1)
-            std::tie(addIn1, addIn1NotStall) =
-                toInputValue(registers, aluInst->getAddMultiplexB(), aluInst->getInputA(), aluInst->getInputB(),
-                    aluInst->getSig() == SIGNAL_ALU_IMMEDIATE, anyElementExecuting);
+        std::tie(addIn0, addIn0NotStall) = toInputValue(registers, inst.add.inputs[0], anyElementExecuting);
+        if(inst.add.code->numOperands > 1)
+            std::tie(addIn1, addIn1NotStall) = toInputValue(registers, inst.add.inputs[1], anyElementExecuting);
 
         if(!addIn0NotStall || !addIn1NotStall)
         {
             // we stall on input, so do not calculate anything
-            std::lock_guard<std::mutex> instrumentationGuard(instrumentationLock);
-            ++instrumentation.at(pc).numStalls;
+            recordStall(toStallReason(inst.add.inputs[addIn0NotStall ? 1 : 0]));
             return false;
         }
     }
 
-    if(aluInst->getMulCondition() != COND_NEVER && aluInst->getMultiplication() != OP_NOP.opMul)
+    if(inst.mul.code)
     {
-        bool anyElementExecuting = isAnyElementExecuted(flags, aluInst->getMulCondition());
+        bool anyElementExecuting = isAnyElementExecuted(flags, inst.mul.condition);
 
         bool mulIn0NotStall = true;
         bool mulIn1NotStall = true;
 
         PROFILE_START(EmulateVectorRotation);
         std::tie(mulIn0, mulIn0NotStall) = applyVectorRotation(
-            toInputValue(registers, aluInst->getMulMultiplexA(), aluInst->getInputA(), aluInst->getInputB(),
-                aluInst->getSig() == SIGNAL_ALU_IMMEDIATE, anyElementExecuting),
-            aluInst, registers, anyElementExecuting);
-        if(mulCode.numOperands > 1)
+            toInputValue(registers, inst.mul.inputs[0], anyElementExecuting), inst, registers, anyElementExecuting);
+        if(inst.mul.code->numOperands > 1)
             std::tie(mulIn1, mulIn1NotStall) = applyVectorRotation(
-                toInputValue(registers, aluInst->getMulMultiplexB(), aluInst->getInputA(), aluInst->getInputB(),
-                    aluInst->getSig() == SIGNAL_ALU_IMMEDIATE, anyElementExecuting),
-                aluInst, registers, anyElementExecuting);
+                toInputValue(registers, inst.mul.inputs[1], anyElementExecuting), inst, registers, anyElementExecuting);
         PROFILE_END(EmulateVectorRotation);
 
         if(!mulIn0NotStall || !mulIn1NotStall)
         {
             // we stall on input, so do not calculate anything
-            std::lock_guard<std::mutex> instrumentationGuard(instrumentationLock);
-            ++instrumentation.at(pc).numStalls;
+            recordStall(toStallReason(inst.mul.inputs[mulIn0NotStall ? 1 : 0]));
             return false;
         }
     }
 
-    if(aluInst->getAddCondition() != COND_NEVER && aluInst->getAddition() != OP_NOP.opAdd)
+    if(inst.add.code)
     {
-        if(aluInst->getUnpack().hasEffect())
+        const OpCode& addCode = *inst.add.code;
+        if(inst.unpack.hasEffect())
         {
             PROFILE_SCOPE(EmulateUnpack);
-            if(aluInst->getUnpack().isUnpackFromR4())
-            {
-                if(aluInst->getAddMultiplexA() == InputMultiplex::ACC4)
-                    addIn0 = aluInst->getUnpack()(addIn0, addCode.acceptsFloat);
-                if(aluInst->getAddMultiplexB() == InputMultiplex::ACC4)
-                    addIn1 = aluInst->getUnpack()(addIn1, addCode.acceptsFloat);
-            }
-            else
-            {
-                if(aluInst->getAddMultiplexA() == InputMultiplex::REGA)
-                    addIn0 = aluInst->getUnpack()(addIn0, addCode.acceptsFloat);
-                if(aluInst->getAddMultiplexB() == InputMultiplex::REGA)
-                    addIn1 = aluInst->getUnpack()(addIn1, addCode.acceptsFloat);
-            }
+            if(inst.add.inputs[0].isUnpacked)
+                addIn0 = inst.unpack(addIn0, addCode.acceptsFloat);
+            if(inst.add.inputs[1].isUnpacked)
+                addIn1 = inst.unpack(addIn1, addCode.acceptsFloat);
         }
 
         PROFILE_START(EmulateOpcode);
@@ -2188,41 +2765,31 @@ bool QPU::executeALU(const qpu_asm::ALUInstruction* aluInst)
         // fall-through for errors above on purpose so the next instruction throws an exception
         auto result = std::move(tmp.first).value();
         auto mask = BITMASK_ALL;
-        if(aluInst->getWriteSwap() == WriteSwap::DONT_SWAP && aluInst->getPack().hasEffect())
+        if(inst.add.isPacked)
         {
-            checkValidPackTarget(aluInst->getPack(), *aluInst);
+            checkValidPackTarget(inst);
             PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "values packed", 1);
-            if(aluInst->getPack().supportsMulALU())
+            if(inst.pack.supportsMulALU())
                 throw CompilationError(CompilationStep::GENERAL, "Cannot apply mul pack mode on add result!");
-            result = aluInst->getPack()(result, tmp.second, addCode.returnsFloat);
-            mask = aluInst->getPack().getOutputMask();
+            result = inst.pack(result, tmp.second, addCode.returnsFloat);
+            mask = inst.packMask;
         }
 
-        writeConditional(toRegister(aluInst->getAddOut(), aluInst->getWriteSwap() == WriteSwap::SWAP), result,
-            aluInst->getAddCondition(), mask, aluInst, nullptr);
-        if(aluInst->getSetFlag() == SetFlag::SET_FLAGS)
-            setFlags(result, aluInst->getAddCondition(), tmp.second);
+        writeConditional(inst.add.output, result, inst.add.condition, mask, true, false);
+        if(inst.setFlags)
+            setFlags(result, inst.add.condition, tmp.second);
         PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "add instructions", 1);
     }
-    if(aluInst->getMulCondition() != COND_NEVER && aluInst->getMultiplication() != OP_NOP.opMul)
+    if(inst.mul.code)
     {
-        if(aluInst->getUnpack().hasEffect())
+        const OpCode& mulCode = *inst.mul.code;
+        if(inst.unpack.hasEffect())
         {
             PROFILE_SCOPE(EmulateUnpack);
-            if(aluInst->getUnpack().isUnpackFromR4())
-            {
-                if(aluInst->getMulMultiplexA() == InputMultiplex::ACC4)
-                    mulIn0 = aluInst->getUnpack()(mulIn0, mulCode.acceptsFloat);
-                if(aluInst->getMulMultiplexB() == InputMultiplex::ACC4)
-                    mulIn1 = aluInst->getUnpack()(mulIn1, mulCode.acceptsFloat);
-            }
-            else
-            {
-                if(aluInst->getMulMultiplexA() == InputMultiplex::REGA)
-                    mulIn0 = aluInst->getUnpack()(mulIn0, mulCode.acceptsFloat);
-                if(aluInst->getMulMultiplexB() == InputMultiplex::REGA)
-                    mulIn1 = aluInst->getUnpack()(mulIn1, mulCode.acceptsFloat);
-            }
+            if(inst.mul.inputs[0].isUnpacked)
+                mulIn0 = inst.unpack(mulIn0, mulCode.acceptsFloat);
+            if(inst.mul.inputs[1].isUnpacked)
+                mulIn1 = inst.unpack(mulIn1, mulCode.acceptsFloat);
         }
 
         PROFILE_START(EmulateOpcode);
@@ -2234,50 +2801,46 @@ bool QPU::executeALU(const qpu_asm::ALUInstruction* aluInst)
                 mulCode.name);
         auto result = std::move(tmp.first).value();
         auto mask = BITMASK_ALL;
-        if(aluInst->getWriteSwap() == WriteSwap::SWAP && aluInst->getPack().hasEffect())
+        if(inst.mul.isPacked)
         {
-            checkValidPackTarget(aluInst->getPack(), *aluInst);
+            checkValidPackTarget(inst);
             PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "values packed", 1);
-            if(!aluInst->getPack().supportsMulALU())
+            if(!inst.pack.supportsMulALU())
                 throw CompilationError(CompilationStep::GENERAL, "Cannot apply add pack mode on mul result!");
-            result = aluInst->getPack()(result, tmp.second, mulCode.returnsFloat);
-            mask = aluInst->getPack().getOutputMask();
+            result = inst.pack(result, tmp.second, mulCode.returnsFloat);
+            mask = inst.packMask;
         }
 
         // FIXME these might depend on flags of add ALU set in same instruction (which is wrong)
-        writeConditional(toRegister(aluInst->getMulOut(), aluInst->getWriteSwap() == WriteSwap::DONT_SWAP), result,
-            aluInst->getMulCondition(), mask, nullptr, aluInst);
-        if(aluInst->getSetFlag() == SetFlag::SET_FLAGS &&
-            isFlagSetByMulALU(aluInst->getAddition(), aluInst->getMultiplication()))
-            setFlags(result, aluInst->getMulCondition(), tmp.second);
+        writeConditional(inst.mul.output, result, inst.mul.condition, mask, false, true);
+        if(inst.setFlags && inst.setFlagsByMulALU)
+            setFlags(result, inst.mul.condition, tmp.second);
         PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "mul instructions", 1);
     }
 
-    if(aluInst->getUnpack().hasEffect())
+    if(inst.unpack.hasEffect())
         PROFILE_COUNTER_SCOPE(vc4c::profiler::COUNTER_EMULATOR, "values unpacked", 1);
 
     return true;
 }
 
-void QPU::writeConditional(Register dest, const SIMDVector& in, ConditionCode cond, BitMask bitMask,
-    const qpu_asm::ALUInstruction* addInst, const qpu_asm::ALUInstruction* mulInst)
+void QPU::writeConditional(
+    Register dest, const SIMDVector& in, ConditionCode cond, BitMask bitMask, bool isAddALU, bool isMulALU)
 {
     if(cond == COND_ALWAYS)
     {
         registers.writeRegister(dest, in, std::bitset<16>(0xFFFF), bitMask);
-        std::lock_guard<std::mutex> instrumentationGuard(instrumentationLock);
-        if(addInst)
+        if(isAddALU)
             ++instrumentation.at(pc).numAddALUExecuted;
-        if(mulInst)
+        if(isMulALU)
             ++instrumentation.at(pc).numMulALUExecuted;
         return;
     }
     else if(cond == COND_NEVER)
     {
-        std::lock_guard<std::mutex> instrumentationGuard(instrumentationLock);
-        if(addInst)
+        if(isAddALU)
             ++instrumentation.at(pc).numAddALUSkipped;
-        if(mulInst)
+        if(isMulALU)
             ++instrumentation.at(pc).numMulALUSkipped;
         return;
     }
@@ -2304,17 +2867,15 @@ void QPU::writeConditional(Register dest, const SIMDVector& in, ConditionCode co
         registers.writeRegister(dest, in, elementMask, bitMask);
     }
 
-    if(addInst != nullptr)
+    if(isAddALU)
     {
-        std::lock_guard<std::mutex> instrumentationGuard(instrumentationLock);
         if(elementMask.any())
             ++instrumentation.at(pc).numAddALUExecuted;
         else
             ++instrumentation.at(pc).numAddALUSkipped;
     }
-    if(mulInst != nullptr)
+    if(isMulALU)
     {
-        std::lock_guard<std::mutex> instrumentationGuard(instrumentationLock);
         if(elementMask.any())
             ++instrumentation.at(pc).numMulALUExecuted;
         else
@@ -2394,22 +2955,19 @@ bool QPU::executeSignal(Signaling signal)
         signal == SIGNAL_NONE)
         // ignore
         return true;
-    if(signal == SIGNAL_LOAD_TMU0)
-        return tmus.triggerTMURead(0, lastR4Value);
-    else if(signal == SIGNAL_LOAD_TMU1)
-        return tmus.triggerTMURead(1, lastR4Value);
+    if(signal == SIGNAL_LOAD_TMU0 || signal == SIGNAL_LOAD_TMU1)
+    {
+        if(!tmus.triggerTMURead(signal == SIGNAL_LOAD_TMU1 ? 1 : 0, lastR4Value))
+            return false;
+        if(trace)
+            trace->recordRegisterWrite(REG_TMU_OUT, lastR4Value, std::bitset<16>(0xFFFF));
+        return true;
+    }
     else if(signal == SIGNAL_END_PROGRAM)
     {
         // end program after the next 2 instructions
-        clock.schedule("Thread end", [this, remainingCycles{2}](uint32_t currentCycle) mutable -> bool {
-            if(remainingCycles > 0)
-            {
-                --remainingCycles;
-                return false;
-            }
-            stopExecution = true;
-            return true;
-        });
+        if(remainingEndDelay < 0)
+            remainingEndDelay = 2;
         return true;
     }
     else
@@ -2436,7 +2994,7 @@ void QPU::setFlags(const SIMDVector& output, ConditionCode cond, const VectorFla
 
 std::vector<MemoryAddress> tools::buildUniforms(Memory& memory, MemoryAddress baseAddress,
     const std::vector<MemoryAddress>& parameter, const WorkGroupConfig& config, MemoryAddress globalData,
-    const KernelUniforms& uniformsUsed, uint8_t workItemMergeFactor)
+    const KernelUniforms& uniformsUsed, uint8_t workItemMergeFactor, const std::array<Word, 3>& groupIDs)
 {
     std::vector<MemoryAddress> res;
 
@@ -2447,11 +3005,6 @@ std::vector<MemoryAddress> tools::buildUniforms(Memory& memory, MemoryAddress ba
     std::vector<Word> qpuUniforms;
     qpuUniforms.resize(uniformsUsed.countUniforms() + parameter.size());
 
-    if((config.numGroups[0] > 1 || config.numGroups[1] > 1 || config.numGroups[2] > 1) &&
-        !(uniformsUsed.getMaxGroupIDXUsed() && uniformsUsed.getMaxGroupIDYUsed() && uniformsUsed.getMaxGroupIDZUsed()))
-        throw CompilationError(CompilationStep::GENERAL,
-            "Emulator of multiple work-groups requires work-group-loop optimization to be enabled!");
-
     for(uint32_t q = 0; q < numQPUs; ++q)
     {
         std::array<Word, 3> localIDs = {q % config.localSizes[0], (q / config.localSizes[0]) % config.localSizes[1],
@@ -2471,11 +3024,11 @@ std::vector<MemoryAddress> tools::buildUniforms(Memory& memory, MemoryAddress ba
         if(uniformsUsed.getNumGroupsZUsed())
             qpuUniforms[i++] = config.numGroups[2];
         if(uniformsUsed.getGroupIDXUsed())
-            qpuUniforms[i++] = 0; // is only set for single work-groups
+            qpuUniforms[i++] = groupIDs[0];
         if(uniformsUsed.getGroupIDYUsed())
-            qpuUniforms[i++] = 0; // is only set for single work-groups
+            qpuUniforms[i++] = groupIDs[1];
         if(uniformsUsed.getGroupIDZUsed())
-            qpuUniforms[i++] = 0; // is only set for single work-groups
+            qpuUniforms[i++] = groupIDs[2];
         if(uniformsUsed.getGlobalOffsetXUsed())
             qpuUniforms[i++] = config.globalOffsets[0];
         if(uniformsUsed.getGlobalOffsetYUsed())
@@ -2503,18 +3056,61 @@ std::vector<MemoryAddress> tools::buildUniforms(Memory& memory, MemoryAddress ba
     return res;
 }
 
-static void emulateStep(std::vector<QPU>& qpus, std::bitset<NATIVE_VECTOR_SIZE>& activeQPUs)
+static void accumulateInstrumentation(InstrumentationResults& total, const InstrumentationResults& part)
+{
+    for(std::size_t i = 0; i < std::min(total.size(), part.size()); ++i)
+    {
+        total[i].numAddALUExecuted += part[i].numAddALUExecuted;
+        total[i].numAddALUSkipped += part[i].numAddALUSkipped;
+        total[i].numMulALUExecuted += part[i].numMulALUExecuted;
+        total[i].numMulALUSkipped += part[i].numMulALUSkipped;
+        total[i].numBranchTaken += part[i].numBranchTaken;
+        total[i].numStalls += part[i].numStalls;
+        total[i].numInstructionFetchStalls += part[i].numInstructionFetchStalls;
+        total[i].numUniformStalls += part[i].numUniformStalls;
+        total[i].numTMUStalls += part[i].numTMUStalls;
+        total[i].numMutexStalls += part[i].numMutexStalls;
+        total[i].numSemaphoreStalls += part[i].numSemaphoreStalls;
+        total[i].numVPMStalls += part[i].numVPMStalls;
+        total[i].numExecutions += part[i].numExecutions;
+    }
+}
+
+// The maximum number of instructions a QPU executes in one step of the functional emulation, limited to regularly
+// check for the maximum number of cycles
+static constexpr unsigned MAX_FUNCTIONAL_STEP_INSTRUCTIONS = 1024;
+
+/*
+ * Executes a single step for all active QPUs and returns whether any QPU made progress.
+ *
+ * In cycle-accurate mode, a step is a single cycle. In functional mode, every QPU runs until it blocks (or finishes).
+ */
+static bool emulateStep(
+    std::vector<QPU>& qpus, std::bitset<NATIVE_VECTOR_SIZE>& activeQPUs, bool functional, uint32_t maxInstructions)
 {
+    const unsigned maxStepInstructions = functional ? MAX_FUNCTIONAL_STEP_INSTRUCTIONS : 1;
+    bool anyProgress = false;
     for(std::size_t i = 0; i < qpus.size(); ++i)
     {
         if(!activeQPUs.test(i))
             continue;
         try
         {
-            bool continueRunning = qpus[i].execute();
-            if(!continueRunning)
-                // this QPU has finished
-                activeQPUs.reset(i);
+            // a step never runs a QPU past the instruction limit, so the limit is the same in all emulation modes
+            for(unsigned n = 0; n < maxStepInstructions && qpus[i].getNumExecutedInstructions() < maxInstructions; ++n)
+            {
+                bool continueRunning = qpus[i].execute();
+                if(!continueRunning)
+                {
+                    // this QPU has finished
+                    activeQPUs.reset(i);
+                    anyProgress = true;
+                    break;
+                }
+                if(qpus[i].isStalled())
+                    break;
+                anyProgress = true;
+            }
         }
         catch(const std::exception&)
         {
@@ -2525,17 +3121,139 @@ static void emulateStep(std::vector<QPU>& qpus, std::bitset<NATIVE_VECTOR_SIZE>&
             throw;
         }
     }
+    return anyProgress;
+}
+
+// The time all running QPUs need to be stalled without any progress to be considered to hang in the parallel
+// emulation. Since the host threads might not be scheduled for some time, this cannot simply be a number of retries.
+static constexpr std::chrono::milliseconds PARALLEL_HANG_TIMEOUT{1000};
+
+/*
+ * Runs the given QPU on the current host thread until it finishes, the emulation is aborted or the QPU times out or
+ * hangs together with all other QPUs.
+ */
+static void runQPU(QPU& qpu, QPUSynchronization& synchronization, uint32_t maxCycles, std::atomic_bool& timedOut,
+    std::atomic_bool& hang)
+{
+    bool wasStalled = false;
+    uint64_t lastEpoch = std::numeric_limits<uint64_t>::max();
+    std::chrono::steady_clock::time_point hangStart{};
+    while(!synchronization.isAborted() && qpu.execute())
+    {
+        // stalls are not counted, since how often a stalled instruction is retried depends on the host scheduling
+        if(qpu.getNumExecutedInstructions() >= maxCycles)
+        {
+            timedOut = true;
+            synchronization.abort();
+            break;
+        }
+        if(qpu.isStalled() != wasStalled)
+        {
+            wasStalled = qpu.isStalled();
+            synchronization.setStalled(qpu.ID, wasStalled);
+        }
+        if(!wasStalled)
+            continue;
+
+        auto allStalled = synchronization.checkAllStalled();
+        auto now = std::chrono::steady_clock::now();
+        if(!allStalled.first || allStalled.second != lastEpoch)
+        {
+            lastEpoch = allStalled.second;
+            hangStart = now;
+        }
+        else if(now - hangStart > PARALLEL_HANG_TIMEOUT)
+        {
+            // no QPU made any progress in the meantime, so they all block each other
+            hang = true;
+            synchronization.abort();
+            break;
+        }
+        // give the other QPUs the chance to release whatever this QPU is waiting for
+        std::this_thread::yield();
+    }
+}
+
+/*
+ * Emulates every QPU on its own host thread, returns whether all QPUs finished successfully
+ */
+static bool emulateInParallel(std::vector<QPU>& qpus, QPUSynchronization& synchronization, uint32_t maxCycles)
+{
+    std::vector<std::exception_ptr> errors(qpus.size());
+    std::atomic_bool timedOut{false};
+    std::atomic_bool hang{false};
+
+    std::vector<std::thread> threads;
+    threads.reserve(qpus.size());
+    for(auto& qpu : qpus)
+    {
+        threads.emplace_back([&, qpuPtr = &qpu]() {
+            QPU& qpu = *qpuPtr;
+            try
+            {
+                runQPU(qpu, synchronization, maxCycles, timedOut, hang);
+            }
+            catch(...)
+            {
+                // catch everything, since any exception escaping the thread would terminate the whole program
+                logging::error() << "Emulation threw exception execution in following instruction on QPU "
+                                 << static_cast<unsigned>(qpu.ID) << " (" << qpu.getCurrentInstructionIndex()
+                                 << "): " << qpu.getCurrentInstruction().toHexString(true) << logging::endl;
+                errors[qpu.ID] = std::current_exception();
+                synchronization.abort();
+            }
+            synchronization.finish(qpu.ID);
+        });
+    }
+    for(auto& thread : threads)
+        thread.join();
+
+    for(auto& error : errors)
+    {
+        if(error)
+            // re-throw error
+            std::rethrow_exception(error);
+    }
+    if(timedOut || hang)
+    {
+        if(timedOut)
+            logging::error() << "After the maximum number of executed instructions, following QPUs are still "
+                                "running: "
+                             << logging::endl;
+        else
+            logging::error() << "No progress for any running QPU, QPUs hang!" << logging::endl;
+        for(const QPU& qpu : qpus)
+            logging::error() << "QPU " << static_cast<unsigned>(qpu.ID) << ": "
+                             << qpu.getCurrentInstruction().toASMString() << logging::endl;
+        return false;
+    }
+    return true;
 }
 
 bool tools::emulate(std::vector<qpu_asm::Instruction>::const_iterator firstInstruction, Memory& memory,
     const std::vector<MemoryAddress>& uniformAddresses, InstrumentationResults& instrumentation,
-    const std::string& name, uint32_t maxCycles)
+    const std::string& name, uint32_t maxCycles, EmulationMode mode)
+{
+    const auto program = decodeInstructions(firstInstruction, instrumentation.size());
+    return emulate(firstInstruction, program, memory, uniformAddresses, instrumentation, name, maxCycles, mode);
+}
+
+bool tools::emulate(std::vector<qpu_asm::Instruction>::const_iterator firstInstruction,
+    const std::vector<DecodedInstruction>& program, Memory& memory, const std::vector<MemoryAddress>& uniformAddresses,
+    InstrumentationResults& instrumentation, const std::string& name, uint32_t maxCycles, EmulationMode mode,
+    TraceWriter* trace, uint32_t traceGroup, SharedMutexLock* sharedMutexLock)
 {
     if(uniformAddresses.size() > NUM_QPUS)
         throw CompilationError(CompilationStep::GENERAL, "Cannot use more than 12 QPUs!");
 
-    Mutex mutex;
+    const bool functional = mode != EmulationMode::CYCLE_ACCURATE;
+    std::unique_ptr<QPUSynchronization> synchronization;
+    if(mode == EmulationMode::PARALLEL || mode == EmulationMode::PARALLEL_RELAXED)
+        synchronization.reset(new QPUSynchronization(uniformAddresses.size(), mode == EmulationMode::PARALLEL));
+
+    Mutex mutex(sharedMutexLock);
     EmulationClock clock{};
+    clock.functional = functional;
     // FIXME is SFU execution per QPU or need SFUs be locked?
     std::vector<Slice> slices;
     slices.reserve(3);
@@ -2566,7 +3284,7 @@ bool tools::emulate(std::vector<qpu_asm::Instruction>::const_iterator firstInstr
         if(slices.size() <= (numQPU / 4))
             slices.emplace_back(Slice(static_cast<uint8_t>(slices.size()), clock, l2Cache));
         qpus.emplace_back(numQPU, clock, slices.at(numQPU / 4), mutex, sfus.at(numQPU), vpm, semaphores, uniformPointer,
-            instrumentation);
+            program, synchronization.get(), trace, traceGroup);
         ++numQPU;
     }
 
@@ -2578,54 +3296,79 @@ bool tools::emulate(std::vector<qpu_asm::Instruction>::const_iterator firstInstr
 
     bool success = true;
     PROFILE_START(Emulation);
-    while(activeQPUs.any())
+    if(synchronization)
+        success = emulateInParallel(qpus, *synchronization, maxCycles);
+    else
     {
-        CPPLOG_LAZY(logging::Level::DEBUG, log << "Emulating cycle: " << clock.currentCycle << logging::endl);
-        PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "emulation cycles (utilization)", qpus.size());
-
-        emulateStep(qpus, activeQPUs);
-        clock.executeClockCycle();
-
-        if(clock.currentCycle == maxCycles)
+        while(activeQPUs.any())
         {
-            logging::error() << "After the maximum number of execution cycles, following QPUs are still running: "
-                             << logging::endl;
-            for(const QPU& qpu : qpus)
-                logging::error() << "QPU " << static_cast<unsigned>(qpu.ID) << ": "
-                                 << qpu.getCurrentInstruction().toASMString() << logging::endl;
-            success = false;
-            break;
-        }
+            CPPLOG_LAZY(logging::Level::DEBUG, log << "Emulating cycle: " << clock.currentCycle << logging::endl);
+            PROFILE_COUNTER(vc4c::profiler::COUNTER_EMULATOR, "emulation cycles (utilization)", qpus.size());
 
-        if(!clock.hasAsynchronousExecutions())
-        {
-            std::vector<std::pair<ProgramCounter, uint64_t>> currentProgramCounters;
-            currentProgramCounters.reserve(qpus.size());
-            for(auto& qpu : qpus)
-            {
-                if(activeQPUs.test(qpu.ID))
-                    currentProgramCounters.emplace_back(
-                        qpu.getCurrentInstructionIndex(), qpu.getCurrentInstruction().toBinaryCode());
-            }
-            if(lastInstructionHadNoAsynchronousExecutions && lastProgramCounters == currentProgramCounters)
+            bool anyProgress = emulateStep(qpus, activeQPUs, functional, maxCycles);
+            clock.executeClockCycle();
+
+            if(std::any_of(qpus.begin(), qpus.end(), [&](const QPU& qpu) -> bool {
+                   return activeQPUs.test(qpu.ID) && qpu.getNumExecutedInstructions() >= maxCycles;
+               }))
             {
-                // this and the last instruction had no asynchronous execution running and the program counters of all
-                // QPUs are identical -> we hung
-                logging::error() << "No progress for the last two instructions, QPUs hang!" << logging::endl;
+                logging::error() << "After the maximum number of executed instructions, following QPUs are still "
+                                    "running: "
+                                 << logging::endl;
                 for(const QPU& qpu : qpus)
                     logging::error() << "QPU " << static_cast<unsigned>(qpu.ID) << ": "
                                      << qpu.getCurrentInstruction().toASMString() << logging::endl;
                 success = false;
                 break;
             }
-            lastInstructionHadNoAsynchronousExecutions = true;
-            lastProgramCounters = std::move(currentProgramCounters);
+
+            if(functional)
+            {
+                // there are no delays in functional mode, so if no QPU can continue, they all block each other
+                if(!anyProgress && activeQPUs.any())
+                {
+                    logging::error() << "No progress for any running QPU, QPUs hang!" << logging::endl;
+                    for(const QPU& qpu : qpus)
+                        logging::error() << "QPU " << static_cast<unsigned>(qpu.ID) << ": "
+                                         << qpu.getCurrentInstruction().toASMString() << logging::endl;
+                    success = false;
+                    break;
+                }
+            }
+            else if(!clock.hasAsynchronousExecutions())
+            {
+                std::vector<std::pair<ProgramCounter, uint64_t>> currentProgramCounters;
+                currentProgramCounters.reserve(qpus.size());
+                for(auto& qpu : qpus)
+                {
+                    if(activeQPUs.test(qpu.ID))
+                        currentProgramCounters.emplace_back(
+                            qpu.getCurrentInstructionIndex(), qpu.getCurrentInstruction().toBinaryCode());
+                }
+                if(lastInstructionHadNoAsynchronousExecutions && lastProgramCounters == currentProgramCounters)
+                {
+                    // this and the last instruction had no asynchronous execution running and the program counters of
+                    // all QPUs are identical -> we hung
+                    logging::error() << "No progress for the last two instructions, QPUs hang!" << logging::endl;
+                    for(const QPU& qpu : qpus)
+                        logging::error() << "QPU " << static_cast<unsigned>(qpu.ID) << ": "
+                                         << qpu.getCurrentInstruction().toASMString() << logging::endl;
+                    success = false;
+                    break;
+                }
+                lastInstructionHadNoAsynchronousExecutions = true;
+                lastProgramCounters = std::move(currentProgramCounters);
+            }
+            else
+                lastInstructionHadNoAsynchronousExecutions = false;
         }
-        else
-            lastInstructionHadNoAsynchronousExecutions = false;
     }
     PROFILE_END_EXTREMA(Emulation, name);
 
+    // the QPUs count into their own instrumentation results, so they do not need to synchronize on every instruction
+    for(const QPU& qpu : qpus)
+        accumulateInstrumentation(instrumentation, qpu.getInstrumentation());
+
     // Run some sanity checks
     semaphores.checkAllZero();
     if(mutex.isLocked())
@@ -2634,9 +3377,13 @@ bool tools::emulate(std::vector<qpu_asm::Instruction>::const_iterator firstInstr
     }
     clock.logPendingExecutions();
 
+    uint32_t numInstructions = 0;
+    for(const QPU& qpu : qpus)
+        numInstructions = std::max(numInstructions, qpu.getNumExecutedInstructions());
     CPPLOG_LAZY(logging::Level::INFO,
         log << "Emulation " << (success ? "finished" : "timed out") << " for " << uniformAddresses.size()
-            << " QPUs after " << clock.currentCycle << " cycles" << logging::endl);
+            << " QPUs after " << numInstructions << " instructions"
+            << (functional ? "" : " (" + std::to_string(clock.currentCycle) + " cycles)") << logging::endl);
 
     vpm.dumpContents();
     return success;
@@ -2657,8 +3404,71 @@ bool tools::emulateTask(std::vector<qpu_asm::Instruction>::const_iterator firstI
     return emulate(firstInstruction, memory, uniformAddresses, instrumentation, name, maxCycles);
 }
 
+uint64_t tools::benchmarkRegisterAccesses(uint32_t numRounds, std::chrono::nanoseconds& duration)
+{
+    // every round reads 2 UNIFORMs
+    Memory memory(2 * numRounds + 16);
+    memory.setUniforms(std::vector<Word>(2 * numRounds, 0x42), 0);
+    const std::vector<qpu_asm::Instruction> instructions;
+    const std::vector<DecodedInstruction> program;
+    EmulationClock clock{};
+    clock.functional = true;
+    L2Cache l2Cache(clock, memory, instructions.begin());
+    Slice slice(0, clock, l2Cache);
+    Mutex mutex;
+    SFU sfu(clock);
+    VPM vpm(clock, memory);
+    Semaphores semaphores;
+    QPU qpu(0, clock, slice, mutex, sfu, vpm, semaphores, 0, program);
+    Registers registers(qpu);
+
+    const Register ra1{RegisterFile::PHYSICAL_A, 1};
+    const Register rb1{RegisterFile::PHYSICAL_B, 1};
+    const std::bitset<16> allElements(0xFFFF);
+    uint64_t numAccesses = 0;
+    auto read = [&](const Register& reg) -> SIMDVector {
+        ++numAccesses;
+        return registers.readRegister(reg, true).first;
+    };
+    auto write = [&](const Register& reg, const SIMDVector& val) {
+        ++numAccesses;
+        registers.writeRegister(reg, val, allElements, BITMASK_ALL);
+    };
+
+    // same register accesses as the instructions "or r0, unif, unif", "or ra1, r0, unif; v8min rb1, r0, r0",
+    // "or r1, r0, elem_num" and "or r2, ra1, rb1; v8min r3, r1, r1" (the second UNIFORM read of an instruction is
+    // served from the read cache), without the actual ALU operations
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < numRounds; ++i)
+    {
+        auto uniform = read(REG_UNIFORM);
+        read(REG_UNIFORM);
+        write(REG_ACC0, uniform);
+        registers.clearReadCache();
+
+        auto acc0 = read(REG_ACC0);
+        write(ra1, read(REG_UNIFORM));
+        read(REG_ACC0);
+        write(rb1, acc0);
+        registers.clearReadCache();
+
+        read(REG_ACC0);
+        write(REG_ACC1, read(REG_ELEMENT_NUMBER));
+        registers.clearReadCache();
+
+        write(REG_ACC2, read(ra1));
+        read(rb1);
+        auto acc1 = read(REG_ACC1);
+        read(REG_ACC1);
+        write(REG_ACC3, acc1);
+        registers.clearReadCache();
+    }
+    duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    return numAccesses;
+}
+
 static Memory fillMemory(const StableList<Global>& globalData, const EmulationData& settings,
-    MemoryAddress& uniformBaseAddressOut, MemoryAddress& globalDataAddressOut,
+    std::vector<tools::Word>&& storage, MemoryAddress& uniformBaseAddressOut, MemoryAddress& globalDataAddressOut,
     std::vector<MemoryAddress>& parameterAddressesOut)
 {
     auto globalDataSize =
@@ -2674,7 +3484,7 @@ static Memory fillMemory(const StableList<Global>& globalData, const EmulationDa
     while((size % 64) != 0)
         ++size;
     size += settings.calcNumWorkItems() * (16 + settings.parameter.size());
-    Memory mem(size);
+    Memory mem(std::move(storage), size);
 
     MemoryAddress currentAddress = 0;
     globalDataAddressOut = currentAddress;
@@ -2789,96 +3599,408 @@ std::string InstrumentationResult::to_string() const
     if(numStalls > 0)
     {
         tmp << "stall: " << numStalls;
+        const std::array<std::pair<const char*, unsigned>, 6> reasons = {{{"fetch", numInstructionFetchStalls},
+            {"uniform", numUniformStalls}, {"tmu", numTMUStalls}, {"mutex", numMutexStalls},
+            {"semaphore", numSemaphoreStalls}, {"vpm", numVPMStalls}}};
+        std::vector<std::string> reasonParts;
+        for(const auto& reason : reasons)
+        {
+            if(reason.second > 0)
+                reasonParts.emplace_back(std::string(reason.first) + ": " + std::to_string(reason.second));
+        }
+        if(!reasonParts.empty())
+            tmp << " (" << vc4c::to_string<std::string>(reasonParts) << ")";
         parts.emplace_back(tmp.str());
         tmp = std::stringstream{};
     }
 
     return vc4c::to_string<std::string>(parts);
 }
+
+/*
+ * A basic block of the emulated kernel code, covering the instructions [start, end)
+ */
+struct CodeBlock
+{
+    std::string name;
+    std::size_t start;
+    std::size_t end;
+};
+
+/*
+ * Returns the index of the instruction the branch at the given index jumps to, if it is known statically and lies
+ * within the kernel code
+ */
+static Optional<std::size_t> getBranchTarget(
+    std::vector<qpu_asm::Instruction>::const_iterator firstInstruction, std::size_t index, std::size_t numInstructions)
+{
+    auto branch = (firstInstruction + static_cast<std::ptrdiff_t>(index))->as<qpu_asm::BranchInstruction>();
+    if(!branch || branch->getAddRegister() == BranchReg::BRANCH_REG)
+        return {};
+    auto target = static_cast<int64_t>(branch->getImmediate() / static_cast<int32_t>(sizeof(uint64_t)));
+    if(branch->getBranchRelative() == BranchRel::BRANCH_RELATIVE)
+        target += static_cast<int64_t>(index) + 4 /* Branch starts at PC + 4 */;
+    if(target >= 0 && static_cast<std::size_t>(target) < numInstructions)
+        return static_cast<std::size_t>(target);
+    return {};
+}
+
+/*
+ * Splits the kernel code into basic blocks, starting at the branch targets and after the delay slots of the branches.
+ *
+ * Branches to a register value cannot be resolved statically, so their targets might lie within a block.
+ */
+static std::vector<CodeBlock> findCodeBlocks(std::vector<qpu_asm::Instruction>::const_iterator firstInstruction,
+    std::size_t numInstructions, const std::string& kernelName)
+{
+    std::set<std::size_t> blockStarts{0};
+    for(std::size_t i = 0; i < numInstructions; ++i)
+    {
+        if(!(firstInstruction + static_cast<std::ptrdiff_t>(i))->as<qpu_asm::BranchInstruction>())
+            continue;
+        // if not taken, the execution continues after the 3 delay slots
+        if(i + 4 < numInstructions)
+            blockStarts.emplace(i + 4);
+        if(auto target = getBranchTarget(firstInstruction, i, numInstructions))
+            blockStarts.emplace(*target);
+    }
+
+    const std::string baseName = kernelName.empty() ? "kernel" : kernelName;
+    std::vector<CodeBlock> blocks;
+    blocks.reserve(blockStarts.size());
+    for(auto start : blockStarts)
+    {
+        if(!blocks.empty())
+            blocks.back().end = start;
+        blocks.emplace_back(CodeBlock{baseName + ".block" + std::to_string(blocks.size()), start, numInstructions});
+    }
+    return blocks;
+}
+
+/*
+ * Writes the instrumentation results annotated to the kernel code, including the share of the cycles spent in every
+ * instruction and basic block
+ */
+static void dumpInstrumentation(const std::string& fileName,
+    std::vector<qpu_asm::Instruction>::const_iterator firstInstruction,
+    const std::vector<InstrumentationResult>& instrumentation, const std::string& kernelName)
+{
+    auto totalCycles = std::accumulate(instrumentation.begin(), instrumentation.end(), uint64_t{0},
+        [](uint64_t sum, const InstrumentationResult& res) -> uint64_t { return sum + res.numExecutions; });
+    auto toShare = [totalCycles](uint64_t cycles) -> double {
+        return totalCycles == 0 ? 0.0 : (100.0 * static_cast<double>(cycles)) / static_cast<double>(totalCycles);
+    };
+
+    std::ofstream f(fileName);
+    f << std::fixed << std::setprecision(2);
+    for(const auto& block : findCodeBlocks(firstInstruction, instrumentation.size(), kernelName))
+    {
+        uint64_t blockCycles = 0;
+        uint64_t blockStalls = 0;
+        for(std::size_t i = block.start; i < block.end; ++i)
+        {
+            blockCycles += instrumentation[i].numExecutions;
+            blockStalls += instrumentation[i].numStalls;
+        }
+        f << "// " << block.name << ": " << blockCycles << " cycles (" << toShare(blockCycles) << "%), "
+          << blockStalls << " stalls" << std::endl;
+        for(std::size_t i = block.start; i < block.end; ++i)
+        {
+            f << std::left << std::setw(80)
+              << (firstInstruction + static_cast<std::ptrdiff_t>(i))->toASMString() << "//" << std::right
+              << std::setw(6) << toShare(instrumentation[i].numExecutions) << "% "
+              << instrumentation[i].to_string() << std::endl;
+        }
+    }
+}
+
+/*
+ * Writes the instrumentation results as profile in the callgrind format (see
+ * https://valgrind.org/docs/manual/cl-format.html), which can be viewed e.g. with KCachegrind.
+ *
+ * Every basic block is written as a function, the position of an instruction is its byte offset in the kernel code.
+ * Taken branches to statically known targets are written as calls to the target block without any inclusive costs.
+ */
+static void writeProfile(const std::string& fileName,
+    std::vector<qpu_asm::Instruction>::const_iterator firstInstruction,
+    const std::vector<InstrumentationResult>& instrumentation, const std::string& kernelName)
+{
+    auto toCosts = [](const InstrumentationResult& res) -> std::array<uint64_t, 8> {
+        return {{res.numExecutions, res.numStalls, res.numInstructionFetchStalls, res.numUniformStalls,
+            res.numTMUStalls, res.numMutexStalls, res.numSemaphoreStalls, res.numVPMStalls}};
+    };
+
+    std::array<uint64_t, 8> totals{};
+    for(const auto& res : instrumentation)
+    {
+        auto costs = toCosts(res);
+        std::transform(totals.begin(), totals.end(), costs.begin(), totals.begin(), std::plus<uint64_t>{});
+    }
+
+    std::ofstream f(fileName);
+    f << "# callgrind format" << std::endl;
+    f << "version: 1" << std::endl;
+    f << "creator: VC4C emulator" << std::endl;
+    f << "positions: instr" << std::endl;
+    f << "events: Cycles Stalls FetchStalls UniformStalls TMUStalls MutexStalls SemaphoreStalls VPMStalls"
+      << std::endl;
+    f << "summary:";
+    for(auto total : totals)
+        f << ' ' << total;
+    f << std::endl << std::endl;
+
+    const auto blocks = findCodeBlocks(firstInstruction, instrumentation.size(), kernelName);
+    auto findBlock = [&blocks](std::size_t index) -> const CodeBlock& {
+        return *std::find_if(
+            blocks.begin(), blocks.end(), [index](const CodeBlock& block) -> bool { return block.end > index; });
+    };
+
+    f << "fl=" << (kernelName.empty() ? "kernel" : kernelName) << std::endl;
+    for(const auto& block : blocks)
+    {
+        f << "fn=" << block.name << std::endl;
+        for(std::size_t i = block.start; i < block.end; ++i)
+        {
+            if(instrumentation[i].numExecutions == 0)
+                continue;
+            f << "0x" << std::hex << i * sizeof(uint64_t) << std::dec;
+            for(auto cost : toCosts(instrumentation[i]))
+                f << ' ' << cost;
+            f << std::endl;
+            auto target = getBranchTarget(firstInstruction, i, instrumentation.size());
+            if(target && instrumentation[i].numBranchTaken > 0)
+            {
+                f << "cfn=" << findBlock(*target).name << std::endl;
+                f << "calls=" << instrumentation[i].numBranchTaken << " 0x" << std::hex << *target * sizeof(uint64_t)
+                  << std::endl;
+                f << "0x" << i * sizeof(uint64_t) << std::dec;
+                for(std::size_t k = 0; k < totals.size(); ++k)
+                    f << " 0";
+                f << std::endl;
+            }
+        }
+    }
+}
 LCOV_EXCL_STOP
 
-EmulationResult tools::emulate(const EmulationData& data)
+/*
+ * Writes the UNIFORMs for all work-groups and returns the UNIFORM addresses for the QPUs of each group to emulate.
+ *
+ * Kernels compiled with the work-group loop iterate all work-groups themselves, so they are emulated in a single
+ * run. Otherwise, every work-group gets its own UNIFORM stream and is emulated separately.
+ */
+static std::vector<std::vector<MemoryAddress>> buildGroupUniforms(Memory& memory, MemoryAddress baseAddress,
+    const std::vector<MemoryAddress>& parameter, const WorkGroupConfig& config, MemoryAddress globalData,
+    const KernelUniforms& uniformsUsed, uint8_t workItemMergeFactor)
+{
+    bool hasWorkGroupLoop =
+        uniformsUsed.getMaxGroupIDXUsed() && uniformsUsed.getMaxGroupIDYUsed() && uniformsUsed.getMaxGroupIDZUsed();
+    if(hasWorkGroupLoop)
+        return {buildUniforms(memory, baseAddress, parameter, config, globalData, uniformsUsed, workItemMergeFactor)};
+
+    const auto uniformsSize =
+        static_cast<MemoryAddress>((uniformsUsed.countUniforms() + parameter.size()) * sizeof(tools::Word));
+    std::vector<std::vector<MemoryAddress>> res;
+    res.reserve(config.numGroups[0] * config.numGroups[1] * config.numGroups[2]);
+    for(tools::Word z = 0; z < config.numGroups[2]; ++z)
+    {
+        for(tools::Word y = 0; y < config.numGroups[1]; ++y)
+        {
+            for(tools::Word x = 0; x < config.numGroups[0]; ++x)
+            {
+                res.emplace_back(buildUniforms(
+                    memory, baseAddress, parameter, config, globalData, uniformsUsed, workItemMergeFactor, {x, y, z}));
+                baseAddress = res.back().back() + uniformsSize;
+            }
+        }
+    }
+    return res;
+}
+
+struct EmulationSession::SessionData
 {
     ModuleHeader module;
     StableList<Global> globals;
     std::vector<qpu_asm::Instruction> instructions;
-    extractBinary(data.module, module, globals, instructions);
-    if(instructions.empty())
+    const KernelHeader* kernel = nullptr;
+    // the offset of the first instruction of the kernel into the instructions of the module
+    std::size_t kernelOffset = 0;
+    std::vector<DecodedInstruction> program;
+
+    std::mutex storageLock;
+    // the memory storage of finished emulations to be reused
+    std::vector<std::vector<tools::Word>> freeStorage;
+
+    std::vector<tools::Word> acquireStorage()
+    {
+        std::lock_guard<std::mutex> guard(storageLock);
+        if(freeStorage.empty())
+            return {};
+        auto storage = std::move(freeStorage.back());
+        freeStorage.pop_back();
+        return storage;
+    }
+
+    void releaseStorage(std::vector<tools::Word>&& storage)
+    {
+        std::lock_guard<std::mutex> guard(storageLock);
+        freeStorage.emplace_back(std::move(storage));
+    }
+};
+
+EmulationSession::EmulationSession(const CompilationData& module, const std::string& kernelName) :
+    data(std::make_unique<SessionData>())
+{
+    PROFILE_SCOPE(LoadEmulationSession);
+    extractBinary(module, data->module, data->globals, data->instructions);
+    if(data->instructions.empty())
         throw CompilationError(CompilationStep::GENERAL, "Extracted module has no instructions!");
-    if(module.kernels.empty())
+    if(data->module.kernels.empty())
         throw CompilationError(CompilationStep::GENERAL, "Extracted module has no kernels!");
 
-    auto kernel = std::find_if(module.kernels.begin(), module.kernels.end(),
-        [&data](const auto& kernel) -> bool { return kernel.name == data.kernelName; });
-    if(data.kernelName.empty() && module.kernels.size() == 1)
-        kernel = module.kernels.begin();
-    if(kernel == module.kernels.end())
-        throw CompilationError(CompilationStep::GENERAL, "Failed to find kernel header for kernel", data.kernelName);
+    auto kernel = std::find_if(data->module.kernels.begin(), data->module.kernels.end(),
+        [&kernelName](const auto& kernel) -> bool { return kernel.name == kernelName; });
+    if(kernelName.empty() && data->module.kernels.size() == 1)
+        kernel = data->module.kernels.begin();
+    if(kernel == data->module.kernels.end())
+        throw CompilationError(CompilationStep::GENERAL, "Failed to find kernel header for kernel", kernelName);
+    data->kernel = &*kernel;
+    data->kernelOffset = kernel->getOffset() - data->module.kernels.front().getOffset();
+    using Offset = std::vector<qpu_asm::Instruction>::difference_type;
+    data->program = decodeInstructions(
+        data->instructions.begin() + static_cast<Offset>(data->kernelOffset), kernel->getLength());
+}
+
+EmulationSession::EmulationSession(EmulationSession&&) noexcept = default;
+EmulationSession::~EmulationSession() noexcept = default;
+EmulationSession& EmulationSession::operator=(EmulationSession&&) noexcept = default;
+
+EmulationResult EmulationSession::emulate(const EmulationData& job) const
+{
+    const auto& kernel = *data->kernel;
     // Count number of direct parameter words (e.g. also for literal vectors)
-    auto numKernelWords = std::accumulate(kernel->parameters.begin(), kernel->parameters.end(), 0u,
+    auto numKernelWords = std::accumulate(kernel.parameters.begin(), kernel.parameters.end(), 0u,
         [](unsigned u, const auto& param) -> unsigned { return u + param.getVectorElements(); });
-    if(data.parameter.size() != numKernelWords)
+    if(job.parameter.size() != numKernelWords)
         throw CompilationError(CompilationStep::GENERAL,
-            "The number of parameters specified (" + std::to_string(data.parameter.size()) +
+            "The number of parameters specified (" + std::to_string(job.parameter.size()) +
                 ") does not match the number of kernel arguments (" +
-                std::to_string(static_cast<unsigned>(kernel->getParamCount())) + ')');
+                std::to_string(static_cast<unsigned>(kernel.getParamCount())) + ')');
 
     MemoryAddress uniformAddress{};
     MemoryAddress globalDataAddress{};
     std::vector<MemoryAddress> paramAddresses;
-    Memory mem(fillMemory(globals, data, uniformAddress, globalDataAddress, paramAddresses));
-
-    auto mergeFactor = std::max(kernel->workItemMergeFactor, uint8_t{1});
-    auto uniformAddresses = buildUniforms(
-        mem, uniformAddress, paramAddresses, data.workGroup, globalDataAddress, kernel->uniformsUsed, mergeFactor);
-
-    if(!data.memoryDump.empty())
-        dumpMemory(mem, data.memoryDump, uniformAddress, true);
-
-    InstrumentationResults instrumentation(kernel->getLength());
-    bool status = emulate(instructions.begin() +
-            static_cast<std::vector<qpu_asm::Instruction>::difference_type>(
-                (kernel->getOffset() - module.kernels.front().getOffset())),
-        mem, uniformAddresses, instrumentation, data.kernelName, data.maxEmulationCycles);
+    Memory mem(fillMemory(
+        data->globals, job, data->acquireStorage(), uniformAddress, globalDataAddress, paramAddresses));
+
+    auto mergeFactor = std::max(kernel.workItemMergeFactor, uint8_t{1});
+    auto groupUniformAddresses = buildGroupUniforms(mem, uniformAddress, paramAddresses, job.workGroup,
+        globalDataAddress, kernel.uniformsUsed, mergeFactor);
+
+    if(!job.memoryDump.empty())
+        dumpMemory(mem, job.memoryDump, uniformAddress, true);
+
+    auto mode = job.functionalEmulation ? EmulationMode::FUNCTIONAL : EmulationMode::CYCLE_ACCURATE;
+    if(job.parallelEmulation)
+        mode = job.relaxedSynchronization ? EmulationMode::PARALLEL_RELAXED : EmulationMode::PARALLEL;
+
+    const auto firstInstruction = data->instructions.begin() +
+        static_cast<std::vector<qpu_asm::Instruction>::difference_type>(data->kernelOffset);
+    std::unique_ptr<TraceWriter> trace;
+    if(!job.traceDump.empty())
+        trace = std::make_unique<TraceWriter>(job.traceDump);
+    InstrumentationResults instrumentation(kernel.getLength());
+    bool status = true;
+    if(groupUniformAddresses.size() == 1)
+        status = tools::emulate(firstInstruction, data->program, mem, groupUniformAddresses.front(), instrumentation,
+            kernel.name, job.maxEmulationCycles, mode, trace.get());
+    else
+    {
+        // Every work-group is emulated on its own set of QPUs, like the host library executes one work-group after
+        // the other. The groups only share the memory and the hardware mutex (e.g. for atomic operations across
+        // work-groups), so they can be emulated concurrently.
+        std::mutex resultLock;
+        SharedMutexLock hardwareMutexLock;
+        auto emulateGroup = [&](uint32_t groupIndex) {
+            InstrumentationResults groupInstrumentation(kernel.getLength());
+            bool groupStatus = tools::emulate(firstInstruction, data->program, mem, groupUniformAddresses[groupIndex],
+                groupInstrumentation, kernel.name, job.maxEmulationCycles, mode, trace.get(), groupIndex,
+                &hardwareMutexLock);
+            std::lock_guard<std::mutex> guard(resultLock);
+            status = status && groupStatus;
+            accumulateInstrumentation(instrumentation, groupInstrumentation);
+        };
+        CPPLOG_LAZY(logging::Level::DEBUG,
+            log << "Emulating " << groupUniformAddresses.size() << " work-groups concurrently" << logging::endl);
+        ThreadPool::TaskGroup group(ThreadPool::getSharedPool());
+        for(uint32_t i = 0; i < groupUniformAddresses.size(); ++i)
+            group.schedule([&emulateGroup, i]() { emulateGroup(i); });
+        group.wait();
+    }
 
-    if(!data.memoryDump.empty())
-        dumpMemory(mem, data.memoryDump, uniformAddress, false);
+    if(!job.memoryDump.empty())
+        dumpMemory(mem, job.memoryDump, uniformAddress, false);
 
-    EmulationResult result{data, status, {}};
+    EmulationResult result{job, status, {}};
 
-    result.results.reserve(data.parameter.size());
-    for(std::size_t i = 0; i < data.parameter.size(); ++i)
+    result.results.reserve(job.parameter.size());
+    for(std::size_t i = 0; i < job.parameter.size(); ++i)
     {
-        if(!data.parameter[i].second)
-            result.results.emplace_back(std::make_pair(data.parameter[i].first, Optional<std::vector<uint32_t>>{}));
+        if(!job.parameter[i].second)
+            result.results.emplace_back(std::make_pair(job.parameter[i].first, Optional<std::vector<uint32_t>>{}));
         else
         {
             result.results.emplace_back(std::make_pair(paramAddresses[i], std::vector<uint32_t>{}));
-            std::copy_n(mem.getWordAddress(paramAddresses[i]), data.parameter[i].second->size(),
+            std::copy_n(mem.getWordAddress(paramAddresses[i]), job.parameter[i].second->size(),
                 std::back_inserter(*result.results[i].second));
         }
     }
+    data->releaseStorage(mem.releaseStorage());
 
     // Map and dump instrumentation results
-    std::unique_ptr<std::ofstream> dumpInstrumentation;
-    if(!data.instrumentationDump.empty())
-        dumpInstrumentation = std::make_unique<std::ofstream>(data.instrumentationDump);
-    std::size_t baseIndex = (kernel->getOffset() - module.kernels.front().getOffset());
-    result.instrumentation.reserve(kernel->getLength());
-    for(std::size_t i = 0; i < kernel->getLength(); ++i)
+    result.instrumentation.reserve(kernel.getLength());
+    for(std::size_t i = 0; i < kernel.getLength(); ++i)
     {
-        auto& it = instructions.at(baseIndex + i);
         result.instrumentation.emplace_back(instrumentation.at(i));
-        if(dumpInstrumentation)
-            *dumpInstrumentation << std::left << std::setw(80) << it.toASMString() << "//"
-                                 << instrumentation[i].to_string() << std::endl;
-        if(it.getSig() == SIGNAL_END_PROGRAM)
+        if((firstInstruction + static_cast<std::ptrdiff_t>(i))->getSig() == SIGNAL_END_PROGRAM)
             break;
     }
+    if(!job.instrumentationDump.empty())
+        dumpInstrumentation(job.instrumentationDump, firstInstruction, result.instrumentation, kernel.name);
+    if(!job.profileDump.empty())
+        writeProfile(job.profileDump, firstInstruction, result.instrumentation, kernel.name);
 
     return result;
 }
 
+void EmulationSession::emulate(const std::vector<EmulationData>& jobs,
+    const std::function<void(std::size_t, EmulationResult&&)>& consumer, bool parallel) const
+{
+    if(!parallel)
+    {
+        for(std::size_t i = 0; i < jobs.size(); ++i)
+            consumer(i, emulate(jobs[i]));
+        return;
+    }
+
+    std::mutex consumerLock;
+    ThreadPool::TaskGroup group(ThreadPool::getSharedPool());
+    for(std::size_t i = 0; i < jobs.size(); ++i)
+    {
+        group.schedule([&, i]() {
+            auto result = emulate(jobs[i]);
+            std::lock_guard<std::mutex> guard(consumerLock);
+            consumer(i, std::move(result));
+        });
+    }
+    group.wait();
+}
+
+EmulationResult tools::emulate(const EmulationData& data)
+{
+    return EmulationSession(data.module, data.kernelName).emulate(data);
+}
+
 static std::vector<qpu_asm::Instruction> extractInstructions(const uint64_t* start, uint32_t numInstructions)
 {
     std::vector<qpu_asm::Instruction> res;
@@ -2911,20 +4033,15 @@ LowLevelEmulationResult tools::emulate(const LowLevelEmulationData& data)
     result.executionSuccessful = status;
 
     // Map and dump instrumentation results
-    std::unique_ptr<std::ofstream> dumpInstrumentation;
-    if(!data.instrumentationDump.empty())
-        dumpInstrumentation = std::make_unique<std::ofstream>(data.instrumentationDump);
     result.instrumentation.reserve(data.numInstructions);
     for(std::size_t i = 0; i < data.numInstructions; ++i)
     {
-        auto& it = instructions[i];
         result.instrumentation.emplace_back(instrumentation.at(i));
-        if(dumpInstrumentation)
-            *dumpInstrumentation << std::left << std::setw(80) << it.toASMString() << "//"
-                                 << instrumentation[i].to_string() << std::endl;
-        if(it.getSig() == SIGNAL_END_PROGRAM)
+        if(instructions[i].getSig() == SIGNAL_END_PROGRAM)
             break;
     }
+    if(!data.instrumentationDump.empty())
+        dumpInstrumentation(data.instrumentationDump, instructions.begin(), result.instrumentation, "");
 
     return result;
 }
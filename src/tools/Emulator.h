@@ -11,18 +11,23 @@
 #include "../Values.h"
 #include "../asm/OpCodes.h"
 #include "../performance.h"
+#include "EmulationTrace.h"
 #include "config.h"
 #include "tools.h"
 
 #include <array>
 #include <atomic>
 #include <bitset>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <deque>
 #include <future>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <shared_mutex>
 
 namespace vc4c
 {
@@ -38,7 +43,9 @@ namespace vc4c
     {
         class Slice;
         class QPU;
+        class QPUSynchronization;
         class EmulationClock;
+        struct DecodedInstruction;
 
         template <typename T>
         using AsynchronousHandle = std::promise<T>;
@@ -55,6 +62,13 @@ namespace vc4c
              * Use a direct buffer
              */
             explicit Memory(std::size_t size) : data(DirectBuffer(size, 0xDEADBEEF)) {}
+            /*
+             * Use a direct buffer, reusing the given storage (e.g. of a previous emulation)
+             */
+            Memory(std::vector<Word>&& storage, std::size_t size) : data(std::move(storage))
+            {
+                VariantNamespace::get<DirectBuffer>(data).assign(size, 0xDEADBEEF);
+            }
             /*
              * Use a mapping of existing buffers
              *
@@ -62,14 +76,27 @@ namespace vc4c
              * [start "device address", start "device address"+ buffer.size())
              */
             explicit Memory(const std::map<uint32_t, std::reference_wrapper<std::vector<uint8_t>>>& buffers) :
-                data(MappedBuffers(buffers))
+                data(PageTable(buffers))
             {
             }
+            // the access lock is not moved, since the memory must not be accessed while it is moved
+            Memory(Memory&& other) noexcept : NonCopyable(std::move(other)), data(std::move(other.data)) {}
+            Memory& operator=(Memory&&) = delete;
+            ~Memory() = default;
 
             Word* getWordAddress(MemoryAddress address);
             const Word* getWordAddress(MemoryAddress address) const;
 
             Word readWord(MemoryAddress address) const;
+            /*
+             * Acquires shared (for reading) or exclusive (for writing) access to the memory contents for direct
+             * accesses via the word addresses, e.g. by VPM DMA.
+             *
+             * QPUs emulated on different host threads read from the memory (e.g. via TMU or UNIFORM reads) while other
+             * QPUs write into it, so any write needs to hold the exclusive lock.
+             */
+            std::shared_lock<std::shared_timed_mutex> lockForReading() const;
+            std::unique_lock<std::shared_timed_mutex> lockForWriting();
             AsynchronousExecution startMemoryRead(AsynchronousHandle<Word>&& handle, MemoryAddress address) const;
             MemoryAddress incrementAddress(MemoryAddress address, DataType typeSize) const;
 
@@ -77,15 +104,93 @@ namespace vc4c
             void assertAddressInMemory(MemoryAddress address, std::size_t numBytes) const;
             void setUniforms(const std::vector<Word>& uniforms, MemoryAddress address);
 
+            /*
+             * Releases the storage of the direct buffer to be reused by another memory object. Afterwards, this memory
+             * is empty.
+             */
+            std::vector<Word> releaseStorage();
+
         private:
             using DirectBuffer = std::vector<Word>;
             using MappedBuffers = std::map<uint32_t, std::reference_wrapper<std::vector<uint8_t>>>;
-            Variant<DirectBuffer, MappedBuffers> data;
+
+            /*
+             * Maps the 32-bit device address space to the mapped buffers via a flat two-level page table, so looking up
+             * the buffer containing an address takes constant time independent of the number of buffers.
+             *
+             * NOTE: The mapped buffers must not be resized while they are mapped!
+             */
+            class PageTable
+            {
+            public:
+                struct Buffer
+                {
+                    MemoryAddress start;
+                    // exclusive, might be outside of the 32-bit address space
+                    uint64_t end;
+                    uint8_t* data;
+                };
+
+                explicit PageTable(const MappedBuffers& mappedBuffers);
+
+                /*
+                 * Returns the buffer completely containing the range [address, address + numBytes) or nullptr
+                 */
+                const Buffer* findBuffer(MemoryAddress address, std::size_t numBytes) const noexcept;
+
+                const std::vector<Buffer>& getBuffers() const noexcept
+                {
+                    return buffers;
+                }
+
+            private:
+                static constexpr unsigned PAGE_OFFSET_BITS = 12;
+                static constexpr unsigned PAGE_INDEX_BITS = 10;
+                static constexpr unsigned DIRECTORY_BITS = 32 - PAGE_INDEX_BITS - PAGE_OFFSET_BITS;
+
+                // The index + 1 into the buffers of the first buffer overlapping the page, 0 for unmapped pages
+                using PageTableEntries = std::array<uint32_t, 1u << PAGE_INDEX_BITS>;
+
+                // sorted by start address
+                std::vector<Buffer> buffers;
+                // the second level page tables are only allocated if any of their pages are mapped
+                std::vector<std::unique_ptr<PageTableEntries>> directory;
+            };
+
+            Variant<DirectBuffer, PageTable> data;
+            mutable std::shared_timed_mutex accessLock;
+
+            void logMappedBuffers() const;
+        };
+
+        /*
+         * Host-side lock sharing the hardware mutex between the emulations of concurrently running work-groups.
+         *
+         * Unlike std::mutex, this lock may be released by another host thread than the one which acquired it, e.g.
+         * if the emulation of a QPU thread was aborted while holding the hardware mutex.
+         */
+        class SharedMutexLock : private NonCopyable
+        {
+        public:
+            void lock();
+            void unlock();
+
+        private:
+            std::mutex mutex;
+            std::condition_variable released;
+            bool locked = false;
         };
 
         class Mutex : private NonCopyable
         {
         public:
+            /*
+             * If a group lock is given, it is held while any QPU holds the mutex. This allows to share the hardware
+             * mutex with the emulations of other work-groups running concurrently on other host threads.
+             */
+            explicit Mutex(SharedMutexLock* groupLock = nullptr) : groupLock(groupLock) {}
+            ~Mutex() noexcept;
+
             bool isLocked() const;
             NODISCARD bool lock(uint8_t qpu);
             void unlock(uint8_t qpu);
@@ -93,6 +198,7 @@ namespace vc4c
         private:
             static constexpr uint8_t NO_OWNER = 255;
             std::atomic<std::uint8_t> lockedOwner{NO_OWNER};
+            SharedMutexLock* groupLock;
         };
 
         class Registers : private NonCopyable
@@ -105,17 +211,30 @@ namespace vc4c
 
             SIMDVector getInterruptValue() const;
 
-            void clearReadCache();
+            /*
+             * Invalidates the values of all registers read by the current instruction.
+             *
+             * This does not touch the cached values, but only advances the generation of the cache.
+             */
+            void clearReadCache() noexcept;
 
         private:
             QPU& qpu;
             std::array<std::pair<SIMDVector, uint32_t>, 4 * 64> storageRegisters;
             Optional<SIMDVector> hostInterrupt;
-            SortedMap<Register, SIMDVector> readCache;
+            /*
+             * Caches the values of registers with side-effects on read (e.g. UNIFORM, VPM or mutex) which were already
+             * read by the current instruction, indexed by the register number.
+             *
+             * An entry is only valid if its generation matches the current generation.
+             */
+            std::array<std::pair<SIMDVector, uint32_t>, 64> readCache;
+            uint32_t readCacheGeneration = 1;
 
             SIMDVector readStorageRegister(Register reg, bool anyElementUsed);
             void writeStorageRegister(Register reg, SIMDVector&& val, std::bitset<16> elementMask, BitMask bitMask);
-            NODISCARD SortedMap<Register, SIMDVector>::iterator setReadCache(Register reg, const SIMDVector& val);
+            const SIMDVector* getReadCache(Register reg) const noexcept;
+            const SIMDVector& setReadCache(Register reg, const SIMDVector& val);
         };
 
         class UniformFifo : private NonCopyable
@@ -166,9 +285,13 @@ namespace vc4c
             // difference, since we provide the response for a request immediately in the emulator
             std::queue<std::future<SIMDVector>> tmu0Queue;
             std::queue<std::future<SIMDVector>> tmu1Queue;
+            // The values already read for the functional emulation
+            std::queue<SIMDVector> tmu0Values;
+            std::queue<SIMDVector> tmu1Values;
 
             void checkTMUWriteCycle() const;
             std::future<SIMDVector> readMemoryAddress(uint8_t tmu, const SIMDVector& address) const;
+            SIMDVector readMemoryAddressDirectly(const SIMDVector& address) const;
             uint8_t toRealTMU(uint8_t tmu) const;
         };
 
@@ -205,8 +328,8 @@ namespace vc4c
             void setWriteSetup(const SIMDVector& val);
             void setReadSetup(const SIMDVector& val);
 
-            void setDMAWriteAddress(const SIMDVector& val);
-            void setDMAReadAddress(const SIMDVector& val);
+            void setDMAWriteAddress(const SIMDVector& val, TraceRecorder* trace);
+            void setDMAReadAddress(const SIMDVector& val, TraceRecorder* trace);
 
             NODISCARD bool waitDMAWrite() const;
             NODISCARD bool waitDMARead() const;
@@ -321,6 +444,8 @@ namespace vc4c
             AsynchronousExecution startTMURead(
                 uint8_t tmuIndex, AsynchronousHandle<Word>&& handle, MemoryAddress address);
             std::pair<qpu_asm::Instruction, bool> readInstruction(ProgramCounter pc);
+            // Bypasses all caches, used for the functional emulation
+            Word readMemoryWord(MemoryAddress address) const;
 
         private:
             uint8_t id;
@@ -339,26 +464,36 @@ namespace vc4c
         {
         public:
             QPU(uint8_t id, EmulationClock& clock, Slice& slice, Mutex& mutex, SFU& sfu, VPM& vpm,
-                Semaphores& semaphores, MemoryAddress uniformAddress, InstrumentationResults& instrumentation) :
-                ID(id),
-                clock(clock), slice(slice), mutex(mutex), registers(*this),
-                uniforms(clock, *this, slice, uniformAddress), tmus(clock, *this, slice), sfu(sfu), vpm(vpm),
-                semaphores(semaphores), pc(0), lastInstruction{0xDEADDEAD, 0}, instrumentation(instrumentation),
-                stopExecution(false)
-            {
-                // initially trigger the loading of the first UNIFORM values into the FIFO
-                uniforms.triggerFifoFill();
-            }
+                Semaphores& semaphores, MemoryAddress uniformAddress, const std::vector<DecodedInstruction>& program,
+                QPUSynchronization* synchronization = nullptr, TraceWriter* traceWriter = nullptr,
+                uint32_t traceGroup = 0);
 
             const uint8_t ID;
 
             uint32_t getCurrentCycle() const;
+            /*
+             * The number of instructions executed by this QPU so far, not counting any stalls.
+             *
+             * In contrast to the current cycle, this is independent of the emulation mode and is used to limit the
+             * emulation in all modes.
+             */
+            uint32_t getNumExecutedInstructions() const noexcept
+            {
+                return numExecutedInstructions;
+            }
 
             NODISCARD bool execute();
+            // Whether the last executed cycle stalled (did not advance to the next instruction)
+            bool isStalled() const;
 
             qpu_asm::Instruction getCurrentInstruction() const;
             uint32_t getCurrentInstructionIndex() const;
 
+            /*
+             * The instrumentation results of this QPU, only written by the thread executing this QPU
+             */
+            const InstrumentationResults& getInstrumentation() const;
+
             inline bool operator<(const QPU& other) const noexcept
             {
                 return ID < other.ID;
@@ -368,6 +503,9 @@ namespace vc4c
             EmulationClock& clock;
             Slice& slice;
             Mutex& mutex;
+            const std::vector<DecodedInstruction>& program;
+            // Only set if the QPUs are emulated in parallel
+            QPUSynchronization* synchronization;
             Registers registers;
             UniformFifo uniforms;
             TMUs tmus;
@@ -377,34 +515,94 @@ namespace vc4c
             VectorFlags flags;
             ProgramCounter pc;
             std::pair<ProgramCounter, uint64_t> lastInstruction;
-            InstrumentationResults& instrumentation;
+            InstrumentationResults instrumentation;
             SIMDVector lastR4Value;
             bool stopExecution;
+            bool stalled;
+            uint32_t numExecutedInstructions;
+            // The delay slots of branches and the thread end, counted in executed instructions
+            ProgramCounter branchTarget;
+            int8_t remainingBranchDelay;
+            int8_t remainingEndDelay;
+            // Only used for the functional emulation
+            uint32_t localCycle;
+            // Only set if the execution is traced
+            std::unique_ptr<TraceRecorder> trace;
 
             friend class Registers;
             friend class UniformFifo;
             friend class TMUs;
             friend class SFU;
             friend class VPM;
+            friend struct DecodedInstruction;
 
-            NODISCARD bool executeALU(const qpu_asm::ALUInstruction* aluInst);
+            NODISCARD bool executeALU(const DecodedInstruction& inst);
+            NODISCARD bool executeBranch(const DecodedInstruction& inst);
+            NODISCARD bool executeLoad(const DecodedInstruction& inst);
+            NODISCARD bool executeSemaphore(const DecodedInstruction& inst);
+            NODISCARD bool executeInvalid(const DecodedInstruction& inst);
             void writeConditional(Register dest, const SIMDVector& in, ConditionCode cond, BitMask bitMask,
-                const qpu_asm::ALUInstruction* addInst = nullptr, const qpu_asm::ALUInstruction* mulInst = nullptr);
+                bool isAddALU = false, bool isMulALU = false);
             bool isConditionMet(BranchCond cond) const;
             NODISCARD bool executeSignal(Signaling signal);
             void setFlags(const SIMDVector& output, ConditionCode cond, const VectorFlags& newFlags);
+            void recordStall(unsigned InstrumentationResult::*reason);
         };
 
+        /*
+         * Decodes the given number of machine code instructions into the representation executed by the QPUs
+         */
+        std::vector<DecodedInstruction> decodeInstructions(
+            std::vector<qpu_asm::Instruction>::const_iterator firstInstruction, std::size_t numInstructions);
+
+        enum class EmulationMode : uint8_t
+        {
+            // All QPUs are emulated in lock-step with cycle-accurate memory accesses and caches
+            CYCLE_ACCURATE,
+            // Every QPU runs until it blocks, memory accesses complete immediately
+            FUNCTIONAL,
+            // Functional emulation with every QPU running on its own host thread, accesses to shared periphery are
+            // executed in a deterministic order
+            PARALLEL,
+            // Like PARALLEL, but accesses to shared periphery are only serialized, not ordered
+            PARALLEL_RELAXED
+        };
+
+        /*
+         * Writes the UNIFORMs for all QPUs executing the work-group with the given IDs and returns the addresses of
+         * the UNIFORMs of every QPU
+         */
         std::vector<MemoryAddress> buildUniforms(Memory& memory, MemoryAddress baseAddress,
             const std::vector<MemoryAddress>& parameter, const WorkGroupConfig& config, MemoryAddress globalData,
-            const KernelUniforms& uniformsUsed, uint8_t workItemMergeFactor = 1);
+            const KernelUniforms& uniformsUsed, uint8_t workItemMergeFactor = 1,
+            const std::array<Word, 3>& groupIDs = {{0, 0, 0}});
         bool emulate(std::vector<qpu_asm::Instruction>::const_iterator firstInstruction, Memory& memory,
             const std::vector<MemoryAddress>& uniformAddresses, InstrumentationResults& instrumentation,
-            const std::string& name = "", uint32_t maxCycles = std::numeric_limits<uint32_t>::max());
+            const std::string& name = "", uint32_t maxCycles = std::numeric_limits<uint32_t>::max(),
+            EmulationMode mode = EmulationMode::CYCLE_ACCURATE);
+        /*
+         * Emulates the already decoded program, the instructions are only used to model the instruction cache.
+         *
+         * If a trace writer is given, the execution of all QPUs is recorded with the given work-group index. If a
+         * shared mutex lock is given, the hardware mutex is shared with all other emulations using the same lock.
+         */
+        bool emulate(std::vector<qpu_asm::Instruction>::const_iterator firstInstruction,
+            const std::vector<DecodedInstruction>& program, Memory& memory,
+            const std::vector<MemoryAddress>& uniformAddresses, InstrumentationResults& instrumentation,
+            const std::string& name, uint32_t maxCycles, EmulationMode mode, TraceWriter* trace = nullptr,
+            uint32_t traceGroup = 0, SharedMutexLock* sharedMutexLock = nullptr);
         bool emulateTask(std::vector<qpu_asm::Instruction>::const_iterator firstInstruction,
             const std::vector<MemoryAddress>& parameter, Memory& memory, MemoryAddress uniformBaseAddress,
             MemoryAddress globalData, const KernelUniforms& uniformsUsed, InstrumentationResults& instrumentation,
             const std::string& name = "", uint32_t maxCycles = std::numeric_limits<uint32_t>::max());
+
+        /*
+         * Runs the given number of rounds of a fixed pattern of register reads and writes (UNIFORMs, accumulators and
+         * physical registers) of a single QPU without emulating any instruction.
+         *
+         * Returns the number of register accesses executed and sets the host time spent for them.
+         */
+        uint64_t benchmarkRegisterAccesses(uint32_t numRounds, std::chrono::nanoseconds& duration);
     } // namespace tools
 } // namespace vc4c
 
@@ -0,0 +1,123 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "SlabAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace vc4c;
+using namespace vc4c::tools;
+
+// The size of the first chunk allocated from the system, every further chunk doubles in size
+static constexpr std::size_t MIN_CHUNK_SIZE = 4 * 1024;
+// The maximum size of the chunks allocated from the system
+static constexpr std::size_t MAX_CHUNK_SIZE = 64 * 1024;
+// Every object allocated via SlabPool#allocateObject is prefixed with the pool it was allocated from (if any), the
+// header size keeps the object correctly aligned
+static constexpr std::size_t OBJECT_HEADER_SIZE = SlabPool::SLOT_ALIGNMENT;
+
+static_assert(sizeof(SlabPool*) <= OBJECT_HEADER_SIZE, "Pool pointer does not fit into object header");
+
+static std::atomic_size_t totalReservedSize{0};
+static thread_local SlabPool* currentPool = nullptr;
+
+static std::size_t toSizeClass(std::size_t size) noexcept
+{
+    return size == 0 ? 0 : (size - 1) / SlabPool::SLOT_ALIGNMENT;
+}
+
+SlabPool::~SlabPool() noexcept
+{
+    for(auto chunk : chunks)
+        ::operator delete(chunk);
+    totalReservedSize -= reservedSize;
+}
+
+void* SlabPool::allocate(std::size_t size)
+{
+    if(size > MAX_SLOT_SIZE)
+        return ::operator new(size);
+    auto sizeClass = toSizeClass(size);
+    auto slotSize = (sizeClass + 1) * SLOT_ALIGNMENT;
+    std::lock_guard<std::mutex> guard(mutex);
+    if(auto slot = freeLists[sizeClass])
+    {
+        freeLists[sizeClass] = slot->next;
+        return slot;
+    }
+    if(chunkPosition == nullptr || chunkPosition + slotSize > chunkEnd)
+    {
+        // The remainder of the previous chunk is wasted, which is at most one slot of the largest size class
+        auto lastChunkSize = chunks.empty() ? 0 : static_cast<std::size_t>(chunkEnd - chunks.back());
+        auto chunkSize = std::max(MIN_CHUNK_SIZE, std::min(2 * lastChunkSize, MAX_CHUNK_SIZE));
+        chunks.push_back(static_cast<char*>(::operator new(chunkSize)));
+        chunkPosition = chunks.back();
+        chunkEnd = chunkPosition + chunkSize;
+        reservedSize += chunkSize;
+        totalReservedSize += chunkSize;
+    }
+    auto slot = chunkPosition;
+    chunkPosition += slotSize;
+    return slot;
+}
+
+void SlabPool::deallocate(void* ptr, std::size_t size) noexcept
+{
+    if(!ptr)
+        return;
+    if(size > MAX_SLOT_SIZE)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+    auto sizeClass = toSizeClass(size);
+    auto slot = static_cast<FreeSlot*>(ptr);
+    std::lock_guard<std::mutex> guard(mutex);
+    slot->next = freeLists[sizeClass];
+    freeLists[sizeClass] = slot;
+}
+
+std::size_t SlabPool::getReservedSize() const noexcept
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return reservedSize;
+}
+
+std::size_t SlabPool::getTotalReservedSize() noexcept
+{
+    return totalReservedSize;
+}
+
+void* SlabPool::allocateObject(std::size_t size)
+{
+    auto pool = currentPool;
+    auto base = static_cast<char*>(
+        pool ? pool->allocate(size + OBJECT_HEADER_SIZE) : ::operator new(size + OBJECT_HEADER_SIZE));
+    *reinterpret_cast<SlabPool**>(base) = pool;
+    return base + OBJECT_HEADER_SIZE;
+}
+
+void SlabPool::deallocateObject(void* ptr, std::size_t size) noexcept
+{
+    if(!ptr)
+        return;
+    auto base = static_cast<char*>(ptr) - OBJECT_HEADER_SIZE;
+    if(auto pool = *reinterpret_cast<SlabPool**>(base))
+        pool->deallocate(base, size + OBJECT_HEADER_SIZE);
+    else
+        ::operator delete(base);
+}
+
+SlabPool::Scope::Scope(SlabPool& pool) noexcept : previousPool(currentPool)
+{
+    currentPool = &pool;
+}
+
+SlabPool::Scope::~Scope() noexcept
+{
+    currentPool = previousPool;
+}
@@ -0,0 +1,178 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace vc4c
+{
+    namespace tools
+    {
+        /**
+         * Arena for small objects, allocating memory from larger chunks split into slots of fixed size classes.
+         *
+         * A pool is owned by a single Method and serves the instructions, basic blocks and locals of that method as
+         * well as the nodes of the lists containing them. Freed slots are reused for further allocations from the same
+         * pool and all chunks are returned to the system at once when the pool is destroyed. Thus, the pool needs to
+         * outlive all objects allocated from it.
+         *
+         * Objects can be allocated and freed concurrently by different threads, e.g. by optimizations running in
+         * parallel for independent basic blocks of the same method.
+         */
+        class SlabPool
+        {
+        public:
+            /*
+             * The maximum object size (in bytes) served from the pool, larger allocations use the global operator new
+             */
+            static constexpr std::size_t MAX_SLOT_SIZE = 256;
+            /*
+             * The granularity (and alignment) of the size classes
+             */
+            static constexpr std::size_t SLOT_ALIGNMENT = alignof(std::max_align_t);
+
+            SlabPool() = default;
+            SlabPool(const SlabPool&) = delete;
+            SlabPool(SlabPool&&) = delete;
+            ~SlabPool() noexcept;
+
+            SlabPool& operator=(const SlabPool&) = delete;
+            SlabPool& operator=(SlabPool&&) = delete;
+
+            void* allocate(std::size_t size);
+            void deallocate(void* ptr, std::size_t size) noexcept;
+
+            /*
+             * Returns the number of bytes allocated by this pool from the system
+             */
+            std::size_t getReservedSize() const noexcept;
+
+            /*
+             * Returns the number of bytes allocated from the system by all currently existing pools
+             */
+            static std::size_t getTotalReservedSize() noexcept;
+
+            /*
+             * Allocates an object of the given size from the pool currently active for the calling thread (see
+             * Scope) or from the global operator new, if no pool is active.
+             *
+             * The object can be freed with #deallocateObject from any thread and in any scope.
+             */
+            static void* allocateObject(std::size_t size);
+            static void deallocateObject(void* ptr, std::size_t size) noexcept;
+
+            /**
+             * Activates the given pool for all objects allocated via #allocateObject (e.g. instructions) by the current
+             * thread for the lifetime of this object.
+             *
+             * NOTE: The objects allocated while a scope is active need to be destroyed before the pool, so the scope
+             * should only be active while processing the method owning the pool.
+             */
+            class Scope
+            {
+            public:
+                explicit Scope(SlabPool& pool) noexcept;
+                Scope(const Scope&) = delete;
+                Scope(Scope&&) = delete;
+                ~Scope() noexcept;
+
+                Scope& operator=(const Scope&) = delete;
+                Scope& operator=(Scope&&) = delete;
+
+            private:
+                SlabPool* previousPool;
+            };
+
+        private:
+            struct FreeSlot
+            {
+                FreeSlot* next;
+            };
+
+            mutable std::mutex mutex;
+            std::array<FreeSlot*, MAX_SLOT_SIZE / SLOT_ALIGNMENT> freeLists{};
+            std::vector<char*> chunks;
+            char* chunkPosition = nullptr;
+            char* chunkEnd = nullptr;
+            std::size_t reservedSize = 0;
+        };
+
+        /**
+         * Allocator for standard containers, allocating single elements (e.g. list nodes) via the given SlabPool.
+         *
+         * A default-constructed allocator has no pool and uses the global operator new. Only containers using the same
+         * pool compare equal, so elements can only be spliced between containers of the same method.
+         */
+        template <typename T>
+        struct SlabAllocator
+        {
+            using value_type = T;
+            using propagate_on_container_copy_assignment = std::true_type;
+            using propagate_on_container_move_assignment = std::true_type;
+            using propagate_on_container_swap = std::true_type;
+
+            static_assert(alignof(T) <= SlabPool::SLOT_ALIGNMENT, "Over-aligned types are not supported");
+
+            SlabAllocator() noexcept = default;
+            explicit SlabAllocator(SlabPool& pool) noexcept : pool(&pool) {}
+            template <typename U>
+            SlabAllocator(const SlabAllocator<U>& other) noexcept : pool(other.pool)
+            {
+            }
+
+            T* allocate(std::size_t n)
+            {
+                return static_cast<T*>(pool ? pool->allocate(n * sizeof(T)) : ::operator new(n * sizeof(T)));
+            }
+
+            void deallocate(T* ptr, std::size_t n) noexcept
+            {
+                if(pool)
+                    pool->deallocate(ptr, n * sizeof(T));
+                else
+                    ::operator delete(ptr);
+            }
+
+            template <typename U>
+            bool operator==(const SlabAllocator<U>& other) const noexcept
+            {
+                return pool == other.pool;
+            }
+
+            template <typename U>
+            bool operator!=(const SlabAllocator<U>& other) const noexcept
+            {
+                return pool != other.pool;
+            }
+
+            SlabPool* pool = nullptr;
+        };
+
+        /**
+         * Base type for polymorphic objects to be allocated via the SlabPool currently active (see SlabPool::Scope).
+         *
+         * NOTE: The type deriving from this needs a virtual destructor, so the correct size is passed on deletion.
+         */
+        struct SlabAllocated
+        {
+            static void* operator new(std::size_t size)
+            {
+                return SlabPool::allocateObject(size);
+            }
+
+            static void operator delete(void* ptr, std::size_t size) noexcept
+            {
+                SlabPool::deallocateObject(ptr, size);
+            }
+        };
+    } // namespace tools
+} // namespace vc4c
@@ -129,6 +129,16 @@ bool tools::parseConfigurationParameter(Configuration& config, const std::string
         config.stopWhenVerificationFailed = false;
         return true;
     }
+    if(arg.find("--cache-dir=") == 0)
+    {
+        config.cacheDirectory = arg.substr(std::string("--cache-dir=").size());
+        return true;
+    }
+    if(arg.find("--trace=") == 0)
+    {
+        config.traceFile = arg.substr(std::string("--trace=").size());
+        return true;
+    }
 
     std::string passName;
     if(arg.find("--fno-") == 0)
@@ -173,6 +183,12 @@ bool tools::parseConfigurationParameter(Configuration& config, const std::string
                 config.additionalOptions.maxOptimizationIterations = static_cast<unsigned>(intValue);
             else if(paramName == "common-subexpression-threshold")
                 config.additionalOptions.maxCommonExpressionDinstance = static_cast<unsigned>(intValue);
+            else if(paramName == "parallel-block-threshold")
+                config.additionalOptions.parallelBlockThreshold = static_cast<unsigned>(intValue);
+            else if(paramName == "worklist-threshold")
+                config.additionalOptions.worklistThreshold = static_cast<unsigned>(intValue);
+            else if(paramName == "max-prefetched-loads")
+                config.additionalOptions.maxPrefetchedLoads = static_cast<unsigned>(intValue);
             else
             {
                 std::cerr << "Cannot set unknown optimization parameter: " << paramName << " to " << value << std::endl;
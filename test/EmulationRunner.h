@@ -10,17 +10,26 @@
 #include "TestCompilationHelper.h"
 #include "TestData.h"
 #include "tools.h"
+#include "tools/Emulator.h"
 
 #include <sstream>
+#include <vector>
 
 class EmulationRunner : public test_data::TestRunner, protected TestCompilationHelper
 {
 public:
-    explicit EmulationRunner(
-        const vc4c::Configuration& config, vc4c::FastMap<std::string, vc4c::CompilationData>& cache) :
+    /*
+     * Runs the test data with the given emulation mode. If additional modes are given, the emulation is repeated for
+     * each of these modes and the results are checked to be the same as for the first emulation.
+     */
+    explicit EmulationRunner(const vc4c::Configuration& config,
+        vc4c::FastMap<std::string, vc4c::CompilationData>& cache,
+        vc4c::tools::EmulationMode mode = vc4c::tools::EmulationMode::CYCLE_ACCURATE,
+        std::vector<vc4c::tools::EmulationMode> comparedModes = {}) :
         TestCompilationHelper(config),
-        compilationCache(cache)
+        compilationCache(cache), comparedModes(std::move(comparedModes))
     {
+        setEmulationMode(currentData, mode);
     }
 
     ~EmulationRunner() noexcept override;
@@ -37,6 +46,7 @@ public:
             currentBinary = compileString(sourceCode, options, name);
         currentData.module = currentBinary;
         compilationCache.emplace(sourceCode + options, currentBinary);
+        session.reset();
         return test_data::RESULT_OK;
     }
     catch(const std::exception& err)
@@ -45,13 +55,20 @@ public:
     }
 
     test_data::Result selectKernel(const std::string& name) override
+    try
     {
         currentData.kernelName = name;
         // reset kernel configuration
         currentData.parameter.clear();
         currentData.workGroup = {};
+        // the kernel is only loaded once for all executions (e.g. in the different emulation modes)
+        session.reset(new vc4c::tools::EmulationSession(currentData.module, name));
         return test_data::RESULT_OK;
     }
+    catch(const std::exception& err)
+    {
+        return test_data::Result{false, err.what()};
+    }
 
     test_data::Result setKernelArgument(
         std::size_t index, bool isLiteral, bool isVector, const void* byteData, std::size_t numBytes) override
@@ -89,10 +106,29 @@ public:
     test_data::Result execute() override
     try
     {
-        currentResult.reset(new vc4c::tools::EmulationResult(emulate(currentData)));
-        if(currentResult->executionSuccessful)
-            return test_data::RESULT_OK;
-        return test_data::Result{false, "Emulation failed!"};
+        if(!session)
+            return test_data::Result{false, "No kernel selected!"};
+        currentResult.reset(new vc4c::tools::EmulationResult(session->emulate(currentData)));
+        if(!currentResult->executionSuccessful)
+            return test_data::Result{false, "Emulation failed!"};
+        for(auto mode : comparedModes)
+        {
+            auto data = currentData;
+            setEmulationMode(data, mode);
+            auto result = session->emulate(data);
+            if(!result.executionSuccessful)
+                return test_data::Result{false, "Emulation failed in mode " + toString(mode) + "!"};
+            for(std::size_t i = 0; i < result.results.size(); ++i)
+            {
+                const auto& expected = currentResult->results[i];
+                const auto& actual = result.results[i];
+                if(expected.second ? (expected.second.value() != actual.second.value()) :
+                                     (expected.first != actual.first))
+                    return test_data::Result{false,
+                        "Result of argument " + std::to_string(i) + " differs for emulation mode " + toString(mode)};
+            }
+        }
+        return test_data::RESULT_OK;
     }
     catch(const std::exception& err)
     {
@@ -120,10 +156,36 @@ public:
         return test_data::RESULT_OK;
     }
 
+    static void setEmulationMode(vc4c::tools::EmulationData& data, vc4c::tools::EmulationMode mode)
+    {
+        data.functionalEmulation = mode != vc4c::tools::EmulationMode::CYCLE_ACCURATE;
+        data.parallelEmulation =
+            mode == vc4c::tools::EmulationMode::PARALLEL || mode == vc4c::tools::EmulationMode::PARALLEL_RELAXED;
+        data.relaxedSynchronization = mode == vc4c::tools::EmulationMode::PARALLEL_RELAXED;
+    }
+
+    static std::string toString(vc4c::tools::EmulationMode mode)
+    {
+        switch(mode)
+        {
+        case vc4c::tools::EmulationMode::CYCLE_ACCURATE:
+            return "cycle-accurate";
+        case vc4c::tools::EmulationMode::FUNCTIONAL:
+            return "functional";
+        case vc4c::tools::EmulationMode::PARALLEL:
+            return "parallel";
+        case vc4c::tools::EmulationMode::PARALLEL_RELAXED:
+            return "parallel (relaxed)";
+        }
+        return "unknown";
+    }
+
 protected:
     vc4c::tools::EmulationData currentData;
     std::unique_ptr<vc4c::tools::EmulationResult> currentResult;
+    std::unique_ptr<vc4c::tools::EmulationSession> session;
     vc4c::FastMap<std::string, vc4c::CompilationData>& compilationCache;
+    std::vector<vc4c::tools::EmulationMode> comparedModes;
 };
 
 #endif /* VC4C_TEST_EMULATION_RUNNER_H */
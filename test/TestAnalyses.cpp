@@ -7,6 +7,7 @@
 
 #include "CompilerInstance.h"
 #include "Precompiler.h"
+#include "analysis/AnalysisManager.h"
 #include "analysis/ControlFlowGraph.h"
 #include "analysis/DataDependencyGraph.h"
 #include "analysis/DominatorTree.h"
@@ -83,6 +84,7 @@ TestAnalyses::TestAnalyses(const Configuration& config)
     TEST_ADD(TestAnalyses::testStaticFlags);
     TEST_ADD(TestAnalyses::testIntegerComparisonDetection);
     TEST_ADD(TestAnalyses::testActiveWorkItems);
+    TEST_ADD(TestAnalyses::testAnalysisManager);
 }
 
 void TestAnalyses::testAvailableExpressions() {}
@@ -1574,3 +1576,42 @@ void TestAnalyses::testActiveWorkItems()
         }
     }
 }
+
+void TestAnalyses::testAnalysisManager()
+{
+    CompilerInstance instance{config};
+    std::stringstream ss(KERNEL_NESTED_LOOPS);
+    instance.precompileAndParseInput(CompilationData{ss});
+    instance.normalize();
+
+    TEST_ASSERT_EQUALS(1u, instance.module.getKernels().size());
+    auto kernel = instance.module.getKernels()[0];
+    auto& analyses = kernel->getAnalyses();
+    TEST_ASSERT(!analyses.isCached(AnalysisType::DATA_DEPENDENCIES));
+
+    // the results are cached and shared between accesses
+    auto dataDependencies = analyses.getDataDependencyGraph();
+    TEST_ASSERT(!!dataDependencies);
+    TEST_ASSERT_EQUALS(dataDependencies.get(), analyses.getDataDependencyGraph().get());
+    auto dominators = analyses.getDominatorTree();
+    TEST_ASSERT_EQUALS(dominators.get(), analyses.getDominatorTree().get());
+    TEST_ASSERT_EQUALS(1u, analyses.getLoops(false).size());
+    TEST_ASSERT(analyses.isCached(AnalysisType::ALL));
+
+    // explicit invalidation only drops the selected analyses
+    analyses.invalidate(AnalysisType::INSTRUCTIONS);
+    TEST_ASSERT(!analyses.isCached(AnalysisType::DATA_DEPENDENCIES));
+    TEST_ASSERT(analyses.isCached(AnalysisType::CONTROL_FLOW));
+    // the invalidated results stay valid for their users, but are not returned anymore
+    TEST_ASSERT(dataDependencies.get() != analyses.getDataDependencyGraph().get());
+    TEST_ASSERT(analyses.isCached(AnalysisType::DATA_DEPENDENCIES));
+
+    // modifying the CFG invalidates the control flow analyses as well as all analyses depending on the blocks
+    auto it = kernel->begin()->walk().nextInBlock();
+    it = kernel->emplaceLabel(
+        it, std::make_unique<intermediate::BranchLabel>(*kernel->addNewLocal(TYPE_LABEL, "%new_block").local()));
+    TEST_ASSERT(!analyses.isCached(AnalysisType::DOMINATOR_TREE));
+    TEST_ASSERT(!analyses.isCached(AnalysisType::LOOPS));
+    TEST_ASSERT(!analyses.isCached(AnalysisType::DATA_DEPENDENCIES));
+    TEST_ASSERT(dominators.get() != analyses.getDominatorTree().get());
+}
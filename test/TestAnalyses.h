@@ -30,6 +30,7 @@ public:
     void testStaticFlags();
     void testIntegerComparisonDetection();
     void testActiveWorkItems();
+    void testAnalysisManager();
 };
 
 #endif /* VC4C_TEST_ANALYSES_H */
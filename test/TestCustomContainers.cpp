@@ -6,9 +6,20 @@
 
 #include "TestCustomContainers.h"
 
+#include "ThreadPool.h"
+#include "tools/SlabAllocator.h"
 #include "tools/SmallMap.h"
 #include "tools/SmallSet.h"
 
+#include <atomic>
+#include <list>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace vc4c;
 using namespace vc4c::tools;
 
 TestCustomContainers::TestCustomContainers()
@@ -18,6 +29,9 @@ TestCustomContainers::TestCustomContainers()
 
     TEST_ADD(TestCustomContainers::testFixedSortedPointerSet);
     TEST_ADD(TestCustomContainers::testSmallSortedPointerSet);
+
+    TEST_ADD(TestCustomContainers::testSlabAllocator);
+    TEST_ADD(TestCustomContainers::testThreadPool);
 }
 
 TestCustomContainers::~TestCustomContainers() = default;
@@ -32,6 +46,50 @@ static auto EVEN_MORE_POINTER = reinterpret_cast<void*>(0xF11AF);
 static auto AND_SOME_MORE_POINTER = reinterpret_cast<void*>(0x1F11AF);
 static auto MAYBE_LAST_POINTER = reinterpret_cast<void*>(0x1ABCDEF);
 
+void TestCustomContainers::testThreadPool()
+{
+    std::vector<unsigned> outer(8);
+    std::iota(outer.begin(), outer.end(), 0u);
+    std::vector<unsigned> inner(16);
+    std::iota(inner.begin(), inner.end(), 0u);
+
+    // nested fork-join tasks on the shared pool, also run with more nested tasks than there are workers
+    std::atomic_uint sum{0};
+    ThreadPool::scheduleAll<unsigned, std::vector<unsigned>>("Test", outer, [&](unsigned i) {
+        ThreadPool::getSharedPool().scheduleAll<unsigned, std::vector<unsigned>>(
+            inner, [&](unsigned k) { sum += i * 100 + k; });
+    });
+    TEST_ASSERT_EQUALS(8u * 120u + 8u * 16u * 350u, sum.load());
+
+    // a pool without any worker executes all tasks in the waiting thread
+    ThreadPool emptyPool("Test", 0);
+    TEST_ASSERT_EQUALS(0u, emptyPool.getNumWorkers());
+    sum = 0;
+    emptyPool.scheduleAll<unsigned, std::vector<unsigned>>(outer, [&](unsigned i) {
+        emptyPool.scheduleAll<unsigned, std::vector<unsigned>>(inner, [&](unsigned k) { sum += i * 100 + k; });
+    });
+    TEST_ASSERT_EQUALS(8u * 120u + 8u * 16u * 350u, sum.load());
+
+    // exceptions are passed to the waiting thread after all tasks finished
+    ThreadPool pool("Test", 2);
+    sum = 0;
+    bool caughtError = false;
+    try
+    {
+        pool.scheduleAll<unsigned, std::vector<unsigned>>(outer, [&](unsigned i) {
+            ++sum;
+            if(i == 3)
+                throw std::runtime_error("Test");
+        });
+    }
+    catch(const std::runtime_error&)
+    {
+        caughtError = true;
+    }
+    TEST_ASSERT(caughtError);
+    TEST_ASSERT_EQUALS(8u, sum.load());
+}
+
 template <typename T, typename U>
 static bool hasSameMapContent(const T& first, const U& second);
 template <typename T, typename U>
@@ -373,6 +431,87 @@ void TestCustomContainers::testSmallSortedPointerSet()
     TEST_ASSERT(hasSameSetContent(reference, set0));
 }
 
+struct PoolObject : public SlabAllocated
+{
+    explicit PoolObject(unsigned val) : value(val) {}
+    virtual ~PoolObject() noexcept = default;
+
+    unsigned value;
+};
+
+void TestCustomContainers::testSlabAllocator()
+{
+    using PoolList = std::list<unsigned, SlabAllocator<unsigned>>;
+    auto initialTotalSize = SlabPool::getTotalReservedSize();
+    {
+        SlabPool pool;
+        PoolList list0(1000, 0u, SlabAllocator<unsigned>{pool});
+        std::iota(list0.begin(), list0.end(), 0u);
+        auto reservedSize = pool.getReservedSize();
+        TEST_ASSERT(reservedSize > 0);
+        TEST_ASSERT_EQUALS(initialTotalSize + reservedSize, SlabPool::getTotalReservedSize());
+
+        // nodes can be moved between lists of the same pool
+        PoolList list1(SlabAllocator<unsigned>{pool});
+        list1.splice(list1.begin(), list0, std::next(list0.begin(), 500), list0.end());
+        TEST_ASSERT_EQUALS(500u, list0.size());
+        TEST_ASSERT_EQUALS(500u, list1.size());
+        TEST_ASSERT_EQUALS(500u, list1.front());
+        TEST_ASSERT_EQUALS(999u, list1.back());
+
+        // freed nodes are reused
+        list0.clear();
+        list0.resize(500);
+        TEST_ASSERT_EQUALS(reservedSize, pool.getReservedSize());
+
+        // nodes can be freed and allocated on different threads
+        unsigned sum = 0;
+        std::thread t([&]() {
+            list1.clear();
+            PoolList list2(100, 42u, SlabAllocator<unsigned>{pool});
+            sum = std::accumulate(list2.begin(), list2.end(), 0u);
+        });
+        t.join();
+        TEST_ASSERT(list1.empty());
+        TEST_ASSERT_EQUALS(100u * 42u, sum);
+        list1.resize(1000, 17u);
+        TEST_ASSERT_EQUALS(1000u * 17u, std::accumulate(list1.begin(), list1.end(), 0u));
+
+        // containers without pool use the global allocator
+        PoolList list3(100, 13u);
+        TEST_ASSERT_EQUALS(100u * 13u, std::accumulate(list3.begin(), list3.end(), 0u));
+        TEST_ASSERT(list3.get_allocator() != list1.get_allocator());
+
+        // objects are only allocated from the pool while it is active and can be freed outside of the scope
+        std::unique_ptr<PoolObject> outside{new PoolObject(1)};
+        std::unique_ptr<PoolObject> inside;
+        auto sizeBefore = pool.getReservedSize();
+        {
+            SlabPool::Scope scope(pool);
+            std::vector<std::unique_ptr<PoolObject>> objects;
+            for(unsigned i = 0; i < 1000; ++i)
+                objects.emplace_back(new PoolObject(i));
+            TEST_ASSERT(pool.getReservedSize() > sizeBefore);
+            inside = std::move(objects.back());
+        }
+        TEST_ASSERT_EQUALS(1u, outside->value);
+        TEST_ASSERT_EQUALS(999u, inside->value);
+        sizeBefore = pool.getReservedSize();
+        outside.reset(new PoolObject(2));
+        TEST_ASSERT_EQUALS(sizeBefore, pool.getReservedSize());
+        inside.reset();
+        outside.reset();
+
+        // large objects are not served from the pool
+        auto ptr = pool.allocate(SlabPool::MAX_SLOT_SIZE + 1);
+        TEST_ASSERT(ptr != nullptr);
+        TEST_ASSERT_EQUALS(sizeBefore, pool.getReservedSize());
+        pool.deallocate(ptr, SlabPool::MAX_SLOT_SIZE + 1);
+    }
+    // all memory is released with the pool
+    TEST_ASSERT_EQUALS(initialTotalSize, SlabPool::getTotalReservedSize());
+}
+
 template <typename T, typename U>
 static bool hasSameMapContent(const T& first, const U& second)
 {
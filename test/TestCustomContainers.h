@@ -20,6 +20,9 @@ public:
     
     void testFixedSortedPointerSet();
     void testSmallSortedPointerSet();
+
+    void testSlabAllocator();
+    void testThreadPool();
 };
 
 #endif /* VC4C_TEST_CUSTOM_CONTAINERS_H */
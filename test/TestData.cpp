@@ -27,6 +27,79 @@ static Result checkPiSum(const std::vector<float>& result)
 
 static std::map<std::string, TestData> ALL_TESTS{};
 
+static const std::string ATOMIC_BARRIER = R"(
+__kernel void test(__global uint* out, volatile __global uint* counter) {
+  size_t lid = get_local_id(0);
+  atomic_add(counter, lid + 1);
+  barrier(CLK_GLOBAL_MEM_FENCE);
+  out[get_global_id(0)] = *counter;
+}
+)";
+
+static const std::string ATOMIC_WORK_GROUPS = R"(
+__kernel void test(__global uint* out, volatile __global uint* counter) {
+  atomic_add(counter, get_global_id(0) + 1);
+  out[get_global_id(0)] = get_group_id(0) * 16 + get_local_id(0);
+}
+)";
+
+// Keeps more constants live across the loop (after loop-invariant code motion) than fit into registers next to the
+// loop variables, so spilling needs to rematerialize the constants
+static const std::string CONSTANTS_REGISTER_PRESSURE = R"(
+#define ALL(F) F(0) F(1) F(2) F(3) F(4) F(5) F(6) F(7) F(8) F(9)
+#define DECLARE(k) uint a##k = base + k * 0x01000193u;
+// different operations per variable, so the updates are not combined into vector operations
+#define XOR_OR(k, p, c) a##k = (a##k ^ c) + (a##p | c);
+#define ADD_AND(k, p, c) a##k = (a##k + c) ^ (a##p & c);
+#define SUB_XOR(k, p, c) a##k = (a##k - c) + (a##p ^ c);
+#define MUL_SUB(k, p, c) a##k = (a##k * 3u) ^ (a##p - c) ^ c;
+#define COMBINE(k) result = (result ^ a##k) + k;
+
+__kernel void test(__global uint* out, const __global uint* in, uint count) {
+  uint base = in[get_global_id(0)];
+  ALL(DECLARE)
+  for(uint i = 0; i < count; ++i) {
+    XOR_OR(0, 9, 0x1142E2FAu)
+    ADD_AND(1, 0, 0x48EB8E25u)
+    SUB_XOR(2, 1, 0x6C889E6Fu)
+    MUL_SUB(3, 2, 0x66C0E518u)
+    XOR_OR(4, 3, 0x61D3F8E2u)
+    ADD_AND(5, 4, 0x08240B68u)
+    SUB_XOR(6, 5, 0x20B6341Eu)
+    MUL_SUB(7, 6, 0x0F27F2C4u)
+    XOR_OR(8, 7, 0x3F7A7DBDu)
+    ADD_AND(9, 8, 0x6177E1A2u)
+  }
+  uint result = 0;
+  ALL(COMBINE)
+  out[get_global_id(0)] = result;
+}
+)";
+
+// Loads read-only memory at addresses derived from the loop counter, so the loads can be prefetched for the next
+// iteration
+static const std::string PREFETCH_LOADS = R"(
+__kernel void test_single_load(__global uint* out, const __global uint* in, uint count) {
+  uint sum = get_global_id(0);
+  uint i = 0;
+  // a do-while loop is entered unconditionally and therefore has a proper preheader to insert the first prefetch into
+  do {
+    sum += in[i] * 7;
+  } while(++i < count);
+  out[get_global_id(0)] = sum;
+}
+
+__kernel void test_multiple_loads(
+    __global uint* out, const __global uint* a, const __global uint* b, const __global uint* c, uint count) {
+  uint sum = get_global_id(0);
+  uint i = 0;
+  do {
+    sum = (sum ^ a[i]) + b[i] * (c[i] | 1);
+  } while(++i < count);
+  out[get_global_id(0)] = sum;
+}
+)";
+
 void test_data::registerTest(TestData&& data)
 {
     auto key = data.uniqueName;
@@ -432,6 +505,81 @@ void test_data::registerGeneralTests()
         builder.checkParameterEquals<1>({2, 0, 3, 5, 4, 6, 7, 8, 9, 10, 0});
     }
 
+    {
+        // all work-items synchronize on the hardware mutex as well as on the barrier
+        TestDataBuilder<Buffer<uint32_t>, Buffer<uint32_t>> builder("atomics_barrier", ATOMIC_BARRIER, "test");
+        builder.setFlags(DataFilter::ATOMIC_FUNCTIONS | DataFilter::ASYNC_BARRIER);
+        builder.setDimensions(8);
+        builder.allocateParameter<0>(8, 0x42);
+        builder.setParameter<1>({0});
+        builder.checkParameterEquals<0>({36, 36, 36, 36, 36, 36, 36, 36});
+        builder.checkParameterEquals<1>({36});
+    }
+
+    {
+        // with only the spill step, this previously exceeded the maximum rounds of the register conflict resolver
+        TestDataBuilder<Buffer<uint32_t>, Buffer<uint32_t>, uint32_t> builder(
+            "constants_register_pressure", CONSTANTS_REGISTER_PRESSURE, "test");
+        builder.setFlags(DataFilter::INT_ARITHMETIC | DataFilter::COMPLEX_KERNEL);
+        builder.setDimensions(8);
+        builder.allocateParameter<0>(8, 0x42);
+        builder.setParameter<1>({7, 195948564, 391897121, 587845678, 783794235, 979742792, 1175691349, 1371639906});
+        builder.setParameter<2>(5);
+        builder.checkParameterEquals<0>({0x3B3D8DD5, 0xC4CC3F44, 0x5FF475C5, 0xD20C92BC, 0xB5CBC471, 0x19E6F1D8,
+            0x18B77F69, 0x81A4FC68});
+    }
+
+    {
+        // a single load per iteration, the only case prefetched by default
+        TestDataBuilder<Buffer<uint32_t>, Buffer<uint32_t>, uint32_t> builder(
+            "prefetch_loads_single_load", PREFETCH_LOADS, "test_single_load");
+        builder.setFlags(DataFilter::MEMORY_ACCESS | DataFilter::CONTROL_FLOW);
+        builder.setDimensions(4);
+        builder.allocateParameter<0>(4, 0x42);
+        builder.setParameter<1>({3, 5, 7, 11, 13, 17, 19});
+        builder.setParameter<2>(6);
+        builder.checkParameterEquals<0>({392, 393, 394, 395});
+    }
+
+    {
+        // loads from three buffers, which can be distributed over both TMUs
+        TestDataBuilder<Buffer<uint32_t>, Buffer<uint32_t>, Buffer<uint32_t>, Buffer<uint32_t>, uint32_t> builder(
+            "prefetch_loads_multiple_loads", PREFETCH_LOADS, "test_multiple_loads");
+        builder.setFlags(DataFilter::MEMORY_ACCESS | DataFilter::CONTROL_FLOW);
+        builder.setDimensions(4);
+        builder.allocateParameter<0>(4, 0x42);
+        builder.setParameter<1>({3, 2654435772, 1013904245, 3668340014, 2027808487, 387276960, 3041712729});
+        builder.setParameter<2>({1000, 1037, 1074, 1111, 1148, 1185, 1222});
+        builder.setParameter<3>({17, 16777636, 33555255, 50332874, 67110493, 83888112, 100665731});
+        builder.setParameter<4>(6);
+        builder.checkParameterEquals<0>({0x7E5C9902, 0x7E5C9909, 0x7E5C9908, 0x7E5C9627});
+    }
+
+    {
+        // the loop is only executed once, so the data prefetched for the first iteration is also the last data read
+        TestDataBuilder<Buffer<uint32_t>, Buffer<uint32_t>, Buffer<uint32_t>, Buffer<uint32_t>, uint32_t> builder(
+            "prefetch_loads_single_iteration", PREFETCH_LOADS, "test_multiple_loads");
+        builder.setFlags(DataFilter::MEMORY_ACCESS | DataFilter::CONTROL_FLOW);
+        builder.setDimensions(4);
+        builder.allocateParameter<0>(4, 0x42);
+        builder.setParameter<1>({3});
+        builder.setParameter<2>({1000});
+        builder.setParameter<3>({17});
+        builder.setParameter<4>(1);
+        builder.checkParameterEquals<0>({0x426B, 0x426A, 0x4269, 0x4268});
+    }
+
+    {
+        // the work-items of all work-groups synchronize on the hardware mutex
+        TestDataBuilder<Buffer<uint32_t>, Buffer<uint32_t>> builder("atomics_work_groups", ATOMIC_WORK_GROUPS, "test");
+        builder.setFlags(DataFilter::ATOMIC_FUNCTIONS | DataFilter::WORK_GROUP);
+        builder.setDimensions(4, 1, 1, 4);
+        builder.allocateParameter<0>(16, 0x42);
+        builder.setParameter<1>({0});
+        builder.checkParameterEquals<0>({0, 1, 2, 3, 16, 17, 18, 19, 32, 33, 34, 35, 48, 49, 50, 51});
+        builder.checkParameterEquals<1>({136});
+    }
+
     {
         TestDataBuilder<float, float, float, float, Buffer<int32_t>> builder("f2i", test_other_cl_string, "test_f2i");
         builder.setFlags(DataFilter::TYPE_CONVERSIONS);
@@ -7,13 +7,20 @@
 #include "TestEmulator.h"
 
 #include "../src/Profiler.h"
+#include "../src/SIMDVector.h"
+#include "../src/tools/EmulationTrace.h"
+#include "../src/optimization/Optimizer.h"
+#include "../src/periphery/TMU.h"
 #include "EmulationRunner.h"
 #include "helper.h"
 
 #include "TestData.h"
 
+#include <algorithm>
 #include <cstring>
+#include <fstream>
 #include <numeric>
+#include <sstream>
 
 using namespace vc4c;
 using namespace vc4c::tools;
@@ -26,6 +33,34 @@ TestEmulator::TestEmulator(const vc4c::Configuration& config) :
             (config.frontend == Frontend::SPIR_V ? test_data::DataFilter::SPIRV_DISABLED :
                                                    test_data::DataFilter::NONE)))
 {
+    // the faster functional emulation needs to produce the same results as the default cycle-accurate emulation
+    for(std::string test : {"hello_world", "branches", "CRC16", "work_item", "barrier_fix_work_size"})
+    {
+        TEST_ADD_WITH_STRING(TestEmulator::testFunctionalEmulation, test);
+    }
+    // the parallel emulation of multiple QPUs synchronizing via barriers and the hardware mutex needs to produce the
+    // same results as the single-threaded functional emulation
+    for(std::string test : {"barrier_dynamic_work_size", "barrier_fix_work_size", "atomics_barrier"})
+    {
+        TEST_ADD_WITH_STRING(TestEmulator::testParallelEmulation, test);
+    }
+    // without the work-group loop, the work-groups are emulated concurrently and only share the memory and the
+    // hardware mutex
+    for(std::string test : {"barrier_dynamic_work_size", "atomics_work_groups"})
+    {
+        TEST_ADD_WITH_STRING(TestEmulator::testSeparateWorkGroups, test);
+    }
+    // prefetching the TMU loads of a loop for the next iteration must not change the loaded values
+    for(std::string test :
+        {"prefetch_loads_single_load", "prefetch_loads_multiple_loads", "prefetch_loads_single_iteration"})
+    {
+        TEST_ADD_WITH_STRING(TestEmulator::testPrefetchLoads, test);
+    }
+    TEST_ADD(TestEmulator::testMappedMemory);
+    TEST_ADD(TestEmulator::testEmulationSession);
+    TEST_ADD(TestEmulator::testProfileOutput);
+    TEST_ADD(TestEmulator::testTraceRoundTrip);
+    TEST_ADD(TestEmulator::testEmulationLimit);
 }
 
 TestEmulator::TestEmulator(const vc4c::Configuration& config,
@@ -71,6 +106,11 @@ void TestEmulator::runTestData(std::string dataName, bool useCompilationCache)
 void TestEmulator::runTestData(std::string dataName, vc4c::FastMap<std::string, vc4c::CompilationData>& cache)
 {
     EmulationRunner runner(config, cache);
+    runTestData(dataName, runner);
+}
+
+void TestEmulator::runTestData(const std::string& dataName, EmulationRunner& runner)
+{
     auto test = test_data::getTest(dataName);
     auto result = test_data::execute(test, runner);
     TEST_ASSERT(result.wasSuccess)
@@ -83,6 +123,418 @@ void TestEmulator::runNoSuchTestData(std::string dataName)
     TEST_ASSERT_EQUALS("(no error)", "There is no test data with the name '" + dataName + "'");
 }
 
+void TestEmulator::testFunctionalEmulation(std::string dataName)
+{
+    EmulationRunner runner(config, compilationCache, EmulationMode::CYCLE_ACCURATE, {EmulationMode::FUNCTIONAL});
+    runTestData(dataName, runner);
+}
+
+void TestEmulator::testMappedMemory()
+{
+    // The first buffers share a single page, the third crosses page boundaries, none of them is page-aligned
+    std::vector<uint8_t> first(0x20, 0x11);
+    std::vector<uint8_t> second(0x30, 0x22);
+    std::vector<uint8_t> third(0x2000, 0x33);
+    std::vector<uint8_t> last(0x10, 0x44);
+    Memory memory(std::map<uint32_t, std::reference_wrapper<std::vector<uint8_t>>>{
+        {0x1010, first}, {0x1040, second}, {0x1FF0, third}, {0xFFFFFFF0, last}});
+
+    TEST_ASSERT_EQUALS(0x11111111u, memory.readWord(0x1010))
+    TEST_ASSERT_EQUALS(0x11111111u, memory.readWord(0x102C))
+    TEST_ASSERT_EQUALS(0x22222222u, memory.readWord(0x1040))
+    TEST_ASSERT_EQUALS(0x22222222u, memory.readWord(0x106C))
+    TEST_ASSERT_EQUALS(0x33333333u, memory.readWord(0x1FF0))
+    TEST_ASSERT_EQUALS(0x33333333u, memory.readWord(0x3000))
+    TEST_ASSERT_EQUALS(0x33333333u, memory.readWord(0x3FEC))
+    TEST_ASSERT_EQUALS(0x44444444u, memory.readWord(0xFFFFFFFC))
+
+    // writes go to the buffer containing the address
+    *memory.getWordAddress(0x1044) = 0x12345678;
+    uint32_t word = 0;
+    std::memcpy(&word, second.data() + 4, sizeof(word));
+    TEST_ASSERT_EQUALS(0x12345678u, word)
+    TEST_ASSERT_EQUALS(0x11111111u, memory.readWord(0x102C))
+    TEST_ASSERT_EQUALS(0x22222222u, memory.readWord(0x1048))
+
+    TEST_THROWS_NOTHING(memory.assertAddressInMemory(0x1010, 0x20))
+    TEST_THROWS_NOTHING(memory.assertAddressInMemory(0x1FF0, 0x2000))
+    // unmapped parts of the page containing mapped buffers
+    TEST_THROWS(memory.readWord(0x1000), CompilationError)
+    TEST_THROWS(memory.readWord(0x1030), CompilationError)
+    TEST_THROWS(memory.readWord(0x1070), CompilationError)
+    // directly behind the buffer crossing the page boundaries
+    TEST_THROWS(memory.readWord(0x3FF0), CompilationError)
+    // ranges exceeding the buffer, even if the following memory is mapped by another buffer
+    TEST_THROWS(memory.assertAddressInMemory(0x102C, 8), CompilationError)
+    TEST_THROWS(memory.assertAddressInMemory(0x1010, 0x40), CompilationError)
+    TEST_THROWS(memory.assertAddressInMemory(0xFFFFFFFC, 8), CompilationError)
+    // completely unmapped pages and page tables
+    TEST_THROWS(memory.readWord(0x0), CompilationError)
+    TEST_THROWS(memory.readWord(0x5000), CompilationError)
+    TEST_THROWS(memory.readWord(0x80000000), CompilationError)
+}
+
+static const std::string SESSION_KERNEL = R"(
+__kernel void test(__global uint* out, const __global uint* in, uint offset) {
+  size_t gid = get_global_id(0);
+  out[gid] = in[gid] + offset;
+}
+)";
+
+static EmulationData createSessionJob(
+    const CompilationData& module, uint32_t numItems, uint32_t numOutputWords, uint32_t inputBase, uint32_t offset)
+{
+    EmulationData job;
+    job.module = module;
+    job.kernelName = "test";
+    job.workGroup.dimensions = 1;
+    job.workGroup.localSizes[0] = numItems;
+    std::vector<uint32_t> input(numItems);
+    std::iota(input.begin(), input.end(), inputBase);
+    job.parameter.emplace_back(0, std::vector<uint32_t>(numOutputWords, 0x42));
+    job.parameter.emplace_back(0, std::move(input));
+    job.parameter.emplace_back(offset, Optional<std::vector<uint32_t>>{});
+    return job;
+}
+
+void TestEmulator::testEmulationSession()
+{
+    auto module = compileString(SESSION_KERNEL, "");
+    // Jobs with different memory sizes, so the memory of previous jobs is reused for smaller and larger ones. The
+    // output buffers are larger than the number of work-items, so parts of them are not written by the kernel.
+    std::vector<EmulationData> jobs;
+    jobs.emplace_back(createSessionJob(module, 12, 16, 0, 100));
+    jobs.emplace_back(createSessionJob(module, 4, 8, 1000, 1));
+    jobs.emplace_back(createSessionJob(module, 8, 12, 17, 0));
+    jobs.emplace_back(createSessionJob(module, 12, 16, 0, 100));
+
+    auto checkResult = [&](std::size_t index, const EmulationResult& result) {
+        const auto& job = jobs.at(index);
+        TEST_ASSERT(result.executionSuccessful)
+        if(!result.executionSuccessful)
+            return;
+        auto expected = job.parameter[0].second.value();
+        for(std::size_t i = 0; i < job.workGroup.localSizes[0]; ++i)
+            expected[i] = job.parameter[1].second.value()[i] + job.parameter[2].first;
+        TEST_ASSERT(expected == result.results.at(0).second.value())
+        TEST_ASSERT(job.parameter[1].second.value() == result.results.at(1).second.value())
+        // the result needs to be the same as for a separate emulation without any memory to be reused
+        auto separateResult = emulate(job);
+        TEST_ASSERT(separateResult.results.at(0).second.value() == result.results.at(0).second.value())
+    };
+
+    EmulationSession session(module, "test");
+    for(std::size_t i = 0; i < jobs.size(); ++i)
+        checkResult(i, session.emulate(jobs[i]));
+
+    std::vector<bool> finishedJobs(jobs.size(), false);
+    session.emulate(
+        jobs,
+        [&](std::size_t index, EmulationResult&& result) {
+            finishedJobs.at(index) = true;
+            checkResult(index, result);
+        },
+        true);
+    TEST_ASSERT(std::all_of(finishedJobs.begin(), finishedJobs.end(), [](bool finished) -> bool { return finished; }))
+}
+
+static const std::string PROFILE_KERNEL = R"(
+__kernel void test(__global uint* out, uint count) {
+  uint sum = 0;
+  for(uint i = 0; i < count; ++i)
+    sum += i * get_global_id(0);
+  out[get_global_id(0)] = sum;
+}
+)";
+
+void TestEmulator::testProfileOutput()
+{
+    auto module = compileString(PROFILE_KERNEL, "");
+    vc4c::TemporaryFile profileFile{};
+    EmulationData job;
+    job.module = module;
+    job.kernelName = "test";
+    job.workGroup.dimensions = 1;
+    job.workGroup.localSizes[0] = 4;
+    job.parameter.emplace_back(0, std::vector<uint32_t>(4, 0x42));
+    job.parameter.emplace_back(10, Optional<std::vector<uint32_t>>{});
+    job.profileDump = profileFile.fileName;
+    auto result = emulate(job);
+    TEST_ASSERT(result.executionSuccessful)
+    TEST_ASSERT((std::vector<uint32_t>{0, 45, 90, 135} == result.results.at(0).second.value()))
+
+    std::ifstream fis{profileFile.fileName};
+    std::string line;
+    TEST_ASSERT(std::getline(fis, line) && line == "# callgrind format")
+    // every cost line consists of the instruction position and one value per event
+    std::size_t numEvents = 0;
+    std::vector<uint64_t> summary;
+    std::vector<uint64_t> totals;
+    auto readCosts = [&](const std::string& costLine) -> std::vector<uint64_t> {
+        std::istringstream ss{costLine};
+        std::string position;
+        ss >> position;
+        TEST_ASSERT(position.find("0x") == 0)
+        std::vector<uint64_t> costs;
+        uint64_t cost = 0;
+        while(ss >> cost)
+            costs.push_back(cost);
+        TEST_ASSERT_EQUALS(numEvents, costs.size())
+        return costs;
+    };
+    std::size_t numFunctions = 0;
+    std::size_t numCalls = 0;
+    std::size_t numCostLines = 0;
+    bool callCostFollows = false;
+    while(std::getline(fis, line))
+    {
+        if(line.empty() || line.find("version:") == 0 || line.find("creator:") == 0 ||
+            line.find("positions:") == 0 || line.find("fl=") == 0 || line.find("cfn=") == 0)
+            continue;
+        if(line.find("events:") == 0)
+        {
+            std::istringstream ss{line.substr(std::strlen("events:"))};
+            std::string event;
+            while(ss >> event)
+                ++numEvents;
+            totals.resize(numEvents, 0);
+        }
+        else if(line.find("summary:") == 0)
+        {
+            std::istringstream ss{line.substr(std::strlen("summary:"))};
+            uint64_t value = 0;
+            while(ss >> value)
+                summary.push_back(value);
+            TEST_ASSERT_EQUALS(numEvents, summary.size())
+        }
+        else if(line.find("fn=") == 0)
+        {
+            // every block has a unique function name
+            TEST_ASSERT(line.size() > std::strlen("fn="))
+            ++numFunctions;
+        }
+        else if(line.find("calls=") == 0)
+        {
+            TEST_ASSERT(numFunctions > 0)
+            TEST_ASSERT(std::stoul(line.substr(std::strlen("calls="))) > 0)
+            ++numCalls;
+            callCostFollows = true;
+        }
+        else
+        {
+            TEST_ASSERT(numFunctions > 0)
+            auto costs = readCosts(line);
+            // the (inclusive) costs of the calls are not counted towards the block costs
+            if(!callCostFollows && costs.size() == totals.size())
+            {
+                std::transform(totals.begin(), totals.end(), costs.begin(), totals.begin(), std::plus<uint64_t>{});
+                ++numCostLines;
+            }
+            callCostFollows = false;
+        }
+    }
+    TEST_ASSERT(numEvents > 0)
+    TEST_ASSERT(numFunctions > 1)
+    // the loop back-edge is taken
+    TEST_ASSERT(numCalls > 0)
+    TEST_ASSERT(numCostLines > 0)
+    TEST_ASSERT(summary == totals)
+    TEST_ASSERT(summary.at(0) > 0)
+}
+
+/*
+ * Records the same events for two QPUs of two work-groups, the value of the last register write can be modified
+ */
+static void recordTestTrace(const std::string& fileName, uint32_t lastValue, bool stallSemaphore)
+{
+    TraceWriter writer(fileName);
+    for(uint32_t group = 0; group < 2; ++group)
+    {
+        for(uint8_t qpu = 0; qpu < 2; ++qpu)
+        {
+            TraceRecorder recorder(writer, group, qpu);
+            uint32_t cycle = 0;
+            recorder.setPosition(cycle++, 0);
+            recorder.recordRegisterWrite(Register{RegisterFile::PHYSICAL_A, 3}, SIMDVector(Literal(17u)), 0xFFFF);
+            recorder.setPosition(cycle++, 1);
+            uint32_t data = 0x12345678;
+            recorder.recordMemoryAccess(false, 0x1000 + group, &data, 3);
+            // the number of semaphore stalls depends on the timing and might differ between valid runs
+            if(stallSemaphore)
+                recorder.recordSemaphore(2, true, 0, true);
+            recorder.setPosition(stallSemaphore ? 8 : cycle++, 2);
+            recorder.recordSemaphore(2, true, 1, false);
+            recorder.setPosition(cycle++, 3);
+            recorder.recordMutex(MutexEvent::LOCKED);
+            recorder.recordBranch(true, 7);
+            recorder.setPosition(cycle++, 7);
+            recorder.recordRegisterWrite(
+                Register{RegisterFile::PHYSICAL_B, 5}, SIMDVector(Literal(lastValue + qpu)), 0x00F0);
+            recorder.recordMutex(MutexEvent::UNLOCKED);
+            recorder.recordFinish();
+        }
+    }
+}
+
+void TestEmulator::testTraceRoundTrip()
+{
+    vc4c::TemporaryFile firstFile{};
+    vc4c::TemporaryFile equalFile{};
+    vc4c::TemporaryFile differentFile{};
+    recordTestTrace(firstFile.fileName, 42, false);
+    recordTestTrace(equalFile.fileName, 42, true);
+    recordTestTrace(differentFile.fileName, 43, false);
+
+    TraceReader first(firstFile.fileName);
+    TraceReader equal(equalFile.fileName);
+    TraceReader different(differentFile.fileName);
+
+    // all records are read back in the order they were written
+    std::vector<TraceEventType> expectedTypes{TraceEventType::REGISTER_WRITE, TraceEventType::MEMORY_READ,
+        TraceEventType::SEMAPHORE, TraceEventType::MUTEX, TraceEventType::BRANCH, TraceEventType::REGISTER_WRITE,
+        TraceEventType::MUTEX, TraceEventType::FINISH};
+    std::size_t offset = 0;
+    TraceRecord record{};
+    for(uint32_t group = 0; group < 2; ++group)
+    {
+        for(uint8_t qpu = 0; qpu < 2; ++qpu)
+        {
+            for(auto type : expectedTypes)
+            {
+                TEST_ASSERT(first.readRecord(offset, record))
+                TEST_ASSERT_EQUALS(static_cast<unsigned>(type), static_cast<unsigned>(record.header->type))
+                TEST_ASSERT_EQUALS(group, record.header->group)
+                TEST_ASSERT_EQUALS(static_cast<unsigned>(qpu), static_cast<unsigned>(record.header->qpu))
+                if(type == TraceEventType::MEMORY_READ)
+                {
+                    TEST_ASSERT_EQUALS(0x1000 + group, record.payload[0])
+                    TEST_ASSERT_EQUALS(3u, record.payload[1])
+                    TEST_ASSERT_EQUALS(0x345678u, record.payload[2])
+                }
+                if(type == TraceEventType::REGISTER_WRITE && record.header->pc == 7)
+                {
+                    // only the elements of the mask are recorded
+                    TEST_ASSERT_EQUALS(5u, record.header->numPayloadWords)
+                    TEST_ASSERT_EQUALS(42u + qpu, record.payload[4])
+                }
+            }
+        }
+    }
+    TEST_ASSERT(!first.readRecord(offset, record))
+
+    std::stringstream out;
+    TEST_ASSERT(compareTraces(out, first, first))
+    TEST_ASSERT(out.str().empty())
+    // timing-dependent records and the cycles are not compared
+    TEST_ASSERT(compareTraces(out, first, equal))
+    TEST_ASSERT(out.str().empty())
+
+    TEST_ASSERT(!compareTraces(out, first, different))
+    // every QPU differs in the last register write, the difference is printed in 3 lines per QPU
+    auto output = out.str();
+    TEST_ASSERT_EQUALS(4 * 3, std::count(output.begin(), output.end(), '\n'))
+    TEST_ASSERT(output.find("group 1, QPU 1 differs after 5 records") != std::string::npos)
+    TEST_ASSERT(output.find("0x2a") != std::string::npos)
+    TEST_ASSERT(output.find("0x2b") != std::string::npos)
+
+    // records with too many payload words cannot be represented
+    vc4c::TemporaryFile largeFile{};
+    TraceWriter writer(largeFile.fileName);
+    TraceRecorder recorder(writer, 0, 0);
+    std::vector<uint8_t> data(0x40000);
+    TEST_THROWS(recorder.recordMemoryAccess(true, 0x1000, data.data(), static_cast<uint32_t>(data.size())),
+        vc4c::CompilationError);
+}
+
+void TestEmulator::testEmulationLimit()
+{
+    auto module = compileString(PROFILE_KERNEL, "");
+    EmulationData job;
+    job.module = module;
+    job.kernelName = "test";
+    job.workGroup.dimensions = 1;
+    // every work-item runs on its own QPU
+    job.workGroup.localSizes[0] = 4;
+    job.parameter.emplace_back(0, std::vector<uint32_t>(4, 0x42));
+    job.parameter.emplace_back(10, Optional<std::vector<uint32_t>>{});
+
+    // the smallest instruction limit the emulation succeeds with
+    auto findMinimumLimit = [&](EmulationMode mode) -> uint32_t {
+        auto data = job;
+        EmulationRunner::setEmulationMode(data, mode);
+        uint32_t lower = 0;
+        uint32_t upper = 1u << 16u;
+        while(lower + 1 < upper)
+        {
+            data.maxEmulationCycles = lower + (upper - lower) / 2;
+            if(emulate(data).executionSuccessful)
+                upper = data.maxEmulationCycles;
+            else
+                lower = data.maxEmulationCycles;
+        }
+        return upper;
+    };
+
+    // stalls are not counted, so the limit needs to be the same for all emulation modes
+    auto cycleAccurateLimit = findMinimumLimit(EmulationMode::CYCLE_ACCURATE);
+    TEST_ASSERT(cycleAccurateLimit > 1 && cycleAccurateLimit < (1u << 16u))
+    TEST_ASSERT_EQUALS(cycleAccurateLimit, findMinimumLimit(EmulationMode::FUNCTIONAL))
+    TEST_ASSERT_EQUALS(cycleAccurateLimit, findMinimumLimit(EmulationMode::PARALLEL))
+    TEST_ASSERT_EQUALS(cycleAccurateLimit, findMinimumLimit(EmulationMode::PARALLEL_RELAXED))
+}
+
+void TestEmulator::testParallelEmulation(std::string dataName)
+{
+    EmulationRunner runner(config, compilationCache, EmulationMode::FUNCTIONAL,
+        {EmulationMode::PARALLEL, EmulationMode::PARALLEL_RELAXED});
+    runTestData(dataName, runner);
+}
+
+void TestEmulator::testSeparateWorkGroups(std::string dataName)
+{
+    auto configCopy = config;
+    configCopy.additionalEnabledOptimizations.erase(vc4c::optimizations::PASS_WORK_GROUP_LOOP);
+    configCopy.additionalDisabledOptimizations.emplace(vc4c::optimizations::PASS_WORK_GROUP_LOOP);
+    // the compilation cache is keyed by the source code and options only, not by the configuration
+    std::unordered_map<std::string, vc4c::CompilationData> cache;
+    EmulationRunner runner(configCopy, cache, EmulationMode::FUNCTIONAL, {EmulationMode::CYCLE_ACCURATE});
+    runTestData(dataName, runner);
+}
+
+void TestEmulator::testPrefetchLoads(std::string dataName)
+{
+    // runs the test data with the given configuration and returns the number of loops rewritten by the PrefetchLoads
+    // pass while compiling the test kernels
+    auto runWithPrefetchStatistics = [&](const Configuration& runConfig) -> uint64_t {
+        // the compilation cache is keyed by the source code and options only, not by the configuration, so each
+        // configuration needs its own cache
+        std::unordered_map<std::string, vc4c::CompilationData> cache;
+        EmulationRunner runner(runConfig, cache, EmulationMode::CYCLE_ACCURATE);
+        optimizations::Optimizer::getPassStatistics(true);
+        optimizations::Optimizer::setCollectPassStatistics(true);
+        runTestData(dataName, runner);
+        optimizations::Optimizer::setCollectPassStatistics(false);
+        auto statistics = optimizations::Optimizer::getPassStatistics(true);
+        auto it = statistics.find("PrefetchLoads");
+        return it != statistics.end() ? it->second.changes : 0;
+    };
+
+    auto noPrefetchConfig = config;
+    noPrefetchConfig.additionalEnabledOptimizations.erase("prefetch-loads");
+    noPrefetchConfig.additionalDisabledOptimizations.emplace("prefetch-loads");
+    TEST_ASSERT_EQUALS(0u, runWithPrefetchStatistics(noPrefetchConfig));
+
+    auto prefetchConfig = config;
+    prefetchConfig.additionalDisabledOptimizations.erase("prefetch-loads");
+    prefetchConfig.additionalEnabledOptimizations.emplace("prefetch-loads");
+    // by default, only the loop of the kernel with a single load is rewritten
+    TEST_ASSERT_EQUALS(1u, runWithPrefetchStatistics(prefetchConfig));
+
+    // allowing to prefetch as many loads as fit into the TMU queues also pipelines the loop with multiple loads
+    prefetchConfig.additionalOptions.maxPrefetchedLoads = 2 * periphery::TMU_QUEUE_SIZE;
+    TEST_ASSERT_EQUALS(2u, runWithPrefetchStatistics(prefetchConfig));
+}
+
 std::map<std::string, const test_data::TestData*> TestEmulator::getAllTestData()
 {
     return test_data::getAllTests(defaultFilter);
@@ -23,6 +23,8 @@ namespace test_data
     class TestData;
 } // namespace test_data
 
+class EmulationRunner;
+
 class TestEmulator : public Test::Suite, protected TestCompilationHelper
 {
 public:
@@ -40,11 +42,22 @@ public:
     void runTestData(std::string dataName, bool useCompilationCache);
     void runTestData(std::string dataName, vc4c::FastMap<std::string, vc4c::CompilationData>& cache);
     void runNoSuchTestData(std::string dataName);
+    void testFunctionalEmulation(std::string dataName);
+    void testParallelEmulation(std::string dataName);
+    void testSeparateWorkGroups(std::string dataName);
+    void testPrefetchLoads(std::string dataName);
+    void testMappedMemory();
+    void testEmulationSession();
+    void testProfileOutput();
+    void testTraceRoundTrip();
+    void testEmulationLimit();
 
     static std::map<std::string, const test_data::TestData*> getAllTestData();
 
 protected:
     std::unordered_map<std::string, vc4c::CompilationData> compilationCache;
+
+    void runTestData(const std::string& dataName, EmulationRunner& runner);
 };
 
 #endif /* TEST_EMULATOR_H */
@@ -6,6 +6,7 @@
 
 #include "TestFrontends.h"
 
+#include "CompilationCache.h"
 #include "CompilerInstance.h"
 #include "GlobalValues.h"
 #include "Profiler.h"
@@ -26,11 +27,15 @@
 using namespace vc4c::spirv;
 
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
+#include <iterator>
 #include <memory>
 #include <sstream>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 using namespace vc4c;
 
@@ -89,6 +94,9 @@ TestFrontends::TestFrontends()
 
     TEST_ADD(TestFrontends::testCompilationDataSerialization);
     TEST_ADD(TestFrontends::testPrecompileStandardLibrary);
+    TEST_ADD(TestFrontends::testCompilationCache);
+    TEST_ADD(TestFrontends::testCompilationTrace);
+    TEST_ADD(TestFrontends::testPipelinedCompilation);
     TEST_ADD(TestFrontends::printProfilingInfo);
 }
 
@@ -443,6 +451,103 @@ void TestFrontends::testPrecompileStandardLibrary()
     remove("/tmp/vc4cc-testing/");
 }
 
+void TestFrontends::testCompilationCache()
+{
+    char cacheDir[] = "/tmp/vc4cc-cache-XXXXXX";
+    if(mkdtemp(cacheDir) == nullptr)
+        TEST_ASSERT_EQUALS("", strerror(errno));
+
+    Configuration config{};
+    config.outputMode = OutputMode::BINARY;
+    config.cacheDirectory = cacheDir;
+    CompilationData source{EXAMPLE_FILES "fibonacci.cl", SourceType::OPENCL_C};
+
+    // first compilation fills the cache, second compilation reads from it
+    auto numHits = CompilationCache::getNumHits();
+    auto first = Compiler::compile(source, config);
+    TEST_ASSERT_EQUALS(numHits, CompilationCache::getNumHits());
+    auto second = Compiler::compile(source, config);
+    TEST_ASSERT_EQUALS(numHits + 1, CompilationCache::getNumHits());
+    TEST_ASSERT_EQUALS(SourceType::QPUASM_BIN, second.first.getType());
+    TEST_ASSERT_EQUALS(first.second, second.second);
+    std::stringstream firstData;
+    first.first.readInto(firstData);
+    std::stringstream secondData;
+    second.first.readInto(secondData);
+    TEST_ASSERT_EQUALS(firstData.str(), secondData.str());
+    testEmulation(second.first);
+
+    // different configuration must not hit the cached entry
+    config.outputMode = OutputMode::HEX;
+    auto third = Compiler::compile(source, config);
+    TEST_ASSERT_EQUALS(numHits + 1, CompilationCache::getNumHits());
+    TEST_ASSERT_EQUALS(SourceType::QPUASM_HEX, third.first.getType());
+    std::stringstream thirdData;
+    third.first.readInto(thirdData);
+    TEST_ASSERT(firstData.str() != thirdData.str());
+
+    // Clean up only after successful test
+    TEST_ASSERT_EQUALS(0, system((std::string{"rm -rf "} + cacheDir).data()));
+}
+
+void TestFrontends::testCompilationTrace()
+{
+    char traceFile[] = "/tmp/vc4cc-trace-XXXXXX";
+    auto fd = mkstemp(traceFile);
+    if(fd < 0)
+        TEST_ASSERT_EQUALS("", strerror(errno));
+    close(fd);
+
+    Configuration config{};
+    config.traceFile = traceFile;
+    CompilationData source{EXAMPLE_FILES "fibonacci.cl", SourceType::OPENCL_C};
+    auto result = Compiler::compile(source, config);
+    TEST_ASSERT(!profiler::isTracingEnabled());
+
+    std::ifstream fis{traceFile};
+    std::string trace{std::istreambuf_iterator<char>{fis}, std::istreambuf_iterator<char>{}};
+    TEST_ASSERT(trace.find("\"traceEvents\"") != std::string::npos);
+    // the single stages as well as the passes are recorded
+    TEST_ASSERT(trace.find("\"Normalize\"") != std::string::npos);
+    TEST_ASSERT(trace.find("\"Optimize\"") != std::string::npos);
+    TEST_ASSERT(trace.find("\"SingleSteps\"") != std::string::npos);
+    TEST_ASSERT(trace.find("\"GenerateCode\"") != std::string::npos);
+    TEST_ASSERT(trace.find("\"fibonacci\"") != std::string::npos);
+
+    // Clean up only after successful test
+    TEST_ASSERT_EQUALS(0, std::remove(traceFile));
+}
+
+void TestFrontends::testPipelinedCompilation()
+{
+    Configuration config{};
+    config.outputMode = OutputMode::HEX;
+    // module with multiple kernels of different sizes
+    CompilationData source{EXAMPLE_FILES "histogram.cl", SourceType::OPENCL_C};
+
+    std::stringstream stagedOutput;
+    {
+        CompilerInstance instance{config};
+        instance.precompileAndParseInput(source);
+        instance.normalize();
+        instance.optimize();
+        instance.adjust();
+        instance.generateCode(stagedOutput);
+    }
+
+    std::stringstream pipelinedOutput;
+    {
+        CompilerInstance instance{config};
+        instance.precompileAndParseInput(source);
+        instance.compileKernels(pipelinedOutput);
+        TEST_ASSERT_EQUALS(instance.module.getKernels().size(), instance.module.methods.size());
+    }
+
+    // processing the kernels independently generates the same code as running the stages for all kernels at once
+    TEST_ASSERT(!stagedOutput.str().empty());
+    TEST_ASSERT_EQUALS(stagedOutput.str(), pipelinedOutput.str());
+}
+
 void TestFrontends::printProfilingInfo()
 {
 #ifndef NDEBUG
@@ -26,6 +26,9 @@ public:
     void testFrontendConversions(std::string sourceFile, vc4c::SourceType destType);
     void testCompilationDataSerialization();
     void testPrecompileStandardLibrary();
+    void testCompilationCache();
+    void testCompilationTrace();
+    void testPipelinedCompilation();
     void printProfilingInfo();
 
 private:
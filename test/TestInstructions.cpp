@@ -1549,6 +1549,31 @@ void TestInstructions::testSIMDVector()
         SIMDVector({Literal(1), Literal(2), Literal(3), Literal(0), Literal(5), Literal(6), Literal(7), Literal(4),
             Literal(9), Literal(10), Literal(11), Literal(8), Literal(13), Literal(14), Literal(15), Literal(12)}),
         v)
+
+    SIMDVector::Words words{};
+    TEST_ASSERT(ELEMENT_NUMBERS.vector().toWords(words))
+    TEST_ASSERT_EQUALS(15u, words[15])
+    TEST_ASSERT_EQUALS(ELEMENT_NUMBERS.vector(), SIMDVector::fromWords(words))
+    v[7] = UNDEFINED_LITERAL;
+    TEST_ASSERT(!v.toWords(words))
+
+    // the calculation on the raw vector lanes needs to produce the same results as the per-element calculation
+    SIMDVector first({Literal(0u), Literal(1u), Literal(-1), Literal(0x7FFFFFFFu), Literal(0x80000000u), Literal(42u),
+        Literal(-42), Literal(0x00FFFFFFu), Literal(0x12345678u), Literal(31u), Literal(32u), Literal(0xFF00FF00u),
+        Literal(17u), Literal(0x80808080u), Literal(-17), Literal(0x7F7F7F7Fu)});
+    SIMDVector second = first.rotate(5);
+    for(const auto& code : {OP_ADD, OP_SUB, OP_SHR, OP_ASR, OP_ROR, OP_SHL, OP_MIN, OP_MAX, OP_AND, OP_OR, OP_XOR,
+            OP_NOT, OP_CLZ, OP_V8ADDS, OP_V8SUBS, OP_MUL24, OP_V8MULD, OP_V8MIN, OP_V8MAX})
+    {
+        auto vectorResult = code(first, second);
+        TEST_ASSERT(!!vectorResult.first)
+        for(std::size_t i = 0; i < first.size(); ++i)
+        {
+            auto literalResult = code(first[i], second[i], TYPE_INT32);
+            TEST_ASSERT_EQUALS(literalResult.first->getLiteralValue().value(), vectorResult.first.value()[i])
+            TEST_ASSERT_EQUALS(literalResult.second[0], vectorResult.second[i])
+        }
+    }
 }
 
 void TestInstructions::testValue()
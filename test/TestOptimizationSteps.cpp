@@ -8,6 +8,7 @@
 #include "Expression.h"
 #include "Method.h"
 #include "Module.h"
+#include "analysis/DependencyGraph.h"
 #include "intermediate/Helper.h"
 #include "intermediate/operators.h"
 #include "optimization/Combiner.h"
@@ -15,6 +16,7 @@
 #include "optimization/ControlFlow.h"
 #include "optimization/Eliminator.h"
 #include "optimization/Flags.h"
+#include "optimization/InstructionScheduler.h"
 #include "optimization/Vector.h"
 
 #include <cmath>
@@ -43,6 +45,7 @@ TestOptimizationSteps::TestOptimizationSteps()
     TEST_ADD(TestOptimizationSteps::testRemoveConditionalFlags);
     TEST_ADD(TestOptimizationSteps::testCombineVectorElementCopies);
     TEST_ADD(TestOptimizationSteps::testLoopInvariantCodeMotion);
+    TEST_ADD(TestOptimizationSteps::testScheduleInstructions);
 }
 
 static bool checkEquals(
@@ -2844,3 +2847,156 @@ void TestOptimizationSteps::testLoopInvariantCodeMotion()
     it.nextInMethod();
     TEST_ASSERT(!!it.get<Branch>());
 }
+
+/*
+ * Creates a chain of dependent instructions requiring all kinds of mandatory delays (SFU result, vector rotation, pack
+ * and unpack modes) followed by a TMU load and appends the given number of independent instructions.
+ *
+ * Returns the instructions writing the TMU address and triggering the TMU load.
+ */
+static std::pair<const intermediate::IntermediateInstruction*, const intermediate::IntermediateInstruction*>
+createSchedulingBlock(Method& method, BasicBlock& block, unsigned numIndependentInstructions)
+{
+    using namespace vc4c::intermediate;
+    auto it = block.walkEnd();
+
+    auto in = assign(it, TYPE_INT32, "%in") = UNIFORM_REGISTER;
+    // SFU result can be read 2 instructions after writing the SFU input
+    assign(it, Value(REG_SFU_RECIP, TYPE_FLOAT)) = in;
+    auto recip = assign(it, TYPE_FLOAT, "%recip") = Value(REG_SFU_OUT, TYPE_FLOAT);
+    // the input of a vector rotation cannot be written in the previous instruction
+    auto rotated = method.addNewLocal(TYPE_FLOAT, "%rotated");
+    it.emplace(std::make_unique<VectorRotation>(
+        rotated, recip, SmallImmediate::fromRotationOffset(1), RotationType::FULL));
+    it.nextInBlock();
+    // a value written with pack mode cannot be read in the next instruction
+    auto packed = method.addNewLocal(TYPE_INT32, "%packed");
+    it.emplace(std::make_unique<MoveOperation>(packed, rotated));
+    it.get<ExtendedInstruction>()->setPackMode(PACK_INT_TO_SHORT_TRUNCATE);
+    it.nextInBlock();
+    auto sum = assign(it, TYPE_INT32, "%sum") = (packed + in);
+    // a value read with unpack mode cannot be written in the previous instruction
+    auto unpacked = method.addNewLocal(TYPE_INT32, "%unpacked");
+    it.emplace(std::make_unique<MoveOperation>(unpacked, sum));
+    it.get<UnpackingInstruction>()->setUnpackMode(UNPACK_16A_32);
+    it.nextInBlock();
+
+    // the TMU load should be triggered 8 instructions after writing the address
+    assign(it, Value(REG_TMU0_ADDRESS, TYPE_INT32)) = unpacked;
+    auto tmuAddressWrite = it.copy().previousInBlock().get();
+    nop(it, DelayType::WAIT_TMU, SIGNAL_LOAD_TMU0);
+    auto tmuLoad = it.copy().previousInBlock().get();
+    ignoreReturnValue(assign(it, TYPE_INT32, "%result") = Value(REG_TMU_OUT, TYPE_INT32));
+
+    for(unsigned i = 0; i < numIndependentInstructions; ++i)
+        ignoreReturnValue(assign(it, TYPE_INT32, "%independent") =
+                              (ELEMENT_NUMBER_REGISTER + Value(Literal(i), TYPE_INT32)));
+
+    return std::make_pair(tmuAddressWrite, tmuLoad);
+}
+
+static FastMap<const intermediate::IntermediateInstruction*, std::size_t> getInstructionCycles(BasicBlock& block)
+{
+    FastMap<const intermediate::IntermediateInstruction*, std::size_t> cycles;
+    std::size_t cycle = 0;
+    for(auto it = block.walk(); !it.isEndOfBlock(); it.nextInBlock())
+    {
+        if(!it.has() || !it->mapsToASMInstruction())
+            continue;
+        cycles.emplace(it.get(), cycle);
+        ++cycle;
+    }
+    return cycles;
+}
+
+static std::size_t countDelays(BasicBlock& block)
+{
+    std::size_t numNops = 0;
+    for(auto it = block.walk(); !it.isEndOfBlock(); it.nextInBlock())
+    {
+        // does not count the NOPs triggering the TMU loads
+        auto nop = it.get<intermediate::Nop>();
+        if(nop && nop->getSignal() == SIGNAL_NONE)
+            ++numNops;
+    }
+    return numNops;
+}
+
+/*
+ * Returns the number of dependencies of the original block whose order or mandatory delay is violated in the scheduled
+ * block.
+ */
+static std::size_t countViolatedDependencies(BasicBlock& block, const analysis::DependencyGraph& originalDependencies)
+{
+    auto cycles = getInstructionCycles(block);
+    std::size_t numViolations = 0;
+    originalDependencies.forAllNodes([&](const analysis::DependencyNode& node) {
+        auto nodeIt = cycles.find(node.key);
+        if(nodeIt == cycles.end())
+            return;
+        node.forAllOutgoingEdges(
+            [&](const analysis::DependencyNode& successor, const analysis::DependencyEdge& edge) -> bool {
+                auto succIt = cycles.find(successor.key);
+                if(succIt == cycles.end())
+                    return true;
+                auto minDistance = 1 + (edge.data.isMandatoryDelay ? edge.data.numDelayCycles : 0);
+                if(succIt->second < nodeIt->second + minDistance)
+                    ++numViolations;
+                return true;
+            });
+    });
+    return numViolations;
+}
+
+void TestOptimizationSteps::testScheduleInstructions()
+{
+    using namespace vc4c::intermediate;
+    Configuration config{};
+    Module module{config};
+
+    // without any independent instructions, the mandatory delays need to be filled with NOPs
+    {
+        Method method(module);
+        auto& block = method.createAndInsertNewBlock(method.end(), "%dummy");
+        createSchedulingBlock(method, block, 0);
+        auto dependencies = analysis::DependencyGraph::createGraph(block);
+
+        optimizations::scheduleInstructions(module, method, block, config);
+
+        TEST_ASSERT_EQUALS(0u, countViolatedDependencies(block, *dependencies));
+        // 2 for the SFU result, 1 each for the vector rotation, the pack mode and the unpack mode
+        TEST_ASSERT_EQUALS(5u, countDelays(block));
+    }
+
+    // independent instructions are moved into the delays, also filling the latency of the TMU load
+    {
+        Method method(module);
+        auto& block = method.createAndInsertNewBlock(method.end(), "%dummy");
+        auto tmuInstructions = createSchedulingBlock(method, block, 16);
+        auto dependencies = analysis::DependencyGraph::createGraph(block);
+
+        optimizations::scheduleInstructions(module, method, block, config);
+
+        TEST_ASSERT_EQUALS(0u, countViolatedDependencies(block, *dependencies));
+        TEST_ASSERT_EQUALS(0u, countDelays(block));
+        auto cycles = getInstructionCycles(block);
+        TEST_ASSERT(cycles.at(tmuInstructions.second) > cycles.at(tmuInstructions.first) + 8);
+    }
+
+    // the TMU address can be written in a previous block, e.g. if the load is prefetched in the previous loop iteration
+    {
+        Method method(module);
+        auto& block = method.createAndInsertNewBlock(method.end(), "%dummy");
+        auto it = block.walkEnd();
+        nop(it, DelayType::WAIT_TMU, SIGNAL_LOAD_TMU0);
+        auto result = assign(it, TYPE_INT32, "%result") = Value(REG_TMU_OUT, TYPE_INT32);
+        assign(it, Value(REG_TMU0_ADDRESS, TYPE_INT32)) = result;
+        auto dependencies = analysis::DependencyGraph::createGraph(block);
+
+        optimizations::scheduleInstructions(module, method, block, config);
+
+        TEST_ASSERT_EQUALS(0u, countViolatedDependencies(block, *dependencies));
+        TEST_ASSERT_EQUALS(0u, countDelays(block));
+        TEST_ASSERT_EQUALS(4u, block.size());
+    }
+}
@@ -12,8 +12,12 @@
 #include "Profiler.h"
 #include "emulation_helper.h"
 #include "intermediate/IntermediateInstruction.h"
+#include "intermediate/operators.h"
 #include "optimization/Optimizer.h"
 
+#include <numeric>
+#include <regex>
+
 using namespace vc4c;
 using namespace vc4c::tools;
 
@@ -93,6 +97,10 @@ TestOptimizations::TestOptimizations(const vc4c::Configuration& config) : TestEm
         TEST_ADD_WITH_STRING(TestOptimizations::testVstoreAlias, pass.parameterName);
         counterNames.emplace(pass.name);
     }
+    TEST_ADD(TestOptimizations::testParallelBlockOptimizations);
+    TEST_ADD(TestOptimizations::testParallelBlockOptimizationsMatchSerial);
+    TEST_ADD(TestOptimizations::testIndependentBlockWaves);
+    TEST_ADD(TestOptimizations::testWorklistOptimizations);
     TEST_ADD(TestOptimizations::checkTestQuality);
     TEST_ADD(TestOptimizations::printProfilingInfo);
 }
@@ -494,6 +502,184 @@ void TestOptimizations::testVstoreAlias(std::string passParamName)
     TestEmulator::runTestData("vstore_alias_private_register_strided_char_to_int", cache);
 }
 
+void TestOptimizations::testParallelBlockOptimizations()
+{
+    config.additionalEnabledOptimizations = {};
+    config.optimizationLevel = OptimizationLevel::FULL;
+    // run the block-local optimizations in parallel for all methods
+    config.additionalOptions.parallelBlockThreshold = 1;
+
+    TestEmulator::runTestData("branches", false);
+    TestEmulator::runTestData("CRC16", false);
+    TestEmulator::runTestData("fibonacci", false);
+
+    config.additionalOptions.parallelBlockThreshold = OptimizationOptions{}.parallelBlockThreshold;
+}
+
+/*
+ * Creates a method with many basic blocks accessing the same locals with optimization opportunities in every block
+ */
+static void createMultiBlockMethod(Method& method)
+{
+    using namespace vc4c::operators;
+    auto& entry = method.createAndInsertNewBlock(method.end(), BasicBlock::DEFAULT_BLOCK);
+    auto it = entry.walkEnd();
+    auto shared = assign(it, TYPE_INT32, "%shared") = UNIFORM_REGISTER;
+    auto& end = method.createAndInsertNewBlock(method.end(), BasicBlock::LAST_BLOCK);
+    auto endLabel = end.getLabel()->getLabel();
+    auto last = shared;
+    for(unsigned i = 0; i < 16; ++i)
+    {
+        auto& block = method.createAndInsertNewBlock(std::prev(method.end()), "%block" + std::to_string(i));
+        it = block.walkEnd();
+        // copy which can be eliminated
+        auto copy = assign(it, TYPE_INT32, "%copy") = last;
+        // arithmetic which can be simplified
+        auto sum = assign(it, TYPE_INT32, "%sum") = (copy + INT_ZERO);
+        last = assign(it, TYPE_INT32, "%result") = (sum ^ shared);
+        assign(it, Value(REG_VPM_IO, TYPE_INT32)) = last;
+        // conditional branches keep the blocks from being merged
+        assignNop(it) = (last, SetFlag::SET_FLAGS);
+        branch(it, endLabel, BRANCH_ALL_Z_SET);
+    }
+}
+
+/*
+ * Creates a method with many basic blocks which only share a parameter and thus can be optimized in parallel
+ */
+static void createIndependentBlocksMethod(Method& method)
+{
+    using namespace vc4c::operators;
+    auto& param = method.addParameter(Parameter("%param", TYPE_INT32));
+    auto& entry = method.createAndInsertNewBlock(method.end(), BasicBlock::DEFAULT_BLOCK);
+    auto it = entry.walkEnd();
+    // same as the parameter loading inserted by the normalization
+    assign(it, param.createReference()) = UNIFORM_REGISTER;
+    auto& end = method.createAndInsertNewBlock(method.end(), BasicBlock::LAST_BLOCK);
+    auto endLabel = end.getLabel()->getLabel();
+    for(unsigned i = 0; i < 16; ++i)
+    {
+        auto& block = method.createAndInsertNewBlock(std::prev(method.end()), "%block" + std::to_string(i));
+        it = block.walkEnd();
+        // copy which can be eliminated
+        auto copy = assign(it, TYPE_INT32, "%copy") = param.createReference();
+        // arithmetic which can be simplified
+        auto sum = assign(it, TYPE_INT32, "%sum") = (copy + INT_ZERO);
+        auto result = assign(it, TYPE_INT32, "%result") = (sum ^ Value(Literal(i), TYPE_INT32));
+        assign(it, Value(REG_VPM_IO, TYPE_INT32)) = result;
+        // conditional branches keep the blocks from being merged
+        assignNop(it) = (result, SetFlag::SET_FLAGS);
+        branch(it, endLabel, BRANCH_ALL_Z_SET);
+    }
+}
+
+/*
+ * Optimizes the method created by the given function with the given configuration and returns the resulting
+ * instructions with the unique suffixes of the local names removed, since they depend on the global naming counter
+ */
+static std::vector<std::string> optimizeMultiBlockMethod(
+    const Configuration& config, void (*createMethod)(Method&) = createMultiBlockMethod)
+{
+    Module module{config};
+    Method method{module};
+    createMethod(method);
+    optimizations::Optimizer{config}.optimizeMethod(module, method);
+
+    static const std::regex localSuffix{"(%[^ .]+)\\.[0-9]+"};
+    std::vector<std::string> instructions;
+    for(auto it = method.walkAllInstructions(); !it.isEndOfMethod(); it.nextInMethod())
+    {
+        if(it.has())
+            instructions.emplace_back(std::regex_replace(it->to_string(), localSuffix, "$1"));
+    }
+    return instructions;
+}
+
+void TestOptimizations::testParallelBlockOptimizationsMatchSerial()
+{
+    Configuration serialConfig = config;
+    serialConfig.additionalEnabledOptimizations = {};
+    serialConfig.optimizationLevel = OptimizationLevel::FULL;
+    serialConfig.additionalOptions.parallelBlockThreshold = 0;
+    Configuration parallelConfig = serialConfig;
+    // run the block-local optimizations in parallel for all methods
+    parallelConfig.additionalOptions.parallelBlockThreshold = 1;
+
+    for(auto createMethod : {createMultiBlockMethod, createIndependentBlocksMethod})
+    {
+        auto serialInstructions = optimizeMultiBlockMethod(serialConfig, createMethod);
+        auto parallelInstructions = optimizeMultiBlockMethod(parallelConfig, createMethod);
+        TEST_ASSERT_EQUALS(serialInstructions.size(), parallelInstructions.size());
+        for(std::size_t i = 0; i < std::min(serialInstructions.size(), parallelInstructions.size()); ++i)
+            TEST_ASSERT_EQUALS(serialInstructions[i], parallelInstructions[i]);
+    }
+}
+
+static std::size_t getMaxWaveWidth(const std::vector<std::vector<BasicBlock*>>& waves)
+{
+    std::size_t width = 0;
+    for(const auto& wave : waves)
+        width = std::max(width, wave.size());
+    return width;
+}
+
+void TestOptimizations::testIndependentBlockWaves()
+{
+    {
+        // every block reads the result of the previous block, so no two of them can be optimized in parallel
+        Module module{config};
+        Method method{module};
+        createMultiBlockMethod(method);
+        auto waves = optimizations::groupIndependentBlocks(method);
+        TEST_ASSERT_EQUALS(method.size(), std::accumulate(waves.begin(), waves.end(), std::size_t{0},
+                                              [](std::size_t sum, const std::vector<BasicBlock*>& wave) {
+                                                  return sum + wave.size();
+                                              }));
+        // only the empty end block can be put in parallel to any other block
+        TEST_ASSERT(getMaxWaveWidth(waves) <= 2u);
+    }
+    {
+        // the blocks only share the (read-only) parameter, so all of them can be optimized in parallel
+        Module module{config};
+        Method method{module};
+        createIndependentBlocksMethod(method);
+        auto waves = optimizations::groupIndependentBlocks(method);
+        TEST_ASSERT_EQUALS(2u, waves.size());
+        // the start block writes the parameter and therefore is not in the same wave as the blocks reading it
+        TEST_ASSERT_EQUALS(&*method.begin(), waves.front().front());
+        TEST_ASSERT(getMaxWaveWidth(waves) >= 16u);
+
+        // restricting the blocks to group only returns the selected blocks
+        FastSet<const BasicBlock*> filter{&*std::next(method.begin()), &*std::next(method.begin(), 2)};
+        waves = optimizations::groupIndependentBlocks(method, &filter);
+        TEST_ASSERT_EQUALS(1u, waves.size());
+        TEST_ASSERT_EQUALS(2u, waves.front().size());
+    }
+}
+
+void TestOptimizations::testWorklistOptimizations()
+{
+    config.additionalEnabledOptimizations = {};
+    config.optimizationLevel = OptimizationLevel::FULL;
+    // only revisit modified blocks for all methods
+    config.additionalOptions.worklistThreshold = 1;
+
+    TestEmulator::runTestData("branches", false);
+    TestEmulator::runTestData("CRC16", false);
+    TestEmulator::runTestData("fibonacci", false);
+
+    // revisiting only the modified blocks needs to produce the same code as visiting all blocks
+    Configuration fullConfig = config;
+    fullConfig.additionalOptions.worklistThreshold = 0;
+    auto fullInstructions = optimizeMultiBlockMethod(fullConfig);
+    auto worklistInstructions = optimizeMultiBlockMethod(config);
+    TEST_ASSERT_EQUALS(fullInstructions.size(), worklistInstructions.size());
+    for(std::size_t i = 0; i < std::min(fullInstructions.size(), worklistInstructions.size()); ++i)
+        TEST_ASSERT_EQUALS(fullInstructions[i], worklistInstructions[i]);
+
+    config.additionalOptions.worklistThreshold = OptimizationOptions{}.worklistThreshold;
+}
+
 void TestOptimizations::checkTestQuality()
 {
     bool anyCounterValues = false;
@@ -58,6 +58,11 @@ public:
 
     void testVstoreAlias(std::string passParamName);
 
+    void testParallelBlockOptimizations();
+    void testParallelBlockOptimizationsMatchSerial();
+    void testIndependentBlockWaves();
+    void testWorklistOptimizations();
+
     void checkTestQuality();
 
 private:
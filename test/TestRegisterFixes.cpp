@@ -12,10 +12,13 @@
 #include "Profiler.h"
 #include "TestData.h"
 #include "TestEntries.h"
+#include "asm/GraphColoring.h"
 #include "asm/RegisterFixes.h"
 #include "tools.h"
 
+#include <algorithm>
 #include <atomic>
+#include <mutex>
 #include <set>
 #include <sstream>
 
@@ -26,6 +29,58 @@ static const std::string MESSAGE_REGISTER_FIX_FAILED =
     "Register allocation failed, remainder of test will be skipped: ";
 
 static std::atomic_bool fixupStepCalled{};
+static std::mutex graphMismatchLock;
+static std::string graphMismatch;
+
+using GraphStructure = vc4c::SortedMap<const Local*, std::vector<std::pair<const Local*, unsigned>>>;
+
+static GraphStructure toGraphStructure(const qpu_asm::ColoredGraph& graph)
+{
+    GraphStructure structure;
+    graph.forAllNodes([&](const qpu_asm::ColoredNode& node) {
+        auto& neighbors = structure[node.key];
+        node.forAllEdges([&](const qpu_asm::ColoredNode& neighbor, const qpu_asm::ColoredEdge& edge) -> bool {
+            neighbors.emplace_back(neighbor.key, static_cast<unsigned>(edge.data));
+            return true;
+        });
+        std::sort(neighbors.begin(), neighbors.end());
+    });
+    return structure;
+}
+
+/*
+ * Fix-up step comparing the colored graph (which is updated incrementally after the previous fix-up steps) with a graph
+ * created from scratch for the current state of the method
+ */
+static qpu_asm::FixupResult compareWithRecreatedGraph(
+    Method& method, const Configuration& config, qpu_asm::GraphColoring& coloredGraph)
+{
+    qpu_asm::GraphColoring recreatedGraph(method, method.walkAllInstructions());
+    (void) recreatedGraph.colorGraph();
+    auto expected = toGraphStructure(recreatedGraph.getGraph());
+    auto actual = toGraphStructure(coloredGraph.getGraph());
+    if(expected != actual)
+    {
+        std::string error = "Incrementally updated graph differs from recreated graph for method " + method.name + ":";
+        for(const auto& node : expected)
+        {
+            auto it = actual.find(node.first);
+            if(it == actual.end())
+                error.append(" missing node ").append(node.first->name);
+            else if(it->second != node.second)
+                error.append(" different neighbors of ").append(node.first->name);
+        }
+        for(const auto& node : actual)
+        {
+            if(expected.find(node.first) == expected.end())
+                error.append(" additional node ").append(node.first->name);
+        }
+        std::lock_guard<std::mutex> guard(graphMismatchLock);
+        if(graphMismatch.empty())
+            graphMismatch = error;
+    }
+    return qpu_asm::FixupResult::NOTHING_FIXED;
+}
 
 class RegisterFixEmulationRunner final : public EmulationRunner
 {
@@ -62,6 +117,7 @@ public:
             std::stringstream ss;
             instance.generateCode(ss, steps);
             currentData.module = CompilationData{ss};
+            session.reset();
         }
         catch(const CompilationError& err)
         {
@@ -103,11 +159,20 @@ TestRegisterFixes::TestRegisterFixes(const vc4c::Configuration& config) : config
         TEST_ADD_TWO_ARGUMENTS(TestRegisterFixes::testRegisterFix, std::string{"boost_fibonacci"}, step.name);
         TEST_ADD_TWO_ARGUMENTS(TestRegisterFixes::testRegisterFix, std::string{"boost_initial_reduce"}, step.name);
         TEST_ADD_TWO_ARGUMENTS(TestRegisterFixes::testRegisterFix, std::string{"clNN_upscale"}, step.name);
+        TEST_ADD_TWO_ARGUMENTS(
+            TestRegisterFixes::testRegisterFix, std::string{"constants_register_pressure"}, step.name);
         TEST_ADD_TWO_ARGUMENTS(TestRegisterFixes::testRegisterFix, std::string{"shuffle"}, step.name);
         TEST_ADD_TWO_ARGUMENTS(TestRegisterFixes::testRegisterFix, std::string{"shuffle_sample3"}, step.name);
         TEST_ADD_TWO_ARGUMENTS(TestRegisterFixes::testRegisterFix,
             std::string{"vstore_alias_private_register_strided_char_to_int"}, step.name);
     }
+    // the incrementally updated graph needs to match a recreated graph after every fix-up step
+    for(std::string test : {"OpenCL_CTS_min_max_constant_args", "OpenCV_mean_stddev", "SHA256", "boost_fibonacci",
+            "clNN_upscale", "shuffle_sample3"})
+    {
+        TEST_ADD_WITH_STRING(TestRegisterFixes::testIncrementalGraphUpdate, test);
+    }
+    TEST_ADD(TestRegisterFixes::testRematerializeSpilledConstants);
     TEST_ADD(TestRegisterFixes::checkTestQuality);
 }
 
@@ -149,6 +214,51 @@ void TestRegisterFixes::testRegisterFix(std::string entryName, std::string stepN
         TEST_ASSERT_EQUALS("(no error)", result.error);
 }
 
+void TestRegisterFixes::testIncrementalGraphUpdate(std::string entryName)
+{
+    {
+        std::lock_guard<std::mutex> guard(graphMismatchLock);
+        graphMismatch.clear();
+    }
+    std::vector<qpu_asm::RegisterFixupStep> steps;
+    for(const auto& step : qpu_asm::FIXUP_STEPS)
+    {
+        steps.emplace_back(step);
+        steps.emplace_back(qpu_asm::RegisterFixupStep{"CompareWithRecreatedGraph", compareWithRecreatedGraph});
+    }
+
+    RegisterFixEmulationRunner runner(config, std::move(steps), precompilationCache);
+    auto result = test_data::execute(test_data::getTest(entryName), runner);
+    {
+        std::lock_guard<std::mutex> guard(graphMismatchLock);
+        TEST_ASSERT_EQUALS("", graphMismatch)
+    }
+    if(!result && result.error.find(MESSAGE_REGISTER_FIX_FAILED) == 0)
+        // the fix-up steps are not enough to compile the kernel, but the graphs were still compared
+        return;
+    TEST_ASSERT(result.wasSuccess)
+    if(!result.error.empty())
+        TEST_ASSERT_EQUALS("(no error)", result.error);
+}
+
+void TestRegisterFixes::testRematerializeSpilledConstants()
+{
+    // Not enough VPM space is left to spill all the constants live across the loop, so the spill step alone can only
+    // fix the register errors if it rematerializes the constants
+    std::vector<qpu_asm::RegisterFixupStep> steps;
+    for(const auto& step : qpu_asm::FIXUP_STEPS)
+    {
+        if(step.name == "Spill locals")
+            steps.emplace_back(step);
+    }
+
+    RegisterFixEmulationRunner runner(config, std::move(steps), precompilationCache);
+    auto result = test_data::execute(test_data::getTest("constants_register_pressure"), runner);
+    TEST_ASSERT(result.wasSuccess)
+    if(!result.error.empty())
+        TEST_ASSERT_EQUALS("(no error)", result.error);
+}
+
 void TestRegisterFixes::checkTestQuality()
 {
     // It is likely (and accepted) that some tests fail to compile with some register fix-up steps. To still be able to
@@ -158,7 +268,7 @@ void TestRegisterFixes::checkTestQuality()
     // applied
     for(const auto& entry : fixupPasses)
     {
-        printf("Register fix-up step '%s' applied %zu times and compiled %zu out of 13 kernels successfully\n",
+        printf("Register fix-up step '%s' applied %zu times and compiled %zu out of 14 kernels successfully\n",
             entry.first.data(), entry.second.second, entry.second.first);
         if(entry.second.first == 0)
             TEST_ASSERT_EQUALS("",
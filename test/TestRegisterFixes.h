@@ -21,6 +21,8 @@ public:
     ~TestRegisterFixes() override;
 
     void testRegisterFix(std::string entryName, std::string stepName);
+    void testIncrementalGraphUpdate(std::string entryName);
+    void testRematerializeSpilledConstants();
     void checkTestQuality();
 
 private:
@@ -0,0 +1,417 @@
+/*
+ * Author: doe300
+ *
+ * See the file "LICENSE" for the full license governing this code.
+ */
+
+#include "CompilationError.h"
+#include "CompilerInstance.h"
+#include "Precompiler.h"
+#include "optimization/Optimizer.h"
+#include "tools/Emulator.h"
+#include "tools/SlabAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <new>
+#include <sstream>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace vc4c;
+
+/*
+ * Replace the global allocation functions to count the number of allocations done by the compiler (in total and per
+ * optimization pass)
+ */
+static std::atomic<uint64_t> numAllocations{0};
+static std::atomic<uint64_t> numAllocatedBytes{0};
+
+void* operator new(std::size_t size)
+{
+    ++numAllocations;
+    numAllocatedBytes += size;
+    optimizations::Optimizer::recordPassAllocation();
+    if(auto ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+struct CorpusEntry
+{
+    std::string file;
+    std::string options;
+};
+
+/*
+ * The default benchmark corpus, a selection of real-world kernels known to be compiled successfully
+ */
+static const std::vector<CorpusEntry> DEFAULT_CORPUS = {
+    {TESTING_FILES "rodinia/backprop_kernel.cl", ""},
+    {TESTING_FILES "rodinia/bfs-Kernels.cl", ""},
+    {TESTING_FILES "rodinia/cfd-Kernels.cl", ""},
+    {TESTING_FILES "rodinia/gaussianElim_kernels.cl", ""},
+    {TESTING_FILES "rodinia/hotspot_kernel.cl", ""},
+    {TESTING_FILES "rodinia/kmeans.cl", ""},
+    {TESTING_FILES "rodinia/lud_kernel.cl", ""},
+    {TESTING_FILES "BabelStream/OCLStream.cl", ""},
+    {TESTING_FILES "clpeak/compute_integer_kernels.cl", ""},
+    {TESTING_FILES "clpeak/compute_sp_kernels.cl", ""},
+    {TESTING_FILES "clpeak/global_bandwidth_kernels.cl", ""},
+    {TESTING_FILES "hashcat/m00000_a0-optimized.cl", "-I" TESTING_FILES "hashcat/"},
+    {TESTING_FILES "OpenCV/gemm.cl", "-DT=float8 -DLOCAL_SIZE=16 -DWT=float8 -DT1=float"},
+    {TESTING_FILES "OpenCV/flip.cl", "-DT=short16 -DPIX_PER_WI_Y=4"},
+    {TESTING_FILES "OpenCV/lut.cl", "-Dlcn=1 -Ddcn=3 -DdstT=uint8 -DsrcT=short16"},
+};
+
+/*
+ * The resources used by a single compilation stage. For multiple iterations, the minimum values are kept.
+ */
+struct StageResult
+{
+    std::chrono::microseconds wallTime{std::numeric_limits<std::chrono::microseconds::rep>::max()};
+    // the resident set size of the process after the stage
+    long rss = std::numeric_limits<long>::max();
+    // the change of the resident set size of the process by the stage
+    long rssDelta = std::numeric_limits<long>::max();
+    // the memory reserved by the pools of all methods after the stage
+    std::size_t poolReservedBytes = 0;
+    uint64_t allocations = std::numeric_limits<uint64_t>::max();
+    uint64_t allocatedBytes = std::numeric_limits<uint64_t>::max();
+};
+
+struct EntryResult
+{
+    CorpusEntry entry;
+    std::string error;
+    std::vector<std::pair<std::string, StageResult>> stages;
+    std::map<std::string, optimizations::PassStatistics> passes;
+    std::size_t outputSize = 0;
+};
+
+/*
+ * Returns the peak resident set size of the whole process (in KiB)
+ */
+static long getPeakRSS()
+{
+    rusage usage{};
+    if(getrusage(RUSAGE_SELF, &usage) < 0)
+        return 0;
+    return usage.ru_maxrss;
+}
+
+/*
+ * Returns the current resident set size of the process (in KiB)
+ */
+static long getCurrentRSS()
+{
+    std::ifstream statm{"/proc/self/statm"};
+    long totalPages = 0;
+    long residentPages = 0;
+    if(!(statm >> totalPages >> residentPages))
+        return 0;
+    return residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void runStage(
+    EntryResult& result, std::size_t index, const std::string& name, const std::function<void()>& stage)
+{
+    auto rssBefore = getCurrentRSS();
+    auto allocations = numAllocations.load();
+    auto allocatedBytes = numAllocatedBytes.load();
+    auto start = std::chrono::steady_clock::now();
+    stage();
+    auto wallTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    allocations = numAllocations.load() - allocations;
+    allocatedBytes = numAllocatedBytes.load() - allocatedBytes;
+    auto rssAfter = getCurrentRSS();
+
+    // only add the stage after it succeeded to not report partial results
+    if(result.stages.size() <= index)
+        result.stages.emplace_back(name, StageResult{});
+    auto& stageResult = result.stages[index].second;
+    stageResult.wallTime = std::min(stageResult.wallTime, wallTime);
+    stageResult.rss = std::min(stageResult.rss, rssAfter);
+    stageResult.rssDelta = std::min(stageResult.rssDelta, rssAfter - rssBefore);
+    stageResult.poolReservedBytes = std::max(stageResult.poolReservedBytes, tools::SlabPool::getTotalReservedSize());
+    stageResult.allocations = std::min(stageResult.allocations, allocations);
+    stageResult.allocatedBytes = std::min(stageResult.allocatedBytes, allocatedBytes);
+}
+
+static void runEntry(EntryResult& result, const Configuration& config, bool pipelined)
+{
+    CompilationData input{result.entry.file};
+    CompilationData intermediate{};
+    CompilerInstance instance{config};
+
+    runStage(result, 0, "precompile",
+        [&]() { intermediate = Precompiler::precompile(input, config, result.entry.options); });
+    runStage(result, 1, "parse", [&]() { instance.parseInput(intermediate); });
+    optimizations::Optimizer::getPassStatistics(true);
+    if(pipelined)
+    {
+        // all kernels are processed independently of each other, so the single stages cannot be measured separately
+        runStage(result, 2, "compile", [&]() {
+            std::stringstream output;
+            result.outputSize = instance.compileKernels(output);
+        });
+    }
+    else
+    {
+        runStage(result, 2, "normalize", [&]() { instance.normalize(); });
+        runStage(result, 3, "optimize", [&]() { instance.optimize(); });
+    }
+    for(const auto& pass : optimizations::Optimizer::getPassStatistics(true))
+    {
+        auto& stats = result.passes[pass.first];
+        stats.duration =
+            stats.invocations == 0 ? pass.second.duration : std::min(stats.duration, pass.second.duration);
+        stats.allocations =
+            stats.invocations == 0 ? pass.second.allocations : std::min(stats.allocations, pass.second.allocations);
+        stats.invocations = pass.second.invocations;
+        stats.changes = pass.second.changes;
+    }
+    if(pipelined)
+        return;
+    runStage(result, 4, "adjust", [&]() { instance.adjust(); });
+    runStage(result, 5, "codegen", [&]() {
+        std::stringstream output;
+        result.outputSize = instance.generateCode(output);
+    });
+}
+
+static std::string escapeJSON(const std::string& s)
+{
+    std::string result;
+    result.reserve(s.size());
+    for(auto c : s)
+    {
+        if(c == '"' || c == '\\')
+        {
+            result.push_back('\\');
+            result.push_back(c);
+        }
+        else if(c == '\n')
+            result.append("\\n");
+        else if(static_cast<unsigned char>(c) < 0x20)
+            result.push_back(' ');
+        else
+            result.push_back(c);
+    }
+    return result;
+}
+
+static void writeJSON(std::ostream& out, const std::vector<EntryResult>& results, const Configuration& config,
+    unsigned iterations, bool pipelined, std::chrono::microseconds totalTime)
+{
+    out << "{\n";
+    out << "  \"optimization_level\": " << static_cast<unsigned>(config.optimizationLevel) << ",\n";
+    out << "  \"iterations\": " << iterations << ",\n";
+    out << "  \"pipelined\": " << (pipelined ? "true" : "false") << ",\n";
+    out << "  \"total_wall_time_us\": " << totalTime.count() << ",\n";
+    out << "  \"peak_rss_kb\": " << getPeakRSS() << ",\n";
+    out << "  \"entries\": [";
+    for(std::size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& result = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\n";
+        out << "      \"file\": \"" << escapeJSON(result.entry.file) << "\",\n";
+        out << "      \"options\": \"" << escapeJSON(result.entry.options) << "\",\n";
+        if(!result.error.empty())
+            out << "      \"error\": \"" << escapeJSON(result.error) << "\",\n";
+        out << "      \"output_bytes\": " << result.outputSize << ",\n";
+        out << "      \"stages\": {";
+        for(std::size_t k = 0; k < result.stages.size(); ++k)
+        {
+            const auto& stage = result.stages[k].second;
+            out << (k == 0 ? "\n" : ",\n") << "        \"" << result.stages[k].first << "\": {"
+                << "\"wall_time_us\": " << stage.wallTime.count() << ", \"rss_kb\": " << stage.rss
+                << ", \"rss_delta_kb\": " << stage.rssDelta
+                << ", \"pool_reserved_bytes\": " << stage.poolReservedBytes
+                << ", \"allocations\": " << stage.allocations << ", \"allocated_bytes\": " << stage.allocatedBytes
+                << "}";
+        }
+        out << "\n      },\n";
+        out << "      \"passes\": {";
+        bool first = true;
+        for(const auto& pass : result.passes)
+        {
+            out << (first ? "\n" : ",\n") << "        \"" << escapeJSON(pass.first) << "\": {"
+                << "\"wall_time_us\": "
+                << std::chrono::duration_cast<std::chrono::microseconds>(pass.second.duration).count()
+                << ", \"invocations\": " << pass.second.invocations << ", \"changes\": " << pass.second.changes
+                << ", \"allocations\": " << pass.second.allocations << "}";
+            first = false;
+        }
+        out << "\n      }\n";
+        out << "    }";
+    }
+    out << "\n  ]\n";
+    out << "}" << std::endl;
+}
+
+/*
+ * The number of repetitions of the register access pattern per iteration of the register benchmark
+ */
+static constexpr uint32_t REGISTER_BENCHMARK_ROUNDS = 1024 * 1024;
+
+/*
+ * Reads and writes the registers of an emulated QPU and reports the host time spent per register access, without the
+ * overhead of decoding and executing any instructions
+ */
+static bool runRegisterBenchmark(std::ostream& out, unsigned iterations)
+{
+    std::chrono::nanoseconds duration{std::numeric_limits<std::chrono::nanoseconds::rep>::max()};
+    uint64_t numAccesses = 0;
+    for(unsigned i = 0; i < iterations; ++i)
+    {
+        std::chrono::nanoseconds iterationDuration{};
+        numAccesses = tools::benchmarkRegisterAccesses(REGISTER_BENCHMARK_ROUNDS, iterationDuration);
+        duration = std::min(duration, iterationDuration);
+    }
+
+    out << "{\n";
+    out << "  \"benchmark\": \"registers\",\n";
+    out << "  \"iterations\": " << iterations << ",\n";
+    out << "  \"register_accesses\": " << numAccesses << ",\n";
+    out << "  \"wall_time_us\": " << std::chrono::duration_cast<std::chrono::microseconds>(duration).count() << ",\n";
+    out << "  \"time_per_access_ns\": "
+        << (numAccesses == 0 ? 0.0 : static_cast<double>(duration.count()) / static_cast<double>(numAccesses)) << "\n";
+    out << "}" << std::endl;
+    return true;
+}
+
+static void printHelp()
+{
+    std::cout << "Usage: vc4c_bench [options] [input-files...]" << std::endl;
+    std::cout << "Compiles the given input files (or a default corpus of real-world kernels, if no files are given) "
+                 "and reports the resources used per compilation stage and optimization pass as JSON"
+              << std::endl;
+    std::cout << "\t-O0, -O1, -O2, -O3\tSets the optimization level to benchmark, defaults to -O2" << std::endl;
+    std::cout << "\t--iterations=<n>\tCompiles every input <n> times and reports the minimum values, defaults to 1"
+              << std::endl;
+    std::cout << "\t--options=<options>\tPasses the given options to the compilation of the input files" << std::endl;
+    std::cout << "\t--pipelined\t\tCompiles all kernels of an input independently of each other, measuring only the "
+                 "combined compilation"
+              << std::endl;
+    std::cout << "\t--output=<file>\t\tWrites the JSON result into the given file instead of the standard output"
+              << std::endl;
+    std::cout << "\t--registers\t\tInstead of compiling, reads and writes the registers of an emulated QPU and "
+                 "reports the time spent per register access"
+              << std::endl;
+    std::cout << "\t-h, --help\t\tPrint this help message" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    setLogger(std::wcerr, false, LogLevel::WARNING);
+
+    Configuration config{};
+    unsigned iterations = 1;
+    bool pipelined = false;
+    bool registerBenchmark = false;
+    std::string options;
+    std::string outputFile;
+    std::vector<std::string> inputFiles;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg == "-h" || arg == "--help")
+        {
+            printHelp();
+            return 0;
+        }
+        else if(arg == "-O0")
+            config.optimizationLevel = OptimizationLevel::NONE;
+        else if(arg == "-O1")
+            config.optimizationLevel = OptimizationLevel::BASIC;
+        else if(arg == "-O2")
+            config.optimizationLevel = OptimizationLevel::MEDIUM;
+        else if(arg == "-O3")
+            config.optimizationLevel = OptimizationLevel::FULL;
+        else if(arg.find("--iterations=") == 0)
+            iterations = std::max(1u, static_cast<unsigned>(std::stoul(arg.substr(arg.find('=') + 1))));
+        else if(arg.find("--options=") == 0)
+            options = arg.substr(arg.find('=') + 1);
+        else if(arg == "--pipelined")
+            pipelined = true;
+        else if(arg == "--registers")
+            registerBenchmark = true;
+        else if(arg.find("--output=") == 0)
+            outputFile = arg.substr(arg.find('=') + 1);
+        else if(arg.find('-') == 0)
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printHelp();
+            return 1;
+        }
+        else
+            inputFiles.emplace_back(arg);
+    }
+
+    if(registerBenchmark)
+    {
+        if(outputFile.empty())
+            return runRegisterBenchmark(std::cout, iterations) ? 0 : 1;
+        std::ofstream fos{outputFile};
+        return runRegisterBenchmark(fos, iterations) ? 0 : 1;
+    }
+
+    std::vector<EntryResult> results;
+    if(inputFiles.empty())
+    {
+        for(const auto& entry : DEFAULT_CORPUS)
+            results.emplace_back(EntryResult{entry, "", {}, {}, 0});
+    }
+    for(const auto& file : inputFiles)
+        results.emplace_back(EntryResult{CorpusEntry{file, options}, "", {}, {}, 0});
+
+    optimizations::Optimizer::setCollectPassStatistics(true);
+    bool anyFailed = false;
+    auto start = std::chrono::steady_clock::now();
+    for(auto& result : results)
+    {
+        std::cerr << "Compiling " << result.entry.file << "..." << std::endl;
+        for(unsigned i = 0; i < iterations && result.error.empty(); ++i)
+        {
+            try
+            {
+                runEntry(result, config, pipelined);
+            }
+            catch(const std::exception& e)
+            {
+                result.error = e.what();
+                anyFailed = true;
+            }
+        }
+    }
+    auto totalTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    if(outputFile.empty())
+        writeJSON(std::cout, results, config, iterations, pipelined, totalTime);
+    else
+    {
+        std::ofstream fos{outputFile};
+        writeJSON(fos, results, config, iterations, pipelined, totalTime);
+    }
+    return anyFailed ? 1 : 0;
+}
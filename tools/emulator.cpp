@@ -4,6 +4,7 @@
  * See the file "LICENSE" for the full license governing this code.
  */
 
+#include "tools/EmulationTrace.h"
 #include "tools/Emulator.h"
 #include "Compiler.h"
 #include "Locals.h"
@@ -163,8 +164,16 @@ static void printHelp()
                  "defaults to single execution"
               << std::endl;
     std::cout << "\t-i <dump-file>\t\tWrites the result of the instrumentation into the file specified" << std::endl;
+    std::cout << "\t-t <trace-file>\t\tRecords a binary trace of the execution into the file specified" << std::endl;
+    std::cout << "\t-p <profile-file>\tWrites the profile of the kernel in the callgrind format into the file specified"
+              << std::endl;
     std::cout << "\t-o <number>\t\tSpecifies the given parameter index as output and prints it when finished"
               << std::endl;
+    std::cout << "\t--functional\t\tRun the faster functional emulation instead of the cycle-accurate one"
+              << std::endl;
+    std::cout << "\t--parallel\t\tRun the functional emulation with every QPU on its own thread" << std::endl;
+    std::cout << "\t--relaxed\t\tDo not enforce a deterministic order of shared accesses in the parallel emulation"
+              << std::endl;
     std::cout << "\t-h, --help\t\tPrint this help message" << std::endl;
     std::cout << "\t-q, --quiet\t\tQuiet all debug output" << std::endl;
     std::cout << "\t--verbose\t\tPrint verbose debug output" << std::endl;
@@ -182,6 +191,43 @@ static void printHelp()
                  "passed space-separated inside a string (double-quotes, e.g. \"0.0 1.0 2.0 3.0 ...\")"
               << std::endl;
     std::cout << "\t<data>\t\t\tUse <data> as input word" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Usage: emulator --replay [--group <index>] [--qpu <index>] [--until <cycle>] trace-file" << std::endl;
+    std::cout << "\tPrints the recorded events and the resulting register contents of a previously recorded trace"
+              << std::endl;
+    std::cout << "Usage: emulator --compare first-trace-file second-trace-file" << std::endl;
+    std::cout << "\tCompares two traces and prints the first differing event of every QPU" << std::endl;
+}
+
+static int replayTrace(int argc, char** argv)
+{
+    TraceFilter filter;
+    for(int i = 2; i < argc - 1; ++i)
+    {
+        if(std::string("--group") == argv[i])
+        {
+            ++i;
+            filter.group = static_cast<uint32_t>(std::strtol(argv[i], nullptr, 0));
+        }
+        else if(std::string("--qpu") == argv[i])
+        {
+            ++i;
+            filter.qpu = static_cast<uint8_t>(std::strtol(argv[i], nullptr, 0));
+        }
+        else if(std::string("--until") == argv[i])
+        {
+            ++i;
+            filter.lastCycle = static_cast<uint32_t>(std::strtol(argv[i], nullptr, 0));
+        }
+        else
+        {
+            std::cerr << "Unknown replay option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    TraceReader trace(argv[argc - 1]);
+    printTrace(std::cout, trace, filter);
+    return 0;
 }
 
 int main(int argc, char** argv)
@@ -198,6 +244,20 @@ int main(int argc, char** argv)
         return 0;
     }
 
+    if(std::string("--replay") == argv[1])
+        return replayTrace(argc, argv);
+    if(std::string("--compare") == argv[1])
+    {
+        if(argc != 4)
+        {
+            printHelp();
+            return 1;
+        }
+        TraceReader first(argv[2]);
+        TraceReader second(argv[3]);
+        return compareTraces(std::cout, first, second) ? 0 : 2;
+    }
+
     EmulationData data;
 
     data.workGroup.dimensions = 1;
@@ -250,6 +310,16 @@ int main(int argc, char** argv)
             ++i;
             data.instrumentationDump = argv[i];
         }
+        else if(std::string("-t") == argv[i])
+        {
+            ++i;
+            data.traceDump = argv[i];
+        }
+        else if(std::string("-p") == argv[i])
+        {
+            ++i;
+            data.profileDump = argv[i];
+        }
         else if(std::string("-f") == argv[i])
         {
             ++i;
@@ -296,6 +366,19 @@ int main(int argc, char** argv)
         {
             setLogger(std::wcout, true, LogLevel::WARNING);
         }
+        else if(std::string("--functional") == argv[i])
+        {
+            data.functionalEmulation = true;
+        }
+        else if(std::string("--parallel") == argv[i])
+        {
+            data.functionalEmulation = true;
+            data.parallelEmulation = true;
+        }
+        else if(std::string("--relaxed") == argv[i])
+        {
+            data.relaxedSynchronization = true;
+        }
         else if(std::string("--verbose") == argv[i])
         {
             setLogger(std::wcout, true, LogLevel::DEBUG);